@@ -0,0 +1,146 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Multi-buffer ChaCha library interface, x86_64 AVX2 and AVX-512VL glue
+ *
+ * chacha_crypt_arch() vectorizes over the blocks of a single message, so
+ * for messages of one or two blocks most of the SIMD width is idle.  Here
+ * each ymm lane holds the state of a different message instead, and up to
+ * eight messages get one keystream block each per call.  Whatever is left
+ * once fewer than two messages remain goes to chacha_crypt_arch().
+ */
+
+#include <crypto/algapi.h>
+#include <crypto/chacha.h>
+#include <crypto/internal/simd.h>
+#include <linux/jump_label.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/sizes.h>
+#include <asm/simd.h>
+
+#define CHACHA_MB_LANES		8
+/* Bound the time spent with preemption disabled to ~4 KiB of keystream */
+#define CHACHA_MB_FPU_ROUNDS	(SZ_4K / (CHACHA_MB_LANES * CHACHA_BLOCK_SIZE))
+
+asmlinkage void chacha_8lane_avx2(u32 *out, const u32 *in, int nrounds);
+asmlinkage void chacha_8lane_avx512vl(u32 *out, const u32 *in, int nrounds);
+
+static __ro_after_init DEFINE_STATIC_KEY_FALSE(chacha_use_avx2);
+static __ro_after_init DEFINE_STATIC_KEY_FALSE(chacha_use_avx512vl);
+
+static void chacha_8lane(u32 *out, const u32 *in, int nrounds)
+{
+	if (IS_ENABLED(CONFIG_AS_AVX512) &&
+	    static_branch_likely(&chacha_use_avx512vl))
+		chacha_8lane_avx512vl(out, in, nrounds);
+	else
+		chacha_8lane_avx2(out, in, nrounds);
+}
+
+static void chacha_dolanes(u32 (*state)[CHACHA_STATE_WORDS], u8 **dst,
+			   const u8 **src, unsigned int *left, unsigned int n,
+			   int nrounds)
+{
+	u32 in[CHACHA_STATE_WORDS][CHACHA_MB_LANES];
+	u32 out[CHACHA_STATE_WORDS][CHACHA_MB_LANES];
+	u8 stream[CHACHA_BLOCK_SIZE] __aligned(sizeof(long));
+	unsigned int lane[CHACHA_MB_LANES];
+	unsigned int i, j, w, l, active, rounds = 0;
+
+	/* Idle lanes compute garbage that is never used */
+	memset(in, 0, sizeof(in));
+
+	kernel_fpu_begin();
+	for (;;) {
+		active = 0;
+		for (i = 0; i < n; i++)
+			if (left[i])
+				lane[active++] = i;
+		if (active < 2)
+			break;
+
+		for (j = 0; j < active; j++)
+			for (w = 0; w < CHACHA_STATE_WORDS; w++)
+				in[w][j] = state[lane[j]][w];
+
+		chacha_8lane(&out[0][0], &in[0][0], nrounds);
+
+		for (j = 0; j < active; j++) {
+			i = lane[j];
+			l = min_t(unsigned int, left[i], CHACHA_BLOCK_SIZE);
+			for (w = 0; w < CHACHA_STATE_WORDS; w++)
+				put_unaligned_le32(out[w][j], stream + w * 4);
+			crypto_xor_cpy(dst[i], src[i], stream, l);
+			dst[i] += l;
+			src[i] += l;
+			left[i] -= l;
+			state[i][12]++;
+		}
+
+		if (++rounds == CHACHA_MB_FPU_ROUNDS) {
+			kernel_fpu_end();
+			kernel_fpu_begin();
+			rounds = 0;
+		}
+	}
+	kernel_fpu_end();
+
+	memzero_explicit(in, sizeof(in));
+	memzero_explicit(out, sizeof(out));
+	memzero_explicit(stream, sizeof(stream));
+}
+
+void chacha_crypt_mb_arch(u32 (*state)[CHACHA_STATE_WORDS], u8 **dst,
+			  const u8 **src, const unsigned int *bytes,
+			  unsigned int n, int nrounds)
+{
+	unsigned int left[CHACHA_MB_LANES];
+	const u8 *s[CHACHA_MB_LANES];
+	u8 *d[CHACHA_MB_LANES];
+	unsigned int i, m;
+
+	for (; n; n -= m, state += m, dst += m, src += m, bytes += m) {
+		m = min_t(unsigned int, n, CHACHA_MB_LANES);
+		for (i = 0; i < m; i++) {
+			d[i] = dst[i];
+			s[i] = src[i];
+			left[i] = bytes[i];
+		}
+
+		if (static_branch_likely(&chacha_use_avx2) && m > 1 &&
+		    crypto_simd_usable())
+			chacha_dolanes(state, d, s, left, m, nrounds);
+
+		for (i = 0; i < m; i++)
+			if (left[i])
+				chacha_crypt_arch(state[i], d[i], s[i], left[i],
+						  nrounds);
+	}
+}
+EXPORT_SYMBOL(chacha_crypt_mb_arch);
+
+static int __init chacha_mb_simd_mod_init(void)
+{
+	if (!boot_cpu_has(X86_FEATURE_AVX) || !boot_cpu_has(X86_FEATURE_AVX2) ||
+	    !cpu_has_xfeatures(XFEATURE_MASK_SSE | XFEATURE_MASK_YMM, NULL))
+		return 0;
+
+	static_branch_enable(&chacha_use_avx2);
+
+	if (IS_ENABLED(CONFIG_AS_AVX512) &&
+	    boot_cpu_has(X86_FEATURE_AVX512VL) &&
+	    cpu_has_xfeatures(XFEATURE_MASK_AVX512, NULL))
+		static_branch_enable(&chacha_use_avx512vl);
+
+	return 0;
+}
+
+static void __exit chacha_mb_simd_mod_fini(void)
+{
+}
+
+module_init(chacha_mb_simd_mod_init);
+module_exit(chacha_mb_simd_mod_fini);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Multi-buffer ChaCha library functions (x86_64 AVX2/AVX-512VL)");
@@ -43,6 +43,8 @@ static void public_key_describe(const struct key *asymmetric_key,
 void public_key_free(struct public_key *key)
 {
 	if (key) {
+		if (key->tfm)
+			crypto_free_akcipher(key->tfm);
 		kfree(key->key);
 		kfree(key->params);
 		kfree(key);
@@ -372,22 +374,106 @@ static inline int cert_sig_digest_update(
 #endif /* ! IS_REACHABLE(CONFIG_CRYPTO_SM2) */
 
 /*
- * Verify a signature using a public key.
+ * Allocate an akcipher transform of the named algorithm and load the key into
+ * it.
  */
-int public_key_verify_signature(const struct public_key *pkey,
-				const struct public_key_signature *sig)
+static struct crypto_akcipher *
+public_key_alloc_tfm(const struct public_key *pkey, const char *alg_name)
 {
-	struct crypto_wait cwait;
+	struct crypto_akcipher *tfm;
+	char *key, *ptr;
+	int ret;
+
+	tfm = crypto_alloc_akcipher(alg_name, 0, 0);
+	if (IS_ERR(tfm))
+		return tfm;
+
+	ret = -ENOMEM;
+	key = kmalloc(pkey->keylen + sizeof(u32) * 2 + pkey->paramlen,
+		      GFP_KERNEL);
+	if (!key)
+		goto error_free_tfm;
+
+	memcpy(key, pkey->key, pkey->keylen);
+	ptr = key + pkey->keylen;
+	ptr = pkey_pack_u32(ptr, pkey->algo);
+	ptr = pkey_pack_u32(ptr, pkey->paramlen);
+	memcpy(ptr, pkey->params, pkey->paramlen);
+
+	if (pkey->key_is_private)
+		ret = crypto_akcipher_set_priv_key(tfm, key, pkey->keylen);
+	else
+		ret = crypto_akcipher_set_pub_key(tfm, key, pkey->keylen);
+	kfree(key);
+	if (ret)
+		goto error_free_tfm;
+	return tfm;
+
+error_free_tfm:
+	crypto_free_akcipher(tfm);
+	return ERR_PTR(ret);
+}
+
+/*
+ * Get a keyed transform for verifying with the key.  Loading the key is most
+ * of the cost of verifying a single signature (parsing it and setting up the
+ * per-key arithmetic), so the first transform made for a key is kept in the
+ * key and shared by all later verifications that use the same algorithm.
+ * Signature verification doesn't modify the transform, so sharing it between
+ * concurrent callers is fine, except for SM2 which keeps scratch state in it.
+ *
+ * *_owned is set if the caller has to free the transform when done.
+ */
+static struct crypto_akcipher *
+public_key_get_tfm(const struct public_key *pkey, const char *alg_name,
+		   bool *_owned)
+{
+	struct crypto_akcipher *tfm;
+	bool cacheable = strcmp(pkey->pkey_algo, "sm2") != 0;
+
+	tfm = smp_load_acquire(&pkey->tfm);
+	if (tfm && strcmp(crypto_tfm_alg_name(crypto_akcipher_tfm(tfm)),
+			  alg_name) == 0) {
+		*_owned = false;
+		return tfm;
+	}
+
+	tfm = public_key_alloc_tfm(pkey, alg_name);
+	if (IS_ERR(tfm))
+		return tfm;
+
+	/* The cache slot is the one part of the key that changes after it is
+	 * set up, and it is only ever filled once.
+	 */
+	*_owned = !cacheable ||
+		  cmpxchg_release(&((struct public_key *)pkey)->tfm, NULL, tfm);
+	return tfm;
+}
+
+/*
+ * The state of one signature verification between issuing the request and
+ * collecting its result.
+ */
+struct public_key_verify_req {
 	struct crypto_akcipher *tfm;
 	struct akcipher_request *req;
+	struct crypto_wait cwait;
 	struct scatterlist src_sg[2];
-	char alg_name[CRYPTO_MAX_ALG_NAME];
-	char *key, *ptr;
+	bool tfm_owned;
 	int ret;
+};
 
-	pr_devel("==>%s()\n", __func__);
+/*
+ * Issue the request to verify a signature.  Returns the akcipher result, which
+ * may be -EINPROGRESS or -EBUSY, for public_key_verify_finish() to wait on.
+ */
+static int public_key_verify_start(const struct public_key *pkey,
+				   const struct public_key_signature *sig,
+				   struct public_key_verify_req *vr)
+{
+	char alg_name[CRYPTO_MAX_ALG_NAME];
+	int ret;
 
-	BUG_ON(!pkey);
 	BUG_ON(!sig);
 	BUG_ON(!sig->s);
 
@@ -411,63 +497,119 @@ int public_key_verify_signature(const struct public_key *pkey,
 	if (ret < 0)
 		return ret;
 
-	tfm = crypto_alloc_akcipher(alg_name, 0, 0);
-	if (IS_ERR(tfm))
-		return PTR_ERR(tfm);
-
-	ret = -ENOMEM;
-	req = akcipher_request_alloc(tfm, GFP_KERNEL);
-	if (!req)
-		goto error_free_tfm;
-
-	key = kmalloc(pkey->keylen + sizeof(u32) * 2 + pkey->paramlen,
-		      GFP_KERNEL);
-	if (!key)
-		goto error_free_req;
-
-	memcpy(key, pkey->key, pkey->keylen);
-	ptr = key + pkey->keylen;
-	ptr = pkey_pack_u32(ptr, pkey->algo);
-	ptr = pkey_pack_u32(ptr, pkey->paramlen);
-	memcpy(ptr, pkey->params, pkey->paramlen);
+	vr->tfm = public_key_get_tfm(pkey, alg_name, &vr->tfm_owned);
+	if (IS_ERR(vr->tfm)) {
+		ret = PTR_ERR(vr->tfm);
+		vr->tfm = NULL;
+		return ret;
+	}
 
-	if (pkey->key_is_private)
-		ret = crypto_akcipher_set_priv_key(tfm, key, pkey->keylen);
-	else
-		ret = crypto_akcipher_set_pub_key(tfm, key, pkey->keylen);
-	if (ret)
-		goto error_free_key;
+	vr->req = akcipher_request_alloc(vr->tfm, GFP_KERNEL);
+	if (!vr->req)
+		return -ENOMEM;
 
 	if (strcmp(pkey->pkey_algo, "sm2") == 0 && sig->data_size) {
-		ret = cert_sig_digest_update(sig, tfm);
+		ret = cert_sig_digest_update(sig, vr->tfm);
 		if (ret)
-			goto error_free_key;
+			return ret;
 	}
 
-	sg_init_table(src_sg, 2);
-	sg_set_buf(&src_sg[0], sig->s, sig->s_size);
-	sg_set_buf(&src_sg[1], sig->digest, sig->digest_size);
-	akcipher_request_set_crypt(req, src_sg, NULL, sig->s_size,
+	sg_init_table(vr->src_sg, 2);
+	sg_set_buf(&vr->src_sg[0], sig->s, sig->s_size);
+	sg_set_buf(&vr->src_sg[1], sig->digest, sig->digest_size);
+	akcipher_request_set_crypt(vr->req, vr->src_sg, NULL, sig->s_size,
 				   sig->digest_size);
-	crypto_init_wait(&cwait);
-	akcipher_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG |
+	crypto_init_wait(&vr->cwait);
+	akcipher_request_set_callback(vr->req, CRYPTO_TFM_REQ_MAY_BACKLOG |
 				      CRYPTO_TFM_REQ_MAY_SLEEP,
-				      crypto_req_done, &cwait);
-	ret = crypto_wait_req(crypto_akcipher_verify(req), &cwait);
+				      crypto_req_done, &vr->cwait);
+	return crypto_akcipher_verify(vr->req);
+}
 
-error_free_key:
-	kfree(key);
-error_free_req:
-	akcipher_request_free(req);
-error_free_tfm:
-	crypto_free_akcipher(tfm);
-	pr_devel("<==%s() = %d\n", __func__, ret);
+/*
+ * Wait for a request issued by public_key_verify_start() and release it.
+ */
+static int public_key_verify_finish(struct public_key_verify_req *vr)
+{
+	int ret = vr->ret;
+
+	if (vr->req) {
+		ret = crypto_wait_req(ret, &vr->cwait);
+		akcipher_request_free(vr->req);
+	}
+	if (vr->tfm && vr->tfm_owned)
+		crypto_free_akcipher(vr->tfm);
 	if (WARN_ON_ONCE(ret > 0))
 		ret = -EINVAL;
 	return ret;
 }
+
+/*
+ * Verify a signature using a public key.
+ */
+int public_key_verify_signature(const struct public_key *pkey,
+				const struct public_key_signature *sig)
+{
+	struct public_key_verify_req vr = {};
+	int ret;
+
+	pr_devel("==>%s()\n", __func__);
+
+	BUG_ON(!pkey);
+
+	vr.ret = public_key_verify_start(pkey, sig, &vr);
+	ret = public_key_verify_finish(&vr);
+	pr_devel("<==%s() = %d\n", __func__, ret);
+	return ret;
+}
 EXPORT_SYMBOL_GPL(public_key_verify_signature);
 
+/**
+ * public_key_verify_signatures - Verify a batch of signatures with one key
+ * @pkey: The public key.
+ * @sigs: The signatures to check.
+ * @nr_sigs: The number of signatures.
+ * @results: Where to store the result for each signature (may be NULL).
+ *
+ * All the requests are issued before any of them is waited for, so that an
+ * asynchronous akcipher implementation can work on them in parallel, and
+ * they all share the keyed transform cached in @pkey.
+ *
+ * Returns 0 if every signature verified, otherwise the first error.
+ */
+int public_key_verify_signatures(const struct public_key *pkey,
+				 const struct public_key_signature *const *sigs,
+				 unsigned int nr_sigs, int *results)
+{
+	struct public_key_verify_req *vr;
+	unsigned int i;
+	int ret = 0, err;
+
+	pr_devel("==>%s(,,%u)\n", __func__, nr_sigs);
+
+	BUG_ON(!pkey);
+
+	vr = kcalloc(nr_sigs, sizeof(*vr), GFP_KERNEL);
+	if (!vr)
+		return -ENOMEM;
+
+	for (i = 0; i < nr_sigs; i++)
+		vr[i].ret = public_key_verify_start(pkey, sigs[i], &vr[i]);
+
+	for (i = 0; i < nr_sigs; i++) {
+		err = public_key_verify_finish(&vr[i]);
+		if (results)
+			results[i] = err;
+		if (err && !ret)
+			ret = err;
+	}
+
+	kfree(vr);
+	pr_devel("<==%s() = %d\n", __func__, ret);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(public_key_verify_signatures);
+
 static int public_key_verify_signature_2(const struct key *key,
 					 const struct public_key_signature *sig)
 {
@@ -475,6 +617,14 @@ static int public_key_verify_signature_2(const struct key *key,
 	return public_key_verify_signature(pk, sig);
 }
 
+static int public_key_verify_signatures_2(const struct key *key,
+				const struct public_key_signature *const *sigs,
+				unsigned int nr_sigs, int *results)
+{
+	const struct public_key *pk = key->payload.data[asym_crypto];
+	return public_key_verify_signatures(pk, sigs, nr_sigs, results);
+}
+
 /*
  * Public key algorithm asymmetric key subtype
  */
@@ -487,5 +637,6 @@ struct asymmetric_key_subtype public_key_subtype = {
 	.query			= software_key_query,
 	.eds_op			= software_key_eds_op,
 	.verify_signature	= public_key_verify_signature_2,
+	.verify_signatures	= public_key_verify_signatures_2,
 };
 EXPORT_SYMBOL_GPL(public_key_subtype);
@@ -7,7 +7,10 @@
 #include <linux/kernel.h>
 #include <linux/cred.h>
 #include <linux/key.h>
+#include <linux/slab.h>
+#include <keys/asymmetric-type.h>
 #include <crypto/pkcs7.h>
+#include <crypto/public_key.h>
 #include "x509_parser.h"
 
 struct certs_test {
@@ -175,6 +178,66 @@ static const struct certs_test certs_tests[] __initconst = {
 	TEST(certs_selftest_1_data, certs_selftest_1_pkcs7),
 };
 
+/*
+ * Check a batch of signatures made with the self-testing key: the
+ * certificate's own signature twice, with a corrupted copy in between.  Only
+ * the corrupted one may fail, and the batch must reuse the keyed transform
+ * that checking the self-signature left cached in the key.
+ */
+static void __init fips_signature_batch_selftest(struct key *keyring)
+{
+	const struct public_key_signature *sigs[3];
+	struct public_key_signature bad;
+	struct crypto_akcipher *tfm;
+	struct x509_certificate *cert;
+	struct key *key;
+	int results[3];
+	int ret;
+
+	cert = x509_cert_parse(certs_selftest_keys,
+			       sizeof(certs_selftest_keys) - 1);
+	if (IS_ERR(cert))
+		panic("Certs batch selftest: x509_cert_parse() = %ld\n",
+		      PTR_ERR(cert));
+
+	tfm = cert->pub->tfm;
+	if (!cert->self_signed || !tfm)
+		panic("Certs batch selftest: no cached transform\n");
+
+	bad = *cert->sig;
+	bad.digest = kmemdup(cert->sig->digest, cert->sig->digest_size,
+			     GFP_KERNEL);
+	if (!bad.digest)
+		panic("Certs batch selftest: out of memory\n");
+	bad.digest[0] ^= 0x01;
+
+	sigs[0] = cert->sig;
+	sigs[1] = &bad;
+	sigs[2] = cert->sig;
+
+	ret = public_key_verify_signatures(cert->pub, sigs, 3, results);
+	if (ret >= 0 || results[0] || results[1] != ret || results[2])
+		panic("Certs batch selftest: public_key_verify_signatures() = %d (%d, %d, %d)\n",
+		      ret, results[0], results[1], results[2]);
+	if (cert->pub->tfm != tfm)
+		panic("Certs batch selftest: cached transform not reused\n");
+
+	/* The same through the key loaded into the keyring */
+	key = find_asymmetric_key(keyring, cert->id, NULL, NULL, false);
+	if (IS_ERR(key))
+		panic("Certs batch selftest: find_asymmetric_key() = %ld\n",
+		      PTR_ERR(key));
+
+	ret = verify_signatures(key, sigs, 3, results);
+	if (ret >= 0 || results[0] || results[1] != ret || results[2])
+		panic("Certs batch selftest: verify_signatures() = %d (%d, %d, %d)\n",
+		      ret, results[0], results[1], results[2]);
+
+	key_put(key);
+	kfree(bad.digest);
+	x509_free_certificate(cert);
+}
+
 int __init fips_signature_selftest(void)
 {
 	struct key *keyring;
@@ -219,6 +282,8 @@ int __init fips_signature_selftest(void)
 		pkcs7_free_message(pkcs7);
 	}
 
+	fips_signature_batch_selftest(keyring);
+
 	key_put(keyring);
 	return 0;
 }
@@ -157,3 +157,50 @@ int verify_signature(const struct key *key,
 	return ret;
 }
 EXPORT_SYMBOL_GPL(verify_signature);
+
+/**
+ * verify_signatures - Verify a batch of signatures made with one key
+ * @key: The asymmetric key to verify against
+ * @sigs: The signatures to check
+ * @nr_sigs: The number of signatures
+ * @results: Where to store the result for each signature (may be NULL)
+ *
+ * Like calling verify_signature() on each signature, but lets the subtype
+ * share its per-key setup across the batch.  Returns 0 if every signature
+ * verified, otherwise the first error.
+ */
+int verify_signatures(const struct key *key,
+		      const struct public_key_signature *const *sigs,
+		      unsigned int nr_sigs, int *results)
+{
+	const struct asymmetric_key_subtype *subtype;
+	unsigned int i;
+	int ret = 0, err;
+
+	pr_devel("==>%s()\n", __func__);
+
+	if (key->type != &key_type_asymmetric)
+		return -EINVAL;
+	subtype = asymmetric_key_subtype(key);
+	if (!subtype ||
+	    !key->payload.data[0])
+		return -EINVAL;
+
+	if (subtype->verify_signatures) {
+		ret = subtype->verify_signatures(key, sigs, nr_sigs, results);
+	} else {
+		if (!subtype->verify_signature)
+			return -ENOTSUPP;
+		for (i = 0; i < nr_sigs; i++) {
+			err = subtype->verify_signature(key, sigs[i]);
+			if (results)
+				results[i] = err;
+			if (err && !ret)
+				ret = err;
+		}
+	}
+
+	pr_devel("<==%s() = %d\n", __func__, ret);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(verify_signatures);
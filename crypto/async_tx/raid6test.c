@@ -8,9 +8,14 @@
  */
 #include <linux/async_tx.h>
 #include <linux/gfp.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 #include <linux/mm.h>
 #include <linux/random.h>
 #include <linux/module.h>
+#include <linux/raid/pq.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
 
 #undef pr
 #define pr(fmt, args...) pr_info("raid6test: " fmt, ##args)
@@ -188,6 +193,150 @@ static int test(int disks, int *tests)
 	return err;
 }
 
+/*
+ * Generate the syndromes of several stripes at once from different cpus,
+ * the way md submits them, so that an engine which runs operations in
+ * parallel is exercised with concurrent dependency chains.
+ */
+#define STRIPE_DISKS 16 /* Including P and Q */
+#define STRIPES 16
+#define WORKERS 8
+
+struct stripe_worker {
+	struct work_struct work;
+	struct page *pages[STRIPES][STRIPE_DISKS];
+	unsigned int offs[STRIPE_DISKS];
+	addr_conv_t addr_conv[STRIPE_DISKS];
+	struct completion cmp[STRIPES];
+	const char *chan;
+	int err;
+};
+
+static void stripe_work(struct work_struct *work)
+{
+	struct stripe_worker *w = container_of(work, struct stripe_worker, work);
+	struct dma_async_tx_descriptor *tx;
+	struct async_submit_ctl submit;
+	int s;
+
+	for (s = 0; s < STRIPES; s++) {
+		init_completion(&w->cmp[s]);
+		init_async_submit(&submit, ASYNC_TX_ACK, NULL, callback,
+				  &w->cmp[s], w->addr_conv);
+		tx = async_gen_syndrome(w->pages[s], w->offs, STRIPE_DISKS,
+					PAGE_SIZE, &submit);
+		if (!s)
+			w->chan = tx ? dma_chan_name(tx->chan) : "synchronous";
+		async_tx_issue_pending(tx);
+	}
+
+	for (s = 0; s < STRIPES; s++)
+		if (wait_for_completion_timeout(&w->cmp[s],
+						msecs_to_jiffies(3000)) == 0)
+			w->err++;
+}
+
+static int stripe_verify(struct stripe_worker *w, struct page *p,
+			 struct page *q)
+{
+	void *ptrs[STRIPE_DISKS];
+	int s, i, err = 0;
+
+	for (s = 0; s < STRIPES; s++) {
+		for (i = 0; i < STRIPE_DISKS - 2; i++)
+			ptrs[i] = page_address(w->pages[s][i]);
+		ptrs[i++] = page_address(p);
+		ptrs[i] = page_address(q);
+		raid6_call.gen_syndrome(STRIPE_DISKS, PAGE_SIZE, ptrs);
+
+		if (memcmp(page_address(p),
+			   page_address(w->pages[s][STRIPE_DISKS - 2]),
+			   PAGE_SIZE) ||
+		    memcmp(page_address(q),
+			   page_address(w->pages[s][STRIPE_DISKS - 1]),
+			   PAGE_SIZE))
+			err++;
+	}
+
+	return err;
+}
+
+static void stripe_workers_free(struct stripe_worker *w, int nr)
+{
+	int n, s, i;
+
+	for (n = 0; n < nr; n++)
+		for (s = 0; s < STRIPES; s++)
+			for (i = 0; i < STRIPE_DISKS; i++)
+				if (w[n].pages[s][i])
+					put_page(w[n].pages[s][i]);
+	kfree(w);
+}
+
+static int test_stripes(int *tests)
+{
+	struct stripe_worker *w;
+	int nr = 0, err = 0;
+	int cpu, n, s, i;
+	ktime_t start;
+	u64 ns;
+
+	w = kcalloc(WORKERS, sizeof(*w), GFP_KERNEL);
+	if (!w)
+		return 1;
+
+	for_each_online_cpu(cpu) {
+		if (nr == WORKERS)
+			break;
+		INIT_WORK(&w[nr].work, stripe_work);
+		for (s = 0; s < STRIPES; s++)
+			for (i = 0; i < STRIPE_DISKS; i++) {
+				w[nr].pages[s][i] = alloc_page(GFP_KERNEL);
+				if (!w[nr].pages[s][i]) {
+					stripe_workers_free(w, nr + 1);
+					return 1;
+				}
+				get_random_bytes(page_address(w[nr].pages[s][i]),
+						 PAGE_SIZE);
+			}
+		nr++;
+	}
+
+	pr("testing %d stripes of %d disks on %d cpus...\n",
+	   nr * STRIPES, STRIPE_DISKS, nr);
+
+	start = ktime_get();
+	n = 0;
+	for_each_online_cpu(cpu) {
+		if (n == nr)
+			break;
+		schedule_work_on(cpu, &w[n++].work);
+	}
+	for (n = 0; n < nr; n++)
+		flush_work(&w[n].work);
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	for (n = 0; n < nr; n++) {
+		(*tests)++;
+		if (w[n].err) {
+			pr("%s: worker %d: timeout!\n", __func__, n);
+			err++;
+			continue;
+		}
+		/* the pages of the single stripe tests serve as scratch */
+		if (stripe_verify(&w[n], data[0], data[1])) {
+			pr("%s: worker %d: validation failure!\n", __func__, n);
+			err++;
+		}
+	}
+
+	pr("%s: %s: %llu MB/s\n", __func__, w[0].chan,
+	   div64_u64((u64)nr * STRIPES * (STRIPE_DISKS - 2) * PAGE_SIZE * 1000,
+		     ns ?: 1));
+
+	stripe_workers_free(w, nr);
+	return err;
+}
 
 static int __init raid6_test(void)
 {
@@ -226,6 +375,8 @@ static int __init raid6_test(void)
 
 	err += test(NDISKS, &tests);
 
+	err += test_stripes(&tests);
+
 	pr("\n");
 	pr("complete (%d tests, %d failure%s)\n",
 	   tests, err, err == 1 ? "" : "s");
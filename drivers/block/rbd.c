@@ -342,6 +342,10 @@ struct rbd_img_request {
 	struct list_head	lock_item;
 	struct list_head	object_extents;	/* obj_req.ex structs */
 
+	struct list_head	batch_item;	/* rbd_queue or merged_reqs */
+	struct list_head	merged_reqs;	/* coalesced block requests */
+	struct bio_vec		*merged_bvecs;
+
 	struct mutex		state_mutex;
 	struct pending_result	pending;
 	struct work_struct	work;
@@ -375,6 +379,16 @@ struct rbd_mapping {
 	u64                     size;
 };
 
+/*
+ * Per hardware queue batch of block requests, handed off to rbd_wq
+ * once blk-mq is done dispatching (bd->last or ->commit_rqs()).
+ */
+struct rbd_queue {
+	spinlock_t		lock;
+	struct list_head	rqs;		/* img_req.batch_item */
+	struct work_struct	work;
+};
+
 /*
  * a single device
  */
@@ -438,6 +452,7 @@ struct rbd_device {
 
 	/* Block layer tags. */
 	struct blk_mq_tag_set	tag_set;
+	struct rbd_queue	*queues;	/* per hardware queue */
 
 	/* protects updating the header */
 	struct rw_semaphore     header_rwsem;
@@ -1575,6 +1590,8 @@ static void rbd_img_request_init(struct rbd_img_request *img_request,
 
 	INIT_LIST_HEAD(&img_request->lock_item);
 	INIT_LIST_HEAD(&img_request->object_extents);
+	INIT_LIST_HEAD(&img_request->batch_item);
+	INIT_LIST_HEAD(&img_request->merged_reqs);
 	mutex_init(&img_request->state_mutex);
 }
 
@@ -1610,6 +1627,8 @@ static void rbd_img_request_destroy(struct rbd_img_request *img_request)
 	if (rbd_img_is_write(img_request))
 		ceph_put_snap_context(img_request->snapc);
 
+	kvfree(img_request->merged_bvecs);
+
 	if (test_bit(IMG_REQ_CHILD, &img_request->flags))
 		kmem_cache_free(rbd_img_request_cache, img_request);
 }
@@ -3568,6 +3587,22 @@ static bool __rbd_img_handle_request(struct rbd_img_request *img_req,
 	return done;
 }
 
+/*
+ * End the block request backing @img_req, along with any block
+ * requests that were coalesced into it.
+ */
+static void rbd_img_end_request(struct rbd_img_request *img_req, int result)
+{
+	blk_status_t status = errno_to_blk_status(result);
+	struct rbd_img_request *merged_req, *next;
+
+	list_for_each_entry_safe(merged_req, next, &img_req->merged_reqs,
+				 batch_item)
+		blk_mq_end_request(blk_mq_rq_from_pdu(merged_req), status);
+
+	blk_mq_end_request(blk_mq_rq_from_pdu(img_req), status);
+}
+
 static void rbd_img_handle_request(struct rbd_img_request *img_req, int result)
 {
 again:
@@ -3583,10 +3618,8 @@ static void rbd_img_handle_request(struct rbd_img_request *img_req, int result)
 			goto again;
 		}
 	} else {
-		struct request *rq = blk_mq_rq_from_pdu(img_req);
-
 		rbd_img_request_destroy(img_req);
-		blk_mq_end_request(rq, errno_to_blk_status(result));
+		rbd_img_end_request(img_req, result);
 	}
 }
 
@@ -4631,13 +4664,12 @@ static int rbd_obj_method_sync(struct rbd_device *rbd_dev,
 	return ret;
 }
 
-static void rbd_queue_workfn(struct work_struct *work)
+static void rbd_queue_img_request(struct rbd_img_request *img_request)
 {
-	struct rbd_img_request *img_request =
-	    container_of(work, struct rbd_img_request, work);
 	struct rbd_device *rbd_dev = img_request->rbd_dev;
 	enum obj_operation_type op_type = img_request->op_type;
 	struct request *rq = blk_mq_rq_from_pdu(img_request);
+	struct rbd_img_request *merged_req;
 	u64 offset = (u64)blk_rq_pos(rq) << SECTOR_SHIFT;
 	u64 length = blk_rq_bytes(rq);
 	u64 mapping_size;
@@ -4651,6 +4683,13 @@ static void rbd_queue_workfn(struct work_struct *work)
 	}
 
 	blk_mq_start_request(rq);
+	list_for_each_entry(merged_req, &img_request->merged_reqs,
+			    batch_item) {
+		struct request *merged_rq = blk_mq_rq_from_pdu(merged_req);
+
+		blk_mq_start_request(merged_rq);
+		length += blk_rq_bytes(merged_rq);
+	}
 
 	down_read(&rbd_dev->header_rwsem);
 	mapping_size = rbd_dev->mapping.size;
@@ -4667,11 +4706,17 @@ static void rbd_queue_workfn(struct work_struct *work)
 	dout("%s rbd_dev %p img_req %p %s %llu~%llu\n", __func__, rbd_dev,
 	     img_request, obj_op_name(op_type), offset, length);
 
-	if (op_type == OBJ_OP_DISCARD || op_type == OBJ_OP_ZEROOUT)
+	if (op_type == OBJ_OP_DISCARD || op_type == OBJ_OP_ZEROOUT) {
 		result = rbd_img_fill_nodata(img_request, offset, length);
-	else
+	} else if (img_request->merged_bvecs) {
+		struct ceph_file_extent ex = { offset, length };
+
+		result = rbd_img_fill_from_bvecs(img_request, &ex, 1,
+						 img_request->merged_bvecs);
+	} else {
 		result = rbd_img_fill_from_bio(img_request, offset, length,
 					       rq->bio);
+	}
 	if (result)
 		goto err_img_request;
 
@@ -4683,13 +4728,100 @@ static void rbd_queue_workfn(struct work_struct *work)
 	if (result)
 		rbd_warn(rbd_dev, "%s %llx at %llx result %d",
 			 obj_op_name(op_type), length, offset, result);
-	blk_mq_end_request(rq, errno_to_blk_status(result));
+	rbd_img_end_request(img_request, result);
+}
+
+/*
+ * Coalesce writes that follow @img_req in @batch and continue it
+ * within the same object into @img_req, so that they go out as a
+ * single OSD write.  Only non-fancy layouts are handled: with
+ * striping, contiguous image extents don't map to contiguous object
+ * extents.
+ */
+static void rbd_img_coalesce_writes(struct rbd_img_request *img_req,
+				    struct list_head *batch)
+{
+	struct rbd_device *rbd_dev = img_req->rbd_dev;
+	struct request *rq = blk_mq_rq_from_pdu(img_req);
+	u32 object_size = rbd_dev->layout.object_size;
+	u64 off = (u64)blk_rq_pos(rq) << SECTOR_SHIFT;
+	u64 end = off + blk_rq_bytes(rq);
+	struct rbd_img_request *next_req, *n;
+	struct req_iterator iter;
+	struct bio_vec bv, *bvecs;
+	u32 bvec_cnt = 0;
+	u32 i = 0;
+
+	if (img_req->op_type != OBJ_OP_WRITE || !blk_rq_bytes(rq) ||
+	    rbd_layout_is_fancy(&rbd_dev->layout))
+		return;
+
+	list_for_each_entry_safe(next_req, n, batch, batch_item) {
+		struct request *next_rq = blk_mq_rq_from_pdu(next_req);
+		u64 next_off = (u64)blk_rq_pos(next_rq) << SECTOR_SHIFT;
+		u64 next_end = next_off + blk_rq_bytes(next_rq);
+
+		if (next_req->op_type != OBJ_OP_WRITE || next_off != end ||
+		    next_end == next_off ||
+		    div_u64(off, object_size) !=
+		    div_u64(next_end - 1, object_size))
+			break;
+
+		end = next_end;
+		list_move_tail(&next_req->batch_item, &img_req->merged_reqs);
+	}
+	if (list_empty(&img_req->merged_reqs))
+		return;
+
+	rq_for_each_bvec(bv, rq, iter)
+		bvec_cnt++;
+	list_for_each_entry(next_req, &img_req->merged_reqs, batch_item)
+		rq_for_each_bvec(bv, blk_mq_rq_from_pdu(next_req), iter)
+			bvec_cnt++;
+
+	bvecs = kvmalloc_array(bvec_cnt, sizeof(*bvecs), GFP_NOIO);
+	if (!bvecs) {
+		/* not fatal, submit them one by one */
+		list_splice_init(&img_req->merged_reqs, batch);
+		return;
+	}
+
+	rq_for_each_bvec(bv, rq, iter)
+		bvecs[i++] = bv;
+	list_for_each_entry(next_req, &img_req->merged_reqs, batch_item)
+		rq_for_each_bvec(bv, blk_mq_rq_from_pdu(next_req), iter)
+			bvecs[i++] = bv;
+	rbd_assert(i == bvec_cnt);
+
+	dout("%s img_req %p %llu~%llu bvec_cnt %u\n", __func__, img_req, off,
+	     end - off, bvec_cnt);
+	img_req->merged_bvecs = bvecs;
+}
+
+static void rbd_queue_workfn(struct work_struct *work)
+{
+	struct rbd_queue *rbd_q = container_of(work, struct rbd_queue, work);
+	struct rbd_img_request *img_req;
+	LIST_HEAD(batch);
+
+	spin_lock(&rbd_q->lock);
+	list_splice_init(&rbd_q->rqs, &batch);
+	spin_unlock(&rbd_q->lock);
+
+	while ((img_req = list_first_entry_or_null(&batch,
+						   struct rbd_img_request,
+						   batch_item))) {
+		list_del_init(&img_req->batch_item);
+		rbd_img_coalesce_writes(img_req, &batch);
+		rbd_queue_img_request(img_req);
+	}
 }
 
 static blk_status_t rbd_queue_rq(struct blk_mq_hw_ctx *hctx,
 		const struct blk_mq_queue_data *bd)
 {
 	struct rbd_device *rbd_dev = hctx->queue->queuedata;
+	struct rbd_queue *rbd_q = hctx->driver_data;
 	struct rbd_img_request *img_req = blk_mq_rq_to_pdu(bd->rq);
 	enum obj_operation_type op_type;
 
@@ -4722,14 +4854,68 @@ static blk_status_t rbd_queue_rq(struct blk_mq_hw_ctx *hctx,
 		rbd_assert(!rbd_is_snap(rbd_dev));
 	}
 
-	INIT_WORK(&img_req->work, rbd_queue_workfn);
-	queue_work(rbd_wq, &img_req->work);
+	spin_lock(&rbd_q->lock);
+	list_add_tail(&img_req->batch_item, &rbd_q->rqs);
+	spin_unlock(&rbd_q->lock);
+
+	if (bd->last)
+		queue_work(rbd_wq, &rbd_q->work);
 	return BLK_STS_OK;
 }
 
+static void rbd_commit_rqs(struct blk_mq_hw_ctx *hctx)
+{
+	struct rbd_queue *rbd_q = hctx->driver_data;
+
+	queue_work(rbd_wq, &rbd_q->work);
+}
+
+static int rbd_init_hctx(struct blk_mq_hw_ctx *hctx, void *data,
+			 unsigned int hctx_idx)
+{
+	struct rbd_device *rbd_dev = data;
+
+	hctx->driver_data = &rbd_dev->queues[hctx_idx];
+	return 0;
+}
+
+static int rbd_alloc_queues(struct rbd_device *rbd_dev)
+{
+	unsigned int nr_queues = rbd_dev->tag_set.nr_hw_queues;
+	unsigned int i;
+
+	rbd_dev->queues = kcalloc(nr_queues, sizeof(*rbd_dev->queues),
+				  GFP_KERNEL);
+	if (!rbd_dev->queues)
+		return -ENOMEM;
+
+	for (i = 0; i < nr_queues; i++) {
+		spin_lock_init(&rbd_dev->queues[i].lock);
+		INIT_LIST_HEAD(&rbd_dev->queues[i].rqs);
+		INIT_WORK(&rbd_dev->queues[i].work, rbd_queue_workfn);
+	}
+	return 0;
+}
+
+static void rbd_free_queues(struct rbd_device *rbd_dev)
+{
+	unsigned int i;
+
+	if (!rbd_dev->queues)
+		return;
+
+	for (i = 0; i < rbd_dev->tag_set.nr_hw_queues; i++) {
+		WARN_ON(!list_empty(&rbd_dev->queues[i].rqs));
+		flush_work(&rbd_dev->queues[i].work);
+	}
+	kfree(rbd_dev->queues);
+	rbd_dev->queues = NULL;
+}
+
 static void rbd_free_disk(struct rbd_device *rbd_dev)
 {
 	put_disk(rbd_dev->disk);
+	rbd_free_queues(rbd_dev);
 	blk_mq_free_tag_set(&rbd_dev->tag_set);
 	rbd_dev->disk = NULL;
 }
@@ -4890,6 +5076,8 @@ static int rbd_dev_refresh(struct rbd_device *rbd_dev)
 
 static const struct blk_mq_ops rbd_mq_ops = {
 	.queue_rq	= rbd_queue_rq,
+	.commit_rqs	= rbd_commit_rqs,
+	.init_hctx	= rbd_init_hctx,
 };
 
 static int rbd_init_disk(struct rbd_device *rbd_dev)
@@ -4907,15 +5095,20 @@ static int rbd_init_disk(struct rbd_device *rbd_dev)
 	rbd_dev->tag_set.flags = BLK_MQ_F_SHOULD_MERGE;
 	rbd_dev->tag_set.nr_hw_queues = num_present_cpus();
 	rbd_dev->tag_set.cmd_size = sizeof(struct rbd_img_request);
+	rbd_dev->tag_set.driver_data = rbd_dev;
 
 	err = blk_mq_alloc_tag_set(&rbd_dev->tag_set);
 	if (err)
 		return err;
 
+	err = rbd_alloc_queues(rbd_dev);
+	if (err)
+		goto out_tag_set;
+
 	disk = blk_mq_alloc_disk(&rbd_dev->tag_set, rbd_dev);
 	if (IS_ERR(disk)) {
 		err = PTR_ERR(disk);
-		goto out_tag_set;
+		goto out_queues;
 	}
 	q = disk->queue;
 
@@ -4952,6 +5145,8 @@ static int rbd_init_disk(struct rbd_device *rbd_dev)
 	rbd_dev->disk = disk;
 
 	return 0;
+out_queues:
+	rbd_free_queues(rbd_dev);
 out_tag_set:
 	blk_mq_free_tag_set(&rbd_dev->tag_set);
 	return err;
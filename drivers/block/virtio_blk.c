@@ -80,11 +80,16 @@ struct virtio_blk {
 	int num_vqs;
 	int io_queues[HCTX_MAX_TYPES];
 	struct virtio_blk_vq *vqs;
+
+	/* Ranges the device takes in one write zeroes command */
+	unsigned int max_write_zeroes_segs;
 };
 
 struct virtblk_req {
 	struct virtio_blk_outhdr out_hdr;
 	u8 status;
+	/* Discards or write zeroes sent to the device along with this one */
+	struct request *merged;
 	struct sg_table sg_table;
 	struct scatterlist sg[];
 };
@@ -130,20 +135,18 @@ static int virtblk_add_req(struct virtqueue *vq, struct virtblk_req *vbr)
 	return virtqueue_add_sgs(vq, sgs, num_out, num_in, vbr, GFP_ATOMIC);
 }
 
-static int virtblk_setup_discard_write_zeroes_erase(struct request *req, bool unmap)
+static inline struct request *virtblk_merged_next(struct request *req)
 {
-	unsigned short segments = blk_rq_nr_discard_segments(req);
-	unsigned short n = 0;
-	struct virtio_blk_discard_write_zeroes *range;
-	struct bio *bio;
-	u32 flags = 0;
+	struct virtblk_req *vbr = blk_mq_rq_to_pdu(req);
 
-	if (unmap)
-		flags |= VIRTIO_BLK_WRITE_ZEROES_FLAG_UNMAP;
+	return vbr->merged;
+}
 
-	range = kmalloc_array(segments, sizeof(*range), GFP_ATOMIC);
-	if (!range)
-		return -ENOMEM;
+static unsigned short virtblk_setup_ranges(struct request *req,
+		struct virtio_blk_discard_write_zeroes *range, u32 flags)
+{
+	unsigned short n = 0;
+	struct bio *bio;
 
 	/*
 	 * Single max discard segment means multi-range discard isn't
@@ -168,6 +171,31 @@ static int virtblk_setup_discard_write_zeroes_erase(struct request *req, bool un
 		}
 	}
 
+	return n;
+}
+
+static int virtblk_setup_discard_write_zeroes_erase(struct request *req, bool unmap)
+{
+	unsigned short segments = blk_rq_nr_discard_segments(req);
+	struct virtio_blk_discard_write_zeroes *range;
+	unsigned short n;
+	struct request *m;
+	u32 flags = 0;
+
+	if (unmap)
+		flags |= VIRTIO_BLK_WRITE_ZEROES_FLAG_UNMAP;
+
+	for (m = virtblk_merged_next(req); m; m = virtblk_merged_next(m))
+		segments += blk_rq_nr_discard_segments(m);
+
+	range = kmalloc_array(segments, sizeof(*range), GFP_ATOMIC);
+	if (!range)
+		return -ENOMEM;
+
+	n = virtblk_setup_ranges(req, range, flags);
+	for (m = virtblk_merged_next(req); m; m = virtblk_merged_next(m))
+		n += virtblk_setup_ranges(m, range + n, flags);
+
 	WARN_ON_ONCE(n != segments);
 
 	req->special_vec.bv_page = virt_to_page(range);
@@ -263,12 +291,36 @@ static blk_status_t virtblk_setup_cmd(struct virtio_device *vdev,
 	return 0;
 }
 
+/* The requests merged into another one share its fate. */
+static void virtblk_end_merged(struct virtblk_req *vbr, blk_status_t status)
+{
+	struct request *req = vbr->merged, *next;
+
+	vbr->merged = NULL;
+	for (; req; req = next) {
+		next = virtblk_merged_next(req);
+		blk_mq_end_request(req, status);
+	}
+}
+
+static void virtblk_requeue_merged(struct virtblk_req *vbr)
+{
+	struct request *req = vbr->merged, *next;
+
+	vbr->merged = NULL;
+	for (; req; req = next) {
+		next = virtblk_merged_next(req);
+		blk_mq_requeue_request(req, true);
+	}
+}
+
 static inline void virtblk_request_done(struct request *req)
 {
 	struct virtblk_req *vbr = blk_mq_rq_to_pdu(req);
 
 	virtblk_unmap_data(req, vbr);
 	virtblk_cleanup_cmd(req);
+	virtblk_end_merged(vbr, virtblk_result(vbr));
 	blk_mq_end_request(req, virtblk_result(vbr));
 }
 
@@ -362,6 +414,7 @@ static blk_status_t virtio_queue_rq(struct blk_mq_hw_ctx *hctx,
 	blk_status_t status;
 	int err;
 
+	vbr->merged = NULL;
 	status = virtblk_prep_rq(hctx, vblk, req, vbr);
 	if (unlikely(status))
 		return status;
@@ -389,14 +442,90 @@ static blk_status_t virtio_queue_rq(struct blk_mq_hw_ctx *hctx,
 	return BLK_STS_OK;
 }
 
+static bool virtblk_can_merge(struct request *req, struct request *next,
+			      unsigned short segments)
+{
+	struct virtio_blk *vblk = req->q->queuedata;
+	unsigned int max_segments;
+
+	if (req->mq_hctx != next->mq_hctx || req_op(req) != req_op(next))
+		return false;
+
+	switch (req_op(req)) {
+	case REQ_OP_DISCARD:
+		max_segments = queue_max_discard_segments(req->q);
+		break;
+	case REQ_OP_WRITE_ZEROES:
+		if ((req->cmd_flags ^ next->cmd_flags) & REQ_NOUNMAP)
+			return false;
+		max_segments = vblk->max_write_zeroes_segs;
+		break;
+	default:
+		return false;
+	}
+
+	/* A single segment means the device doesn't take multiple ranges. */
+	return max_segments > 1 &&
+	       segments + blk_rq_nr_discard_segments(next) <= max_segments;
+}
+
+/*
+ * Take the discards or write zeroes that follow @req in the list into it,
+ * so that they reach the device as a single multi-range command.  Returns
+ * the request now following @req.
+ */
+static struct request *virtblk_merge_rqs(struct request *req,
+					 struct request *next)
+{
+	struct virtblk_req *vbr = blk_mq_rq_to_pdu(req);
+	unsigned short segments = blk_rq_nr_discard_segments(req);
+	struct request **tail = &vbr->merged;
+
+	vbr->merged = NULL;
+	while (next && virtblk_can_merge(req, next, segments)) {
+		struct virtblk_req *next_vbr = blk_mq_rq_to_pdu(next);
+
+		segments += blk_rq_nr_discard_segments(next);
+		req->rq_next = next->rq_next;
+		*tail = next;
+		tail = &next_vbr->merged;
+		*tail = NULL;
+		next = req->rq_next;
+	}
+
+	return next;
+}
+
+/* Give back the requests merged into @req, which failed to be prepared. */
+static void virtblk_unmerge_rqs(struct request *req, struct request **rqlist)
+{
+	struct virtblk_req *vbr = blk_mq_rq_to_pdu(req);
+	struct request *m = vbr->merged, *next;
+
+	vbr->merged = NULL;
+	for (; m; m = next) {
+		next = virtblk_merged_next(m);
+		rq_list_add(rqlist, m);
+	}
+}
+
 static bool virtblk_prep_rq_batch(struct request *req)
 {
 	struct virtio_blk *vblk = req->mq_hctx->queue->queuedata;
 	struct virtblk_req *vbr = blk_mq_rq_to_pdu(req);
+	struct request *m;
 
 	req->mq_hctx->tags->rqs[req->tag] = req;
 
-	return virtblk_prep_rq(req->mq_hctx, vblk, req, vbr) == BLK_STS_OK;
+	if (virtblk_prep_rq(req->mq_hctx, vblk, req, vbr) != BLK_STS_OK)
+		return false;
+
+	for (m = vbr->merged; m; m = virtblk_merged_next(m)) {
+		m->mq_hctx->tags->rqs[m->tag] = m;
+		blk_mq_start_request(m);
+	}
+
+	return true;
 }
 
 static bool virtblk_add_req_batch(struct virtio_blk_vq *vq,
@@ -416,6 +545,7 @@ static bool virtblk_add_req_batch(struct virtio_blk_vq *vq,
 		if (err) {
 			virtblk_unmap_data(req, vbr);
 			virtblk_cleanup_cmd(req);
+			virtblk_requeue_merged(vbr);
 			blk_mq_requeue_request(req, true);
 		}
 	}
@@ -435,7 +565,9 @@ static void virtio_queue_rqs(struct request **rqlist)
 		struct virtio_blk_vq *vq = get_virtio_blk_vq(req->mq_hctx);
 		bool kick;
 
+		next = virtblk_merge_rqs(req, next);
 		if (!virtblk_prep_rq_batch(req)) {
+			virtblk_unmerge_rqs(req, &requeue_list);
 			rq_list_move(rqlist, &requeue_list, req, prev);
 			req = prev;
 			if (!req)
@@ -863,7 +995,8 @@ static int virtblk_poll(struct blk_mq_hw_ctx *hctx, struct io_comp_batch *iob)
 		struct request *req = blk_mq_rq_from_pdu(vbr);
 
 		found++;
-		if (!blk_mq_add_to_batch(req, iob, vbr->status,
+		/* Requests merged into this one are ended along with it. */
+		if (vbr->merged || !blk_mq_add_to_batch(req, iob, vbr->status,
 						virtblk_complete_batch))
 			blk_mq_complete_request(req);
 	}
@@ -934,6 +1067,7 @@ static int virtblk_probe(struct virtio_device *vdev)
 	mutex_init(&vblk->vdev_mutex);
 
 	vblk->vdev = vdev;
+	vblk->max_write_zeroes_segs = 0;
 
 	INIT_WORK(&vblk->config_work, virtblk_config_changed_work);
 
@@ -1068,6 +1202,10 @@ static int virtblk_probe(struct virtio_device *vdev)
 		virtio_cread(vdev, struct virtio_blk_config,
 			     max_write_zeroes_sectors, &v);
 		blk_queue_max_write_zeroes_sectors(q, v ? v : UINT_MAX);
+
+		virtio_cread(vdev, struct virtio_blk_config,
+			     max_write_zeroes_seg, &v);
+		vblk->max_write_zeroes_segs = min(v, MAX_DISCARD_SEGMENTS);
 	}
 
 	/* The discard and secure erase limits are combined since the Linux
@@ -0,0 +1,730 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Software offload engine for the async_tx API
+ *
+ * Without an offload engine async_tx runs every memcpy, xor and raid6
+ * syndrome operation synchronously on the submitting thread, so an md
+ * raid5/6 array computes all of its parity on the one thread handling the
+ * stripe.  This driver registers a dmaengine device per NUMA node whose
+ * channels execute those operations on the CPU, from an unbound workqueue
+ * running on the channel's node.  dmaengine hands out channels per CPU,
+ * and async_tx keeps a dependency chain on the channel of its first
+ * operation, so independent stripes submitted from different CPUs are
+ * computed in parallel while each chain still executes in order.
+ *
+ * Channels "transfer" through the direct mapping: a DMA address is turned
+ * back into a kernel virtual address with dma_to_phys().  That is only
+ * valid for cache coherent DMA without highmem, which the Kconfig entry
+ * enforces.
+ *
+ * A thread polling for a descriptor that has not completed yet runs the
+ * channel's queue itself rather than spinning, so a chain never waits for
+ * a busy worker pool.  Completion callbacks always run from the worker.
+ */
+
+#include <linux/cpumask.h>
+#include <linux/dma-direct.h>
+#include <linux/dma-mapping.h>
+#include <linux/dmaengine.h>
+#include <linux/init.h>
+#include <linux/interrupt.h>
+#include <linux/mempool.h>
+#include <linux/module.h>
+#include <linux/overflow.h>
+#include <linux/platform_device.h>
+#include <linux/raid/pq.h>
+#include <linux/raid/xor.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/topology.h>
+#include <linux/workqueue.h>
+
+#include "dmaengine.h"
+
+#define CPU_DMA_MAX_SRCS	255
+/* Operations are computed in chunks that fit the scratch buffers */
+#define CPU_DMA_CHUNK		PAGE_SIZE
+/*
+ * Descriptors kept in reserve per channel.  async_xor() and friends retry
+ * the prep call until it succeeds, so a descriptor must become available
+ * again without any allocation succeeding, as it does once the ones in
+ * flight complete and are acked.
+ */
+#define CPU_DMA_POOL_DESCS	16
+
+static unsigned int chans_per_node;
+module_param(chans_per_node, uint, 0444);
+MODULE_PARM_DESC(chans_per_node,
+		 "Channels per NUMA node (default: number of CPUs in the node)");
+
+struct cpu_dma_desc {
+	struct dma_async_tx_descriptor txd;
+	struct list_head node;
+	enum dma_transaction_type type;
+	enum dma_ctrl_flags flags;
+	enum sum_check_flags *result;
+	size_t len;
+	dma_addr_t dst[2];
+	unsigned char *scf;		/* follows src[] for pq operations */
+	unsigned int src_cnt;
+	dma_addr_t src[];
+};
+
+struct cpu_dma_chan {
+	struct dma_chan chan;
+	struct work_struct work;
+	int node;
+	/* Owner of the queue and the buffers below, see cpu_dma_run() */
+	unsigned long running;
+	void *scratch[2];
+	void *srcs[CPU_DMA_MAX_SRCS];
+	void *stripe[CPU_DMA_MAX_SRCS + 2];
+	mempool_t *pool;		/* of CPU_DMA_DESC_SIZE descriptors */
+
+	spinlock_t lock;
+	struct list_head submitted;	/* waiting for issue_pending */
+	struct list_head issued;	/* waiting to be executed */
+	struct list_head done;		/* executed, callback pending */
+	struct list_head completed;	/* waiting for the client's ack */
+};
+
+struct cpu_dma_device {
+	struct dma_device dma;
+	struct platform_device *pdev;
+	unsigned int nr_chans;
+	struct cpu_dma_chan chans[];
+};
+
+/* Room for the largest descriptor, with src[] and scf[] */
+#define CPU_DMA_DESC_SIZE						\
+	(struct_size((struct cpu_dma_desc *)NULL, src, CPU_DMA_MAX_SRCS) + \
+	 CPU_DMA_MAX_SRCS)
+
+static struct workqueue_struct *cpu_dma_wq;
+static struct cpu_dma_device **cpu_dma_devs;
+
+static inline struct cpu_dma_chan *to_cpu_dma_chan(struct dma_chan *chan)
+{
+	return container_of(chan, struct cpu_dma_chan, chan);
+}
+
+static inline struct cpu_dma_desc *
+to_cpu_dma_desc(struct dma_async_tx_descriptor *txd)
+{
+	return container_of(txd, struct cpu_dma_desc, txd);
+}
+
+static void *cpu_dma_addr(struct cpu_dma_chan *c, dma_addr_t addr)
+{
+	return phys_to_virt(dma_to_phys(c->chan.device->dev, addr));
+}
+
+static void cpu_dma_xor(void *dst, void **srcs, unsigned int src_cnt,
+			size_t len)
+{
+	unsigned int n;
+
+	while (src_cnt) {
+		n = min_t(unsigned int, src_cnt, MAX_XOR_BLOCKS);
+		xor_blocks(n, len, dst, srcs);
+		srcs += n;
+		src_cnt -= n;
+	}
+}
+
+/*
+ * dst = src[0] ^ ... ^ src[src_cnt - 1], where dst may also be one of the
+ * sources (async_xor passes the destination as the first source of a
+ * continued operation).
+ */
+static void cpu_dma_exec_xor(void **srcs, unsigned int src_cnt, void *dst,
+			     size_t len)
+{
+	unsigned int i, n = 0;
+	bool in_place = false;
+
+	for (i = 0; i < src_cnt; i++) {
+		void *src = srcs[i];
+
+		if (src == dst)
+			in_place = true;
+		else
+			srcs[n++] = src;
+	}
+	if (!in_place) {
+		memcpy(dst, srcs[0], len);
+		cpu_dma_xor(dst, srcs + 1, n - 1, len);
+	} else {
+		cpu_dma_xor(dst, srcs, n, len);
+	}
+}
+
+/*
+ * P = sum(src), Q = sum(scf * src).  The syndrome routines compute this
+ * for scf = {02}^0, {02}^1, ..., so coefficients which are increasing
+ * powers of {02}, as async_gen_syndrome() passes them after dropping
+ * empty blocks, are expanded back into a stripe with zero pages in the
+ * holes.  Anything else, such as the products used by raid6 recovery,
+ * goes through the multiplication tables.
+ */
+static void cpu_dma_exec_pq(struct cpu_dma_chan *c, unsigned int src_cnt,
+			    const unsigned char *scf, void *p, void *q,
+			    size_t len)
+{
+	void **stripe = c->stripe, **srcs = c->srcs;
+	unsigned int i, j, disks = 0;
+	size_t b;
+
+	for (i = 0; i < src_cnt; i++) {
+		if (!scf[i])
+			break;
+		j = raid6_gflog[scf[i]];
+		if (j < disks || j >= CPU_DMA_MAX_SRCS - 2)
+			break;
+		while (disks < j)
+			stripe[disks++] = (void *)raid6_empty_zero_page;
+		stripe[disks++] = srcs[i];
+	}
+
+	if (i == src_cnt) {
+		/* gen_syndrome() wants at least two data disks */
+		while (disks < 2)
+			stripe[disks++] = (void *)raid6_empty_zero_page;
+		stripe[disks++] = p;
+		stripe[disks++] = q;
+		raid6_call.gen_syndrome(disks, len, stripe);
+		return;
+	}
+
+	memset(p, 0, len);
+	memset(q, 0, len);
+	for (i = 0; i < src_cnt; i++) {
+		const u8 *mul = raid6_gfmul[scf[i]];
+		const u8 *s = srcs[i];
+		u8 *pp = p, *qq = q;
+
+		for (b = 0; b < len; b++) {
+			pp[b] ^= s[b];
+			qq[b] ^= mul[s[b]];
+		}
+	}
+}
+
+static void cpu_dma_exec(struct cpu_dma_chan *c, struct cpu_dma_desc *d)
+{
+	void **srcs = c->srcs;
+	enum sum_check_flags result = 0;
+	size_t off, len;
+	unsigned int i;
+	void *p, *q;
+
+	if (d->type == DMA_MEMCPY) {
+		memcpy(cpu_dma_addr(c, d->dst[0]), cpu_dma_addr(c, d->src[0]),
+		       d->len);
+		return;
+	}
+
+	for (off = 0; off < d->len; off += len) {
+		len = min_t(size_t, d->len - off, CPU_DMA_CHUNK);
+		for (i = 0; i < d->src_cnt; i++)
+			srcs[i] = cpu_dma_addr(c, d->src[i]) + off;
+
+		switch (d->type) {
+		case DMA_XOR:
+			cpu_dma_exec_xor(srcs, d->src_cnt,
+					 cpu_dma_addr(c, d->dst[0]) + off, len);
+			break;
+		case DMA_XOR_VAL:
+			memcpy(c->scratch[0], srcs[0], len);
+			cpu_dma_xor(c->scratch[0], srcs + 1, d->src_cnt - 1,
+				    len);
+			if (memchr_inv(c->scratch[0], 0, len))
+				result |= SUM_CHECK_P_RESULT;
+			break;
+		case DMA_PQ:
+			p = d->flags & DMA_PREP_PQ_DISABLE_P ? c->scratch[0] :
+			    cpu_dma_addr(c, d->dst[0]) + off;
+			q = d->flags & DMA_PREP_PQ_DISABLE_Q ? c->scratch[1] :
+			    cpu_dma_addr(c, d->dst[1]) + off;
+			cpu_dma_exec_pq(c, d->src_cnt, d->scf, p, q, len);
+			break;
+		case DMA_PQ_VAL:
+			cpu_dma_exec_pq(c, d->src_cnt, d->scf,
+					c->scratch[0], c->scratch[1], len);
+			if (!(d->flags & DMA_PREP_PQ_DISABLE_P) &&
+			    memcmp(c->scratch[0],
+				   cpu_dma_addr(c, d->dst[0]) + off, len))
+				result |= SUM_CHECK_P_RESULT;
+			if (!(d->flags & DMA_PREP_PQ_DISABLE_Q) &&
+			    memcmp(c->scratch[1],
+				   cpu_dma_addr(c, d->dst[1]) + off, len))
+				result |= SUM_CHECK_Q_RESULT;
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (d->result)
+		*d->result = result;
+}
+
+/*
+ * Execute the issued descriptors in order.  Whoever sets the running bit,
+ * the worker or a thread polling in tx_status, owns the queue until it is
+ * empty; everyone else returns right away and leaves its descriptors to
+ * the owner, which checks for them again after dropping the bit.
+ */
+static void cpu_dma_run(struct cpu_dma_chan *c)
+{
+	struct cpu_dma_desc *d;
+	unsigned long flags;
+	bool more;
+
+again:
+	if (test_and_set_bit_lock(0, &c->running))
+		return;
+
+	for (;;) {
+		spin_lock_irqsave(&c->lock, flags);
+		d = list_first_entry_or_null(&c->issued, struct cpu_dma_desc,
+					     node);
+		if (d)
+			list_del(&d->node);
+		spin_unlock_irqrestore(&c->lock, flags);
+		if (!d)
+			break;
+
+		cpu_dma_exec(c, d);
+
+		spin_lock_irqsave(&c->lock, flags);
+		dma_cookie_complete(&d->txd);
+		list_add_tail(&d->node, &c->done);
+		spin_unlock_irqrestore(&c->lock, flags);
+	}
+
+	clear_bit_unlock(0, &c->running);
+	smp_mb__after_atomic();
+
+	spin_lock_irqsave(&c->lock, flags);
+	more = !list_empty(&c->issued);
+	spin_unlock_irqrestore(&c->lock, flags);
+	if (more)
+		goto again;
+}
+
+/* Free the descriptors the client has acked, must not be called locked */
+static void cpu_dma_reclaim(struct cpu_dma_chan *c)
+{
+	struct cpu_dma_desc *d, *n;
+	unsigned long flags;
+	LIST_HEAD(free);
+
+	spin_lock_irqsave(&c->lock, flags);
+	list_for_each_entry_safe(d, n, &c->completed, node)
+		if (async_tx_test_ack(&d->txd))
+			list_move(&d->node, &free);
+	spin_unlock_irqrestore(&c->lock, flags);
+
+	list_for_each_entry_safe(d, n, &free, node)
+		mempool_free(d, c->pool);
+}
+
+static void cpu_dma_work(struct work_struct *work)
+{
+	struct cpu_dma_chan *c = container_of(work, struct cpu_dma_chan, work);
+	struct cpu_dma_desc *d;
+	LIST_HEAD(done);
+
+	cpu_dma_run(c);
+
+	spin_lock_irq(&c->lock);
+	list_splice_init(&c->done, &done);
+	spin_unlock_irq(&c->lock);
+
+	/* Clients expect to be called back from softirq context */
+	local_bh_disable();
+	list_for_each_entry(d, &done, node) {
+		dma_descriptor_unmap(&d->txd);
+		dmaengine_desc_get_callback_invoke(&d->txd, NULL);
+		dma_run_dependencies(&d->txd);
+	}
+	local_bh_enable();
+
+	spin_lock_irq(&c->lock);
+	list_splice_tail(&done, &c->completed);
+	spin_unlock_irq(&c->lock);
+
+	cpu_dma_reclaim(c);
+}
+
+static dma_cookie_t cpu_dma_tx_submit(struct dma_async_tx_descriptor *txd)
+{
+	struct cpu_dma_chan *c = to_cpu_dma_chan(txd->chan);
+	struct cpu_dma_desc *d = to_cpu_dma_desc(txd);
+	unsigned long flags;
+	dma_cookie_t cookie;
+
+	spin_lock_irqsave(&c->lock, flags);
+	cookie = dma_cookie_assign(txd);
+	list_add_tail(&d->node, &c->submitted);
+	spin_unlock_irqrestore(&c->lock, flags);
+
+	return cookie;
+}
+
+static void cpu_dma_issue_pending(struct dma_chan *chan)
+{
+	struct cpu_dma_chan *c = to_cpu_dma_chan(chan);
+	unsigned long flags;
+
+	spin_lock_irqsave(&c->lock, flags);
+	if (!list_empty(&c->submitted)) {
+		list_splice_tail_init(&c->submitted, &c->issued);
+		queue_work_node(c->node, cpu_dma_wq, &c->work);
+	}
+	spin_unlock_irqrestore(&c->lock, flags);
+}
+
+static enum dma_status cpu_dma_tx_status(struct dma_chan *chan,
+					 dma_cookie_t cookie,
+					 struct dma_tx_state *txstate)
+{
+	struct cpu_dma_chan *c = to_cpu_dma_chan(chan);
+	enum dma_status ret;
+
+	ret = dma_cookie_status(chan, cookie, txstate);
+	if (ret == DMA_COMPLETE || !in_task())
+		return ret;
+
+	/* Lend the polling thread to the channel instead of spinning */
+	cpu_dma_run(c);
+	/* Callbacks are left to the worker */
+	if (!list_empty_careful(&c->done))
+		queue_work_node(c->node, cpu_dma_wq, &c->work);
+
+	return dma_cookie_status(chan, cookie, txstate);
+}
+
+static struct cpu_dma_desc *
+cpu_dma_alloc_desc(struct dma_chan *chan, enum dma_transaction_type type,
+		   unsigned int src_cnt, size_t len, unsigned long flags)
+{
+	struct cpu_dma_chan *c = to_cpu_dma_chan(chan);
+	struct cpu_dma_desc *d;
+
+	if (src_cnt > CPU_DMA_MAX_SRCS)
+		return NULL;
+
+	cpu_dma_reclaim(c);
+
+	/* Falls back on the reserve, never sleeps */
+	d = mempool_alloc(c->pool, GFP_NOWAIT);
+	if (!d)
+		return NULL;
+	memset(d, 0, struct_size(d, src, src_cnt) + src_cnt);
+	d->scf = (unsigned char *)&d->src[src_cnt];
+
+	dma_async_tx_descriptor_init(&d->txd, chan);
+	d->txd.tx_submit = cpu_dma_tx_submit;
+	d->txd.flags = flags;
+	d->type = type;
+	d->flags = flags;
+	d->src_cnt = src_cnt;
+	d->len = len;
+	return d;
+}
+
+static struct dma_async_tx_descriptor *
+cpu_dma_prep_memcpy(struct dma_chan *chan, dma_addr_t dest, dma_addr_t src,
+		    size_t len, unsigned long flags)
+{
+	struct cpu_dma_desc *d;
+
+	d = cpu_dma_alloc_desc(chan, DMA_MEMCPY, 1, len, flags);
+	if (!d)
+		return NULL;
+	d->dst[0] = dest;
+	d->src[0] = src;
+	return &d->txd;
+}
+
+static struct dma_async_tx_descriptor *
+cpu_dma_prep_xor(struct dma_chan *chan, dma_addr_t dest, dma_addr_t *src,
+		 unsigned int src_cnt, size_t len, unsigned long flags)
+{
+	struct cpu_dma_desc *d;
+
+	if (!src_cnt)
+		return NULL;
+	d = cpu_dma_alloc_desc(chan, DMA_XOR, src_cnt, len, flags);
+	if (!d)
+		return NULL;
+	d->dst[0] = dest;
+	memcpy(d->src, src, src_cnt * sizeof(*src));
+	return &d->txd;
+}
+
+static struct dma_async_tx_descriptor *
+cpu_dma_prep_xor_val(struct dma_chan *chan, dma_addr_t *src,
+		     unsigned int src_cnt, size_t len,
+		     enum sum_check_flags *result, unsigned long flags)
+{
+	struct cpu_dma_desc *d;
+
+	if (!src_cnt)
+		return NULL;
+	d = cpu_dma_alloc_desc(chan, DMA_XOR_VAL, src_cnt, len, flags);
+	if (!d)
+		return NULL;
+	memcpy(d->src, src, src_cnt * sizeof(*src));
+	d->result = result;
+	return &d->txd;
+}
+
+static struct dma_async_tx_descriptor *
+cpu_dma_prep_pq(struct dma_chan *chan, dma_addr_t *dst, dma_addr_t *src,
+		unsigned int src_cnt, const unsigned char *scf, size_t len,
+		unsigned long flags)
+{
+	struct cpu_dma_desc *d;
+
+	/* max_pq covers every stripe, so there is never a continuation */
+	if (WARN_ON_ONCE(flags & DMA_PREP_CONTINUE))
+		return NULL;
+	d = cpu_dma_alloc_desc(chan, DMA_PQ, src_cnt, len, flags);
+	if (!d)
+		return NULL;
+	d->dst[0] = dst[0];
+	d->dst[1] = dst[1];
+	memcpy(d->src, src, src_cnt * sizeof(*src));
+	memcpy(d->scf, scf, src_cnt);
+	return &d->txd;
+}
+
+static struct dma_async_tx_descriptor *
+cpu_dma_prep_pq_val(struct dma_chan *chan, dma_addr_t *pq, dma_addr_t *src,
+		    unsigned int src_cnt, const unsigned char *scf, size_t len,
+		    enum sum_check_flags *pqres, unsigned long flags)
+{
+	struct cpu_dma_desc *d;
+
+	d = cpu_dma_alloc_desc(chan, DMA_PQ_VAL, src_cnt, len, flags);
+	if (!d)
+		return NULL;
+	d->dst[0] = pq[0];
+	d->dst[1] = pq[1];
+	memcpy(d->src, src, src_cnt * sizeof(*src));
+	memcpy(d->scf, scf, src_cnt);
+	d->result = pqres;
+	return &d->txd;
+}
+
+static struct dma_async_tx_descriptor *
+cpu_dma_prep_interrupt(struct dma_chan *chan, unsigned long flags)
+{
+	struct cpu_dma_desc *d;
+
+	d = cpu_dma_alloc_desc(chan, DMA_INTERRUPT, 0, 0, flags);
+	return d ? &d->txd : NULL;
+}
+
+static int cpu_dma_alloc_chan_resources(struct dma_chan *chan)
+{
+	struct cpu_dma_chan *c = to_cpu_dma_chan(chan);
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(c->scratch); i++) {
+		c->scratch[i] = kmalloc_node(CPU_DMA_CHUNK, GFP_KERNEL,
+					     c->node);
+		if (!c->scratch[i])
+			goto err;
+	}
+	c->pool = mempool_create_node(CPU_DMA_POOL_DESCS, mempool_kmalloc,
+				      mempool_kfree,
+				      (void *)CPU_DMA_DESC_SIZE, GFP_KERNEL,
+				      c->node);
+	if (!c->pool)
+		goto err;
+	dma_cookie_init(chan);
+	return 1;
+
+err:
+	while (i--) {
+		kfree(c->scratch[i]);
+		c->scratch[i] = NULL;
+	}
+	return -ENOMEM;
+}
+
+static void cpu_dma_free_chan_resources(struct dma_chan *chan)
+{
+	struct cpu_dma_chan *c = to_cpu_dma_chan(chan);
+	struct cpu_dma_desc *d, *n;
+	LIST_HEAD(free);
+	int i;
+
+	cpu_dma_issue_pending(chan);
+	flush_work(&c->work);
+
+	spin_lock_irq(&c->lock);
+	list_splice_init(&c->submitted, &free);
+	list_splice_init(&c->completed, &free);
+	spin_unlock_irq(&c->lock);
+
+	list_for_each_entry_safe(d, n, &free, node)
+		mempool_free(d, c->pool);
+	mempool_destroy(c->pool);
+	c->pool = NULL;
+	for (i = 0; i < ARRAY_SIZE(c->scratch); i++) {
+		kfree(c->scratch[i]);
+		c->scratch[i] = NULL;
+	}
+}
+
+static void cpu_dma_remove_node(struct cpu_dma_device *cd)
+{
+	dma_async_device_unregister(&cd->dma);
+	platform_device_unregister(cd->pdev);
+	kfree(cd);
+}
+
+static struct cpu_dma_device *cpu_dma_probe_node(int node)
+{
+	unsigned int i, nr_chans = chans_per_node;
+	struct cpu_dma_device *cd;
+	struct dma_device *dma;
+	struct device *dev;
+	int err;
+
+	if (!nr_chans)
+		nr_chans = max(cpumask_weight(cpumask_of_node(node)), 1U);
+
+	cd = kzalloc_node(struct_size(cd, chans, nr_chans), GFP_KERNEL, node);
+	if (!cd)
+		return ERR_PTR(-ENOMEM);
+	cd->nr_chans = nr_chans;
+
+	cd->pdev = platform_device_register_simple("cpu_dma", node, NULL, 0);
+	if (IS_ERR(cd->pdev)) {
+		err = PTR_ERR(cd->pdev);
+		kfree(cd);
+		return ERR_PTR(err);
+	}
+	dev = &cd->pdev->dev;
+	set_dev_node(dev, node);
+	err = dma_coerce_mask_and_coherent(dev, DMA_BIT_MASK(64));
+	if (err)
+		goto err;
+
+	dma = &cd->dma;
+	dma->dev = dev;
+	INIT_LIST_HEAD(&dma->channels);
+	dma_cap_set(DMA_MEMCPY, dma->cap_mask);
+	dma_cap_set(DMA_XOR, dma->cap_mask);
+	dma_cap_set(DMA_XOR_VAL, dma->cap_mask);
+	dma_cap_set(DMA_PQ, dma->cap_mask);
+	dma_cap_set(DMA_PQ_VAL, dma->cap_mask);
+	dma_cap_set(DMA_INTERRUPT, dma->cap_mask);
+
+	/* The xor and syndrome routines work on whole cache lines */
+	dma->xor_align = DMAENGINE_ALIGN_256_BYTES;
+	dma->pq_align = DMAENGINE_ALIGN_256_BYTES;
+	dma->max_xor = CPU_DMA_MAX_SRCS;
+	dma_set_maxpq(dma, CPU_DMA_MAX_SRCS, 0);
+
+	dma->device_alloc_chan_resources = cpu_dma_alloc_chan_resources;
+	dma->device_free_chan_resources = cpu_dma_free_chan_resources;
+	dma->device_prep_dma_memcpy = cpu_dma_prep_memcpy;
+	dma->device_prep_dma_xor = cpu_dma_prep_xor;
+	dma->device_prep_dma_xor_val = cpu_dma_prep_xor_val;
+	dma->device_prep_dma_pq = cpu_dma_prep_pq;
+	dma->device_prep_dma_pq_val = cpu_dma_prep_pq_val;
+	dma->device_prep_dma_interrupt = cpu_dma_prep_interrupt;
+	dma->device_tx_status = cpu_dma_tx_status;
+	dma->device_issue_pending = cpu_dma_issue_pending;
+
+	for (i = 0; i < nr_chans; i++) {
+		struct cpu_dma_chan *c = &cd->chans[i];
+
+		c->node = node;
+		spin_lock_init(&c->lock);
+		INIT_LIST_HEAD(&c->submitted);
+		INIT_LIST_HEAD(&c->issued);
+		INIT_LIST_HEAD(&c->done);
+		INIT_LIST_HEAD(&c->completed);
+		INIT_WORK(&c->work, cpu_dma_work);
+		c->chan.device = dma;
+		list_add_tail(&c->chan.device_node, &dma->channels);
+	}
+
+	err = dma_async_device_register(dma);
+	if (err)
+		goto err;
+
+	dev_info(dev, "%u channels on node %d\n", nr_chans, node);
+	return cd;
+
+err:
+	platform_device_unregister(cd->pdev);
+	kfree(cd);
+	return ERR_PTR(err);
+}
+
+static void cpu_dma_cleanup(void)
+{
+	int node;
+
+	for_each_node(node)
+		if (!IS_ERR_OR_NULL(cpu_dma_devs[node]))
+			cpu_dma_remove_node(cpu_dma_devs[node]);
+	kfree(cpu_dma_devs);
+	destroy_workqueue(cpu_dma_wq);
+}
+
+static int __init cpu_dma_init(void)
+{
+	int node, err, nr_nodes = 0;
+
+	cpu_dma_wq = alloc_workqueue("cpu_dma", WQ_UNBOUND | WQ_MEM_RECLAIM |
+				     WQ_HIGHPRI | WQ_SYSFS, 0);
+	if (!cpu_dma_wq)
+		return -ENOMEM;
+
+	cpu_dma_devs = kcalloc(nr_node_ids, sizeof(*cpu_dma_devs), GFP_KERNEL);
+	if (!cpu_dma_devs) {
+		destroy_workqueue(cpu_dma_wq);
+		return -ENOMEM;
+	}
+
+	err = -ENODEV;
+	for_each_node_state(node, N_CPU) {
+		cpu_dma_devs[node] = cpu_dma_probe_node(node);
+		if (IS_ERR(cpu_dma_devs[node])) {
+			err = PTR_ERR(cpu_dma_devs[node]);
+			pr_err("cpu_dma: node %d: error %d\n", node, err);
+		} else {
+			nr_nodes++;
+		}
+	}
+
+	/* Keep whatever nodes came up */
+	if (!nr_nodes) {
+		cpu_dma_cleanup();
+		return err;
+	}
+	return 0;
+}
+
+static void __exit cpu_dma_exit(void)
+{
+	cpu_dma_cleanup();
+}
+
+/* Register before async_tx users start looking for channels */
+subsys_initcall(cpu_dma_init);
+module_exit(cpu_dma_exit);
+
+MODULE_DESCRIPTION("Software offload engine for async_tx");
+MODULE_LICENSE("GPL");
@@ -11,11 +11,19 @@
 #include <linux/smp.h>
 #include <linux/bitops.h>
 #include <linux/cpu.h>
+#include <linux/nodemask.h>
+#include <linux/topology.h>
 
 /* The anchor node sits above the top of the usable address space */
 #define IOVA_ANCHOR	~0UL
 
 #define IOVA_RANGE_CACHE_MAX_SIZE 6	/* log of max cached IOVA range size (in pages) */
+#define IOVA_RANGE_CACHE_LIMIT 11	/* upper limit for rcache_max_size */
+
+static unsigned int rcache_max_size = IOVA_RANGE_CACHE_MAX_SIZE;
+module_param(rcache_max_size, uint, 0444);
+MODULE_PARM_DESC(rcache_max_size,
+	"Cache IOVA ranges of up to 2^(rcache_max_size - 1) pages (default: 6, max: 11)");
 
 static bool iova_rcache_insert(struct iova_domain *iovad,
 			       unsigned long pfn,
@@ -26,9 +34,14 @@ static unsigned long iova_rcache_get(struct iova_domain *iovad,
 static void free_cpu_cached_iovas(unsigned int cpu, struct iova_domain *iovad);
 static void free_iova_rcaches(struct iova_domain *iovad);
 
+static unsigned int iova_rcache_max_size(void)
+{
+	return clamp_t(unsigned int, rcache_max_size, 1, IOVA_RANGE_CACHE_LIMIT);
+}
+
 unsigned long iova_rcache_range(void)
 {
-	return PAGE_SIZE << (IOVA_RANGE_CACHE_MAX_SIZE - 1);
+	return PAGE_SIZE << (iova_rcache_max_size() - 1);
 }
 
 static int iova_cpuhp_dead(unsigned int cpu, struct hlist_node *node)
@@ -448,7 +461,7 @@ alloc_iova_fast(struct iova_domain *iovad, unsigned long size,
 	 * rounding up anything cacheable to make sure that can't happen. The
 	 * order of the unadjusted size will still match upon freeing.
 	 */
-	if (size < (1 << (IOVA_RANGE_CACHE_MAX_SIZE - 1)))
+	if (size < (1 << (iova_rcache_max_size() - 1)))
 		size = roundup_pow_of_two(size);
 
 	iova_pfn = iova_rcache_get(iovad, size, limit_pfn + 1);
@@ -625,7 +638,7 @@ EXPORT_SYMBOL_GPL(reserve_iova);
  * will be wasted.
  */
 #define IOVA_MAG_SIZE 127
-#define MAX_GLOBAL_MAGS 32	/* magazines per bin */
+#define MAX_GLOBAL_MAGS 32	/* magazines per bin and node */
 
 struct iova_magazine {
 	unsigned long size;
@@ -638,10 +651,20 @@ struct iova_cpu_rcache {
 	struct iova_magazine *prev;
 };
 
-struct iova_rcache {
+/*
+ * Full magazines are kept in a depot per NUMA node, so that CPUs of
+ * different nodes don't contend on the same lock. A node whose depot runs
+ * empty takes magazines from the other nodes, and a node whose depot is full
+ * hands them on, which keeps IOVAs freed on one node available to another.
+ */
+struct iova_depot {
 	spinlock_t lock;
-	unsigned long depot_size;
-	struct iova_magazine *depot[MAX_GLOBAL_MAGS];
+	unsigned long size;
+	struct iova_magazine *mags[MAX_GLOBAL_MAGS];
+};
+
+struct iova_rcache {
+	struct iova_depot **depots;	/* indexed by node id */
 	struct iova_cpu_rcache __percpu *cpu_rcaches;
 };
 
@@ -711,24 +734,90 @@ static void iova_magazine_push(struct iova_magazine *mag, unsigned long pfn)
 	mag->pfns[mag->size++] = pfn;
 }
 
+/*
+ * Store a full magazine in the depot of the local node, or of the next node
+ * that has room. Returns false if all depots are full.
+ */
+static bool iova_depot_push(struct iova_rcache *rcache,
+			    struct iova_magazine *mag)
+{
+	int local = numa_node_id(), nid = local;
+	struct iova_depot *depot;
+	bool pushed = false;
+
+	do {
+		depot = rcache->depots[nid];
+		if (depot && READ_ONCE(depot->size) < MAX_GLOBAL_MAGS) {
+			spin_lock(&depot->lock);
+			if (depot->size < MAX_GLOBAL_MAGS) {
+				depot->mags[depot->size++] = mag;
+				pushed = true;
+			}
+			spin_unlock(&depot->lock);
+		}
+		nid = next_node_in(nid, node_possible_map);
+	} while (!pushed && nid != local);
+
+	return pushed;
+}
+
+/*
+ * Take a full magazine from the depot of the local node, or of the next node
+ * that has one. Returns NULL if all depots are empty.
+ */
+static struct iova_magazine *iova_depot_pop(struct iova_rcache *rcache)
+{
+	int local = numa_node_id(), nid = local;
+	struct iova_magazine *mag = NULL;
+	struct iova_depot *depot;
+
+	do {
+		depot = rcache->depots[nid];
+		if (depot && READ_ONCE(depot->size)) {
+			spin_lock(&depot->lock);
+			if (depot->size)
+				mag = depot->mags[--depot->size];
+			spin_unlock(&depot->lock);
+		}
+		nid = next_node_in(nid, node_possible_map);
+	} while (!mag && nid != local);
+
+	return mag;
+}
+
 int iova_domain_init_rcaches(struct iova_domain *iovad)
 {
 	unsigned int cpu;
-	int i, ret;
+	int i, nid, ret;
 
-	iovad->rcaches = kcalloc(IOVA_RANGE_CACHE_MAX_SIZE,
+	iovad->rcaches = kcalloc(iova_rcache_max_size(),
 				 sizeof(struct iova_rcache),
 				 GFP_KERNEL);
 	if (!iovad->rcaches)
 		return -ENOMEM;
 
-	for (i = 0; i < IOVA_RANGE_CACHE_MAX_SIZE; ++i) {
+	for (i = 0; i < iova_rcache_max_size(); ++i) {
 		struct iova_cpu_rcache *cpu_rcache;
 		struct iova_rcache *rcache;
+		struct iova_depot *depot;
 
 		rcache = &iovad->rcaches[i];
-		spin_lock_init(&rcache->lock);
-		rcache->depot_size = 0;
+		rcache->depots = kcalloc(nr_node_ids, sizeof(*rcache->depots),
+					 GFP_KERNEL);
+		if (!rcache->depots) {
+			ret = -ENOMEM;
+			goto out_err;
+		}
+		for_each_node(nid) {
+			depot = kzalloc_node(sizeof(*depot), GFP_KERNEL, nid);
+			if (!depot) {
+				ret = -ENOMEM;
+				goto out_err;
+			}
+			spin_lock_init(&depot->lock);
+			rcache->depots[nid] = depot;
+		}
+
 		rcache->cpu_rcaches = __alloc_percpu(sizeof(*cpu_rcache),
 						     cache_line_size());
 		if (!rcache->cpu_rcaches) {
@@ -787,14 +876,8 @@ static bool __iova_rcache_insert(struct iova_domain *iovad,
 		struct iova_magazine *new_mag = iova_magazine_alloc(GFP_ATOMIC);
 
 		if (new_mag) {
-			spin_lock(&rcache->lock);
-			if (rcache->depot_size < MAX_GLOBAL_MAGS) {
-				rcache->depot[rcache->depot_size++] =
-						cpu_rcache->loaded;
-			} else {
+			if (!iova_depot_push(rcache, cpu_rcache->loaded))
 				mag_to_free = cpu_rcache->loaded;
-			}
-			spin_unlock(&rcache->lock);
 
 			cpu_rcache->loaded = new_mag;
 			can_insert = true;
@@ -819,7 +902,7 @@ static bool iova_rcache_insert(struct iova_domain *iovad, unsigned long pfn,
 {
 	unsigned int log_size = order_base_2(size);
 
-	if (log_size >= IOVA_RANGE_CACHE_MAX_SIZE)
+	if (log_size >= iova_rcache_max_size())
 		return false;
 
 	return __iova_rcache_insert(iovad, &iovad->rcaches[log_size], pfn);
@@ -834,6 +917,7 @@ static unsigned long __iova_rcache_get(struct iova_rcache *rcache,
 				       unsigned long limit_pfn)
 {
 	struct iova_cpu_rcache *cpu_rcache;
+	struct iova_magazine *mag;
 	unsigned long iova_pfn = 0;
 	bool has_pfn = false;
 	unsigned long flags;
@@ -847,13 +931,12 @@ static unsigned long __iova_rcache_get(struct iova_rcache *rcache,
 		swap(cpu_rcache->prev, cpu_rcache->loaded);
 		has_pfn = true;
 	} else {
-		spin_lock(&rcache->lock);
-		if (rcache->depot_size > 0) {
+		mag = iova_depot_pop(rcache);
+		if (mag) {
 			iova_magazine_free(cpu_rcache->loaded);
-			cpu_rcache->loaded = rcache->depot[--rcache->depot_size];
+			cpu_rcache->loaded = mag;
 			has_pfn = true;
 		}
-		spin_unlock(&rcache->lock);
 	}
 
 	if (has_pfn)
@@ -875,7 +958,7 @@ static unsigned long iova_rcache_get(struct iova_domain *iovad,
 {
 	unsigned int log_size = order_base_2(size);
 
-	if (log_size >= IOVA_RANGE_CACHE_MAX_SIZE)
+	if (log_size >= iova_rcache_max_size())
 		return 0;
 
 	return __iova_rcache_get(&iovad->rcaches[log_size], limit_pfn - size);
@@ -888,11 +971,23 @@ static void free_iova_rcaches(struct iova_domain *iovad)
 {
 	struct iova_rcache *rcache;
 	struct iova_cpu_rcache *cpu_rcache;
+	struct iova_depot *depot;
 	unsigned int cpu;
-	int i, j;
+	int i, j, nid;
 
-	for (i = 0; i < IOVA_RANGE_CACHE_MAX_SIZE; ++i) {
+	for (i = 0; i < iova_rcache_max_size(); ++i) {
 		rcache = &iovad->rcaches[i];
+		if (!rcache->depots)
+			break;
+		for_each_node(nid) {
+			depot = rcache->depots[nid];
+			if (!depot)
+				continue;
+			for (j = 0; j < depot->size; ++j)
+				iova_magazine_free(depot->mags[j]);
+			kfree(depot);
+		}
+		kfree(rcache->depots);
 		if (!rcache->cpu_rcaches)
 			break;
 		for_each_possible_cpu(cpu) {
@@ -901,8 +996,6 @@ static void free_iova_rcaches(struct iova_domain *iovad)
 			iova_magazine_free(cpu_rcache->prev);
 		}
 		free_percpu(rcache->cpu_rcaches);
-		for (j = 0; j < rcache->depot_size; ++j)
-			iova_magazine_free(rcache->depot[j]);
 	}
 
 	kfree(iovad->rcaches);
@@ -919,7 +1012,7 @@ static void free_cpu_cached_iovas(unsigned int cpu, struct iova_domain *iovad)
 	unsigned long flags;
 	int i;
 
-	for (i = 0; i < IOVA_RANGE_CACHE_MAX_SIZE; ++i) {
+	for (i = 0; i < iova_rcache_max_size(); ++i) {
 		rcache = &iovad->rcaches[i];
 		cpu_rcache = per_cpu_ptr(rcache->cpu_rcaches, cpu);
 		spin_lock_irqsave(&cpu_rcache->lock, flags);
@@ -935,18 +1028,22 @@ static void free_cpu_cached_iovas(unsigned int cpu, struct iova_domain *iovad)
 static void free_global_cached_iovas(struct iova_domain *iovad)
 {
 	struct iova_rcache *rcache;
+	struct iova_depot *depot;
 	unsigned long flags;
-	int i, j;
+	int i, j, nid;
 
-	for (i = 0; i < IOVA_RANGE_CACHE_MAX_SIZE; ++i) {
+	for (i = 0; i < iova_rcache_max_size(); ++i) {
 		rcache = &iovad->rcaches[i];
-		spin_lock_irqsave(&rcache->lock, flags);
-		for (j = 0; j < rcache->depot_size; ++j) {
-			iova_magazine_free_pfns(rcache->depot[j], iovad);
-			iova_magazine_free(rcache->depot[j]);
+		for_each_node(nid) {
+			depot = rcache->depots[nid];
+			spin_lock_irqsave(&depot->lock, flags);
+			for (j = 0; j < depot->size; ++j) {
+				iova_magazine_free_pfns(depot->mags[j], iovad);
+				iova_magazine_free(depot->mags[j]);
+			}
+			depot->size = 0;
+			spin_unlock_irqrestore(&depot->lock, flags);
 		}
-		rcache->depot_size = 0;
-		spin_unlock_irqrestore(&rcache->lock, flags);
 	}
 }
 MODULE_AUTHOR("Anil S Keshavamurthy <anil.s.keshavamurthy@intel.com>");
@@ -0,0 +1,349 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Flowlet balancing for the balance-xor and 802.3ad modes
+ *
+ * With a static hash a few long-lived flows can keep one slave saturated
+ * while the others idle.  The flowlet3+4 policy hashes like layer3+4 but
+ * lets a flow change slaves at idle gaps: a flow stays where it is while
+ * its packets keep coming, and once it has been quiet for flowlet_gap_us
+ * the packets sent so far have left the old slave, so the next burst may
+ * go to a less loaded one without being reordered.
+ *
+ * Flows are tracked in one table per bond, shared by all CPUs since a
+ * flow may be sent from several at once.  Each entry is a single word,
+ * so the xmit path reads it and updates it with cmpxchg and takes no
+ * locks.  A flow only ever leaves its slave after the recorded gap, and a
+ * flow without an entry of its own stays on its layer3+4 slave.  Slave
+ * load is the TX byte rate plus the bytes waiting in the qdiscs and BQL
+ * of the slave, sampled by a work item.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/hash.h>
+#include <linux/mm.h>
+#include <linux/percpu.h>
+#include <linux/prandom.h>
+#include <linux/sched/clock.h>
+#include <linux/slab.h>
+#include <net/gen_stats.h>
+#include <net/sch_generic.h>
+#include <net/bonding.h>
+#include <net/bond_flowlet.h>
+
+static unsigned int flowlet_gap_us = 500;
+module_param(flowlet_gap_us, uint, 0644);
+MODULE_PARM_DESC(flowlet_gap_us, "Idle time after which a flow may move to "
+				 "another slave with xmit_hash_policy "
+				 "flowlet3+4, in microseconds (default 500)");
+
+static bool bond_flowlet_mode(struct bonding *bond)
+{
+	return bond->params.xmit_policy == BOND_XMIT_POLICY_FLOWLET34 &&
+	       (BOND_MODE(bond) == BOND_MODE_8023AD ||
+		BOND_MODE(bond) == BOND_MODE_XOR);
+}
+
+static const struct flowlet_load *flowlet_find(const struct flowlet_loads *loads,
+						const struct net_device *dev)
+{
+	unsigned int i;
+
+	for (i = 0; i < loads->count; i++)
+		if (loads->slave[i].dev == dev)
+			return &loads->slave[i];
+
+	return NULL;
+}
+
+static u64 flowlet_find_load(const struct flowlet_loads *loads,
+			     const struct net_device *dev)
+{
+	const struct flowlet_load *l = flowlet_find(loads, dev);
+
+	/* A slave that was just added carries nothing yet */
+	return l ? l->load : 0;
+}
+
+/* Pick a slave for a flowlet that may start anywhere.  Comparing the
+ * current slave with one random other, instead of going to the least
+ * loaded one, keeps all the flowlets that start before the next sample
+ * from piling onto the same slave.
+ */
+static unsigned int flowlet_pick(struct bond_flowlet *fl,
+				 struct bond_up_slave *slaves,
+				 unsigned int count, unsigned int idx)
+{
+	struct flowlet_loads *loads = rcu_dereference(fl->loads);
+	u64 load, alt_load;
+	unsigned int alt;
+
+	if (!loads || count < 2)
+		return idx;
+
+	alt = prandom_u32_max(count - 1);
+	if (alt >= idx)
+		alt++;
+
+	load = flowlet_find_load(loads, slaves->arr[idx]->dev);
+	alt_load = flowlet_find_load(loads, slaves->arr[alt]->dev);
+
+	/* Only move for a clear difference, so that flows don't flap
+	 * between slaves that are about as busy.
+	 */
+	if (alt_load < load - (load >> 3))
+		return alt;
+
+	return idx;
+}
+
+static bool flowlet_owns(u64 entry, u32 hash, unsigned int count)
+{
+	return FIELD_GET(FLOWLET_TAG, entry) == hash >> 8 &&
+	       FIELD_GET(FLOWLET_IDX, entry) < count;
+}
+
+/**
+ * bond_flowlet_slave_get - select the slave for a packet with flowlet3+4
+ * @bond: bonding device
+ * @fl: flowlet state of @bond
+ * @skb: packet to send
+ * @slaves: usable slaves
+ *
+ * Called from the xmit path, with bottom halves disabled.
+ */
+struct slave *bond_flowlet_slave_get(struct bonding *bond,
+				     struct bond_flowlet *fl, struct sk_buff *skb,
+				     struct bond_up_slave *slaves)
+{
+	unsigned int count, idx, cur;
+	u64 entry, new;
+	atomic64_t *e;
+	u32 hash, now, quiet;
+	bool idle;
+
+	count = slaves ? READ_ONCE(slaves->count) : 0;
+	if (unlikely(!count))
+		return NULL;
+
+	hash = bond_xmit_hash(bond, skb);
+	idx = hash % count;
+	if (unlikely(count > FLOWLET_MAX_SLAVES))
+		return slaves->arr[idx];
+
+	/* Close enough to microseconds for comparing with the gap */
+	now = local_clock() >> 10;
+
+	e = &fl->table[hash_32(hash, BOND_FLOWLET_BITS)];
+	entry = atomic64_read(e);
+	/* local_clock() is not synchronized across CPUs, so the entry may
+	 * have been stamped a little ahead of now by another CPU.  That flow
+	 * was just active, not idle for most of the 32-bit range.
+	 */
+	quiet = now - (u32)FIELD_GET(FLOWLET_LAST, entry);
+	idle = (s32)quiet > 0 && quiet > READ_ONCE(flowlet_gap_us);
+
+	if (flowlet_owns(entry, hash, count)) {
+		cur = FIELD_GET(FLOWLET_IDX, entry);
+		idx = idle ? flowlet_pick(fl, slaves, count, cur) : cur;
+	} else if (!idle) {
+		/* The entry belongs to another flow that is still active.
+		 * Any flow without an entry is on its layer3+4 slave.
+		 */
+		return slaves->arr[idx];
+	} else {
+		/* Take the entry over, starting on the layer3+4 slave */
+		cur = idx;
+	}
+
+	new = FIELD_PREP(FLOWLET_TAG, hash >> 8) |
+	      FIELD_PREP(FLOWLET_IDX, idx) |
+	      FIELD_PREP(FLOWLET_LAST, now);
+	if (new == entry)
+		return slaves->arr[idx];
+
+	if (atomic64_try_cmpxchg(e, &entry, new)) {
+		if (idx != cur)
+			this_cpu_inc(*fl->moves);
+	} else if (flowlet_owns(entry, hash, count)) {
+		/* Another CPU sent this flow in the meantime, follow it */
+		idx = FIELD_GET(FLOWLET_IDX, entry);
+	} else {
+		idx = hash % count;
+	}
+
+	return slaves->arr[idx];
+}
+
+/* Bytes waiting to be sent on @dev, in its qdiscs and its BQL limits */
+static u64 flowlet_backlog(struct net_device *dev)
+{
+	struct Qdisc *q, *prev = NULL;
+	struct gnet_stats_queue qstats;
+	struct netdev_queue *txq;
+	u64 backlog = 0;
+	unsigned int i;
+
+	for (i = 0; i < dev->real_num_tx_queues; i++) {
+		txq = netdev_get_tx_queue(dev, i);
+#ifdef CONFIG_BQL
+		backlog += READ_ONCE(txq->dql.num_queued) -
+			   READ_ONCE(txq->dql.num_completed);
+#endif
+		/* Without mq all the queues share the root qdisc */
+		q = rcu_dereference(txq->qdisc);
+		if (!q || q == prev)
+			continue;
+		prev = q;
+
+		memset(&qstats, 0, sizeof(qstats));
+		gnet_stats_add_queue(&qstats, q->cpu_qstats, &q->qstats);
+		backlog += qstats.backlog;
+	}
+
+	return backlog;
+}
+
+static void bond_flowlet_sample(struct work_struct *work)
+{
+	struct bond_flowlet *fl = container_of(work, struct bond_flowlet,
+					       work.work);
+	struct bonding *bond = fl->bond;
+	const struct flowlet_load *prev;
+	struct flowlet_loads *loads, *old;
+	struct rtnl_link_stats64 stats;
+	struct bond_up_slave *slaves;
+	struct flowlet_load *l;
+	unsigned int i, count;
+
+	if (!bond_flowlet_mode(bond))
+		return;
+
+	count = READ_ONCE(bond->slave_cnt);
+	loads = kzalloc(struct_size(loads, slave, count), GFP_KERNEL);
+	if (!loads)
+		goto out;
+
+	old = rcu_dereference_protected(fl->loads, true);
+
+	rcu_read_lock();
+	slaves = rcu_dereference(bond->usable_slaves);
+	if (slaves)
+		count = min(count, READ_ONCE(slaves->count));
+	else
+		count = 0;
+
+	for (i = 0; i < count; i++) {
+		l = &loads->slave[loads->count++];
+		l->dev = slaves->arr[i]->dev;
+		dev_get_stats(slaves->arr[i]->dev, &stats);
+		l->tx_bytes = stats.tx_bytes;
+
+		/* 3/4 of the old rate plus 1/4 of the new one */
+		prev = old ? flowlet_find(old, l->dev) : NULL;
+		if (prev)
+			l->rate = (prev->rate * 3 +
+				   (l->tx_bytes - prev->tx_bytes)) >> 2;
+		l->load = l->rate + flowlet_backlog(l->dev);
+	}
+	rcu_read_unlock();
+
+	rcu_assign_pointer(fl->loads, loads);
+	kfree_rcu(old, rcu);
+
+out:
+	queue_delayed_work(bond->wq, &fl->work, BOND_FLOWLET_INTERVAL);
+}
+
+/**
+ * bond_flowlet_start - set up flowlet balancing if the bond uses it
+ * @bond: bonding device
+ *
+ * Called with RTNL held when the bond is opened or its xmit hash policy
+ * changes.  The state is kept until the bond is destroyed.
+ */
+int bond_flowlet_start(struct bonding *bond)
+{
+	struct bond_flowlet *fl = rtnl_dereference(bond->flowlet);
+
+	if (!bond_flowlet_mode(bond))
+		return 0;
+
+	if (!fl) {
+		fl = kzalloc(sizeof(*fl), GFP_KERNEL);
+		if (!fl)
+			return -ENOMEM;
+
+		fl->table = kvcalloc(BOND_FLOWLET_SIZE, sizeof(*fl->table),
+				     GFP_KERNEL);
+		fl->moves = alloc_percpu(u64);
+		if (!fl->table || !fl->moves) {
+			free_percpu(fl->moves);
+			kvfree(fl->table);
+			kfree(fl);
+			return -ENOMEM;
+		}
+
+		fl->bond = bond;
+		INIT_DELAYED_WORK(&fl->work, bond_flowlet_sample);
+		/* The xmit path may already run with this policy */
+		rcu_assign_pointer(bond->flowlet, fl);
+	}
+
+	queue_delayed_work(bond->wq, &fl->work, 0);
+
+	return 0;
+}
+
+void bond_flowlet_stop(struct bonding *bond)
+{
+	struct bond_flowlet *fl = rtnl_dereference(bond->flowlet);
+
+	if (fl)
+		cancel_delayed_work_sync(&fl->work);
+}
+
+/* Called from the destructor, once nothing can transmit on the bond */
+void bond_flowlet_free(struct bonding *bond)
+{
+	struct bond_flowlet *fl = rcu_dereference_protected(bond->flowlet, true);
+
+	if (!fl)
+		return;
+
+	RCU_INIT_POINTER(bond->flowlet, NULL);
+	kfree(rcu_dereference_protected(fl->loads, true));
+	free_percpu(fl->moves);
+	kvfree(fl->table);
+	kfree(fl);
+}
+
+/* Called under RCU */
+u64 bond_flowlet_moves(struct bonding *bond)
+{
+	struct bond_flowlet *fl = rcu_dereference(bond->flowlet);
+	u64 moves = 0;
+	int cpu;
+
+	if (!fl)
+		return 0;
+
+	for_each_possible_cpu(cpu)
+		moves += READ_ONCE(*per_cpu_ptr(fl->moves, cpu));
+
+	return moves;
+}
+
+/* Called under RCU */
+u64 bond_flowlet_load(struct bonding *bond, const struct net_device *dev)
+{
+	struct bond_flowlet *fl = rcu_dereference(bond->flowlet);
+	struct flowlet_loads *loads;
+
+	if (!fl)
+		return 0;
+
+	loads = rcu_dereference(fl->loads);
+
+	return loads ? flowlet_find_load(loads, dev) : 0;
+}
@@ -85,6 +85,7 @@
 #include <net/bonding.h>
 #include <net/bond_3ad.h>
 #include <net/bond_alb.h>
+#include <net/bond_flowlet.h>
 #if IS_ENABLED(CONFIG_TLS_DEVICE)
 #include <net/tls.h>
 #endif
@@ -170,7 +171,8 @@ module_param(xmit_hash_policy, charp, 0);
 MODULE_PARM_DESC(xmit_hash_policy, "balance-alb, balance-tlb, balance-xor, 802.3ad hashing method; "
 				   "0 for layer 2 (default), 1 for layer 3+4, "
 				   "2 for layer 2+3, 3 for encap layer 2+3, "
-				   "4 for encap layer 3+4, 5 for vlan+srcmac");
+				   "4 for encap layer 3+4, 5 for vlan+srcmac, "
+				   "6 for flowlet layer 3+4");
 module_param(arp_interval, int, 0);
 MODULE_PARM_DESC(arp_interval, "arp interval in milliseconds");
 module_param_array(arp_ip_target, charp, NULL, 0);
@@ -4051,7 +4053,8 @@ static u32 bond_vlan_srcmac_hash(struct sk_buff *skb, const void *data, int mhof
 static bool bond_flow_dissect(struct bonding *bond, struct sk_buff *skb, const void *data,
 			      __be16 l2_proto, int nhoff, int hlen, struct flow_keys *fk)
 {
-	bool l34 = bond->params.xmit_policy == BOND_XMIT_POLICY_LAYER34;
+	bool l34 = bond->params.xmit_policy == BOND_XMIT_POLICY_LAYER34 ||
+		   bond->params.xmit_policy == BOND_XMIT_POLICY_FLOWLET34;
 	int ip_proto = -1;
 
 	switch (bond->params.xmit_policy) {
@@ -4102,7 +4105,8 @@ static u32 bond_ip_hash(u32 hash, struct flow_keys *flow, int xmit_policy)
 
 	/* discard lowest hash bit to deal with the common even ports pattern */
 	if (xmit_policy == BOND_XMIT_POLICY_LAYER34 ||
-		xmit_policy == BOND_XMIT_POLICY_ENCAP34)
+		xmit_policy == BOND_XMIT_POLICY_ENCAP34 ||
+		xmit_policy == BOND_XMIT_POLICY_FLOWLET34)
 		return hash >> 1;
 
 	return hash;
@@ -4212,6 +4216,9 @@ static int bond_open(struct net_device *bond_dev)
 			return -ENOMEM;
 	}
 
+	if (bond_flowlet_start(bond))
+		return -ENOMEM;
+
 	/* reset slave->backup and slave->inactive */
 	if (bond_has_slaves(bond)) {
 		bond_for_each_slave(bond, slave, iter) {
@@ -4266,6 +4273,7 @@ static int bond_close(struct net_device *bond_dev)
 	struct slave *slave;
 
 	bond_work_cancel_all(bond);
+	bond_flowlet_stop(bond);
 	bond->send_peer_notif = 0;
 	if (bond_is_lb(bond))
 		bond_alb_deinitialize(bond);
@@ -5166,10 +5174,16 @@ static netdev_tx_t bond_3ad_xor_xmit(struct sk_buff *skb,
 {
 	struct bonding *bond = netdev_priv(dev);
 	struct bond_up_slave *slaves;
+	struct bond_flowlet *fl;
 	struct slave *slave;
 
 	slaves = rcu_dereference(bond->usable_slaves);
-	slave = bond_xmit_3ad_xor_slave_get(bond, skb, slaves);
+	fl = bond->params.xmit_policy == BOND_XMIT_POLICY_FLOWLET34 ?
+	     rcu_dereference(bond->flowlet) : NULL;
+	if (fl)
+		slave = bond_flowlet_slave_get(bond, fl, skb, slaves);
+	else
+		slave = bond_xmit_3ad_xor_slave_get(bond, skb, slaves);
 	if (likely(slave))
 		return bond_dev_queue_xmit(bond, skb, slave->dev);
 
@@ -5769,6 +5783,8 @@ static void bond_destructor(struct net_device *bond_dev)
 
 	if (bond->rr_tx_counter)
 		free_percpu(bond->rr_tx_counter);
+
+	bond_flowlet_free(bond);
 }
 
 void bond_setup(struct net_device *bond_dev)
@@ -15,6 +15,7 @@
 #include <linux/sched/signal.h>
 
 #include <net/bonding.h>
+#include <net/bond_flowlet.h>
 
 static int bond_option_active_slave_set(struct bonding *bond,
 					const struct bond_opt_value *newval);
@@ -110,6 +111,7 @@ static const struct bond_opt_value bond_xmit_hashtype_tbl[] = {
 	{ "encap2+3",    BOND_XMIT_POLICY_ENCAP23,     0},
 	{ "encap3+4",    BOND_XMIT_POLICY_ENCAP34,     0},
 	{ "vlan+srcmac", BOND_XMIT_POLICY_VLAN_SRCMAC, 0},
+	{ "flowlet3+4",  BOND_XMIT_POLICY_FLOWLET34,   0},
 	{ NULL,          -1,                           0},
 };
 
@@ -1414,10 +1416,17 @@ static int bond_option_fail_over_mac_set(struct bonding *bond,
 static int bond_option_xmit_hash_policy_set(struct bonding *bond,
 					    const struct bond_opt_value *newval)
 {
+	int old_policy = bond->params.xmit_policy;
+
 	netdev_dbg(bond->dev, "Setting xmit hash policy to %s (%llu)\n",
 		   newval->string, newval->value);
 	bond->params.xmit_policy = newval->value;
 
+	if (netif_running(bond->dev) && bond_flowlet_start(bond)) {
+		bond->params.xmit_policy = old_policy;
+		return -ENOMEM;
+	}
+
 	if (bond->dev->reg_state == NETREG_REGISTERED)
 		if (bond_set_tls_features(bond))
 			netdev_update_features(bond->dev);
@@ -5,6 +5,7 @@
 #include <net/net_namespace.h>
 #include <net/netns/generic.h>
 #include <net/bonding.h>
+#include <net/bond_flowlet.h>
 
 #include "bonding_priv.h"
 
@@ -81,6 +82,9 @@ static void bond_info_show_master(struct seq_file *seq)
 					  bond->params.xmit_policy);
 		seq_printf(seq, "Transmit Hash Policy: %s (%d)\n",
 			   optval->string, bond->params.xmit_policy);
+		if (bond->params.xmit_policy == BOND_XMIT_POLICY_FLOWLET34)
+			seq_printf(seq, "Flowlet moves: %llu\n",
+				   bond_flowlet_moves(bond));
 	}
 
 	if (bond_uses_primary(bond)) {
@@ -210,6 +214,10 @@ static void bond_info_show_slave(struct seq_file *seq,
 	seq_printf(seq, "Permanent HW addr: %*phC\n",
 		   slave->dev->addr_len, slave->perm_hwaddr);
 	seq_printf(seq, "Slave queue ID: %d\n", slave->queue_id);
+	if (bond_mode_uses_xmit_hash(bond) &&
+	    bond->params.xmit_policy == BOND_XMIT_POLICY_FLOWLET34)
+		seq_printf(seq, "Flowlet load: %llu\n",
+			   bond_flowlet_load(bond, slave->dev));
 
 	if (BOND_MODE(bond) == BOND_MODE_8023AD) {
 		const struct port *port = &SLAVE_AD_INFO(slave)->port;
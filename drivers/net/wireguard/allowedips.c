@@ -6,7 +6,7 @@
 #include "allowedips.h"
 #include "peer.h"
 
-enum { MAX_ALLOWEDIPS_BITS = 128 };
+enum { MAX_ALLOWEDIPS_BITS = 128, MAX_STRIDE_BITS = 16 };
 
 static struct kmem_cache *node_cache;
 
@@ -84,18 +84,23 @@ static unsigned int fls128(u64 a, u64 b)
 	return a ? fls64(a) + 64U : fls64(b);
 }
 
-static u8 common_bits(const struct allowedips_node *node, const u8 *key,
-		      u8 bits)
+static u8 common_key_bits(const u8 *a, const u8 *key, u8 bits)
 {
 	if (bits == 32)
-		return 32U - fls(*(const u32 *)node->bits ^ *(const u32 *)key);
+		return 32U - fls(*(const u32 *)a ^ *(const u32 *)key);
 	else if (bits == 128)
 		return 128U - fls128(
-			*(const u64 *)&node->bits[0] ^ *(const u64 *)&key[0],
-			*(const u64 *)&node->bits[8] ^ *(const u64 *)&key[8]);
+			*(const u64 *)&a[0] ^ *(const u64 *)&key[0],
+			*(const u64 *)&a[8] ^ *(const u64 *)&key[8]);
 	return 0;
 }
 
+static u8 common_bits(const struct allowedips_node *node, const u8 *key,
+		      u8 bits)
+{
+	return common_key_bits(node->bits, key, bits);
+}
+
 static bool prefix_matches(const struct allowedips_node *node, const u8 *key,
 			   u8 bits)
 {
@@ -123,8 +128,85 @@ static struct allowedips_node *find_node(struct allowedips_node *trie, u8 bits,
 	return found;
 }
 
+/* Returns the stride bits of key that follow the cidr bits of the table. */
+static u32 slot_index(const struct allowedips_stride *table, const u8 *key,
+		      u8 bits)
+{
+	u64 window;
+
+	if (!table->stride)
+		return 0;
+	if (bits == 32)
+		return (*(const u32 *)key << table->cidr) >> (32U - table->stride);
+	if (table->cidr >= 64)
+		window = ((const u64 *)key)[1] << (table->cidr - 64U);
+	else if (table->cidr)
+		window = ((const u64 *)key)[0] << table->cidr |
+			 ((const u64 *)key)[1] >> (64U - table->cidr);
+	else
+		window = ((const u64 *)key)[0];
+	return window >> (64U - table->stride);
+}
+
+/* Builds the key of the prefix that slot index of the table stands for. */
+static void slot_key(u8 *key, const struct allowedips_stride *table, u32 index,
+		     u8 bits)
+{
+	const u64 *prefix = (const u64 *)table->bits;
+	const u8 end = table->cidr + table->stride;
+	u64 *k = (u64 *)key;
+
+	if (bits == 32) {
+		*(u32 *)key = table->cidr ?
+			*(const u32 *)table->bits & ~0U << (32U - table->cidr) : 0;
+		if (table->stride)
+			*(u32 *)key |= index << (32U - end);
+		return;
+	}
+
+	k[0] = k[1] = 0;
+	if (table->cidr >= 64)
+		k[0] = prefix[0];
+	else if (table->cidr)
+		k[0] = prefix[0] & ~0ULL << (64U - table->cidr);
+	if (table->cidr > 64)
+		k[1] = prefix[1] & ~0ULL << (128U - table->cidr);
+	if (!table->stride)
+		return;
+	if (end <= 64) {
+		k[0] |= (u64)index << (64U - end);
+	} else if (table->cidr >= 64) {
+		k[1] |= (u64)index << (128U - end);
+	} else {
+		k[0] |= (u64)index >> (end - 64U);
+		k[1] |= (u64)index << (128U - end);
+	}
+}
+
+static struct allowedips_node *find_node_stride(struct allowedips_stride *table,
+						struct allowedips_node *trie,
+						u8 bits, const u8 *key)
+{
+	struct allowedips_slot *slot;
+	struct allowedips_node *node;
+
+	if (!table)
+		return find_node(trie, bits, key);
+	if (common_key_bits(table->bits, key, bits) < table->cidr)
+		return NULL;
+	slot = &table->slots[slot_index(table, key, bits)];
+	node = rcu_dereference_bh(slot->next);
+	if (node && (node = find_node(node, bits, key)))
+		return node;
+	node = rcu_dereference_bh(slot->best);
+	if (!node || rcu_access_pointer(node->peer))
+		return node;
+	/* The best match is being removed, so the slot is about to change. */
+	return find_node(trie, bits, key);
+}
+
 /* Returns a strong reference to a peer */
-static struct wg_peer *lookup(struct allowedips_node __rcu *root, u8 bits,
+static struct wg_peer *lookup(struct allowedips *table, u8 bits,
 			      const void *be_ip)
 {
 	/* Aligned so it can be passed to fls/fls64 */
@@ -136,7 +218,14 @@ static struct wg_peer *lookup(struct allowedips_node __rcu *root, u8 bits,
 
 	rcu_read_lock_bh();
 retry:
-	node = find_node(rcu_dereference_bh(root), bits, ip);
+	if (bits == 32)
+		node = find_node_stride(rcu_dereference_bh(table->stride4),
+					rcu_dereference_bh(table->root4),
+					bits, ip);
+	else
+		node = find_node_stride(rcu_dereference_bh(table->stride6),
+					rcu_dereference_bh(table->root6),
+					bits, ip);
 	if (node) {
 		peer = wg_peer_get_maybe_zero(rcu_dereference_bh(node->peer));
 		if (!peer)
@@ -179,7 +268,8 @@ static inline void choose_and_connect_node(struct allowedips_node *parent, struc
 }
 
 static int add(struct allowedips_node __rcu **trie, u8 bits, const u8 *key,
-	       u8 cidr, struct wg_peer *peer, struct mutex *lock)
+	       u8 cidr, struct wg_peer *peer, unsigned int *nodes,
+	       struct mutex *lock)
 {
 	struct allowedips_node *node, *parent, *down, *newnode;
 
@@ -194,6 +284,7 @@ static int add(struct allowedips_node __rcu **trie, u8 bits, const u8 *key,
 		list_add_tail(&node->peer_list, &peer->allowedips_list);
 		copy_and_assign_cidr(node, key, cidr, bits);
 		connect_node(trie, 2, node);
+		++*nodes;
 		return 0;
 	}
 	if (node_placement(*trie, key, cidr, bits, &node, lock)) {
@@ -208,6 +299,7 @@ static int add(struct allowedips_node __rcu **trie, u8 bits, const u8 *key,
 	RCU_INIT_POINTER(newnode->peer, peer);
 	list_add_tail(&newnode->peer_list, &peer->allowedips_list);
 	copy_and_assign_cidr(newnode, key, cidr, bits);
+	++*nodes;
 
 	if (!node) {
 		down = rcu_dereference_protected(*trie, lockdep_is_held(lock));
@@ -235,10 +327,12 @@ static int add(struct allowedips_node __rcu **trie, u8 bits, const u8 *key,
 	if (unlikely(!node)) {
 		list_del(&newnode->peer_list);
 		kmem_cache_free(node_cache, newnode);
+		--*nodes;
 		return -ENOMEM;
 	}
 	INIT_LIST_HEAD(&node->peer_list);
 	copy_and_assign_cidr(node, newnode->bits, cidr, bits);
+	++*nodes;
 
 	choose_and_connect_node(node, down);
 	choose_and_connect_node(node, newnode);
@@ -249,9 +343,146 @@ static int add(struct allowedips_node __rcu **trie, u8 bits, const u8 *key,
 	return 0;
 }
 
+static void fill_slot(struct allowedips_stride *table,
+		      struct allowedips_node *trie, u32 index, u8 bits,
+		      struct mutex *lock)
+{
+	/* Aligned so it can be passed to fls/fls64 */
+	u8 key[16] __aligned(__alignof(u64));
+	const u8 end = table->cidr + table->stride;
+	struct allowedips_node *node = trie, *best = NULL;
+
+	slot_key(key, table, index, bits);
+	while (node && node->cidr < end && prefix_matches(node, key, bits)) {
+		if (rcu_access_pointer(node->peer))
+			best = node;
+		node = rcu_dereference_protected(node->bit[choose(node, key)],
+						 lockdep_is_held(lock));
+	}
+	if (node && common_bits(node, key, bits) < end)
+		node = NULL;
+	rcu_assign_pointer(table->slots[index].best, best);
+	rcu_assign_pointer(table->slots[index].next, node);
+}
+
+/* Refreshes the slots that the prefix key/cidr covers or lies under. */
+static void fill_slots(struct allowedips_stride *table,
+		       struct allowedips_node *trie, const u8 *key, u8 cidr,
+		       u8 bits, struct mutex *lock)
+{
+	const u8 end = table->cidr + table->stride;
+	u32 index = 0, count = 1U << table->stride;
+
+	if (cidr > table->cidr) {
+		count = cidr >= end ? 1 : 1U << (end - cidr);
+		index = slot_index(table, key, bits) & ~(count - 1);
+	}
+	while (count--)
+		fill_slot(table, trie, index++, bits, lock);
+}
+
+/* The stride grows with the number of nodes, which keeps the table at
+ * around one slot per node, and never goes past the last bit.
+ */
+static u8 stride_for(const struct allowedips_node *trie, unsigned int nodes,
+		     u8 bits)
+{
+	return min3(fls(nodes), MAX_STRIDE_BITS, bits - trie->cidr);
+}
+
+static bool stride_is_current(const struct allowedips_stride *table,
+			      const struct allowedips_node *trie,
+			      unsigned int nodes, u8 bits)
+{
+	u8 stride;
+
+	if (!trie || !table)
+		return !trie && !table;
+	if (table->cidr != trie->cidr ||
+	    common_key_bits(table->bits, trie->bits, bits) < trie->cidr)
+		return false;
+	/* Let it shrink lazily, so that a table hovering around a power of
+	 * two in size isn't rebuilt over and over again.
+	 */
+	stride = stride_for(trie, nodes, bits);
+	return stride <= table->stride && stride + 2 >= table->stride;
+}
+
+static void rebuild_stride(struct allowedips_stride __rcu **stridep,
+			   struct allowedips_node *trie, unsigned int nodes,
+			   u8 bits, struct mutex *lock)
+{
+	struct allowedips_stride *old = rcu_dereference_protected(*stridep,
+						lockdep_is_held(lock));
+	struct allowedips_stride *table = NULL;
+	u8 stride = 0;
+	u32 index;
+
+	if (trie) {
+		stride = stride_for(trie, nodes, bits);
+		/* Without a table, lookups simply walk the whole trie. */
+		table = kvzalloc(struct_size(table, slots, 1U << stride),
+				 GFP_KERNEL);
+	}
+	if (table) {
+		memcpy(table->bits, trie->bits, bits / 8U);
+		table->cidr = trie->cidr;
+		table->stride = stride;
+		for (index = 0; index < 1U << stride; ++index)
+			fill_slot(table, trie, index, bits, lock);
+	}
+	rcu_assign_pointer(*stridep, table);
+	if (old)
+		kvfree_rcu(old, rcu);
+}
+
+/* Brings the stride table in line with a change to the prefix key/cidr.
+ * This has to happen before any node that was unlinked from the trie is
+ * handed to call_rcu(), so that no slot still points to it afterwards.
+ */
+static void update_stride(struct allowedips *table, const u8 *key, u8 cidr,
+			  u8 bits, struct mutex *lock)
+{
+	struct allowedips_stride __rcu **stridep =
+		bits == 32 ? &table->stride4 : &table->stride6;
+	struct allowedips_node *trie = rcu_dereference_protected(
+		bits == 32 ? table->root4 : table->root6, lockdep_is_held(lock));
+	struct allowedips_stride *stride = rcu_dereference_protected(*stridep,
+						lockdep_is_held(lock));
+
+	if (stride && trie && common_key_bits(stride->bits, key, bits) >=
+			      min(cidr, stride->cidr))
+		fill_slots(stride, trie, key, cidr, bits, lock);
+	else if (stride && !trie)
+		rebuild_stride(stridep, NULL, 0, bits, lock);
+}
+
+/* Rebuilds the stride table if the top of the trie moved, or if the trie
+ * grew or shrank enough for a different stride to fit better. Returns
+ * whether it did.
+ */
+static bool refresh_stride(struct allowedips *table, u8 bits,
+			   struct mutex *lock)
+{
+	struct allowedips_stride __rcu **stridep =
+		bits == 32 ? &table->stride4 : &table->stride6;
+	struct allowedips_node *trie = rcu_dereference_protected(
+		bits == 32 ? table->root4 : table->root6, lockdep_is_held(lock));
+	unsigned int nodes = bits == 32 ? table->nodes4 : table->nodes6;
+
+	if (stride_is_current(rcu_dereference_protected(*stridep,
+						lockdep_is_held(lock)),
+			      trie, nodes, bits))
+		return false;
+	rebuild_stride(stridep, trie, nodes, bits, lock);
+	return true;
+}
+
 void wg_allowedips_init(struct allowedips *table)
 {
 	table->root4 = table->root6 = NULL;
+	table->stride4 = table->stride6 = NULL;
+	table->nodes4 = table->nodes6 = 0;
 	table->seq = 1;
 }
 
@@ -260,6 +491,9 @@ void wg_allowedips_free(struct allowedips *table, struct mutex *lock)
 	struct allowedips_node __rcu *old4 = table->root4, *old6 = table->root6;
 
 	++table->seq;
+	rebuild_stride(&table->stride4, NULL, 0, 32, lock);
+	rebuild_stride(&table->stride6, NULL, 0, 128, lock);
+	table->nodes4 = table->nodes6 = 0;
 	RCU_INIT_POINTER(table->root4, NULL);
 	RCU_INIT_POINTER(table->root6, NULL);
 	if (rcu_access_pointer(old4)) {
@@ -283,10 +517,14 @@ int wg_allowedips_insert_v4(struct allowedips *table, const struct in_addr *ip,
 {
 	/* Aligned so it can be passed to fls */
 	u8 key[4] __aligned(__alignof(u32));
+	int ret;
 
 	++table->seq;
 	swap_endian(key, (const u8 *)ip, 32);
-	return add(&table->root4, 32, key, cidr, peer, lock);
+	ret = add(&table->root4, 32, key, cidr, peer, &table->nodes4, lock);
+	if (!ret && !refresh_stride(table, 32, lock))
+		update_stride(table, key, cidr, 32, lock);
+	return ret;
 }
 
 int wg_allowedips_insert_v6(struct allowedips *table, const struct in6_addr *ip,
@@ -294,26 +532,35 @@ int wg_allowedips_insert_v6(struct allowedips *table, const struct in6_addr *ip,
 {
 	/* Aligned so it can be passed to fls64 */
 	u8 key[16] __aligned(__alignof(u64));
+	int ret;
 
 	++table->seq;
 	swap_endian(key, (const u8 *)ip, 128);
-	return add(&table->root6, 128, key, cidr, peer, lock);
+	ret = add(&table->root6, 128, key, cidr, peer, &table->nodes6, lock);
+	if (!ret && !refresh_stride(table, 128, lock))
+		update_stride(table, key, cidr, 128, lock);
+	return ret;
 }
 
 void wg_allowedips_remove_by_peer(struct allowedips *table,
 				  struct wg_peer *peer, struct mutex *lock)
 {
 	struct allowedips_node *node, *child, **parent_bit, *parent, *tmp;
+	unsigned int *nodes;
 	bool free_parent;
 
 	if (list_empty(&peer->allowedips_list))
 		return;
 	++table->seq;
 	list_for_each_entry_safe(node, tmp, &peer->allowedips_list, peer_list) {
+		nodes = node->bitlen == 32 ? &table->nodes4 : &table->nodes6;
 		list_del_init(&node->peer_list);
 		RCU_INIT_POINTER(node->peer, NULL);
-		if (node->bit[0] && node->bit[1])
+		if (node->bit[0] && node->bit[1]) {
+			update_stride(table, node->bits, node->cidr,
+				      node->bitlen, lock);
 			continue;
+		}
 		child = rcu_dereference_protected(node->bit[!rcu_access_pointer(node->bit[0])],
 						  lockdep_is_held(lock));
 		if (child)
@@ -330,14 +577,24 @@ void wg_allowedips_remove_by_peer(struct allowedips *table,
 			child = rcu_dereference_protected(
 					parent->bit[!(node->parent_bit_packed & 1)],
 					lockdep_is_held(lock));
-		call_rcu(&node->rcu, node_free_rcu);
-		if (!free_parent)
+		--*nodes;
+		if (!free_parent) {
+			update_stride(table, node->bits, node->cidr,
+				      node->bitlen, lock);
+			call_rcu(&node->rcu, node_free_rcu);
 			continue;
+		}
 		if (child)
 			child->parent_bit_packed = parent->parent_bit_packed;
 		*(struct allowedips_node **)(parent->parent_bit_packed & ~3UL) = child;
+		--*nodes;
+		update_stride(table, parent->bits, parent->cidr, parent->bitlen,
+			      lock);
+		call_rcu(&node->rcu, node_free_rcu);
 		call_rcu(&parent->rcu, node_free_rcu);
 	}
+	refresh_stride(table, 32, lock);
+	refresh_stride(table, 128, lock);
 }
 
 int wg_allowedips_read_node(struct allowedips_node *node, u8 ip[16], u8 *cidr)
@@ -357,9 +614,9 @@ struct wg_peer *wg_allowedips_lookup_dst(struct allowedips *table,
 					 struct sk_buff *skb)
 {
 	if (skb->protocol == htons(ETH_P_IP))
-		return lookup(table->root4, 32, &ip_hdr(skb)->daddr);
+		return lookup(table, 32, &ip_hdr(skb)->daddr);
 	else if (skb->protocol == htons(ETH_P_IPV6))
-		return lookup(table->root6, 128, &ipv6_hdr(skb)->daddr);
+		return lookup(table, 128, &ipv6_hdr(skb)->daddr);
 	return NULL;
 }
 
@@ -368,9 +625,9 @@ struct wg_peer *wg_allowedips_lookup_src(struct allowedips *table,
 					 struct sk_buff *skb)
 {
 	if (skb->protocol == htons(ETH_P_IP))
-		return lookup(table->root4, 32, &ip_hdr(skb)->saddr);
+		return lookup(table, 32, &ip_hdr(skb)->saddr);
 	else if (skb->protocol == htons(ETH_P_IPV6))
-		return lookup(table->root6, 128, &ipv6_hdr(skb)->saddr);
+		return lookup(table, 128, &ipv6_hdr(skb)->saddr);
 	return NULL;
 }
 
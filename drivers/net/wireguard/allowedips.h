@@ -26,9 +26,30 @@ struct allowedips_node {
 	};
 };
 
+struct allowedips_slot {
+	/* Longest match shorter than the end of the stride, if any. */
+	struct allowedips_node __rcu *best;
+	/* Topmost node at or beyond the end of the stride under this slot. */
+	struct allowedips_node __rcu *next;
+};
+
+/* Level-compressed top of a trie: the stride bits following the cidr bits
+ * shared by every node index straight into slots, which replace the first
+ * levels of the walk down the binary trie.
+ */
+struct allowedips_stride {
+	u8 bits[16] __aligned(__alignof(u64));
+	u8 cidr, stride;
+	struct rcu_head rcu;
+	struct allowedips_slot slots[];
+};
+
 struct allowedips {
 	struct allowedips_node __rcu *root4;
 	struct allowedips_node __rcu *root6;
+	struct allowedips_stride __rcu *stride4;
+	struct allowedips_stride __rcu *stride6;
+	unsigned int nodes4, nodes6;
 	u64 seq;
 } __aligned(4); /* We pack the lower 2 bits of &root, but m68k only gives 16-bit alignment. */
 
@@ -50,6 +50,8 @@ struct wg_peer {
 	struct cookie latest_cookie;
 	struct hlist_node pubkey_hash;
 	u64 rx_bytes, tx_bytes;
+	u64 tx_gso_batches, tx_gso_packets, rx_gro_batches, rx_gro_packets;
+	bool tx_sg;
 	struct timer_list timer_retransmit_handshake, timer_send_keepalive;
 	struct timer_list timer_new_handshake, timer_zero_key_material;
 	struct timer_list timer_persistent_keepalive;
@@ -50,6 +50,9 @@ void wg_packet_handshake_send_worker(struct work_struct *work);
 void wg_packet_tx_worker(struct work_struct *work);
 void wg_packet_encrypt_worker(struct work_struct *work);
 
+/* Packets handed to the multi-buffer AEAD at once by the crypt workers */
+enum { CRYPT_BATCH_SIZE = 8 };
+
 enum packet_state {
 	PACKET_STATE_UNCRYPTED,
 	PACKET_STATE_CRYPTED,
@@ -62,6 +65,7 @@ struct packet_cb {
 	atomic_t state;
 	u32 mtu;
 	u8 ds;
+	u16 gro_segs;
 };
 
 #define PACKET_CB(skb) ((struct packet_cb *)((skb)->cb))
@@ -239,21 +239,23 @@ static void keep_key_fresh(struct wg_peer *peer)
 	}
 }
 
-static bool decrypt_packet(struct sk_buff *skb, struct noise_keypair *keypair)
+/* Returns the number of scatterlist entries the packet needs, or a negative
+ * value if it has to be dropped.
+ */
+static int prepare_packet(struct sk_buff *skb, struct noise_keypair *keypair)
 {
-	struct scatterlist sg[MAX_SKB_FRAGS + 8];
 	struct sk_buff *trailer;
 	unsigned int offset;
 	int num_frags;
 
 	if (unlikely(!keypair))
-		return false;
+		return -1;
 
 	if (unlikely(!READ_ONCE(keypair->receiving.is_valid) ||
 		  wg_birthdate_has_expired(keypair->receiving.birthdate, REJECT_AFTER_TIME) ||
 		  keypair->receiving_counter.counter >= REJECT_AFTER_MESSAGES)) {
 		WRITE_ONCE(keypair->receiving.is_valid, false);
-		return false;
+		return -1;
 	}
 
 	PACKET_CB(skb)->nonce =
@@ -268,8 +270,31 @@ static bool decrypt_packet(struct sk_buff *skb, struct noise_keypair *keypair)
 	num_frags = skb_cow_data(skb, 0, &trailer);
 	offset += sizeof(struct message_data);
 	skb_pull(skb, offset);
-	if (unlikely(num_frags < 0 || num_frags > ARRAY_SIZE(sg)))
+	if (unlikely(num_frags < 0 || num_frags > MAX_SKB_FRAGS + 8))
+		return -1;
+	return num_frags;
+}
+
+static bool finish_packet(struct sk_buff *skb)
+{
+	unsigned int offset = skb->data - skb_network_header(skb);
+
+	/* Another ugly situation of pushing and pulling the header so as to
+	 * keep endpoint information intact.
+	 */
+	skb_push(skb, offset);
+	if (pskb_trim(skb, skb->len - noise_encrypted_len(0)))
 		return false;
+	skb_pull(skb, offset);
+
+	return true;
+}
+
+static noinline_for_stack bool decrypt_packet(struct sk_buff *skb,
+					      struct noise_keypair *keypair,
+					      int num_frags)
+{
+	struct scatterlist sg[MAX_SKB_FRAGS + 8];
 
 	sg_init_table(sg, num_frags);
 	if (skb_to_sgvec(skb, sg, 0, skb->len) <= 0)
@@ -280,15 +305,19 @@ static bool decrypt_packet(struct sk_buff *skb, struct noise_keypair *keypair)
 						 keypair->receiving.key))
 		return false;
 
-	/* Another ugly situation of pushing and pulling the header so as to
-	 * keep endpoint information intact.
-	 */
-	skb_push(skb, offset);
-	if (pskb_trim(skb, skb->len - noise_encrypted_len(0)))
-		return false;
-	skb_pull(skb, offset);
+	return finish_packet(skb);
+}
 
-	return true;
+static void decrypt_batch(struct chacha20poly1305_req *reqs,
+			  struct sk_buff **skbs, unsigned int n)
+{
+	unsigned int i;
+
+	chacha20poly1305_decrypt_sg_inplace_mb(reqs, n);
+	for (i = 0; i < n; ++i)
+		wg_queue_enqueue_per_peer_rx(skbs[i],
+			likely(reqs[i].ok && finish_packet(skbs[i])) ?
+				PACKET_STATE_CRYPTED : PACKET_STATE_DEAD);
 }
 
 /* This is RFC6479, a replay detection bitmap algorithm that avoids bitshifts */
@@ -470,6 +499,11 @@ int wg_packet_rx_poll(struct napi_struct *napi, int budget)
 		if (unlikely(wg_socket_endpoint_from_skb(&endpoint, skb)))
 			goto next;
 
+		if (PACKET_CB(skb)->gro_segs) {
+			++peer->rx_gro_batches;
+			peer->rx_gro_packets += PACKET_CB(skb)->gro_segs;
+		}
+
 		wg_reset_packet(skb, false);
 		wg_packet_consume_data_done(peer, skb, &endpoint);
 		free = false;
@@ -494,16 +528,51 @@ void wg_packet_decrypt_worker(struct work_struct *work)
 {
 	struct crypt_queue *queue = container_of(work, struct multicore_worker,
 						 work)->ptr;
+	struct chacha20poly1305_req reqs[CRYPT_BATCH_SIZE];
+	struct scatterlist sg[CRYPT_BATCH_SIZE];
+	struct sk_buff *skbs[CRYPT_BATCH_SIZE];
+	struct noise_keypair *keypair;
+	unsigned int n = 0;
 	struct sk_buff *skb;
+	int num_frags;
 
+	/* Linear packets are gathered up and decrypted CRYPT_BATCH_SIZE at a
+	 * time; a partial batch is flushed as soon as the ring runs dry, so
+	 * this never holds a packet back waiting for more to arrive.
+	 */
 	while ((skb = ptr_ring_consume_bh(&queue->ring)) != NULL) {
-		enum packet_state state =
-			likely(decrypt_packet(skb, PACKET_CB(skb)->keypair)) ?
-				PACKET_STATE_CRYPTED : PACKET_STATE_DEAD;
-		wg_queue_enqueue_per_peer_rx(skb, state);
+		keypair = PACKET_CB(skb)->keypair;
+		num_frags = prepare_packet(skb, keypair);
+		if (unlikely(num_frags < 0)) {
+			wg_queue_enqueue_per_peer_rx(skb, PACKET_STATE_DEAD);
+		} else if (num_frags > 1) {
+			wg_queue_enqueue_per_peer_rx(skb,
+				likely(decrypt_packet(skb, keypair, num_frags)) ?
+					PACKET_STATE_CRYPTED : PACKET_STATE_DEAD);
+		} else {
+			sg_init_table(&sg[n], 1);
+			if (unlikely(skb_to_sgvec(skb, &sg[n], 0, skb->len) <= 0)) {
+				wg_queue_enqueue_per_peer_rx(skb, PACKET_STATE_DEAD);
+			} else {
+				reqs[n] = (struct chacha20poly1305_req){
+					.sg = &sg[n],
+					.len = skb->len,
+					.nonce = PACKET_CB(skb)->nonce,
+					.key = keypair->receiving.key
+				};
+				skbs[n++] = skb;
+			}
+		}
+
+		if (n == CRYPT_BATCH_SIZE) {
+			decrypt_batch(reqs, skbs, n);
+			n = 0;
+		}
 		if (need_resched())
 			cond_resched();
 	}
+	if (n)
+		decrypt_batch(reqs, skbs, n);
 }
 
 static void wg_packet_consume_data(struct wg_device *wg, struct sk_buff *skb)
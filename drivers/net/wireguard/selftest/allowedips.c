@@ -3,16 +3,18 @@
  * Copyright (C) 2015-2019 Jason A. Donenfeld <Jason@zx2c4.com>. All Rights Reserved.
  *
  * This contains some basic static unit tests for the allowedips data structure.
- * It also has two additional modes that are disabled and meant to be used by
+ * It also has three additional modes that are disabled and meant to be used by
  * folks directly playing with this file. If you define the macro
  * DEBUG_PRINT_TRIE_GRAPHVIZ to be 1, then every time there's a full tree in
  * memory, it will be printed out as KERN_DEBUG in a format that can be passed
  * to graphviz (the dot command) to visualize it. If you define the macro
  * DEBUG_RANDOM_TRIE to be 1, then there will be an extremely costly set of
  * randomized tests done against a trivial implementation, which may take
- * upwards of a half-hour to complete. There's no set of users who should be
- * enabling these, and the only developers that should go anywhere near these
- * nobs are the ones who are reading this comment.
+ * upwards of a half-hour to complete. If you define the macro
+ * DEBUG_HUB_BENCHMARK to be 1, then the hub test will also time lookups with
+ * and without the stride table and print the result as KERN_INFO. There's no
+ * set of users who should be enabling these, and the only developers that
+ * should go anywhere near these nobs are the ones who are reading this comment.
  */
 
 #ifdef DEBUG
@@ -382,13 +384,13 @@ static __init bool randomized_test(void)
 	for (j = 0;; ++j) {
 		for (i = 0; i < NUM_QUERIES; ++i) {
 			get_random_bytes(ip, 4);
-			if (lookup(t.root4, 32, ip) != horrible_allowedips_lookup_v4(&h, (struct in_addr *)ip)) {
+			if (lookup(&t, 32, ip) != horrible_allowedips_lookup_v4(&h, (struct in_addr *)ip)) {
 				horrible_allowedips_lookup_v4(&h, (struct in_addr *)ip);
 				pr_err("allowedips random v4 self-test: FAIL\n");
 				goto free;
 			}
 			get_random_bytes(ip, 16);
-			if (lookup(t.root6, 128, ip) != horrible_allowedips_lookup_v6(&h, (struct in6_addr *)ip)) {
+			if (lookup(&t, 128, ip) != horrible_allowedips_lookup_v6(&h, (struct in6_addr *)ip)) {
 				pr_err("allowedips random v6 self-test: FAIL\n");
 				goto free;
 			}
@@ -401,7 +403,7 @@ static __init bool randomized_test(void)
 		horrible_allowedips_remove_by_value(&h, peers[j]);
 	}
 
-	if (t.root4 || t.root6) {
+	if (t.root4 || t.root6 || t.stride4 || t.stride6) {
 		pr_err("allowedips random self-test removal: FAIL\n");
 		goto free;
 	}
@@ -457,6 +459,186 @@ static __init struct wg_peer *init_peer(void)
 	return peer;
 }
 
+enum {
+	NUM_HUB_PEERS = 4096,
+	NUM_HUB_QUERIES = NUM_HUB_PEERS * 16
+};
+
+/* The answer of a plain walk down the binary trie, for comparison. */
+static __init struct wg_peer *lookup_trie(struct allowedips_node __rcu *root,
+					  u8 bits, const void *be_ip)
+{
+	u8 ip[16] __aligned(__alignof(u64));
+	struct allowedips_node *node;
+	struct wg_peer *peer = NULL;
+
+	swap_endian(ip, be_ip, bits);
+	rcu_read_lock_bh();
+	node = find_node(rcu_dereference_bh(root), bits, ip);
+	if (node)
+		peer = rcu_dereference_bh(node->peer);
+	rcu_read_unlock_bh();
+	return peer;
+}
+
+/* Picks a query near one of the addresses in ips, or anywhere at all. */
+static __init void hub_query(u8 *ip, const u8 *ips, unsigned int len)
+{
+	unsigned int i = prandom_u32_max(NUM_HUB_PEERS);
+
+	if (i & 1) {
+		get_random_bytes(ip, len);
+		return;
+	}
+	memcpy(ip, ips + i * len, len);
+	ip[len - 1 - (i & 2) / 2] ^= get_random_u8() & (i & 4 ? 0xff : 0x0f);
+}
+
+static __init bool hub_compare(struct allowedips *t, const u8 *ips4,
+			       const u8 *ips6)
+{
+	u8 ip[16] __aligned(__alignof(u64));
+	struct wg_peer *peer;
+	unsigned int i;
+
+	for (i = 0; i < NUM_HUB_QUERIES; ++i) {
+		hub_query(ip, ips4, 4);
+		peer = lookup(t, 32, ip);
+		if (peer != lookup_trie(t->root4, 32, ip)) {
+			pr_err("allowedips hub v4 self-test: FAIL\n");
+			return false;
+		}
+		hub_query(ip, ips6, 16);
+		peer = lookup(t, 128, ip);
+		if (peer != lookup_trie(t->root6, 128, ip)) {
+			pr_err("allowedips hub v6 self-test: FAIL\n");
+			return false;
+		}
+	}
+	return true;
+}
+
+static __init u64 hub_benchmark(struct allowedips *t, const u8 *ips4,
+				bool stride)
+{
+	u8 ip[16] __aligned(__alignof(u64));
+	struct allowedips_node *node;
+	unsigned int i, hits = 0;
+	u64 start;
+
+	start = ktime_get_ns();
+	rcu_read_lock_bh();
+	for (i = 0; i < NUM_HUB_QUERIES; ++i) {
+		swap_endian(ip, ips4 + (i % NUM_HUB_PEERS) * 4, 32);
+		if (stride)
+			node = find_node_stride(rcu_dereference_bh(t->stride4),
+						rcu_dereference_bh(t->root4),
+						32, ip);
+		else
+			node = find_node(rcu_dereference_bh(t->root4), 32, ip);
+		hits += !!node;
+	}
+	rcu_read_unlock_bh();
+	return hits == NUM_HUB_QUERIES ?
+	       div_u64(ktime_get_ns() - start, NUM_HUB_QUERIES) : U64_MAX;
+}
+
+/* A hub: thousands of peers with a host route each under a common prefix,
+ * some of them with a subnet behind them too. Lookups through the stride
+ * table must agree with walking the trie, while peers come and go.
+ */
+static __init bool hub_test(void)
+{
+	u8 *ips4 = NULL, *ips6 = NULL;
+	struct wg_peer **peers;
+	struct allowedips t;
+	DEFINE_MUTEX(mutex);
+	bool ret = false;
+	unsigned int i;
+
+	mutex_init(&mutex);
+	wg_allowedips_init(&t);
+
+	peers = kcalloc(NUM_HUB_PEERS, sizeof(*peers), GFP_KERNEL);
+	ips4 = kmalloc_array(NUM_HUB_PEERS, 4, GFP_KERNEL);
+	ips6 = kmalloc_array(NUM_HUB_PEERS, 16, GFP_KERNEL);
+	if (unlikely(!peers || !ips4 || !ips6))
+		goto out;
+	for (i = 0; i < NUM_HUB_PEERS; ++i) {
+		peers[i] = init_peer();
+		if (unlikely(!peers[i]))
+			goto out;
+	}
+
+	mutex_lock(&mutex);
+	for (i = 0; i < NUM_HUB_PEERS; ++i) {
+		get_random_bytes(ips4 + i * 4, 4);
+		ips4[i * 4] = 10;
+		get_random_bytes(ips6 + i * 16, 16);
+		memcpy(ips6 + i * 16, ip6(0xfd000000, 0, 0, 0), 6);
+		if (wg_allowedips_insert_v4(&t, (struct in_addr *)(ips4 + i * 4),
+					    32, peers[i], &mutex) < 0 ||
+		    wg_allowedips_insert_v6(&t, (struct in6_addr *)(ips6 + i * 16),
+					    128, peers[i], &mutex) < 0 ||
+		    (!(i % 16) &&
+		     (wg_allowedips_insert_v4(&t, (struct in_addr *)(ips4 + i * 4),
+					      24, peers[i], &mutex) < 0 ||
+		      wg_allowedips_insert_v6(&t, (struct in6_addr *)(ips6 + i * 16),
+					      64, peers[i], &mutex) < 0))) {
+			mutex_unlock(&mutex);
+			pr_err("allowedips hub self-test malloc: FAIL\n");
+			goto out;
+		}
+	}
+	mutex_unlock(&mutex);
+
+	if (!hub_compare(&t, ips4, ips6))
+		goto out;
+
+	if (IS_ENABLED(DEBUG_HUB_BENCHMARK)) {
+		u64 stride_ns = hub_benchmark(&t, ips4, true);
+		u64 trie_ns = hub_benchmark(&t, ips4, false);
+
+		if (stride_ns == U64_MAX || trie_ns == U64_MAX) {
+			pr_err("allowedips hub self-test lookup: FAIL\n");
+			goto out;
+		}
+		pr_info("allowedips hub lookups: %llu ns with stride table, %llu ns walking the trie\n",
+			stride_ns, trie_ns);
+	}
+
+	mutex_lock(&mutex);
+	for (i = 0; i < NUM_HUB_PEERS; i += 3)
+		wg_allowedips_remove_by_peer(&t, peers[i], &mutex);
+	mutex_unlock(&mutex);
+	if (!hub_compare(&t, ips4, ips6))
+		goto out;
+
+	mutex_lock(&mutex);
+	for (i = 0; i < NUM_HUB_PEERS; ++i)
+		wg_allowedips_remove_by_peer(&t, peers[i], &mutex);
+	mutex_unlock(&mutex);
+	if (t.root4 || t.root6 || t.stride4 || t.stride6) {
+		pr_err("allowedips hub self-test removal: FAIL\n");
+		goto out;
+	}
+
+	ret = true;
+
+out:
+	mutex_lock(&mutex);
+	wg_allowedips_free(&t, &mutex);
+	mutex_unlock(&mutex);
+	if (peers) {
+		for (i = 0; i < NUM_HUB_PEERS; ++i)
+			kfree(peers[i]);
+	}
+	kfree(peers);
+	kfree(ips4);
+	kfree(ips6);
+	return ret;
+}
+
 #define insert(version, mem, ipa, ipb, ipc, ipd, cidr)                       \
 	wg_allowedips_insert_v##version(&t, ip##version(ipa, ipb, ipc, ipd), \
 					cidr, mem, &mutex)
@@ -470,13 +652,13 @@ static __init struct wg_peer *init_peer(void)
 	} while (0)
 
 #define test(version, mem, ipa, ipb, ipc, ipd) do {                          \
-		bool _s = lookup(t.root##version, (version) == 4 ? 32 : 128, \
+		bool _s = lookup(&t, (version) == 4 ? 32 : 128,              \
 				 ip##version(ipa, ipb, ipc, ipd)) == (mem);  \
 		maybe_fail();                                                \
 	} while (0)
 
 #define test_negative(version, mem, ipa, ipb, ipc, ipd) do {                 \
-		bool _s = lookup(t.root##version, (version) == 4 ? 32 : 128, \
+		bool _s = lookup(&t, (version) == 4 ? 32 : 128,              \
 				 ip##version(ipa, ipb, ipc, ipd)) != (mem);  \
 		maybe_fail();                                                \
 	} while (0)
@@ -646,6 +828,9 @@ bool __init wg_allowedips_selftest(void)
 	test_boolean(found_e);
 	test_boolean(!found_other);
 
+	if (success)
+		success = hub_test();
+
 	if (IS_ENABLED(DEBUG_RANDOM_TRIE) && success)
 		success = randomized_test();
 
@@ -159,10 +159,13 @@ static unsigned int calculate_skb_padding(struct sk_buff *skb)
 	return padded_size - last_unit;
 }
 
-static bool encrypt_packet(struct sk_buff *skb, struct noise_keypair *keypair)
+/* Returns the number of scatterlist entries the packet needs, or a negative
+ * value if it has to be dropped.
+ */
+static int prepare_packet(struct sk_buff *skb, struct noise_keypair *keypair,
+			  unsigned int *plaintext_len)
 {
-	unsigned int padding_len, plaintext_len, trailer_len;
-	struct scatterlist sg[MAX_SKB_FRAGS + 8];
+	unsigned int padding_len, trailer_len;
 	struct message_data *header;
 	struct sk_buff *trailer;
 	int num_frags;
@@ -175,12 +178,12 @@ static bool encrypt_packet(struct sk_buff *skb, struct noise_keypair *keypair)
 	/* Calculate lengths. */
 	padding_len = calculate_skb_padding(skb);
 	trailer_len = padding_len + noise_encrypted_len(0);
-	plaintext_len = skb->len + padding_len;
+	*plaintext_len = skb->len + padding_len;
 
 	/* Expand data section to have room for padding and auth tag. */
 	num_frags = skb_cow_data(skb, trailer_len, &trailer);
-	if (unlikely(num_frags < 0 || num_frags > ARRAY_SIZE(sg)))
-		return false;
+	if (unlikely(num_frags < 0 || num_frags > MAX_SKB_FRAGS + 8))
+		return -1;
 
 	/* Set the padding to zeros, and make sure it and the auth tag are part
 	 * of the skb.
@@ -191,12 +194,12 @@ static bool encrypt_packet(struct sk_buff *skb, struct noise_keypair *keypair)
 	 * stack's headers.
 	 */
 	if (unlikely(skb_cow_head(skb, DATA_PACKET_HEAD_ROOM) < 0))
-		return false;
+		return -1;
 
 	/* Finalize checksum calculation for the inner packet, if required. */
 	if (unlikely(skb->ip_summed == CHECKSUM_PARTIAL &&
 		     skb_checksum_help(skb)))
-		return false;
+		return -1;
 
 	/* Only after checksumming can we safely add on the padding at the end
 	 * and the header.
@@ -207,6 +210,15 @@ static bool encrypt_packet(struct sk_buff *skb, struct noise_keypair *keypair)
 	header->key_idx = keypair->remote_index;
 	header->counter = cpu_to_le64(PACKET_CB(skb)->nonce);
 	pskb_put(skb, trailer, trailer_len);
+	return num_frags;
+}
+
+static noinline_for_stack bool encrypt_packet(struct sk_buff *skb,
+					      struct noise_keypair *keypair,
+					      int num_frags,
+					      unsigned int plaintext_len)
+{
+	struct scatterlist sg[MAX_SKB_FRAGS + 8];
 
 	/* Now we can encrypt the scattergather segments */
 	sg_init_table(sg, num_frags);
@@ -218,6 +230,67 @@ static bool encrypt_packet(struct sk_buff *skb, struct noise_keypair *keypair)
 						   keypair->sending.key);
 }
 
+static bool encrypt_batch(struct chacha20poly1305_req *reqs,
+			  struct sk_buff **skbs, unsigned int n)
+{
+	unsigned int i;
+	bool ret = true;
+
+	chacha20poly1305_encrypt_sg_inplace_mb(reqs, n);
+	for (i = 0; i < n; ++i) {
+		if (unlikely(!reqs[i].ok))
+			ret = false;
+		wg_reset_packet(skbs[i], true);
+	}
+	return ret;
+}
+
+/* Linear packets, which is nearly all of them on the transmit path, are
+ * encrypted CRYPT_BATCH_SIZE at a time so that short packets can share the
+ * width of the SIMD unit; anything fragmented takes the per-packet path.
+ */
+static bool encrypt_packets(struct sk_buff *first, struct noise_keypair *keypair)
+{
+	struct chacha20poly1305_req reqs[CRYPT_BATCH_SIZE];
+	struct scatterlist sg[CRYPT_BATCH_SIZE];
+	struct sk_buff *skbs[CRYPT_BATCH_SIZE];
+	struct sk_buff *skb, *next;
+	unsigned int plaintext_len, n = 0;
+	int num_frags;
+
+	skb_list_walk_safe(first, skb, next) {
+		num_frags = prepare_packet(skb, keypair, &plaintext_len);
+		if (unlikely(num_frags < 0))
+			return false;
+
+		if (num_frags > 1) {
+			if (unlikely(!encrypt_packet(skb, keypair, num_frags,
+						     plaintext_len)))
+				return false;
+			wg_reset_packet(skb, true);
+			continue;
+		}
+
+		sg_init_table(&sg[n], 1);
+		if (unlikely(skb_to_sgvec(skb, &sg[n], sizeof(struct message_data),
+					  noise_encrypted_len(plaintext_len)) <= 0))
+			return false;
+		reqs[n] = (struct chacha20poly1305_req){
+			.sg = &sg[n],
+			.len = plaintext_len,
+			.nonce = PACKET_CB(skb)->nonce,
+			.key = keypair->sending.key
+		};
+		skbs[n] = skb;
+		if (++n == CRYPT_BATCH_SIZE) {
+			if (unlikely(!encrypt_batch(reqs, skbs, n)))
+				return false;
+			n = 0;
+		}
+	}
+	return !n || encrypt_batch(reqs, skbs, n);
+}
+
 void wg_packet_send_keepalive(struct wg_peer *peer)
 {
 	struct sk_buff *skb;
@@ -239,17 +312,88 @@ void wg_packet_send_keepalive(struct wg_peer *peer)
 	wg_packet_send_staged_packets(peer);
 }
 
+/* The largest UDP payload that still fits in the length field of the outer
+ * IPv4 or IPv6 header.
+ */
+#define MAX_GSO_PAYLOAD_LEN (U16_MAX - sizeof(struct iphdr) - sizeof(struct udphdr))
+
+/* Appends the packets following first to its page fragments for as long as
+ * they are no larger than first and carry the same outer DS field, so that
+ * the batch goes out as a single UDP GSO packet: the route lookup and the
+ * trip down the IP stack are then paid once per batch rather than once per
+ * packet. skb_try_coalesce() steals the head of each packet as a page
+ * fragment, or copies it into the tailroom of first if it fits there,
+ * rather than chaining it on the frag_list. When the device has no UDP
+ * segmentation offload, skb_segment() then only has to point each segment
+ * at its fragment and write its headers, without copying the ciphertext.
+ * That needs a scatter-gather device, which the peer's last route is
+ * checked for. A packet shorter than first ends the batch, since only the
+ * last segment may be short, and so does one whose head can't be stolen.
+ * Returns the remainder of the list, and the number of packets in the batch
+ * in segs.
+ */
+static struct sk_buff *coalesce_packets(struct wg_peer *peer,
+					struct sk_buff *first,
+					unsigned int *segs)
+{
+	unsigned int mss = first->len, len;
+	struct sk_buff *skb = first->next, *next;
+	bool stolen;
+	int delta;
+
+	*segs = 1;
+	if (!READ_ONCE(peer->tx_sg))
+		return skb;
+
+	while (skb && *segs < UDP_MAX_SEGMENTS && skb->len <= mss &&
+	       PACKET_CB(skb)->ds == PACKET_CB(first)->ds &&
+	       first->len + skb->len <= MAX_GSO_PAYLOAD_LEN) {
+		next = skb->next;
+		len = skb->len;
+		if (!skb_try_coalesce(first, skb, &stolen, &delta))
+			break;
+		kfree_skb_partial(skb, stolen);
+		skb = next;
+		++*segs;
+		if (len < mss)
+			break;
+	}
+	if (*segs == 1)
+		return skb;
+
+	skb_shinfo(first)->gso_size = mss;
+	skb_shinfo(first)->gso_segs = *segs;
+	skb_shinfo(first)->gso_type = SKB_GSO_UDP_L4;
+
+	/* udp_set_csum() only seeds the pseudo-header sum of GSO packets, so
+	 * point the checksum at the UDP header that the tunnel will push.
+	 */
+	first->ip_summed = CHECKSUM_PARTIAL;
+	first->csum_start = skb_headroom(first) - sizeof(struct udphdr);
+	first->csum_offset = offsetof(struct udphdr, check);
+	return skb;
+}
+
 static void wg_packet_create_data_done(struct wg_peer *peer, struct sk_buff *first)
 {
 	struct sk_buff *skb, *next;
 	bool is_keepalive, data_sent = false;
+	unsigned int segs;
 
 	wg_timers_any_authenticated_packet_traversal(peer);
 	wg_timers_any_authenticated_packet_sent(peer);
-	skb_list_walk_safe(first, skb, next) {
+	for (skb = first; skb; skb = next) {
+		/* A batch is never larger than its first packet. */
 		is_keepalive = skb->len == message_data_len(0);
-		if (likely(!wg_socket_send_skb_to_peer(peer, skb,
-				PACKET_CB(skb)->ds) && !is_keepalive))
+		next = coalesce_packets(peer, skb, &segs);
+		if (unlikely(wg_socket_send_skb_to_peer(peer, skb,
+							PACKET_CB(skb)->ds)))
+			continue;
+		if (segs > 1) {
+			++peer->tx_gso_batches;
+			peer->tx_gso_packets += segs;
+		}
+		if (likely(!is_keepalive))
 			data_sent = true;
 	}
 
@@ -288,20 +432,13 @@ void wg_packet_encrypt_worker(struct work_struct *work)
 {
 	struct crypt_queue *queue = container_of(work, struct multicore_worker,
 						 work)->ptr;
-	struct sk_buff *first, *skb, *next;
+	struct sk_buff *first;
 
 	while ((first = ptr_ring_consume_bh(&queue->ring)) != NULL) {
 		enum packet_state state = PACKET_STATE_CRYPTED;
 
-		skb_list_walk_safe(first, skb, next) {
-			if (likely(encrypt_packet(skb,
-					PACKET_CB(first)->keypair))) {
-				wg_reset_packet(skb, true);
-			} else {
-				state = PACKET_STATE_DEAD;
-				break;
-			}
-		}
+		if (unlikely(!encrypt_packets(first, PACKET_CB(first)->keypair)))
+			state = PACKET_STATE_DEAD;
 		wg_queue_enqueue_per_peer_tx(first, state);
 		if (need_resched())
 			cond_resched();
@@ -17,8 +17,17 @@
 #include <net/udp_tunnel.h>
 #include <net/ipv6.h>
 
+/* Whether UDP GSO packets built from page fragments go out over dev without
+ * their payload being copied, either whole or through software segmentation.
+ */
+static bool takes_sg_gso(const struct net_device *dev)
+{
+	return dev->features & NETIF_F_SG;
+}
+
 static int send4(struct wg_device *wg, struct sk_buff *skb,
-		 struct endpoint *endpoint, u8 ds, struct dst_cache *cache)
+		 struct endpoint *endpoint, u8 ds, struct dst_cache *cache,
+		 bool *sg)
 {
 	struct flowi4 fl = {
 		.saddr = endpoint->src4.s_addr,
@@ -81,6 +90,8 @@ static int send4(struct wg_device *wg, struct sk_buff *skb,
 			dst_cache_set_ip4(cache, &rt->dst, fl.saddr);
 	}
 
+	if (sg)
+		WRITE_ONCE(*sg, takes_sg_gso(rt->dst.dev));
 	skb->ignore_df = 1;
 	udp_tunnel_xmit_skb(rt, sock, skb, fl.saddr, fl.daddr, ds,
 			    ip4_dst_hoplimit(&rt->dst), 0, fl.fl4_sport,
@@ -95,7 +106,8 @@ static int send4(struct wg_device *wg, struct sk_buff *skb,
 }
 
 static int send6(struct wg_device *wg, struct sk_buff *skb,
-		 struct endpoint *endpoint, u8 ds, struct dst_cache *cache)
+		 struct endpoint *endpoint, u8 ds, struct dst_cache *cache,
+		 bool *sg)
 {
 #if IS_ENABLED(CONFIG_IPV6)
 	struct flowi6 fl = {
@@ -148,6 +160,8 @@ static int send6(struct wg_device *wg, struct sk_buff *skb,
 			dst_cache_set_ip6(cache, dst, &fl.saddr);
 	}
 
+	if (sg)
+		WRITE_ONCE(*sg, takes_sg_gso(dst->dev));
 	skb->ignore_df = 1;
 	udp_tunnel6_xmit_skb(dst, sock, skb, skb->dev, &fl.saddr, &fl.daddr, ds,
 			     ip6_dst_hoplimit(dst), 0, fl.fl6_sport,
@@ -173,10 +187,10 @@ int wg_socket_send_skb_to_peer(struct wg_peer *peer, struct sk_buff *skb, u8 ds)
 	read_lock_bh(&peer->endpoint_lock);
 	if (peer->endpoint.addr.sa_family == AF_INET)
 		ret = send4(peer->device, skb, &peer->endpoint, ds,
-			    &peer->endpoint_cache);
+			    &peer->endpoint_cache, &peer->tx_sg);
 	else if (peer->endpoint.addr.sa_family == AF_INET6)
 		ret = send6(peer->device, skb, &peer->endpoint, ds,
-			    &peer->endpoint_cache);
+			    &peer->endpoint_cache, &peer->tx_sg);
 	else
 		dev_kfree_skb(skb);
 	if (likely(!ret))
@@ -222,9 +236,9 @@ int wg_socket_send_buffer_as_reply_to_skb(struct wg_device *wg,
 	skb_put_data(skb, buffer, len);
 
 	if (endpoint.addr.sa_family == AF_INET)
-		ret = send4(wg, skb, &endpoint, 0, NULL);
+		ret = send4(wg, skb, &endpoint, 0, NULL, NULL);
 	else if (endpoint.addr.sa_family == AF_INET6)
-		ret = send6(wg, skb, &endpoint, 0, NULL);
+		ret = send6(wg, skb, &endpoint, 0, NULL, NULL);
 	/* No other possibilities if the endpoint is valid, which it is,
 	 * as we checked above.
 	 */
@@ -315,7 +329,9 @@ void wg_socket_clear_peer_endpoint_src(struct wg_peer *peer)
 
 static int wg_receive(struct sock *sk, struct sk_buff *skb)
 {
+	struct sk_buff *segs, *next;
 	struct wg_device *wg;
+	u16 count;
 
 	if (unlikely(!sk))
 		goto err;
@@ -323,7 +339,27 @@ static int wg_receive(struct sock *sk, struct sk_buff *skb)
 	if (unlikely(!wg))
 		goto err;
 	skb_mark_not_on_list(skb);
-	wg_packet_receive(wg, skb);
+	if (likely(!skb_is_gso(skb))) {
+		PACKET_CB(skb)->gro_segs = 0;
+		wg_packet_receive(wg, skb);
+		return 0;
+	}
+
+	/* UDP GRO coalesced a run of ciphertext packets from one sender. Cut
+	 * it back into packets here, so that the whole run is handed to the
+	 * decryption workers in one go; the first one carries the size of the
+	 * run for the peer's statistics.
+	 */
+	count = skb_shinfo(skb)->gso_segs;
+	__skb_push(skb, -skb_mac_offset(skb));
+	segs = udp_rcv_segment(sk, skb, sk->sk_family == AF_INET);
+	skb_list_walk_safe(segs, skb, next) {
+		skb_mark_not_on_list(skb);
+		__skb_pull(skb, skb_transport_offset(skb));
+		PACKET_CB(skb)->gro_segs = count;
+		count = 0;
+		wg_packet_receive(wg, skb);
+	}
 	return 0;
 
 err:
@@ -344,6 +380,11 @@ static void set_sock_opts(struct socket *sock)
 	sock->sk->sk_allocation = GFP_ATOMIC;
 	sock->sk->sk_sndbuf = INT_MAX;
 	sk_set_memalloc(sock->sk);
+	/* Have UDP GRO coalesce incoming ciphertext, and have the result
+	 * delivered to wg_receive() whole.
+	 */
+	udp_sk(sock->sk)->gro_enabled = 1;
+	udp_allow_gso(sock->sk);
 }
 
 int wg_socket_init(struct wg_device *wg, u16 port)
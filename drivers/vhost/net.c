@@ -54,6 +54,15 @@ MODULE_PARM_DESC(experimental_zcopytx, "Enable Zero Copy TX;"
 #define VHOST_MAX_PEND 128
 #define VHOST_GOODCOPY_LEN 256
 
+/* Bounds of the zerocopy threshold, which adapts to how long the lower
+ * device holds on to zerocopy buffers.  The upper bound is above any MTU,
+ * so that large GSO packets keep using zerocopy: that is where copying
+ * costs most, and they keep the latency samples coming.
+ */
+#define VHOST_ZCOPY_MAX_LEN 16384
+#define VHOST_ZCOPY_SLOW_NS (250 * NSEC_PER_USEC)
+#define VHOST_ZCOPY_FAST_NS (50 * NSEC_PER_USEC)
+
 /*
  * For transmit, used buffer len is unused; we override it to track buffer
  * status internally; used for zerocopy tx only.
@@ -119,6 +128,9 @@ struct vhost_net_virtqueue {
 	int batched_xdp;
 	/* an array of userspace buffers info */
 	struct ubuf_info_msgzc *ubuf_info;
+	/* Submit time of each ubuf_info, turned into the completion
+	 * latency by vhost_zerocopy_callback() */
+	u64 *ubuf_ns;
 	/* Reference counting for outstanding ubufs.
 	 * Protected by vq mutex. Writers must also take device mutex. */
 	struct vhost_net_ubuf_ref *ubufs;
@@ -138,6 +150,13 @@ struct vhost_net {
 	/* Number of times zerocopy TX recently failed.
 	 * Protected by tx vq lock. */
 	unsigned tx_zcopy_err;
+	/* Packets shorter than this are copied, see vhost_net_tx_adapt().
+	 * Protected by tx vq lock. */
+	unsigned int tx_zcopy_thresh;
+	/* Zerocopy TX recently completed, and their total latency.
+	 * Protected by tx vq lock. */
+	unsigned int tx_zcopy_done;
+	u64 tx_zcopy_ns;
 	/* Flush in progress. Protected by tx vq lock. */
 	bool tx_flush;
 	/* Private page frag */
@@ -273,6 +292,8 @@ static void vhost_net_clear_ubuf_info(struct vhost_net *n)
 	for (i = 0; i < VHOST_NET_VQ_MAX; ++i) {
 		kfree(n->vqs[i].ubuf_info);
 		n->vqs[i].ubuf_info = NULL;
+		kfree(n->vqs[i].ubuf_ns);
+		n->vqs[i].ubuf_ns = NULL;
 	}
 }
 
@@ -291,6 +312,12 @@ static int vhost_net_set_ubuf_info(struct vhost_net *n)
 				      GFP_KERNEL);
 		if  (!n->vqs[i].ubuf_info)
 			goto err;
+		n->vqs[i].ubuf_ns =
+			kmalloc_array(UIO_MAXIOV,
+				      sizeof(*n->vqs[i].ubuf_ns),
+				      GFP_KERNEL);
+		if (!n->vqs[i].ubuf_ns)
+			goto err;
 	}
 	return 0;
 
@@ -316,11 +343,42 @@ static void vhost_net_vq_reset(struct vhost_net *n)
 
 }
 
+/* Zerocopy saves copying the packet, but the guest buffer and its slot in
+ * the VHOST_MAX_PEND window stay busy until the lower device is done with
+ * the pages.  When that takes long, e.g. because the packets sit in a qdisc
+ * or in the socket of another guest, the guest stalls on TX completions and
+ * copying is the better deal for all but the largest packets.  Once per
+ * window, raise the threshold if zerocopy completions were slow, and lower
+ * it if they were fast or if nothing was zero-copied to tell.
+ */
+static void vhost_net_tx_adapt(struct vhost_net *net)
+{
+	unsigned int thresh = net->tx_zcopy_thresh;
+	u64 avg;
+
+	if (net->tx_zcopy_done) {
+		avg = div_u64(net->tx_zcopy_ns, net->tx_zcopy_done);
+		if (avg > VHOST_ZCOPY_SLOW_NS)
+			thresh *= 2;
+		else if (avg < VHOST_ZCOPY_FAST_NS)
+			thresh /= 2;
+	} else {
+		thresh /= 2;
+	}
+
+	net->tx_zcopy_thresh = clamp_t(unsigned int, thresh,
+				       VHOST_GOODCOPY_LEN,
+				       VHOST_ZCOPY_MAX_LEN);
+	net->tx_zcopy_done = 0;
+	net->tx_zcopy_ns = 0;
+}
+
 static void vhost_net_tx_packet(struct vhost_net *net)
 {
 	++net->tx_packets;
 	if (net->tx_packets < 1024)
 		return;
+	vhost_net_tx_adapt(net);
 	net->tx_packets = 0;
 	net->tx_zcopy_err = 0;
 }
@@ -339,6 +397,15 @@ static bool vhost_net_tx_select_zcopy(struct vhost_net *net)
 		net->tx_packets / 64 >= net->tx_zcopy_err;
 }
 
+/* Zerocopy pins every page the packet touches: ask for VHOST_GOODCOPY_LEN
+ * bytes per pinned page, which is what a single page always required.
+ */
+static bool vhost_net_tx_zcopy_pays(const struct iov_iter *from, size_t len)
+{
+	return len >= (size_t)iov_iter_npages(from, UIO_MAXIOV) *
+		      VHOST_GOODCOPY_LEN;
+}
+
 static bool vhost_sock_zcopy(struct socket *sock)
 {
 	return unlikely(experimental_zcopytx) &&
@@ -367,6 +434,13 @@ static void vhost_zerocopy_signal_used(struct vhost_net *net,
 		if (vq->heads[i].len == VHOST_DMA_FAILED_LEN)
 			vhost_net_tx_err(net);
 		if (VHOST_DMA_IS_DONE(vq->heads[i].len)) {
+			/* Pairs with smp_wmb() in vhost_zerocopy_callback() */
+			smp_rmb();
+			if (vq->heads[i].len == VHOST_DMA_DONE_LEN &&
+			    (s64)nvq->ubuf_ns[i] > 0) {
+				net->tx_zcopy_ns += nvq->ubuf_ns[i];
+				++net->tx_zcopy_done;
+			}
 			vq->heads[i].len = VHOST_DMA_CLEAR_LEN;
 			++j;
 		} else
@@ -387,10 +461,15 @@ static void vhost_zerocopy_callback(struct sk_buff *skb,
 	struct ubuf_info_msgzc *ubuf = uarg_to_msgzc(ubuf_base);
 	struct vhost_net_ubuf_ref *ubufs = ubuf->ctx;
 	struct vhost_virtqueue *vq = ubufs->vq;
+	struct vhost_net_virtqueue *nvq =
+		container_of(vq, struct vhost_net_virtqueue, vq);
 	int cnt;
 
 	rcu_read_lock_bh();
 
+	nvq->ubuf_ns[ubuf->desc] = local_clock() - nvq->ubuf_ns[ubuf->desc];
+	smp_wmb();
+
 	/* set len to mark this desc buffers done DMA */
 	vq->heads[ubuf->desc].len = success ?
 		VHOST_DMA_DONE_LEN : VHOST_DMA_FAILED_LEN;
@@ -458,6 +537,15 @@ static void vhost_net_signal_used(struct vhost_net_virtqueue *nvq)
 	nvq->done_idx = 0;
 }
 
+/* handle_tx_zerocopy() tracks the heads in flight in vq->heads[0, UIO_MAXIOV)
+ * and keeps the heads of the packets it batches for copying after them.
+ */
+static struct vring_used_elem *
+vhost_net_batch_heads(struct vhost_net_virtqueue *nvq)
+{
+	return nvq->vq.heads + UIO_MAXIOV;
+}
+
 static void vhost_tx_batch(struct vhost_net *net,
 			   struct vhost_net_virtqueue *nvq,
 			   struct socket *sock,
@@ -485,13 +573,20 @@ static void vhost_tx_batch(struct vhost_net *net,
 		 */
 		for (i = 0; i < nvq->batched_xdp; ++i)
 			put_page(virt_to_head_page(nvq->xdp[i].data));
-		nvq->batched_xdp = 0;
-		nvq->done_idx = 0;
-		return;
+		if (!nvq->ubufs) {
+			nvq->batched_xdp = 0;
+			nvq->done_idx = 0;
+			return;
+		}
 	}
 
 signal_used:
-	vhost_net_signal_used(nvq);
+	if (!nvq->ubufs)
+		vhost_net_signal_used(nvq);
+	else if (nvq->batched_xdp)
+		vhost_add_used_and_signal_n(&net->dev, &nvq->vq,
+					    vhost_net_batch_heads(nvq),
+					    nvq->batched_xdp);
 	nvq->batched_xdp = 0;
 }
 
@@ -545,7 +640,7 @@ static void vhost_net_busy_poll(struct vhost_net *net,
 	endtime = busy_clock() + busyloop_timeout;
 
 	while (vhost_can_busy_poll(endtime)) {
-		if (vhost_has_work(&net->dev)) {
+		if (vhost_vq_has_work(poll_rx ? rvq : tvq)) {
 			*busyloop_intr = true;
 			break;
 		}
@@ -582,10 +677,7 @@ static int vhost_net_tx_get_vq_desc(struct vhost_net *net,
 
 	if (r == tvq->num && tvq->busyloop_timeout) {
 		/* Flush batched packets first */
-		if (!vhost_sock_zcopy(vhost_vq_get_backend(tvq)))
-			vhost_tx_batch(net, tnvq,
-				       vhost_vq_get_backend(tvq),
-				       msghdr);
+		vhost_tx_batch(net, tnvq, vhost_vq_get_backend(tvq), msghdr);
 
 		vhost_net_busy_poll(net, rvq, tvq, busyloop_intr, false);
 
@@ -875,6 +967,7 @@ static void handle_tx_zerocopy(struct vhost_net *net, struct socket *sock)
 	struct ubuf_info_msgzc *ubuf;
 	bool zcopy_used;
 	int sent_pkts = 0;
+	bool sock_can_batch = (sock->sk->sk_sndbuf == INT_MAX);
 
 	do {
 		bool busyloop_intr;
@@ -899,9 +992,40 @@ static void handle_tx_zerocopy(struct vhost_net *net, struct socket *sock)
 			break;
 		}
 
-		zcopy_used = len >= VHOST_GOODCOPY_LEN
+		zcopy_used = len >= net->tx_zcopy_thresh
 			     && !vhost_exceeds_maxpend(net)
-			     && vhost_net_tx_select_zcopy(net);
+			     && vhost_net_tx_select_zcopy(net)
+			     && vhost_net_tx_zcopy_pays(&msg.msg_iter, len);
+
+		/* Packets that are copied anyway are batched as in
+		 * handle_tx_copy(), their heads are used once the batch
+		 * is sent.
+		 */
+		if (!zcopy_used && sock_can_batch) {
+			if (nvq->batched_xdp == VHOST_NET_BATCH)
+				vhost_tx_batch(net, nvq, sock, &msg);
+
+			err = vhost_net_build_xdp(nvq, &msg.msg_iter);
+			if (!err) {
+				struct vring_used_elem *used =
+					vhost_net_batch_heads(nvq) +
+					nvq->batched_xdp - 1;
+
+				used->id = cpu_to_vhost32(vq, head);
+				used->len = 0;
+				total_len += len;
+				vhost_net_tx_packet(net);
+				continue;
+			} else if (unlikely(err != -ENOSPC)) {
+				vhost_tx_batch(net, nvq, sock, &msg);
+				vhost_discard_vq_desc(vq, 1);
+				vhost_net_enable_vq(net, vq);
+				break;
+			}
+		}
+
+		/* Keep the batched packets ahead of this one */
+		vhost_tx_batch(net, nvq, sock, &msg);
 
 		/* use msg_control to pass vhost zerocopy ubuf info to skb */
 		if (zcopy_used) {
@@ -910,6 +1034,7 @@ static void handle_tx_zerocopy(struct vhost_net *net, struct socket *sock)
 			vq->heads[nvq->upend_idx].len = VHOST_DMA_IN_PROGRESS;
 			ubuf->ctx = nvq->ubufs;
 			ubuf->desc = nvq->upend_idx;
+			nvq->ubuf_ns[nvq->upend_idx] = local_clock();
 			ubuf->ubuf.callback = vhost_zerocopy_callback;
 			ubuf->ubuf.flags = SKBFL_ZEROCOPY_FRAG;
 			refcount_set(&ubuf->ubuf.refcnt, 1);
@@ -955,6 +1080,8 @@ static void handle_tx_zerocopy(struct vhost_net *net, struct socket *sock)
 			vhost_zerocopy_signal_used(net, vq);
 		vhost_net_tx_packet(net);
 	} while (likely(!vhost_exceeds_weight(vq, ++sent_pkts, total_len)));
+
+	vhost_tx_batch(net, nvq, sock, &msg);
 }
 
 /* Expects to be always run from workqueue - which acts as
@@ -1328,6 +1455,7 @@ static int vhost_net_open(struct inode *inode, struct file *f)
 	for (i = 0; i < VHOST_NET_VQ_MAX; i++) {
 		n->vqs[i].ubufs = NULL;
 		n->vqs[i].ubuf_info = NULL;
+		n->vqs[i].ubuf_ns = NULL;
 		n->vqs[i].upend_idx = 0;
 		n->vqs[i].done_idx = 0;
 		n->vqs[i].batched_xdp = 0;
@@ -1341,8 +1469,10 @@ static int vhost_net_open(struct inode *inode, struct file *f)
 		       VHOST_NET_PKT_WEIGHT, VHOST_NET_WEIGHT, true,
 		       NULL);
 
-	vhost_poll_init(n->poll + VHOST_NET_VQ_TX, handle_tx_net, EPOLLOUT, dev);
-	vhost_poll_init(n->poll + VHOST_NET_VQ_RX, handle_rx_net, EPOLLIN, dev);
+	vhost_poll_init(n->poll + VHOST_NET_VQ_TX, handle_tx_net, EPOLLOUT, dev,
+			vqs[VHOST_NET_VQ_TX]);
+	vhost_poll_init(n->poll + VHOST_NET_VQ_RX, handle_rx_net, EPOLLIN, dev,
+			vqs[VHOST_NET_VQ_RX]);
 
 	f->private_data = n;
 	n->page_frag.page = NULL;
@@ -1556,6 +1686,9 @@ static long vhost_net_set_backend(struct vhost_net *n, unsigned index, int fd)
 
 		n->tx_packets = 0;
 		n->tx_zcopy_err = 0;
+		n->tx_zcopy_thresh = VHOST_GOODCOPY_LEN;
+		n->tx_zcopy_done = 0;
+		n->tx_zcopy_ns = 0;
 		n->tx_flush = false;
 	}
 
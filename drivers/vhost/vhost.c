@@ -25,6 +25,7 @@
 #include <linux/cgroup.h>
 #include <linux/module.h>
 #include <linux/sort.h>
+#include <linux/sched/clock.h>
 #include <linux/sched/mm.h>
 #include <linux/sched/signal.h>
 #include <linux/interval_tree_generic.h>
@@ -187,12 +188,14 @@ EXPORT_SYMBOL_GPL(vhost_work_init);
 
 /* Init poll structure */
 void vhost_poll_init(struct vhost_poll *poll, vhost_work_fn_t fn,
-		     __poll_t mask, struct vhost_dev *dev)
+		     __poll_t mask, struct vhost_dev *dev,
+		     struct vhost_virtqueue *vq)
 {
 	init_waitqueue_func_entry(&poll->wait, vhost_poll_wakeup);
 	init_poll_funcptr(&poll->table, vhost_poll_func);
 	poll->mask = mask;
 	poll->dev = dev;
+	poll->vq = vq;
 	poll->wqh = NULL;
 
 	vhost_work_init(&poll->work, fn);
@@ -231,46 +234,86 @@ void vhost_poll_stop(struct vhost_poll *poll)
 }
 EXPORT_SYMBOL_GPL(vhost_poll_stop);
 
-void vhost_dev_flush(struct vhost_dev *dev)
+static void vhost_worker_queue(struct vhost_worker *worker,
+			       struct vhost_work *work)
+{
+	if (!test_and_set_bit(VHOST_WORK_QUEUED, &work->flags)) {
+		/* We can only add the work to the list after we're
+		 * sure it was not in the list.
+		 * test_and_set_bit() implies a memory barrier.
+		 */
+		llist_add(&work->node, &worker->work_list);
+		wake_up_process(worker->task);
+	}
+}
+
+static void vhost_worker_flush(struct vhost_worker *worker)
 {
 	struct vhost_flush_struct flush;
 
-	if (dev->worker) {
-		init_completion(&flush.wait_event);
-		vhost_work_init(&flush.work, vhost_flush_work);
+	init_completion(&flush.wait_event);
+	vhost_work_init(&flush.work, vhost_flush_work);
 
-		vhost_work_queue(dev, &flush.work);
-		wait_for_completion(&flush.wait_event);
-	}
+	vhost_worker_queue(worker, &flush.work);
+	wait_for_completion(&flush.wait_event);
+}
+
+/* Flush all the workers of the device. Caller should have device mutex. */
+void vhost_dev_flush(struct vhost_dev *dev)
+{
+	struct vhost_worker *worker;
+	unsigned long i;
+
+	xa_for_each(&dev->worker_xa, i, worker)
+		vhost_worker_flush(worker);
 }
 EXPORT_SYMBOL_GPL(vhost_dev_flush);
 
+/* Queue work on the default worker of the device */
 void vhost_work_queue(struct vhost_dev *dev, struct vhost_work *work)
 {
 	if (!dev->worker)
 		return;
 
-	if (!test_and_set_bit(VHOST_WORK_QUEUED, &work->flags)) {
-		/* We can only add the work to the list after we're
-		 * sure it was not in the list.
-		 * test_and_set_bit() implies a memory barrier.
-		 */
-		llist_add(&work->node, &dev->work_list);
-		wake_up_process(dev->worker);
-	}
+	vhost_worker_queue(dev->worker, work);
 }
 EXPORT_SYMBOL_GPL(vhost_work_queue);
 
+/* Queue work on the worker the virtqueue is attached to */
+void vhost_vq_work_queue(struct vhost_virtqueue *vq, struct vhost_work *work)
+{
+	struct vhost_worker *worker;
+
+	rcu_read_lock();
+	worker = rcu_dereference(vq->worker);
+	if (worker)
+		vhost_worker_queue(worker, work);
+	rcu_read_unlock();
+}
+EXPORT_SYMBOL_GPL(vhost_vq_work_queue);
+
 /* A lockless hint for busy polling code to exit the loop */
-bool vhost_has_work(struct vhost_dev *dev)
+bool vhost_vq_has_work(struct vhost_virtqueue *vq)
 {
-	return !llist_empty(&dev->work_list);
+	struct vhost_worker *worker;
+	bool has_work = false;
+
+	rcu_read_lock();
+	worker = rcu_dereference(vq->worker);
+	if (worker && !llist_empty(&worker->work_list))
+		has_work = true;
+	rcu_read_unlock();
+
+	return has_work;
 }
-EXPORT_SYMBOL_GPL(vhost_has_work);
+EXPORT_SYMBOL_GPL(vhost_vq_has_work);
 
 void vhost_poll_queue(struct vhost_poll *poll)
 {
-	vhost_work_queue(poll->dev, &poll->work);
+	if (poll->vq)
+		vhost_vq_work_queue(poll->vq, &poll->work);
+	else
+		vhost_work_queue(poll->dev, &poll->work);
 }
 EXPORT_SYMBOL_GPL(vhost_poll_queue);
 
@@ -335,9 +378,11 @@ static void vhost_vq_reset(struct vhost_dev *dev,
 
 static int vhost_worker(void *data)
 {
-	struct vhost_dev *dev = data;
+	struct vhost_worker *worker = data;
+	struct vhost_dev *dev = worker->dev;
 	struct vhost_work *work, *work_next;
 	struct llist_node *node;
+	u64 start;
 
 	kthread_use_mm(dev->mm);
 
@@ -350,10 +395,14 @@ static int vhost_worker(void *data)
 			break;
 		}
 
-		node = llist_del_all(&dev->work_list);
-		if (!node)
+		node = llist_del_all(&worker->work_list);
+		if (!node) {
 			schedule();
+			WRITE_ONCE(worker->wakeups, worker->wakeups + 1);
+			continue;
+		}
 
+		start = local_clock();
 		node = llist_reverse_order(node);
 		/* make sure flag is seen after deletion */
 		smp_wmb();
@@ -363,9 +412,12 @@ static int vhost_worker(void *data)
 			kcov_remote_start_common(dev->kcov_handle);
 			work->fn(work);
 			kcov_remote_stop();
+			WRITE_ONCE(worker->work_items, worker->work_items + 1);
 			if (need_resched())
 				schedule();
 		}
+		WRITE_ONCE(worker->busy_ns,
+			   worker->busy_ns + local_clock() - start);
 	}
 	kthread_unuse_mm(dev->mm);
 	return 0;
@@ -474,12 +526,12 @@ void vhost_dev_init(struct vhost_dev *dev,
 	dev->iotlb = NULL;
 	dev->mm = NULL;
 	dev->worker = NULL;
+	xa_init_flags(&dev->worker_xa, XA_FLAGS_ALLOC);
 	dev->iov_limit = iov_limit;
 	dev->weight = weight;
 	dev->byte_weight = byte_weight;
 	dev->use_worker = use_worker;
 	dev->msg_handler = msg_handler;
-	init_llist_head(&dev->work_list);
 	init_waitqueue_head(&dev->wait);
 	INIT_LIST_HEAD(&dev->read_list);
 	INIT_LIST_HEAD(&dev->pending_list);
@@ -492,11 +544,12 @@ void vhost_dev_init(struct vhost_dev *dev,
 		vq->indirect = NULL;
 		vq->heads = NULL;
 		vq->dev = dev;
+		RCU_INIT_POINTER(vq->worker, NULL);
 		mutex_init(&vq->mutex);
 		vhost_vq_reset(dev, vq);
 		if (vq->handle_kick)
 			vhost_poll_init(&vq->poll, vq->handle_kick,
-					EPOLLIN, dev);
+					EPOLLIN, dev, vq);
 	}
 }
 EXPORT_SYMBOL_GPL(vhost_dev_init);
@@ -523,17 +576,238 @@ static void vhost_attach_cgroups_work(struct vhost_work *work)
 	s->ret = cgroup_attach_task_all(s->owner, current);
 }
 
-static int vhost_attach_cgroups(struct vhost_dev *dev)
+static int vhost_attach_cgroups(struct vhost_worker *worker)
 {
 	struct vhost_attach_cgroups_struct attach;
 
 	attach.owner = current;
 	vhost_work_init(&attach.work, vhost_attach_cgroups_work);
-	vhost_work_queue(dev, &attach.work);
-	vhost_dev_flush(dev);
+	vhost_worker_queue(worker, &attach.work);
+	vhost_worker_flush(worker);
 	return attach.ret;
 }
 
+static void vhost_worker_destroy(struct vhost_dev *dev,
+				 struct vhost_worker *worker)
+{
+	WARN_ON(!llist_empty(&worker->work_list));
+	xa_erase(&dev->worker_xa, worker->id);
+	kthread_stop(worker->task);
+	kfree(worker);
+}
+
+/* Caller should have device mutex */
+static void vhost_workers_free(struct vhost_dev *dev)
+{
+	struct vhost_worker *worker;
+	unsigned long i;
+
+	/* The vqs are stopped, no one can queue work on them anymore */
+	for (i = 0; i < dev->nvqs; i++)
+		RCU_INIT_POINTER(dev->vqs[i]->worker, NULL);
+	/* Wait for vhost_vq_work_queue() and vhost_vq_has_work() callers */
+	synchronize_rcu();
+
+	xa_for_each(&dev->worker_xa, i, worker)
+		vhost_worker_destroy(dev, worker);
+	dev->worker = NULL;
+	xa_destroy(&dev->worker_xa);
+}
+
+/* Caller should have device mutex */
+static struct vhost_worker *vhost_worker_create(struct vhost_dev *dev)
+{
+	struct vhost_worker *worker;
+	struct task_struct *task;
+	u32 id;
+	int ret;
+
+	worker = kzalloc(sizeof(*worker), GFP_KERNEL_ACCOUNT);
+	if (!worker)
+		return ERR_PTR(-ENOMEM);
+
+	worker->dev = dev;
+	init_llist_head(&worker->work_list);
+
+	/* The default worker plus at most one per vq */
+	ret = xa_alloc(&dev->worker_xa, &id, worker, XA_LIMIT(0, dev->nvqs),
+		       GFP_KERNEL);
+	if (ret < 0)
+		goto free_worker;
+	worker->id = id;
+
+	/* The first worker keeps the name vhost workers always had */
+	if (id)
+		task = kthread_create(vhost_worker, worker, "vhost-%d-%u",
+				      current->pid, id);
+	else
+		task = kthread_create(vhost_worker, worker, "vhost-%d",
+				      current->pid);
+	if (IS_ERR(task)) {
+		ret = PTR_ERR(task);
+		goto erase_id;
+	}
+
+	worker->task = task;
+	wake_up_process(task); /* avoid contributing to loadavg */
+
+	ret = vhost_attach_cgroups(worker);
+	if (ret)
+		goto stop_worker;
+
+	return worker;
+
+stop_worker:
+	kthread_stop(task);
+erase_id:
+	xa_erase(&dev->worker_xa, id);
+free_worker:
+	kfree(worker);
+	return ERR_PTR(ret);
+}
+
+/*
+ * Drivers rely on the work of a vq, including completions that touch the
+ * vring without the vq mutex, running on a single thread. The worker can
+ * therefore only be changed while the vq is inactive, when nothing can be
+ * queued for it.
+ *
+ * Caller should have device mutex
+ */
+static int vhost_vq_attach_worker(struct vhost_virtqueue *vq,
+				  struct vhost_worker *worker)
+{
+	struct vhost_worker *old_worker;
+
+	mutex_lock(&vq->mutex);
+	if (vq->kick || vhost_vq_get_backend(vq)) {
+		mutex_unlock(&vq->mutex);
+		return -EBUSY;
+	}
+
+	old_worker = rcu_dereference_protected(vq->worker,
+					       lockdep_is_held(&vq->mutex));
+	rcu_assign_pointer(vq->worker, worker);
+	mutex_unlock(&vq->mutex);
+
+	if (old_worker == worker)
+		return 0;
+	worker->attachment_cnt++;
+	if (!old_worker)
+		return 0;
+
+	/*
+	 * Once no one can still be queueing on the old worker, run what is
+	 * already queued there, so that no work is left with
+	 * VHOST_WORK_QUEUED set on a worker the vq no longer uses.
+	 */
+	synchronize_rcu();
+	vhost_worker_flush(old_worker);
+	old_worker->attachment_cnt--;
+	return 0;
+}
+
+static long vhost_worker_ioctl(struct vhost_dev *dev, unsigned int ioctl,
+			       void __user *argp)
+{
+	struct vhost_worker_stats stats = {};
+	struct vhost_worker_state state;
+	struct vhost_worker *worker;
+
+	if (!dev->use_worker)
+		return -EOPNOTSUPP;
+
+	switch (ioctl) {
+	case VHOST_NEW_WORKER:
+		worker = vhost_worker_create(dev);
+		if (IS_ERR(worker))
+			return PTR_ERR(worker);
+
+		/*
+		 * Workers are kernel threads that the owner is not allowed
+		 * to move, let them start where the caller runs instead.
+		 */
+		set_cpus_allowed_ptr(worker->task, current->cpus_ptr);
+
+		state.worker_id = worker->id;
+		if (copy_to_user(argp, &state, sizeof(state))) {
+			vhost_worker_destroy(dev, worker);
+			return -EFAULT;
+		}
+		return 0;
+	case VHOST_FREE_WORKER:
+		if (copy_from_user(&state, argp, sizeof(state)))
+			return -EFAULT;
+
+		worker = xa_load(&dev->worker_xa, state.worker_id);
+		if (!worker)
+			return -ENODEV;
+		if (worker == dev->worker || worker->attachment_cnt)
+			return -EBUSY;
+
+		vhost_worker_destroy(dev, worker);
+		return 0;
+	case VHOST_GET_WORKER_STATS:
+		if (copy_from_user(&stats.worker_id, argp,
+				   sizeof(stats.worker_id)))
+			return -EFAULT;
+
+		worker = xa_load(&dev->worker_xa, stats.worker_id);
+		if (!worker)
+			return -ENODEV;
+
+		stats.pid = task_pid_vnr(worker->task);
+		stats.vrings = worker->attachment_cnt;
+		stats.work_items = READ_ONCE(worker->work_items);
+		stats.wakeups = READ_ONCE(worker->wakeups);
+		stats.busy_ns = READ_ONCE(worker->busy_ns);
+		if (copy_to_user(argp, &stats, sizeof(stats)))
+			return -EFAULT;
+		return 0;
+	default:
+		return -ENOIOCTLCMD;
+	}
+}
+
+/* Caller should have device mutex */
+static long vhost_vring_worker_ioctl(struct vhost_dev *dev,
+				     struct vhost_virtqueue *vq,
+				     unsigned int ioctl, void __user *argp)
+{
+	struct vhost_vring_worker ring_worker;
+	struct vhost_worker *worker;
+
+	if (!dev->use_worker)
+		return -EOPNOTSUPP;
+
+	if (copy_from_user(&ring_worker, argp, sizeof(ring_worker)))
+		return -EFAULT;
+
+	switch (ioctl) {
+	case VHOST_ATTACH_VRING_WORKER:
+		worker = xa_load(&dev->worker_xa, ring_worker.worker_id);
+		if (!worker)
+			return -ENODEV;
+
+		return vhost_vq_attach_worker(vq, worker);
+	case VHOST_GET_VRING_WORKER:
+		mutex_lock(&vq->mutex);
+		worker = rcu_dereference_protected(vq->worker,
+						   lockdep_is_held(&vq->mutex));
+		if (worker)
+			ring_worker.worker_id = worker->id;
+		mutex_unlock(&vq->mutex);
+		if (!worker)
+			return -EINVAL;
+
+		if (copy_to_user(argp, &ring_worker, sizeof(ring_worker)))
+			return -EFAULT;
+		return 0;
+	default:
+		return -ENOIOCTLCMD;
+	}
+}
+
 /* Caller should have device mutex */
 bool vhost_dev_has_owner(struct vhost_dev *dev)
 {
@@ -574,8 +848,8 @@ static void vhost_detach_mm(struct vhost_dev *dev)
 /* Caller should have device mutex */
 long vhost_dev_set_owner(struct vhost_dev *dev)
 {
-	struct task_struct *worker;
-	int err;
+	struct vhost_worker *worker;
+	int i, err;
 
 	/* Is there an owner already? */
 	if (vhost_dev_has_owner(dev)) {
@@ -587,31 +861,25 @@ long vhost_dev_set_owner(struct vhost_dev *dev)
 
 	dev->kcov_handle = kcov_common_handle();
 	if (dev->use_worker) {
-		worker = kthread_create(vhost_worker, dev,
-					"vhost-%d", current->pid);
+		worker = vhost_worker_create(dev);
 		if (IS_ERR(worker)) {
 			err = PTR_ERR(worker);
 			goto err_worker;
 		}
 
 		dev->worker = worker;
-		wake_up_process(worker); /* avoid contributing to loadavg */
-
-		err = vhost_attach_cgroups(dev);
-		if (err)
-			goto err_cgroup;
+		for (i = 0; i < dev->nvqs; i++)
+			rcu_assign_pointer(dev->vqs[i]->worker, worker);
+		worker->attachment_cnt = dev->nvqs;
 	}
 
 	err = vhost_dev_alloc_iovecs(dev);
 	if (err)
-		goto err_cgroup;
+		goto err_iovecs;
 
 	return 0;
-err_cgroup:
-	if (dev->worker) {
-		kthread_stop(dev->worker);
-		dev->worker = NULL;
-	}
+err_iovecs:
+	vhost_workers_free(dev);
 err_worker:
 	vhost_detach_mm(dev);
 	dev->kcov_handle = 0;
@@ -705,10 +973,8 @@ void vhost_dev_cleanup(struct vhost_dev *dev)
 	dev->iotlb = NULL;
 	vhost_clear_msg(dev);
 	wake_up_interruptible_poll(&dev->wait, EPOLLIN | EPOLLRDNORM);
-	WARN_ON(!llist_empty(&dev->work_list));
 	if (dev->worker) {
-		kthread_stop(dev->worker);
-		dev->worker = NULL;
+		vhost_workers_free(dev);
 		dev->kcov_handle = 0;
 	}
 	vhost_detach_mm(dev);
@@ -1619,6 +1885,10 @@ long vhost_vring_ioctl(struct vhost_dev *d, unsigned int ioctl, void __user *arg
 		return vhost_vring_set_num_addr(d, vq, ioctl, argp);
 	}
 
+	if (ioctl == VHOST_ATTACH_VRING_WORKER ||
+	    ioctl == VHOST_GET_VRING_WORKER)
+		return vhost_vring_worker_ioctl(d, vq, ioctl, argp);
+
 	mutex_lock(&vq->mutex);
 
 	switch (ioctl) {
@@ -1820,6 +2090,11 @@ long vhost_dev_ioctl(struct vhost_dev *d, unsigned int ioctl, void __user *argp)
 		if (ctx)
 			eventfd_ctx_put(ctx);
 		break;
+	case VHOST_NEW_WORKER:
+	case VHOST_FREE_WORKER:
+	case VHOST_GET_WORKER_STATS:
+		r = vhost_worker_ioctl(d, ioctl, argp);
+		break;
 	default:
 		r = -ENOIOCTLCMD;
 		break;
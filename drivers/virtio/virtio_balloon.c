@@ -18,6 +18,7 @@
 #include <linux/wait.h>
 #include <linux/mm.h>
 #include <linux/page_reporting.h>
+#include <linux/sizes.h>
 
 /*
  * Balloon device works in 4K page units.  So each page is pointed to by
@@ -25,7 +26,15 @@
  * page units.
  */
 #define VIRTIO_BALLOON_PAGES_PER_PAGE (unsigned int)(PAGE_SIZE >> VIRTIO_BALLOON_PFN_SHIFT)
-#define VIRTIO_BALLOON_ARRAY_PFNS_MAX 256
+#define VIRTIO_BALLOON_ARRAY_PFNS_MAX 2048
+/*
+ * Order of the blocks we try to inflate at once: 2MB, the huge page size
+ * of a host with 4KB base pages. Telling the host about whole huge pages
+ * allows it to discard them without splitting.
+ */
+#define VIRTIO_BALLOON_INFLATE_ORDER (ilog2(SZ_2M) - PAGE_SHIFT)
+#define VIRTIO_BALLOON_INFLATE_PFNS \
+	((1 << VIRTIO_BALLOON_INFLATE_ORDER) * VIRTIO_BALLOON_PAGES_PER_PAGE)
 /* Maximum number of (4k) pages to deflate on OOM notifications. */
 #define VIRTIO_BALLOON_OOM_NR_PAGES 256
 #define VIRTIO_BALLOON_OOM_NOTIFY_PRIORITY 80
@@ -110,6 +119,14 @@ struct virtio_balloon {
 	/* Memory statistics */
 	struct virtio_balloon_stat stats[VIRTIO_BALLOON_S_NR];
 
+	/* Inflate/deflate statistics, in balloon pages, exposed via sysfs */
+	u64 inflate_requests;
+	u64 deflate_requests;
+	u64 inflated_pages;
+	u64 deflated_pages;
+	/* Number of VIRTIO_BALLOON_INFLATE_ORDER blocks inflated at once */
+	u64 inflated_blocks;
+
 	/* Shrinker to return free pages - VIRTIO_BALLOON_F_FREE_PAGE_HINT */
 	struct shrinker shrinker;
 
@@ -201,20 +218,59 @@ static void set_page_pfns(struct virtio_balloon *vb,
 					  page_to_balloon_pfn(page) + i);
 }
 
+/*
+ * Try to allocate a free VIRTIO_BALLOON_INFLATE_ORDER block without reclaim
+ * or compaction, not even by kswapd, and split it into pages that are pushed
+ * to the list such that they pop in ascending pfn order.
+ */
+static bool balloon_block_alloc(struct list_head *pages)
+{
+	const gfp_t gfp = (balloon_mapping_gfp_mask() | __GFP_NOMEMALLOC |
+			   __GFP_NORETRY | __GFP_NOWARN) & ~__GFP_RECLAIM;
+	struct page *page;
+	int i;
+
+	page = alloc_pages(gfp, VIRTIO_BALLOON_INFLATE_ORDER);
+	if (!page)
+		return false;
+
+	split_page(page, VIRTIO_BALLOON_INFLATE_ORDER);
+	for (i = (1 << VIRTIO_BALLOON_INFLATE_ORDER) - 1; i >= 0; i--)
+		balloon_page_push(pages, page + i);
+	return true;
+}
+
 static unsigned int fill_balloon(struct virtio_balloon *vb, size_t num)
 {
 	unsigned int num_allocated_pages;
-	unsigned int num_pfns;
+	unsigned int num_pfns, num_blocks = 0;
+	bool try_blocks = true;
 	struct page *page;
 	LIST_HEAD(pages);
 
+	BUILD_BUG_ON(VIRTIO_BALLOON_INFLATE_ORDER >= MAX_ORDER);
+	BUILD_BUG_ON(VIRTIO_BALLOON_INFLATE_PFNS > VIRTIO_BALLOON_ARRAY_PFNS_MAX);
+
 	/* We can only do one array worth at a time. */
 	num = min(num, ARRAY_SIZE(vb->pfns));
 
-	for (num_pfns = 0; num_pfns < num;
-	     num_pfns += VIRTIO_BALLOON_PAGES_PER_PAGE) {
-		struct page *page = balloon_page_alloc();
+	for (num_pfns = 0; num_pfns < num;) {
+		struct page *page;
 
+		/*
+		 * Inflate whole blocks while they are readily available, so
+		 * the host gets to discard whole huge pages.
+		 */
+		if (try_blocks && num - num_pfns >= VIRTIO_BALLOON_INFLATE_PFNS) {
+			try_blocks = balloon_block_alloc(&pages);
+			if (try_blocks) {
+				num_blocks++;
+				num_pfns += VIRTIO_BALLOON_INFLATE_PFNS;
+				continue;
+			}
+		}
+
+		page = balloon_page_alloc();
 		if (!page) {
 			dev_info_ratelimited(&vb->vdev->dev,
 					     "Out of puff! Can't get %u pages\n",
@@ -225,6 +281,7 @@ static unsigned int fill_balloon(struct virtio_balloon *vb, size_t num)
 		}
 
 		balloon_page_push(&pages, page);
+		num_pfns += VIRTIO_BALLOON_PAGES_PER_PAGE;
 	}
 
 	mutex_lock(&vb->balloon_lock);
@@ -244,8 +301,12 @@ static unsigned int fill_balloon(struct virtio_balloon *vb, size_t num)
 
 	num_allocated_pages = vb->num_pfns;
 	/* Did we get any? */
-	if (vb->num_pfns != 0)
+	if (vb->num_pfns != 0) {
 		tell_host(vb, vb->inflate_vq);
+		vb->inflate_requests++;
+		vb->inflated_pages += vb->num_pfns;
+		vb->inflated_blocks += num_blocks;
+	}
 	mutex_unlock(&vb->balloon_lock);
 
 	return num_allocated_pages;
@@ -294,8 +355,11 @@ static unsigned int leak_balloon(struct virtio_balloon *vb, size_t num)
 	 * virtio_has_feature(vdev, VIRTIO_BALLOON_F_MUST_TELL_HOST);
 	 * is true, we *have* to do it in this order
 	 */
-	if (vb->num_pfns != 0)
+	if (vb->num_pfns != 0) {
 		tell_host(vb, vb->deflate_vq);
+		vb->deflate_requests++;
+		vb->deflated_pages += vb->num_pfns;
+	}
 	release_pages_balloon(vb, &pages);
 	mutex_unlock(&vb->balloon_lock);
 	return num_freed_pages;
@@ -1097,6 +1161,41 @@ static int virtballoon_validate(struct virtio_device *vdev)
 	return 0;
 }
 
+#define VIRTIO_BALLOON_STAT_ATTR(_name)					\
+static ssize_t _name##_show(struct device *dev,				\
+			    struct device_attribute *attr, char *buf)	\
+{									\
+	struct virtio_balloon *vb = dev_to_virtio(dev)->priv;		\
+									\
+	return sysfs_emit(buf, "%llu\n", READ_ONCE(vb->_name));		\
+}									\
+static DEVICE_ATTR_RO(_name)
+
+VIRTIO_BALLOON_STAT_ATTR(inflate_requests);
+VIRTIO_BALLOON_STAT_ATTR(deflate_requests);
+VIRTIO_BALLOON_STAT_ATTR(inflated_pages);
+VIRTIO_BALLOON_STAT_ATTR(deflated_pages);
+VIRTIO_BALLOON_STAT_ATTR(inflated_blocks);
+
+static struct attribute *virtio_balloon_attrs[] = {
+	&dev_attr_inflate_requests.attr,
+	&dev_attr_deflate_requests.attr,
+	&dev_attr_inflated_pages.attr,
+	&dev_attr_deflated_pages.attr,
+	&dev_attr_inflated_blocks.attr,
+	NULL,
+};
+
+static const struct attribute_group virtio_balloon_group = {
+	.name = "virtio_balloon",
+	.attrs = virtio_balloon_attrs,
+};
+
+static const struct attribute_group *virtio_balloon_groups[] = {
+	&virtio_balloon_group,
+	NULL,
+};
+
 static unsigned int features[] = {
 	VIRTIO_BALLOON_F_MUST_TELL_HOST,
 	VIRTIO_BALLOON_F_STATS_VQ,
@@ -1111,6 +1210,7 @@ static struct virtio_driver virtio_balloon_driver = {
 	.feature_table_size = ARRAY_SIZE(features),
 	.driver.name =	KBUILD_MODNAME,
 	.driver.owner =	THIS_MODULE,
+	.driver.dev_groups = virtio_balloon_groups,
 	.id_table =	id_table,
 	.validate =	virtballoon_validate,
 	.probe =	virtballoon_probe,
@@ -43,6 +43,11 @@ module_param(bbm_safe_unplug, bool, 0444);
 MODULE_PARM_DESC(bbm_safe_unplug,
 	     "Use a safe unplug mechanism in BBM, avoiding long/endless loops");
 
+static unsigned long plug_chunk_size;
+module_param(plug_chunk_size, ulong, 0444);
+MODULE_PARM_DESC(plug_chunk_size,
+		 "Plug and add unused memory in aligned chunks of up to this many bytes. Default is 0 (one block at a time).");
+
 /*
  * virtio-mem currently supports the following modes of operation:
  *
@@ -159,6 +164,13 @@ struct virtio_mem {
 	/* If set, the driver is in SBM, otherwise in BBM. */
 	bool in_sbm;
 
+	/*
+	 * Number of completely unused memory blocks (SBM) or big blocks (BBM)
+	 * that are plugged and added at once, see plug_chunk_size. Always a
+	 * power of two, chunks are naturally aligned.
+	 */
+	unsigned long blocks_per_chunk;
+
 	union {
 		struct {
 			/* Id of the first memory block of this device. */
@@ -250,6 +262,15 @@ struct virtio_mem {
 	/* Memory notifier (online/offline events). */
 	struct notifier_block memory_notifier;
 
+	/* Statistics, exposed via sysfs. */
+	uint64_t plug_requests;
+	uint64_t unplug_requests;
+	uint64_t failed_requests;
+	/* Start of the resize in progress, zero if there is none. */
+	ktime_t resize_start;
+	/* How long it took to process the last resize request. */
+	uint64_t last_resize_ms;
+
 #ifdef CONFIG_PROC_VMCORE
 	/* vmcore callback for /proc/vmcore handling in kdump mode */
 	struct vmcore_cb vmcore_cb;
@@ -1364,6 +1385,7 @@ static int virtio_mem_send_plug_request(struct virtio_mem *vm, uint64_t addr,
 
 	dev_dbg(&vm->vdev->dev, "plugging memory: 0x%llx - 0x%llx\n", addr,
 		addr + size - 1);
+	vm->plug_requests++;
 
 	switch (virtio_mem_send_request(vm, &req)) {
 	case VIRTIO_MEM_RESP_ACK:
@@ -1382,6 +1404,7 @@ static int virtio_mem_send_plug_request(struct virtio_mem *vm, uint64_t addr,
 		break;
 	}
 
+	vm->failed_requests++;
 	dev_dbg(&vm->vdev->dev, "plugging memory failed: %d\n", rc);
 	return rc;
 }
@@ -1402,6 +1425,7 @@ static int virtio_mem_send_unplug_request(struct virtio_mem *vm, uint64_t addr,
 
 	dev_dbg(&vm->vdev->dev, "unplugging memory: 0x%llx - 0x%llx\n", addr,
 		addr + size - 1);
+	vm->unplug_requests++;
 
 	switch (virtio_mem_send_request(vm, &req)) {
 	case VIRTIO_MEM_RESP_ACK:
@@ -1417,6 +1441,7 @@ static int virtio_mem_send_unplug_request(struct virtio_mem *vm, uint64_t addr,
 		break;
 	}
 
+	vm->failed_requests++;
 	dev_dbg(&vm->vdev->dev, "unplugging memory failed: %d\n", rc);
 	return rc;
 }
@@ -1429,6 +1454,7 @@ static int virtio_mem_send_unplug_all_request(struct virtio_mem *vm)
 	int rc = -ENOMEM;
 
 	dev_dbg(&vm->vdev->dev, "unplugging all memory");
+	vm->unplug_requests++;
 
 	switch (virtio_mem_send_request(vm, &req)) {
 	case VIRTIO_MEM_RESP_ACK:
@@ -1444,6 +1470,7 @@ static int virtio_mem_send_unplug_all_request(struct virtio_mem *vm)
 		break;
 	}
 
+	vm->failed_requests++;
 	dev_dbg(&vm->vdev->dev, "unplugging all memory failed: %d\n", rc);
 	return rc;
 }
@@ -1640,6 +1667,74 @@ static int virtio_mem_sbm_plug_and_add_mb(struct virtio_mem *vm,
 	return 0;
 }
 
+/*
+ * Try to completely plug the unused memory block mb_id and the unused memory
+ * blocks following it up to the end of its chunk (see plug_chunk_size), and
+ * add them to Linux, using a single plug request and a single call to
+ * add_memory_driver_managed(). New memory blocks are prepared as needed.
+ * Falls back to virtio_mem_sbm_plug_and_add_mb() if that would cover less
+ * than two memory blocks.
+ *
+ * Will modify the state of the memory blocks.
+ */
+static int virtio_mem_sbm_plug_and_add_chunk(struct virtio_mem *vm,
+					     unsigned long mb_id,
+					     uint64_t *nb_sb)
+{
+	const uint64_t mb_size = memory_block_size_bytes();
+	unsigned long count, max_count, next_mb_id, i;
+	const uint64_t addr = virtio_mem_mb_id_to_phys(mb_id);
+	int rc, new_state;
+
+	max_count = vm->blocks_per_chunk - mb_id % vm->blocks_per_chunk;
+	max_count = min_t(uint64_t, max_count, *nb_sb / vm->sbm.sbs_per_mb);
+
+	for (count = 1; count < max_count; count++) {
+		if (!virtio_mem_could_add_memory(vm, (count + 1) * mb_size))
+			break;
+		if (mb_id + count == vm->sbm.next_mb_id) {
+			if (virtio_mem_sbm_prepare_next_mb(vm, &next_mb_id))
+				break;
+		} else if (virtio_mem_sbm_get_mb_state(vm, mb_id + count) !=
+			   VIRTIO_MEM_SBM_MB_UNUSED) {
+			break;
+		}
+	}
+
+	if (count < 2)
+		return virtio_mem_sbm_plug_and_add_mb(vm, mb_id, nb_sb);
+
+	rc = virtio_mem_send_plug_request(vm, addr, count * mb_size);
+	if (rc)
+		return rc;
+
+	/* See virtio_mem_sbm_plug_and_add_mb(). */
+	for (i = 0; i < count; i++) {
+		virtio_mem_sbm_set_sb_plugged(vm, mb_id + i, 0,
+					      vm->sbm.sbs_per_mb);
+		virtio_mem_sbm_set_mb_state(vm, mb_id + i,
+					    VIRTIO_MEM_SBM_MB_OFFLINE);
+	}
+
+	rc = virtio_mem_add_memory(vm, addr, count * mb_size);
+	if (rc) {
+		new_state = VIRTIO_MEM_SBM_MB_UNUSED;
+		if (virtio_mem_send_unplug_request(vm, addr, count * mb_size))
+			new_state = VIRTIO_MEM_SBM_MB_PLUGGED;
+
+		for (i = 0; i < count; i++) {
+			if (new_state == VIRTIO_MEM_SBM_MB_UNUSED)
+				virtio_mem_sbm_set_sb_unplugged(vm, mb_id + i,
+						0, vm->sbm.sbs_per_mb);
+			virtio_mem_sbm_set_mb_state(vm, mb_id + i, new_state);
+		}
+		return rc;
+	}
+
+	*nb_sb -= count * vm->sbm.sbs_per_mb;
+	return 0;
+}
+
 /*
  * Try to plug the desired number of subblocks of a memory block that
  * is already added to Linux.
@@ -1726,7 +1821,7 @@ static int virtio_mem_sbm_plug_request(struct virtio_mem *vm, uint64_t diff)
 		if (!virtio_mem_could_add_memory(vm, memory_block_size_bytes()))
 			return -ENOSPC;
 
-		rc = virtio_mem_sbm_plug_and_add_mb(vm, mb_id, &nb_sb);
+		rc = virtio_mem_sbm_plug_and_add_chunk(vm, mb_id, &nb_sb);
 		if (rc || !nb_sb)
 			return rc;
 		cond_resched();
@@ -1740,7 +1835,7 @@ static int virtio_mem_sbm_plug_request(struct virtio_mem *vm, uint64_t diff)
 		rc = virtio_mem_sbm_prepare_next_mb(vm, &mb_id);
 		if (rc)
 			return rc;
-		rc = virtio_mem_sbm_plug_and_add_mb(vm, mb_id, &nb_sb);
+		rc = virtio_mem_sbm_plug_and_add_chunk(vm, mb_id, &nb_sb);
 		if (rc)
 			return rc;
 		cond_resched();
@@ -1807,6 +1902,74 @@ static int virtio_mem_bbm_prepare_next_bb(struct virtio_mem *vm,
 	return 0;
 }
 
+/*
+ * Try to plug the unused big block bb_id and the unused big blocks following
+ * it up to the end of its chunk (see plug_chunk_size), and add them to Linux,
+ * using a single plug request and a single call to
+ * add_memory_driver_managed(). New big blocks are prepared as needed. Falls
+ * back to virtio_mem_bbm_plug_and_add_bb() if that would cover less than two
+ * big blocks.
+ *
+ * Will modify the state of the big blocks.
+ */
+static int virtio_mem_bbm_plug_and_add_chunk(struct virtio_mem *vm,
+					     unsigned long bb_id,
+					     uint64_t *nb_bb)
+{
+	const uint64_t addr = virtio_mem_bb_id_to_phys(vm, bb_id);
+	unsigned long count, max_count, next_bb_id, i;
+	int rc, new_state;
+
+	if (WARN_ON_ONCE(virtio_mem_bbm_get_bb_state(vm, bb_id) !=
+			 VIRTIO_MEM_BBM_BB_UNUSED))
+		return -EINVAL;
+
+	max_count = vm->blocks_per_chunk - bb_id % vm->blocks_per_chunk;
+	max_count = min_t(uint64_t, max_count, *nb_bb);
+
+	for (count = 1; count < max_count; count++) {
+		if (!virtio_mem_could_add_memory(vm,
+						 (count + 1) * vm->bbm.bb_size))
+			break;
+		if (bb_id + count == vm->bbm.next_bb_id) {
+			if (virtio_mem_bbm_prepare_next_bb(vm, &next_bb_id))
+				break;
+		} else if (virtio_mem_bbm_get_bb_state(vm, bb_id + count) !=
+			   VIRTIO_MEM_BBM_BB_UNUSED) {
+			break;
+		}
+	}
+
+	if (count < 2) {
+		rc = virtio_mem_bbm_plug_and_add_bb(vm, bb_id);
+		if (!rc)
+			*nb_bb -= 1;
+		return rc;
+	}
+
+	rc = virtio_mem_send_plug_request(vm, addr, count * vm->bbm.bb_size);
+	if (rc)
+		return rc;
+	for (i = 0; i < count; i++)
+		virtio_mem_bbm_set_bb_state(vm, bb_id + i,
+					    VIRTIO_MEM_BBM_BB_ADDED);
+
+	rc = virtio_mem_add_memory(vm, addr, count * vm->bbm.bb_size);
+	if (rc) {
+		new_state = VIRTIO_MEM_BBM_BB_UNUSED;
+		/* Retry from the main loop if unplugging fails. */
+		if (virtio_mem_send_unplug_request(vm, addr,
+						   count * vm->bbm.bb_size))
+			new_state = VIRTIO_MEM_BBM_BB_PLUGGED;
+		for (i = 0; i < count; i++)
+			virtio_mem_bbm_set_bb_state(vm, bb_id + i, new_state);
+		return rc;
+	}
+
+	*nb_bb -= count;
+	return 0;
+}
+
 static int virtio_mem_bbm_plug_request(struct virtio_mem *vm, uint64_t diff)
 {
 	uint64_t nb_bb = diff / vm->bbm.bb_size;
@@ -1821,9 +1984,7 @@ static int virtio_mem_bbm_plug_request(struct virtio_mem *vm, uint64_t diff)
 		if (!virtio_mem_could_add_memory(vm, vm->bbm.bb_size))
 			return -ENOSPC;
 
-		rc = virtio_mem_bbm_plug_and_add_bb(vm, bb_id);
-		if (!rc)
-			nb_bb--;
+		rc = virtio_mem_bbm_plug_and_add_chunk(vm, bb_id, &nb_bb);
 		if (rc || !nb_bb)
 			return rc;
 		cond_resched();
@@ -1837,9 +1998,7 @@ static int virtio_mem_bbm_plug_request(struct virtio_mem *vm, uint64_t diff)
 		rc = virtio_mem_bbm_prepare_next_bb(vm, &bb_id);
 		if (rc)
 			return rc;
-		rc = virtio_mem_bbm_plug_and_add_bb(vm, bb_id);
-		if (!rc)
-			nb_bb--;
+		rc = virtio_mem_bbm_plug_and_add_chunk(vm, bb_id, &nb_bb);
 		if (rc)
 			return rc;
 		cond_resched();
@@ -1901,13 +2060,31 @@ static int virtio_mem_sbm_unplug_any_sb_offline(struct virtio_mem *vm,
 }
 
 /*
- * Unplug the given plugged subblocks of an online memory block.
+ * Test if none of the pages in the given online range is in use, so the
+ * range can be fake-offlined without migrating anything. Pages can get
+ * allocated at any time, so this check is racy, but we don't care.
+ */
+static bool virtio_mem_range_is_free(unsigned long start_pfn,
+				     unsigned long nr_pages)
+{
+	unsigned long pfn;
+
+	for (pfn = start_pfn; pfn < start_pfn + nr_pages; pfn++)
+		if (page_ref_count(pfn_to_page(pfn)))
+			return false;
+
+	return true;
+}
+
+/*
+ * Unplug the given plugged subblocks of an online memory block. If free_only
+ * is set, fail with -EBUSY if any of the subblocks is in use.
  *
  * Will modify the state of the memory block.
  */
 static int virtio_mem_sbm_unplug_sb_online(struct virtio_mem *vm,
 					   unsigned long mb_id, int sb_id,
-					   int count)
+					   int count, bool free_only)
 {
 	const unsigned long nr_pages = PFN_DOWN(vm->sbm.sb_size) * count;
 	const int old_state = virtio_mem_sbm_get_mb_state(vm, mb_id);
@@ -1917,6 +2094,9 @@ static int virtio_mem_sbm_unplug_sb_online(struct virtio_mem *vm,
 	start_pfn = PFN_DOWN(virtio_mem_mb_id_to_phys(mb_id) +
 			     sb_id * vm->sbm.sb_size);
 
+	if (free_only && !virtio_mem_range_is_free(start_pfn, nr_pages))
+		return -EBUSY;
+
 	rc = virtio_mem_fake_offline(start_pfn, nr_pages);
 	if (rc)
 		return rc;
@@ -1945,7 +2125,7 @@ static int virtio_mem_sbm_unplug_sb_online(struct virtio_mem *vm,
 
 /*
  * Unplug the desired number of plugged subblocks of an online memory block.
- * Will skip subblock that are busy.
+ * Will skip subblock that are busy, or that are in use if free_only is set.
  *
  * Will modify the state of the memory block. Might temporarily drop the
  * hotplug_mutex.
@@ -1955,7 +2135,7 @@ static int virtio_mem_sbm_unplug_sb_online(struct virtio_mem *vm,
  */
 static int virtio_mem_sbm_unplug_any_sb_online(struct virtio_mem *vm,
 					       unsigned long mb_id,
-					       uint64_t *nb_sb)
+					       uint64_t *nb_sb, bool free_only)
 {
 	int rc, sb_id;
 
@@ -1963,7 +2143,8 @@ static int virtio_mem_sbm_unplug_any_sb_online(struct virtio_mem *vm,
 	if (*nb_sb >= vm->sbm.sbs_per_mb &&
 	    virtio_mem_sbm_test_sb_plugged(vm, mb_id, 0, vm->sbm.sbs_per_mb)) {
 		rc = virtio_mem_sbm_unplug_sb_online(vm, mb_id, 0,
-						     vm->sbm.sbs_per_mb);
+						     vm->sbm.sbs_per_mb,
+						     free_only);
 		if (!rc) {
 			*nb_sb -= vm->sbm.sbs_per_mb;
 			goto unplugged;
@@ -1980,7 +2161,8 @@ static int virtio_mem_sbm_unplug_any_sb_online(struct virtio_mem *vm,
 		if (sb_id < 0)
 			break;
 
-		rc = virtio_mem_sbm_unplug_sb_online(vm, mb_id, sb_id, 1);
+		rc = virtio_mem_sbm_unplug_sb_online(vm, mb_id, sb_id, 1,
+						     free_only);
 		if (rc == -EBUSY)
 			continue;
 		else if (rc)
@@ -2009,8 +2191,8 @@ static int virtio_mem_sbm_unplug_any_sb_online(struct virtio_mem *vm,
 /*
  * Unplug the desired number of plugged subblocks of a memory block that is
  * already added to Linux. Will skip subblock of online memory blocks that are
- * busy (by the OS). Will fail if any subblock that's not busy cannot get
- * unplugged.
+ * busy (by the OS), or that are in use if free_only is set. Will fail if any
+ * subblock that's not busy cannot get unplugged.
  *
  * Will modify the state of the memory block. Might temporarily drop the
  * hotplug_mutex.
@@ -2020,7 +2202,7 @@ static int virtio_mem_sbm_unplug_any_sb_online(struct virtio_mem *vm,
  */
 static int virtio_mem_sbm_unplug_any_sb(struct virtio_mem *vm,
 					unsigned long mb_id,
-					uint64_t *nb_sb)
+					uint64_t *nb_sb, bool free_only)
 {
 	const int old_state = virtio_mem_sbm_get_mb_state(vm, mb_id);
 
@@ -2029,7 +2211,8 @@ static int virtio_mem_sbm_unplug_any_sb(struct virtio_mem *vm,
 	case VIRTIO_MEM_SBM_MB_KERNEL:
 	case VIRTIO_MEM_SBM_MB_MOVABLE_PARTIAL:
 	case VIRTIO_MEM_SBM_MB_MOVABLE:
-		return virtio_mem_sbm_unplug_any_sb_online(vm, mb_id, nb_sb);
+		return virtio_mem_sbm_unplug_any_sb_online(vm, mb_id, nb_sb,
+							   free_only);
 	case VIRTIO_MEM_SBM_MB_OFFLINE_PARTIAL:
 	case VIRTIO_MEM_SBM_MB_OFFLINE:
 		return virtio_mem_sbm_unplug_any_sb_offline(vm, mb_id, nb_sb);
@@ -2039,13 +2222,18 @@ static int virtio_mem_sbm_unplug_any_sb(struct virtio_mem *vm,
 
 static int virtio_mem_sbm_unplug_request(struct virtio_mem *vm, uint64_t diff)
 {
-	const int mb_states[] = {
-		VIRTIO_MEM_SBM_MB_OFFLINE_PARTIAL,
-		VIRTIO_MEM_SBM_MB_OFFLINE,
-		VIRTIO_MEM_SBM_MB_MOVABLE_PARTIAL,
-		VIRTIO_MEM_SBM_MB_KERNEL_PARTIAL,
-		VIRTIO_MEM_SBM_MB_MOVABLE,
-		VIRTIO_MEM_SBM_MB_KERNEL,
+	const struct {
+		int mb_state;
+		bool free_only;
+	} passes[] = {
+		{ VIRTIO_MEM_SBM_MB_OFFLINE_PARTIAL, false },
+		{ VIRTIO_MEM_SBM_MB_OFFLINE, false },
+		{ VIRTIO_MEM_SBM_MB_MOVABLE_PARTIAL, true },
+		{ VIRTIO_MEM_SBM_MB_MOVABLE, true },
+		{ VIRTIO_MEM_SBM_MB_MOVABLE_PARTIAL, false },
+		{ VIRTIO_MEM_SBM_MB_KERNEL_PARTIAL, false },
+		{ VIRTIO_MEM_SBM_MB_MOVABLE, false },
+		{ VIRTIO_MEM_SBM_MB_KERNEL, false },
 	};
 	uint64_t nb_sb = diff / vm->sbm.sb_size;
 	unsigned long mb_id;
@@ -2066,11 +2254,15 @@ static int virtio_mem_sbm_unplug_request(struct virtio_mem *vm, uint64_t diff)
 	 * whole memory blocks along with metadata. We prioritize ZONE_MOVABLE
 	 * as it's more reliable to unplug memory and remove whole memory
 	 * blocks, and we don't want to trigger a zone imbalances by
-	 * accidentially removing too much kernel memory.
+	 * accidentially removing too much kernel memory. Within ZONE_MOVABLE,
+	 * we first only unplug subblocks that are completely free: they can
+	 * be unplugged without migrating any pages, and unplugging them
+	 * first leaves less memory that has to be migrated.
 	 */
-	for (i = 0; i < ARRAY_SIZE(mb_states); i++) {
-		virtio_mem_sbm_for_each_mb_rev(vm, mb_id, mb_states[i]) {
-			rc = virtio_mem_sbm_unplug_any_sb(vm, mb_id, &nb_sb);
+	for (i = 0; i < ARRAY_SIZE(passes); i++) {
+		virtio_mem_sbm_for_each_mb_rev(vm, mb_id, passes[i].mb_state) {
+			rc = virtio_mem_sbm_unplug_any_sb(vm, mb_id, &nb_sb,
+							  passes[i].free_only);
 			if (rc || !nb_sb)
 				goto out_unlock;
 			mutex_unlock(&vm->hotplug_mutex);
@@ -2208,6 +2400,28 @@ static bool virtio_mem_bbm_bb_is_movable(struct virtio_mem *vm,
 	return true;
 }
 
+/*
+ * Test if none of the online memory of a big block is in use.
+ */
+static bool virtio_mem_bbm_bb_is_free(struct virtio_mem *vm,
+				      unsigned long bb_id)
+{
+	const unsigned long start_pfn = PFN_DOWN(virtio_mem_bb_id_to_phys(vm, bb_id));
+	const unsigned long nr_pages = PFN_DOWN(vm->bbm.bb_size);
+	unsigned long pfn;
+
+	for (pfn = start_pfn; pfn < start_pfn + nr_pages;
+	     pfn += PAGES_PER_SECTION) {
+		if (!pfn_to_online_page(pfn))
+			continue;
+		if (!virtio_mem_range_is_free(pfn, PAGES_PER_SECTION))
+			return false;
+		cond_resched();
+	}
+
+	return true;
+}
+
 static int virtio_mem_bbm_unplug_request(struct virtio_mem *vm, uint64_t diff)
 {
 	uint64_t nb_bb = diff / vm->bbm.bb_size;
@@ -2219,9 +2433,9 @@ static int virtio_mem_bbm_unplug_request(struct virtio_mem *vm, uint64_t diff)
 
 	/*
 	 * Try to unplug big blocks. Similar to SBM, start with offline
-	 * big blocks.
+	 * big blocks, followed by free big blocks in ZONE_MOVABLE.
 	 */
-	for (i = 0; i < 3; i++) {
+	for (i = 0; i < 4; i++) {
 		virtio_mem_bbm_for_each_bb_rev(vm, bb_id, VIRTIO_MEM_BBM_BB_ADDED) {
 			cond_resched();
 
@@ -2231,7 +2445,10 @@ static int virtio_mem_bbm_unplug_request(struct virtio_mem *vm, uint64_t diff)
 			 */
 			if (i == 0 && !virtio_mem_bbm_bb_is_offline(vm, bb_id))
 				continue;
-			if (i == 1 && !virtio_mem_bbm_bb_is_movable(vm, bb_id))
+			if ((i == 1 || i == 2) &&
+			    !virtio_mem_bbm_bb_is_movable(vm, bb_id))
+				continue;
+			if (i == 1 && !virtio_mem_bbm_bb_is_free(vm, bb_id))
 				continue;
 			rc = virtio_mem_bbm_offline_remove_and_unplug_bb(vm, bb_id);
 			if (rc == -EBUSY)
@@ -2373,6 +2590,8 @@ static void virtio_mem_run_wq(struct work_struct *work)
 		rc = virtio_mem_unplug_pending_mb(vm);
 
 	if (!rc && vm->requested_size != vm->plugged_size) {
+		if (!vm->resize_start)
+			vm->resize_start = ktime_get();
 		if (vm->requested_size > vm->plugged_size) {
 			diff = vm->requested_size - vm->plugged_size;
 			rc = virtio_mem_plug_request(vm, diff);
@@ -2385,6 +2604,11 @@ static void virtio_mem_run_wq(struct work_struct *work)
 	switch (rc) {
 	case 0:
 		vm->retry_timer_ms = VIRTIO_MEM_RETRY_TIMER_MIN_MS;
+		if (vm->resize_start) {
+			vm->last_resize_ms = ktime_ms_delta(ktime_get(),
+							    vm->resize_start);
+			vm->resize_start = 0;
+		}
 		break;
 	case -ENOSPC:
 		/*
@@ -2454,7 +2678,7 @@ static int virtio_mem_init_vq(struct virtio_mem *vm)
 static int virtio_mem_init_hotplug(struct virtio_mem *vm)
 {
 	const struct range pluggable_range = mhp_get_pluggable_range(true);
-	uint64_t unit_pages, sb_size, addr;
+	uint64_t unit_pages, sb_size, addr, block_size, chunk_size;
 	int rc;
 
 	/* bad device setup - warn only */
@@ -2520,6 +2744,23 @@ static int virtio_mem_init_hotplug(struct virtio_mem *vm)
 					      vm->offline_threshold);
 	}
 
+	/*
+	 * A chunk must neither exceed the offline threshold nor the number of
+	 * device blocks a single plug request can cover.
+	 */
+	vm->blocks_per_chunk = 1;
+	if (plug_chunk_size) {
+		block_size = vm->in_sbm ? memory_block_size_bytes() :
+					  vm->bbm.bb_size;
+		chunk_size = min_t(uint64_t, plug_chunk_size,
+				   vm->offline_threshold);
+		chunk_size = min_t(uint64_t, chunk_size,
+				   U16_MAX * vm->device_block_size);
+		if (chunk_size >= 2 * block_size)
+			vm->blocks_per_chunk =
+				rounddown_pow_of_two(chunk_size / block_size);
+	}
+
 	dev_info(&vm->vdev->dev, "memory block size: 0x%lx",
 		 memory_block_size_bytes());
 	if (vm->in_sbm)
@@ -2528,6 +2769,11 @@ static int virtio_mem_init_hotplug(struct virtio_mem *vm)
 	else
 		dev_info(&vm->vdev->dev, "big block size: 0x%llx",
 			 (unsigned long long)vm->bbm.bb_size);
+	if (vm->blocks_per_chunk > 1)
+		dev_info(&vm->vdev->dev, "plug chunk size: 0x%llx",
+			 (unsigned long long)vm->blocks_per_chunk *
+			 (vm->in_sbm ? memory_block_size_bytes() :
+				       vm->bbm.bb_size));
 
 	/* create the parent resource for all memory */
 	rc = virtio_mem_create_resource(vm);
@@ -2925,6 +3171,57 @@ static unsigned int virtio_mem_features[] = {
 	VIRTIO_MEM_F_UNPLUGGED_INACCESSIBLE,
 };
 
+#define VIRTIO_MEM_STAT_ATTR(_name)					\
+static ssize_t _name##_show(struct device *dev,				\
+			    struct device_attribute *attr, char *buf)	\
+{									\
+	struct virtio_mem *vm = dev_to_virtio(dev)->priv;		\
+									\
+	return sysfs_emit(buf, "%llu\n",				\
+			  (unsigned long long)READ_ONCE(vm->_name));	\
+}									\
+static DEVICE_ATTR_RO(_name)
+
+VIRTIO_MEM_STAT_ATTR(plugged_size);
+VIRTIO_MEM_STAT_ATTR(requested_size);
+VIRTIO_MEM_STAT_ATTR(plug_requests);
+VIRTIO_MEM_STAT_ATTR(unplug_requests);
+VIRTIO_MEM_STAT_ATTR(failed_requests);
+VIRTIO_MEM_STAT_ATTR(last_resize_ms);
+
+static ssize_t resize_ms_show(struct device *dev,
+			      struct device_attribute *attr, char *buf)
+{
+	struct virtio_mem *vm = dev_to_virtio(dev)->priv;
+	const ktime_t start = READ_ONCE(vm->resize_start);
+
+	/* Time spent on the resize in progress, if any. */
+	return sysfs_emit(buf, "%lld\n",
+			  start ? ktime_ms_delta(ktime_get(), start) : 0);
+}
+static DEVICE_ATTR_RO(resize_ms);
+
+static struct attribute *virtio_mem_attrs[] = {
+	&dev_attr_plugged_size.attr,
+	&dev_attr_requested_size.attr,
+	&dev_attr_plug_requests.attr,
+	&dev_attr_unplug_requests.attr,
+	&dev_attr_failed_requests.attr,
+	&dev_attr_resize_ms.attr,
+	&dev_attr_last_resize_ms.attr,
+	NULL,
+};
+
+static const struct attribute_group virtio_mem_group = {
+	.name = "virtio_mem",
+	.attrs = virtio_mem_attrs,
+};
+
+static const struct attribute_group *virtio_mem_groups[] = {
+	&virtio_mem_group,
+	NULL,
+};
+
 static const struct virtio_device_id virtio_mem_id_table[] = {
 	{ VIRTIO_ID_MEM, VIRTIO_DEV_ANY_ID },
 	{ 0 },
@@ -2935,6 +3232,7 @@ static struct virtio_driver virtio_mem_driver = {
 	.feature_table_size = ARRAY_SIZE(virtio_mem_features),
 	.driver.name = KBUILD_MODNAME,
 	.driver.owner = THIS_MODULE,
+	.driver.dev_groups = virtio_mem_groups,
 	.id_table = virtio_mem_id_table,
 	.probe = virtio_mem_probe,
 	.remove = virtio_mem_remove,
@@ -70,6 +70,7 @@
 struct vring_desc_state_split {
 	void *data;			/* Data for callback. */
 	struct vring_desc *indir_desc;	/* Indirect descriptor, if any. */
+	u32 total_in_len;		/* Writable length, for in order. */
 };
 
 struct vring_desc_state_packed {
@@ -77,6 +78,7 @@ struct vring_desc_state_packed {
 	struct vring_packed_desc *indir_desc; /* Indirect descriptor, if any. */
 	u16 num;			/* Descriptor list length. */
 	u16 last;			/* The last desc state in a list. */
+	u32 total_in_len;		/* Writable length, for in order. */
 };
 
 struct vring_desc_extra {
@@ -172,6 +174,9 @@ struct vring_virtqueue {
 	/* Host publishes avail event idx */
 	bool event;
 
+	/* Host uses buffers in the order they were made available */
+	bool in_order;
+
 	/* Head of free buffer list. */
 	unsigned int free_head;
 	/* Number we've added since last sync. */
@@ -185,6 +190,15 @@ struct vring_virtqueue {
 	 */
 	u16 last_used_idx;
 
+	/*
+	 * In order only: the used entry that ends the batch being returned,
+	 * id is UINT_MAX when the next entry has to be read from the ring.
+	 */
+	struct {
+		unsigned int id;
+		u32 len;
+	} batch_last;
+
 	/* Hint for event idx: already triggered no need to disable. */
 	bool event_triggered;
 
@@ -402,6 +416,7 @@ static void virtqueue_init(struct vring_virtqueue *vq, u32 num)
 	else
 		vq->last_used_idx = 0;
 
+	vq->batch_last.id = UINT_MAX;
 	vq->event_triggered = false;
 	vq->num_added = 0;
 
@@ -527,6 +542,7 @@ static inline int virtqueue_add_split(struct virtqueue *_vq,
 	struct scatterlist *sg;
 	struct vring_desc *desc;
 	unsigned int i, n, avail, descs_used, prev, err_idx;
+	u32 total_in_len = 0;
 	int head;
 	bool indirect;
 
@@ -610,6 +626,7 @@ static inline int virtqueue_add_split(struct virtqueue *_vq,
 						     VRING_DESC_F_NEXT |
 						     VRING_DESC_F_WRITE,
 						     indirect);
+			total_in_len += sg->length;
 		}
 	}
 	/* Last one doesn't continue. */
@@ -644,6 +661,7 @@ static inline int virtqueue_add_split(struct virtqueue *_vq,
 
 	/* Store token and indirect buffer state. */
 	vq->split.desc_state[head].data = data;
+	vq->split.desc_state[head].total_in_len = total_in_len;
 	if (indirect)
 		vq->split.desc_state[head].indir_desc = desc;
 	else
@@ -747,8 +765,11 @@ static void detach_buf_split(struct vring_virtqueue *vq, unsigned int head,
 	}
 
 	vring_unmap_one_split(vq, i);
-	vq->split.desc_extra[i].next = vq->free_head;
-	vq->free_head = head;
+	/* In order, the free descriptors stay in ring order from free_head. */
+	if (!vq->in_order) {
+		vq->split.desc_extra[i].next = vq->free_head;
+		vq->free_head = head;
+	}
 
 	/* Plus final descriptor */
 	vq->vq.num_free++;
@@ -842,6 +863,82 @@ static void *virtqueue_get_buf_ctx_split(struct virtqueue *_vq,
 	return ret;
 }
 
+/*
+ * With VIRTIO_F_IN_ORDER, used entries sit at the ring index of the buffer's
+ * head and the used index counts descriptors.  The device may use a whole
+ * batch of buffers with the one entry that names the last of them: read that
+ * entry once, then return the buffers in ring order up to that one.
+ */
+static void *virtqueue_get_buf_ctx_split_in_order(struct virtqueue *_vq,
+						  unsigned int *len,
+						  void **ctx)
+{
+	struct vring_virtqueue *vq = to_vvq(_vq);
+	unsigned int num_free = vq->vq.num_free;
+	u16 last_used;
+	void *ret;
+
+	START_USE(vq);
+
+	if (unlikely(vq->broken)) {
+		END_USE(vq);
+		return NULL;
+	}
+
+	last_used = (vq->last_used_idx & (vq->split.vring.num - 1));
+
+	if (vq->batch_last.id == UINT_MAX) {
+		if (!more_used_split(vq)) {
+			pr_debug("No more buffers in queue\n");
+			END_USE(vq);
+			return NULL;
+		}
+
+		/* Only get used array entries after they have been exposed by host. */
+		virtio_rmb(vq->weak_barriers);
+
+		vq->batch_last.id = virtio32_to_cpu(_vq->vdev,
+				vq->split.vring.used->ring[last_used].id);
+		vq->batch_last.len = virtio32_to_cpu(_vq->vdev,
+				vq->split.vring.used->ring[last_used].len);
+
+		if (unlikely(vq->batch_last.id >= vq->split.vring.num)) {
+			BAD_RING(vq, "id %u out of range\n", vq->batch_last.id);
+			return NULL;
+		}
+	}
+
+	if (unlikely(!vq->split.desc_state[last_used].data)) {
+		BAD_RING(vq, "id %u is not a head!\n", last_used);
+		return NULL;
+	}
+
+	if (vq->batch_last.id == last_used) {
+		*len = vq->batch_last.len;
+		vq->batch_last.id = UINT_MAX;
+	} else {
+		/* Skipped over by the device, which filled it entirely. */
+		*len = vq->split.desc_state[last_used].total_in_len;
+	}
+
+	/* detach_buf_split clears data, so grab it now. */
+	ret = vq->split.desc_state[last_used].data;
+	detach_buf_split(vq, last_used, ctx);
+	vq->last_used_idx += vq->vq.num_free - num_free;
+	/* If we expect an interrupt for the next entry, tell host
+	 * by writing event index and flush out the write before
+	 * the read in the next get_buf call. */
+	if (!(vq->split.avail_flags_shadow & VRING_AVAIL_F_NO_INTERRUPT))
+		virtio_store_mb(vq->weak_barriers,
+				&vring_used_event(&vq->split.vring),
+				cpu_to_virtio16(_vq->vdev, vq->last_used_idx));
+
+	LAST_ADD_TIME_INVALID(vq);
+
+	END_USE(vq);
+	return ret;
+}
+
 static void virtqueue_disable_cb_split(struct virtqueue *_vq)
 {
 	struct vring_virtqueue *vq = to_vvq(_vq);
@@ -911,7 +1008,12 @@ static bool virtqueue_enable_cb_delayed_split(struct virtqueue *_vq)
 						vq->split.avail_flags_shadow);
 	}
 	/* TODO: tune this threshold */
-	bufs = (u16)(vq->split.avail_idx_shadow - vq->last_used_idx) * 3 / 4;
+	if (vq->in_order)
+		/* The used index counts descriptors. */
+		bufs = (vq->split.vring.num - vq->vq.num_free) * 3 / 4;
+	else
+		bufs = (u16)(vq->split.avail_idx_shadow -
+			     vq->last_used_idx) * 3 / 4;
 
 	virtio_store_mb(vq->weak_barriers,
 			&vring_used_event(&vq->split.vring),
@@ -993,6 +1095,10 @@ static void virtqueue_reinit_split(struct vring_virtqueue *vq)
 
 	virtqueue_init(vq, num);
 
+	/* Everything is free again, and in order starts over from 0. */
+	if (vq->in_order)
+		vq->free_head = 0;
+
 	virtqueue_vring_init_split(&vq->split, vq);
 }
 
@@ -1238,6 +1344,7 @@ static int virtqueue_add_indirect_packed(struct vring_virtqueue *vq,
 	struct vring_packed_desc *desc;
 	struct scatterlist *sg;
 	unsigned int i, n, err_idx;
+	u32 total_in_len = 0;
 	u16 head, id;
 	dma_addr_t addr;
 
@@ -1268,6 +1375,8 @@ static int virtqueue_add_indirect_packed(struct vring_virtqueue *vq,
 						0 : VRING_DESC_F_WRITE);
 			desc[i].addr = cpu_to_le64(addr);
 			desc[i].len = cpu_to_le32(sg->length);
+			if (n >= out_sgs)
+				total_in_len += sg->length;
 			i++;
 		}
 	}
@@ -1321,6 +1430,7 @@ static int virtqueue_add_indirect_packed(struct vring_virtqueue *vq,
 	vq->packed.desc_state[id].data = data;
 	vq->packed.desc_state[id].indir_desc = desc;
 	vq->packed.desc_state[id].last = id;
+	vq->packed.desc_state[id].total_in_len = total_in_len;
 
 	vq->num_added += 1;
 
@@ -1354,6 +1464,7 @@ static inline int virtqueue_add_packed(struct virtqueue *_vq,
 	struct vring_packed_desc *desc;
 	struct scatterlist *sg;
 	unsigned int i, n, c, descs_used, err_idx;
+	u32 total_in_len = 0;
 	__le16 head_flags, flags;
 	u16 head, id, prev, curr, avail_used_flags;
 	int err;
@@ -1422,6 +1533,8 @@ static inline int virtqueue_add_packed(struct virtqueue *_vq,
 			desc[i].addr = cpu_to_le64(addr);
 			desc[i].len = cpu_to_le32(sg->length);
 			desc[i].id = cpu_to_le16(id);
+			if (n >= out_sgs)
+				total_in_len += sg->length;
 
 			if (unlikely(vq->use_dma_api)) {
 				vq->packed.desc_extra[curr].addr = addr;
@@ -1456,6 +1569,7 @@ static inline int virtqueue_add_packed(struct virtqueue *_vq,
 	vq->packed.desc_state[id].data = data;
 	vq->packed.desc_state[id].indir_desc = ctx;
 	vq->packed.desc_state[id].last = prev;
+	vq->packed.desc_state[id].total_in_len = total_in_len;
 
 	/*
 	 * A driver MUST NOT make the first descriptor in the list
@@ -1553,8 +1667,14 @@ static void detach_buf_packed(struct vring_virtqueue *vq,
 	/* Clear data ptr. */
 	state->data = NULL;
 
-	vq->packed.desc_extra[state->last].next = vq->free_head;
-	vq->free_head = id;
+	/*
+	 * In order, the free ids stay in ring order from free_head, and so
+	 * each buffer's id is the ring index of its first descriptor.
+	 */
+	if (!vq->in_order) {
+		vq->packed.desc_extra[state->last].next = vq->free_head;
+		vq->free_head = id;
+	}
 	vq->vq.num_free += state->num;
 
 	if (unlikely(vq->use_dma_api)) {
@@ -1606,12 +1726,40 @@ static inline bool more_used_packed(const struct vring_virtqueue *vq)
 	u16 last_used_idx;
 	bool used_wrap_counter;
 
+	/* The rest of an in order batch is only known from batch_last. */
+	if (vq->batch_last.id != UINT_MAX)
+		return true;
+
 	last_used_idx = READ_ONCE(vq->last_used_idx);
 	last_used = packed_last_used(last_used_idx);
 	used_wrap_counter = packed_used_wrap_counter(last_used_idx);
 	return is_used_desc_packed(vq, last_used, used_wrap_counter);
 }
 
+static void update_last_used_idx_packed(struct vring_virtqueue *vq,
+					u16 id, u16 last_used,
+					u16 used_wrap_counter)
+{
+	last_used += vq->packed.desc_state[id].num;
+	if (unlikely(last_used >= vq->packed.vring.num)) {
+		last_used -= vq->packed.vring.num;
+		used_wrap_counter ^= 1;
+	}
+
+	last_used = (last_used | (used_wrap_counter << VRING_PACKED_EVENT_F_WRAP_CTR));
+	WRITE_ONCE(vq->last_used_idx, last_used);
+
+	/*
+	 * If we expect an interrupt for the next entry, tell host
+	 * by writing event index and flush out the write before
+	 * the read in the next get_buf call.
+	 */
+	if (vq->packed.event_flags_shadow == VRING_PACKED_EVENT_FLAG_DESC)
+		virtio_store_mb(vq->weak_barriers,
+				&vq->packed.vring.driver->off_wrap,
+				cpu_to_le16(vq->last_used_idx));
+}
+
 static void *virtqueue_get_buf_ctx_packed(struct virtqueue *_vq,
 					  unsigned int *len,
 					  void **ctx)
@@ -1655,25 +1803,79 @@ static void *virtqueue_get_buf_ctx_packed(struct virtqueue *_vq,
 	/* detach_buf_packed clears data, so grab it now. */
 	ret = vq->packed.desc_state[id].data;
 	detach_buf_packed(vq, id, ctx);
+	update_last_used_idx_packed(vq, id, last_used, used_wrap_counter);
 
-	last_used += vq->packed.desc_state[id].num;
-	if (unlikely(last_used >= vq->packed.vring.num)) {
-		last_used -= vq->packed.vring.num;
-		used_wrap_counter ^= 1;
+	LAST_ADD_TIME_INVALID(vq);
+
+	END_USE(vq);
+	return ret;
+}
+
+/*
+ * With VIRTIO_F_IN_ORDER, a buffer's id is the ring index of its first
+ * descriptor, and the device may use a whole batch of buffers with one used
+ * descriptor, written where the batch starts and carrying the id of its last
+ * buffer: read it once, then return the buffers in ring order up to that one.
+ */
+static void *virtqueue_get_buf_ctx_packed_in_order(struct virtqueue *_vq,
+						   unsigned int *len,
+						   void **ctx)
+{
+	struct vring_virtqueue *vq = to_vvq(_vq);
+	u16 last_used, last_used_idx;
+	bool used_wrap_counter;
+	void *ret;
+
+	START_USE(vq);
+
+	if (unlikely(vq->broken)) {
+		END_USE(vq);
+		return NULL;
 	}
 
-	last_used = (last_used | (used_wrap_counter << VRING_PACKED_EVENT_F_WRAP_CTR));
-	WRITE_ONCE(vq->last_used_idx, last_used);
+	last_used_idx = READ_ONCE(vq->last_used_idx);
+	used_wrap_counter = packed_used_wrap_counter(last_used_idx);
+	last_used = packed_last_used(last_used_idx);
 
-	/*
-	 * If we expect an interrupt for the next entry, tell host
-	 * by writing event index and flush out the write before
-	 * the read in the next get_buf call.
-	 */
-	if (vq->packed.event_flags_shadow == VRING_PACKED_EVENT_FLAG_DESC)
-		virtio_store_mb(vq->weak_barriers,
-				&vq->packed.vring.driver->off_wrap,
-				cpu_to_le16(vq->last_used_idx));
+	if (vq->batch_last.id == UINT_MAX) {
+		if (!is_used_desc_packed(vq, last_used, used_wrap_counter)) {
+			pr_debug("No more buffers in queue\n");
+			END_USE(vq);
+			return NULL;
+		}
+
+		/* Only get used elements after they have been exposed by host. */
+		virtio_rmb(vq->weak_barriers);
+
+		vq->batch_last.id =
+			le16_to_cpu(vq->packed.vring.desc[last_used].id);
+		vq->batch_last.len =
+			le32_to_cpu(vq->packed.vring.desc[last_used].len);
+
+		if (unlikely(vq->batch_last.id >= vq->packed.vring.num)) {
+			BAD_RING(vq, "id %u out of range\n", vq->batch_last.id);
+			return NULL;
+		}
+	}
+
+	if (unlikely(!vq->packed.desc_state[last_used].data)) {
+		BAD_RING(vq, "id %u is not a head!\n", last_used);
+		return NULL;
+	}
+
+	if (vq->batch_last.id == last_used) {
+		*len = vq->batch_last.len;
+		vq->batch_last.id = UINT_MAX;
+	} else {
+		/* Skipped over by the device, which filled it entirely. */
+		*len = vq->packed.desc_state[last_used].total_in_len;
+	}
+
+	/* detach_buf_packed clears data, so grab it now. */
+	ret = vq->packed.desc_state[last_used].data;
+	detach_buf_packed(vq, last_used, ctx);
+	update_last_used_idx_packed(vq, last_used, last_used,
+				    used_wrap_counter);
 
 	LAST_ADD_TIME_INVALID(vq);
 
@@ -1731,6 +1933,9 @@ static bool virtqueue_poll_packed(struct virtqueue *_vq, u16 off_wrap)
 	bool wrap_counter;
 	u16 used_idx;
 
+	if (vq->batch_last.id != UINT_MAX)
+		return true;
+
 	wrap_counter = off_wrap >> VRING_PACKED_EVENT_F_WRAP_CTR;
 	used_idx = off_wrap & ~(1 << VRING_PACKED_EVENT_F_WRAP_CTR);
 
@@ -1789,7 +1994,8 @@ static bool virtqueue_enable_cb_delayed_packed(struct virtqueue *_vq)
 	last_used_idx = READ_ONCE(vq->last_used_idx);
 	wrap_counter = packed_used_wrap_counter(last_used_idx);
 	used_idx = packed_last_used(last_used_idx);
-	if (is_used_desc_packed(vq, used_idx, wrap_counter)) {
+	if (vq->batch_last.id != UINT_MAX ||
+	    is_used_desc_packed(vq, used_idx, wrap_counter)) {
 		END_USE(vq);
 		return false;
 	}
@@ -1975,6 +2181,10 @@ static void virtqueue_reinit_packed(struct vring_virtqueue *vq)
 
 	virtqueue_init(vq, vq->packed.vring.num);
 	virtqueue_vring_init_packed(&vq->packed, !!vq->vq.callback);
+
+	/* Everything is free again, and in order starts over from 0. */
+	if (vq->in_order)
+		vq->free_head = 0;
 }
 
 static struct virtqueue *vring_create_virtqueue_packed(
@@ -2019,6 +2229,7 @@ static struct virtqueue *vring_create_virtqueue_packed(
 	vq->indirect = virtio_has_feature(vdev, VIRTIO_RING_F_INDIRECT_DESC) &&
 		!context;
 	vq->event = virtio_has_feature(vdev, VIRTIO_RING_F_EVENT_IDX);
+	vq->in_order = virtio_has_feature(vdev, VIRTIO_F_IN_ORDER);
 
 	if (virtio_has_feature(vdev, VIRTIO_F_ORDER_PLATFORM))
 		vq->weak_barriers = false;
@@ -2286,6 +2497,11 @@ void *virtqueue_get_buf_ctx(struct virtqueue *_vq, unsigned int *len,
 {
 	struct vring_virtqueue *vq = to_vvq(_vq);
 
+	if (vq->in_order)
+		return vq->packed_ring ?
+			virtqueue_get_buf_ctx_packed_in_order(_vq, len, ctx) :
+			virtqueue_get_buf_ctx_split_in_order(_vq, len, ctx);
+
 	return vq->packed_ring ? virtqueue_get_buf_ctx_packed(_vq, len, ctx) :
 				 virtqueue_get_buf_ctx_split(_vq, len, ctx);
 }
@@ -2512,6 +2728,7 @@ static struct virtqueue *__vring_new_virtqueue(unsigned int index,
 	vq->indirect = virtio_has_feature(vdev, VIRTIO_RING_F_INDIRECT_DESC) &&
 		!context;
 	vq->event = virtio_has_feature(vdev, VIRTIO_RING_F_EVENT_IDX);
+	vq->in_order = virtio_has_feature(vdev, VIRTIO_F_IN_ORDER);
 
 	if (virtio_has_feature(vdev, VIRTIO_F_ORDER_PLATFORM))
 		vq->weak_barriers = false;
@@ -2718,6 +2935,8 @@ void vring_transport_features(struct virtio_device *vdev)
 			break;
 		case VIRTIO_F_ORDER_PLATFORM:
 			break;
+		case VIRTIO_F_IN_ORDER:
+			break;
 		default:
 			/* We don't understand this bit. */
 			__virtio_clear_bit(vdev, i);
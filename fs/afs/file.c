@@ -235,6 +235,27 @@ void afs_put_read(struct afs_read *req)
 	}
 }
 
+/*
+ * Determine if reads of a file may be striped over several fileservers.  This
+ * is only the case for R/O and backup volumes that have more than one replica.
+ */
+static bool afs_vnode_can_stripe(struct afs_vnode *vnode)
+{
+	struct afs_volume *volume = vnode->volume;
+	struct afs_server_list *slist;
+	bool can_stripe;
+
+	if (!READ_ONCE(afs_stripe_size) ||
+	    (volume->type != AFSVL_ROVOL && volume->type != AFSVL_BACKVOL))
+		return false;
+
+	rcu_read_lock();
+	slist = rcu_dereference(volume->servers);
+	can_stripe = slist && slist->nr_servers > 1;
+	rcu_read_unlock();
+	return can_stripe;
+}
+
 static void afs_fetch_data_notify(struct afs_operation *op)
 {
 	struct afs_read *req = op->fetch.req;
@@ -262,11 +283,17 @@ static void afs_fetch_data_success(struct afs_operation *op)
 	afs_vnode_commit_status(op, &op->file[0]);
 	afs_stat_v(vnode, n_fetches);
 	atomic_long_add(op->fetch.req->actual_len, &op->net->n_fetch_bytes);
+	if (op->fetch.stripe_server)
+		afs_fs_record_fetch(op->fetch.stripe_server,
+				    op->fetch.req->actual_len,
+				    op->fetch.issued_at);
 	afs_fetch_data_notify(op);
 }
 
 static void afs_fetch_data_put(struct afs_operation *op)
 {
+	if (op->fetch.stripe_server)
+		atomic_dec(&op->fetch.stripe_server->fetch_inflight);
 	op->fetch.req->error = op->error;
 	afs_put_read(op->fetch.req);
 }
@@ -303,11 +330,42 @@ int afs_fetch_data(struct afs_vnode *vnode, struct afs_read *req)
 
 	afs_op_set_vnode(op, 0, vnode);
 
+	/* Striped reads from a R/O volume don't need to be serialised with
+	 * each other: nothing can change the data under them.
+	 */
+	if (req->subreq && afs_vnode_can_stripe(vnode)) {
+		op->flags |= AFS_OPERATION_STRIPE;
+		op->file[0].need_io_lock = false;
+	}
+
 	op->fetch.req	= afs_get_read(req);
 	op->ops		= &afs_fetch_data_operation;
 	return afs_do_sync_operation(op);
 }
 
+static void afs_fetch_data_worker(struct work_struct *work)
+{
+	struct afs_read *fsreq = container_of(work, struct afs_read, work);
+
+	afs_fetch_data(fsreq->vnode, fsreq);
+	afs_put_read(fsreq);
+}
+
+/*
+ * Cut reads from replicated R/O volumes into stripes so that netfs issues them
+ * as separate subrequests, each of which can go to a different fileserver.
+ */
+static bool afs_clamp_length(struct netfs_io_subrequest *subreq)
+{
+	struct afs_vnode *vnode = AFS_FS_I(subreq->rreq->inode);
+
+	if (afs_vnode_can_stripe(vnode))
+		subreq->len = min_t(size_t, subreq->len,
+				    round_up(READ_ONCE(afs_stripe_size),
+					     PAGE_SIZE));
+	return true;
+}
+
 static void afs_issue_read(struct netfs_io_subrequest *subreq)
 {
 	struct afs_vnode *vnode = AFS_FS_I(subreq->rreq->inode);
@@ -328,6 +386,15 @@ static void afs_issue_read(struct netfs_io_subrequest *subreq)
 			&fsreq->vnode->netfs.inode.i_mapping->i_pages,
 			fsreq->pos, fsreq->len);
 
+	/* Let the stripes of a read proceed in parallel rather than waiting
+	 * for each one to complete before netfs issues the next.
+	 */
+	if (afs_vnode_can_stripe(vnode)) {
+		INIT_WORK(&fsreq->work, afs_fetch_data_worker);
+		queue_work(afs_wq, &fsreq->work);
+		return;
+	}
+
 	afs_fetch_data(fsreq->vnode, fsreq);
 	afs_put_read(fsreq);
 }
@@ -392,6 +459,7 @@ const struct netfs_request_ops afs_req_ops = {
 	.free_request		= afs_free_request,
 	.begin_cache_operation	= afs_begin_cache_operation,
 	.check_write_begin	= afs_check_write_begin,
+	.clamp_length		= afs_clamp_length,
 	.issue_read		= afs_issue_read,
 };
 
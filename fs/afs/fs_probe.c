@@ -476,3 +476,38 @@ void afs_fs_probe_cleanup(struct afs_net *net)
 	if (del_timer_sync(&net->fs_probe_timer))
 		afs_dec_servers_outstanding(net);
 }
+
+/*
+ * Estimate how long, in uS, a FetchData of the given length would take on a
+ * server, going by the probed RTT and the throughput seen on earlier striped
+ * fetches, and scaled up by the number of striped fetches already in flight
+ * to it.  A server we don't have a throughput figure for is costed on RTT
+ * alone so that it gets tried.
+ */
+u64 afs_fs_estimate_fetch(struct afs_server *server, loff_t len)
+{
+	unsigned int rate = READ_ONCE(server->fetch_rate);
+	u64 cost = READ_ONCE(server->probe.rtt);
+
+	if (rate)
+		cost += div_u64((u64)len * 1000, rate);
+	return cost * (atomic_read(&server->fetch_inflight) + 1);
+}
+
+/*
+ * Fold the throughput of a completed striped fetch into the server's record.
+ */
+void afs_fs_record_fetch(struct afs_server *server, loff_t len, ktime_t issued_at)
+{
+	s64 us = ktime_us_delta(ktime_get(), issued_at);
+	unsigned int rate, old;
+
+	if (len <= 0)
+		return;
+	if (us <= 0)
+		us = 1;
+
+	rate = min_t(u64, div64_u64((u64)len * 1000, us), UINT_MAX);
+	old = READ_ONCE(server->fetch_rate);
+	WRITE_ONCE(server->fetch_rate, old ? old - old / 8 + rate / 8 : rate);
+}
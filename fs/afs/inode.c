@@ -266,6 +266,12 @@ static void afs_apply_callback(struct afs_operation *op,
 	struct afs_callback *cb = &vp->scb.callback;
 	struct afs_vnode *vnode = vp->vnode;
 
+	/* Striped fetches don't hold the io_lock and leave the callback
+	 * promise to the operations that do.
+	 */
+	if (op->flags & AFS_OPERATION_STRIPE)
+		return;
+
 	if (!afs_cb_is_broken(vp->cb_break_before, vnode)) {
 		vnode->cb_expires_at	= cb->expires_at;
 		vnode->cb_server	= op->server;
@@ -216,6 +216,7 @@ struct afs_read {
 	void (*cleanup)(struct afs_read *);
 	struct iov_iter		*iter;		/* Iterator representing the buffer */
 	struct iov_iter		def_iter;	/* Default iterator */
+	struct work_struct	work;		/* Async issue of striped reads */
 };
 
 /*
@@ -522,6 +523,10 @@ struct afs_server {
 	unsigned int		rtt;		/* Server's current RTT in uS */
 	unsigned int		debug_id;	/* Debugging ID for traces */
 
+	/* Striped reads from R/O replicas */
+	atomic_t		fetch_inflight;	/* Striped fetches in progress */
+	unsigned int		fetch_rate;	/* FetchData throughput (bytes/ms, EWMA) */
+
 	/* file service access */
 	rwlock_t		fs_lock;	/* access lock */
 
@@ -819,6 +824,8 @@ struct afs_operation {
 		} rename;
 		struct {
 			struct afs_read *req;
+			struct afs_server *stripe_server; /* Server charged for striped fetch */
+			ktime_t		issued_at;	/* When sent to stripe_server */
 		} fetch;
 		struct {
 			afs_lock_type_t type;
@@ -865,6 +872,7 @@ struct afs_operation {
 #define AFS_OPERATION_TRIED_ALL		0x0400	/* Set if we've tried all the fileservers */
 #define AFS_OPERATION_RETRY_SERVER	0x0800	/* Set if we should retry the current server */
 #define AFS_OPERATION_DIR_CONFLICT	0x1000	/* Set if we detected a 3rd-party dir change */
+#define AFS_OPERATION_STRIPE		0x2000	/* Set if fetch may go to any R/O replica */
 };
 
 /*
@@ -1163,6 +1171,8 @@ extern void afs_probe_fileserver(struct afs_net *, struct afs_server *);
 extern void afs_fs_probe_dispatcher(struct work_struct *);
 extern int afs_wait_for_one_fs_probe(struct afs_server *, bool);
 extern void afs_fs_probe_cleanup(struct afs_net *);
+extern u64 afs_fs_estimate_fetch(struct afs_server *, loff_t);
+extern void afs_fs_record_fetch(struct afs_server *, loff_t, ktime_t);
 
 /*
  * inode.c
@@ -1188,6 +1198,8 @@ extern int afs_drop_inode(struct inode *);
  */
 extern struct workqueue_struct *afs_wq;
 extern int afs_net_id;
+extern unsigned int afs_stripe_size;
+extern unsigned int afs_stripe_max_inflight;
 
 static inline struct afs_net *afs_net(struct net *net)
 {
@@ -28,6 +28,14 @@ static char *rootcell;
 module_param(rootcell, charp, 0);
 MODULE_PARM_DESC(rootcell, "root AFS cell name and VL server IP addr list");
 
+unsigned int afs_stripe_size = 256 * 1024;
+module_param_named(stripe_size, afs_stripe_size, uint, 0644);
+MODULE_PARM_DESC(stripe_size, "Size of reads striped over R/O replicas (0 to disable)");
+
+unsigned int afs_stripe_max_inflight = 4;
+module_param_named(stripe_max_inflight, afs_stripe_max_inflight, uint, 0644);
+MODULE_PARM_DESC(stripe_max_inflight, "Striped reads in flight per fileserver before others are preferred");
+
 struct workqueue_struct *afs_wq;
 static struct proc_dir_entry *afs_proc_symlink;
 
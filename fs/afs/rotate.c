@@ -34,6 +34,12 @@ static bool afs_start_fs_iteration(struct afs_operation *op,
 	op->untried = (1UL << op->server_list->nr_servers) - 1;
 	op->index = READ_ONCE(op->server_list->preferred);
 
+	/* Striped fetches run in parallel without the io_lock, so they leave
+	 * the callback bookkeeping to the operations that hold it.
+	 */
+	if (op->flags & AFS_OPERATION_STRIPE)
+		return true;
+
 	cb_server = vnode->cb_server;
 	if (cb_server) {
 		/* See if the vnode's preferred record is still available */
@@ -67,6 +73,55 @@ static bool afs_start_fs_iteration(struct afs_operation *op,
 	return true;
 }
 
+/*
+ * Pick the untried server on which a striped fetch is expected to complete
+ * soonest.  Servers that already have their fill of striped fetches in flight
+ * are only used if all the others do too.
+ */
+static int afs_pick_stripe_server(struct afs_operation *op)
+{
+	u64 cost, best = U64_MAX, best_busy = U64_MAX;
+	int index = -1, busy_index = -1, i;
+
+	for (i = 0; i < op->server_list->nr_servers; i++) {
+		struct afs_server *s = op->server_list->servers[i].server;
+
+		if (!test_bit(i, &op->untried) ||
+		    !test_bit(AFS_SERVER_FL_RESPONDING, &s->flags))
+			continue;
+
+		cost = afs_fs_estimate_fetch(s, op->fetch.req->len);
+		if (atomic_read(&s->fetch_inflight) >=
+		    READ_ONCE(afs_stripe_max_inflight)) {
+			if (cost < best_busy) {
+				busy_index = i;
+				best_busy = cost;
+			}
+			continue;
+		}
+
+		if (cost < best) {
+			index = i;
+			best = cost;
+		}
+	}
+
+	return index != -1 ? index : busy_index;
+}
+
+/*
+ * Charge a striped fetch to the server it's about to be sent to.
+ */
+static void afs_set_stripe_server(struct afs_operation *op,
+				  struct afs_server *server)
+{
+	if (op->fetch.stripe_server)
+		atomic_dec(&op->fetch.stripe_server->fetch_inflight);
+	atomic_inc(&server->fetch_inflight);
+	op->fetch.stripe_server = server;
+	op->fetch.issued_at = ktime_get();
+}
+
 /*
  * Post volume busy note.
  */
@@ -341,16 +396,20 @@ bool afs_select_fileserver(struct afs_operation *op)
 	}
 
 	op->index = -1;
-	rtt = U32_MAX;
-	for (i = 0; i < op->server_list->nr_servers; i++) {
-		struct afs_server *s = op->server_list->servers[i].server;
+	if (op->flags & AFS_OPERATION_STRIPE) {
+		op->index = afs_pick_stripe_server(op);
+	} else {
+		rtt = U32_MAX;
+		for (i = 0; i < op->server_list->nr_servers; i++) {
+			struct afs_server *s = op->server_list->servers[i].server;
 
-		if (!test_bit(i, &op->untried) ||
-		    !test_bit(AFS_SERVER_FL_RESPONDING, &s->flags))
-			continue;
-		if (s->probe.rtt < rtt) {
-			op->index = i;
-			rtt = s->probe.rtt;
+			if (!test_bit(i, &op->untried) ||
+			    !test_bit(AFS_SERVER_FL_RESPONDING, &s->flags))
+				continue;
+			if (s->probe.rtt < rtt) {
+				op->index = i;
+				rtt = s->probe.rtt;
+			}
 		}
 	}
 
@@ -375,6 +434,13 @@ bool afs_select_fileserver(struct afs_operation *op)
 
 	op->flags |= AFS_OPERATION_RETRY_SERVER;
 	op->server = server;
+	if (op->flags & AFS_OPERATION_STRIPE) {
+		/* Leave the vnode's callback server alone, see
+		 * afs_start_fs_iteration().
+		 */
+		afs_set_stripe_server(op, server);
+		goto got_server;
+	}
 	if (vnode->cb_server != server) {
 		vnode->cb_server = server;
 		vnode->cb_s_break = server->cb_s_break;
@@ -383,6 +449,7 @@ bool afs_select_fileserver(struct afs_operation *op)
 		clear_bit(AFS_VNODE_CB_PROMISED, &vnode->flags);
 	}
 
+got_server:
 	read_lock(&server->fs_lock);
 	alist = rcu_dereference_protected(server->addresses,
 					  lockdep_is_held(&server->fs_lock));
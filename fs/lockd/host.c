@@ -18,6 +18,7 @@
 #include <linux/sunrpc/svc.h>
 #include <linux/lockd/lockd.h>
 #include <linux/mutex.h>
+#include <linux/rculist.h>
 
 #include <linux/sunrpc/svc_xprt.h>
 
@@ -45,6 +46,12 @@ static struct hlist_head	nlm_client_hosts[NLM_HOST_NRHASH];
 		hlist_for_each_entry_safe((host), (next), \
 						(chain), h_hash)
 
+/*
+ * nlm_host_mutex serializes changes to the host tables: insertion,
+ * destruction and garbage collection. Lookups that hit an existing
+ * host walk the hash chain under RCU instead; a host whose h_count
+ * has dropped to zero is about to be destroyed and is skipped.
+ */
 static unsigned long		nrhosts;
 static DEFINE_MUTEX(nlm_host_mutex);
 
@@ -105,6 +112,38 @@ static unsigned int nlm_hash_address(const struct sockaddr *sap)
 	return hash & (NLM_HOST_NRHASH - 1);
 }
 
+/*
+ * Find a matching host without taking nlm_host_mutex. @src_sap is only
+ * compared for server hosts.
+ */
+static struct nlm_host *nlm_lookup_host_rcu(struct hlist_head *chain,
+					    const struct nlm_lookup_host_info *ni,
+					    const struct sockaddr *src_sap)
+{
+	struct nlm_host	*host;
+
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(host, chain, h_hash) {
+		if (host->net != ni->net)
+			continue;
+		if (!rpc_cmp_addr(nlm_addr(host), ni->sap))
+			continue;
+		if (host->h_proto != ni->protocol)
+			continue;
+		if (host->h_version != ni->version)
+			continue;
+		if (src_sap && !rpc_cmp_addr(nlm_srcaddr(host), src_sap))
+			continue;
+		if (!refcount_inc_not_zero(&host->h_count))
+			continue;
+		host->h_expires = jiffies + NLM_HOST_EXPIRE;
+		rcu_read_unlock();
+		return host;
+	}
+	rcu_read_unlock();
+	return NULL;
+}
+
 /*
  * Allocate and initialize an nlm_host.  Common to both client and server.
  */
@@ -182,7 +221,7 @@ static void nlm_destroy_host_locked(struct nlm_host *host)
 
 	dprintk("lockd: destroy host %s\n", host->h_name);
 
-	hlist_del_init(&host->h_hash);
+	hlist_del_init_rcu(&host->h_hash);
 
 	nsm_unmonitor(host);
 	nsm_release(host->h_nsmhandle);
@@ -191,7 +230,7 @@ static void nlm_destroy_host_locked(struct nlm_host *host)
 	if (clnt != NULL)
 		rpc_shutdown_client(clnt);
 	put_cred(host->h_cred);
-	kfree(host);
+	kfree_rcu(host, h_rcu);
 
 	ln->nrhosts--;
 	nrhosts--;
@@ -243,9 +282,16 @@ struct nlm_host *nlmclnt_lookup_host(const struct sockaddr *sap,
 			(hostname ? hostname : "<none>"), version,
 			(protocol == IPPROTO_UDP ? "udp" : "tcp"));
 
+	chain = &nlm_client_hosts[nlm_hash_address(sap)];
+	host = nlm_lookup_host_rcu(chain, &ni, NULL);
+	if (host) {
+		dprintk("lockd: %s found host %s (%s)\n", __func__,
+			host->h_name, host->h_addrbuf);
+		return host;
+	}
+
 	mutex_lock(&nlm_host_mutex);
 
-	chain = &nlm_client_hosts[nlm_hash_address(sap)];
 	hlist_for_each_entry(host, chain, h_hash) {
 		if (host->net != net)
 			continue;
@@ -271,7 +317,7 @@ struct nlm_host *nlmclnt_lookup_host(const struct sockaddr *sap,
 	if (unlikely(host == NULL))
 		goto out;
 
-	hlist_add_head(&host->h_hash, chain);
+	hlist_add_head_rcu(&host->h_hash, chain);
 	ln->nrhosts++;
 	nrhosts++;
 
@@ -351,12 +397,21 @@ struct nlm_host *nlmsvc_lookup_host(const struct svc_rqst *rqstp,
 			(int)hostname_len, hostname, rqstp->rq_vers,
 			(rqstp->rq_prot == IPPROTO_UDP ? "udp" : "tcp"));
 
+	chain = &nlm_server_hosts[nlm_hash_address(ni.sap)];
+	if (time_before(jiffies, ln->next_gc)) {
+		host = nlm_lookup_host_rcu(chain, &ni, src_sap);
+		if (host) {
+			dprintk("lockd: %s found host %s (%s)\n",
+				__func__, host->h_name, host->h_addrbuf);
+			return host;
+		}
+	}
+
 	mutex_lock(&nlm_host_mutex);
 
 	if (time_after_eq(jiffies, ln->next_gc))
 		nlm_gc_hosts(net);
 
-	chain = &nlm_server_hosts[nlm_hash_address(ni.sap)];
 	hlist_for_each_entry(host, chain, h_hash) {
 		if (host->net != net)
 			continue;
@@ -375,8 +430,8 @@ struct nlm_host *nlmsvc_lookup_host(const struct svc_rqst *rqstp,
 			continue;
 
 		/* Move to head of hash chain. */
-		hlist_del(&host->h_hash);
-		hlist_add_head(&host->h_hash, chain);
+		hlist_del_rcu(&host->h_hash);
+		hlist_add_head_rcu(&host->h_hash, chain);
 
 		nlm_get_host(host);
 		dprintk("lockd: %s found host %s (%s)\n",
@@ -390,12 +445,11 @@ struct nlm_host *nlmsvc_lookup_host(const struct svc_rqst *rqstp,
 
 	memcpy(nlm_srcaddr(host), src_sap, src_len);
 	host->h_srcaddrlen = src_len;
-	hlist_add_head(&host->h_hash, chain);
+	refcount_inc(&host->h_count);
+	hlist_add_head_rcu(&host->h_hash, chain);
 	ln->nrhosts++;
 	nrhosts++;
 
-	refcount_inc(&host->h_count);
-
 	dprintk("lockd: %s created host %s (%s)\n",
 		__func__, host->h_name, host->h_addrbuf);
 
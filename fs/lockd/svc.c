@@ -642,6 +642,8 @@ static int __init init_nlm(void)
 {
 	int err;
 
+	nlm_files_init();
+
 #ifdef CONFIG_SYSCTL
 	err = -ENOMEM;
 	nlm_sysctl_table = register_sysctl_table(nlm_sysctl_root);
@@ -13,24 +13,36 @@
 #include <linux/in.h>
 #include <linux/slab.h>
 #include <linux/mutex.h>
+#include <linux/jhash.h>
+#include <linux/rculist.h>
 #include <linux/sunrpc/svc.h>
 #include <linux/sunrpc/addr.h>
 #include <linux/lockd/lockd.h>
 #include <linux/lockd/share.h>
 #include <linux/module.h>
 #include <linux/mount.h>
-#include <uapi/linux/nfs2.h>
 
 #define NLMDBG_FACILITY		NLMDBG_SVCSUBS
 
 
 /*
  * Global file hash table
+ *
+ * Each bucket has its own mutex, which serializes insertion and removal
+ * of files on that chain. Lookups of existing files walk the chain
+ * under RCU and only take the bucket mutex when a new file has to be
+ * created. A file whose f_count has been set to NLM_FILE_DEAD is being
+ * torn down and must not be handed out again.
  */
-#define FILE_HASH_BITS		7
+#define FILE_HASH_BITS		8
 #define FILE_NRHASH		(1<<FILE_HASH_BITS)
-static struct hlist_head	nlm_files[FILE_NRHASH];
-static DEFINE_MUTEX(nlm_file_mutex);
+#define NLM_FILE_DEAD		(-1)
+
+struct nlm_file_bucket {
+	struct mutex		lock;
+	struct hlist_head	files;
+};
+static struct nlm_file_bucket	nlm_files[FILE_NRHASH];
 
 #ifdef CONFIG_SUNRPC_DEBUG
 static inline void nlm_debug_print_fh(char *msg, struct nfs_fh *f)
@@ -64,11 +76,22 @@ static inline void nlm_debug_print_file(char *msg, struct nlm_file *file)
 
 static inline unsigned int file_hash(struct nfs_fh *f)
 {
-	unsigned int tmp=0;
+	return jhash(f->data, f->size, 0) & (FILE_NRHASH - 1);
+}
+
+static inline struct nlm_file_bucket *nlm_file_bucket(struct nfs_fh *f)
+{
+	return &nlm_files[file_hash(f)];
+}
+
+void nlm_files_init(void)
+{
 	int i;
-	for (i=0; i<NFS2_FHSIZE;i++)
-		tmp += f->data[i];
-	return tmp & (FILE_NRHASH - 1);
+
+	for (i = 0; i < FILE_NRHASH; i++) {
+		mutex_init(&nlm_files[i].lock);
+		INIT_HLIST_HEAD(&nlm_files[i].files);
+	}
 }
 
 int lock_to_openmode(struct file_lock *lock)
@@ -97,6 +120,29 @@ static __be32 nlm_do_fopen(struct svc_rqst *rqstp,
 	return nfserr;
 }
 
+/*
+ * Find a file in the hash table and take a reference to it, without
+ * taking the bucket mutex.
+ */
+static struct nlm_file *
+nlm_lookup_file_rcu(struct nlm_file_bucket *bucket, struct nfs_fh *fh)
+{
+	struct nlm_file	*file;
+
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(file, &bucket->files, f_list) {
+		if (nfs_compare_fh(&file->f_handle, fh))
+			continue;
+		if (atomic_fetch_add_unless(&file->f_count, 1,
+					    NLM_FILE_DEAD) == NLM_FILE_DEAD)
+			continue;
+		rcu_read_unlock();
+		return file;
+	}
+	rcu_read_unlock();
+	return NULL;
+}
+
 /*
  * Lookup file info. If it doesn't exist, create a file info struct
  * and open a (VFS) file for the given inode.
@@ -105,24 +151,27 @@ __be32
 nlm_lookup_file(struct svc_rqst *rqstp, struct nlm_file **result,
 					struct nlm_lock *lock)
 {
+	struct nlm_file_bucket *bucket;
 	struct nlm_file	*file;
-	unsigned int	hash;
-	__be32		nfserr;
+	__be32		nfserr = 0;
 	int		mode;
 
 	nlm_debug_print_fh("nlm_lookup_file", &lock->fh);
 
-	hash = file_hash(&lock->fh);
+	bucket = nlm_file_bucket(&lock->fh);
 	mode = lock_to_openmode(&lock->fl);
 
-	/* Lock file table */
-	mutex_lock(&nlm_file_mutex);
+	file = nlm_lookup_file_rcu(bucket, &lock->fh);
+	if (file)
+		goto found;
 
-	hlist_for_each_entry(file, &nlm_files[hash], f_list)
+	mutex_lock(&bucket->lock);
+
+	/* Files on the chain can only be marked dead under the bucket lock */
+	hlist_for_each_entry(file, &bucket->files, f_list)
 		if (!nfs_compare_fh(&file->f_handle, &lock->fh)) {
-			mutex_lock(&file->f_mutex);
-			nfserr = nlm_do_fopen(rqstp, file, mode);
-			mutex_unlock(&file->f_mutex);
+			atomic_inc(&file->f_count);
+			mutex_unlock(&bucket->lock);
 			goto found;
 		}
 	nlm_debug_print_fh("creating file for", &lock->fh);
@@ -130,47 +179,68 @@ nlm_lookup_file(struct svc_rqst *rqstp, struct nlm_file **result,
 	nfserr = nlm_lck_denied_nolocks;
 	file = kzalloc(sizeof(*file), GFP_KERNEL);
 	if (!file)
-		goto out_free;
+		goto out_unlock;
 
 	memcpy(&file->f_handle, &lock->fh, sizeof(struct nfs_fh));
 	mutex_init(&file->f_mutex);
 	INIT_HLIST_NODE(&file->f_list);
 	INIT_LIST_HEAD(&file->f_blocks);
+	atomic_set(&file->f_count, 1);
 
 	nfserr = nlm_do_fopen(rqstp, file, mode);
 	if (nfserr)
-		goto out_unlock;
+		goto out_free;
 
-	hlist_add_head(&file->f_list, &nlm_files[hash]);
+	hlist_add_head_rcu(&file->f_list, &bucket->files);
+	mutex_unlock(&bucket->lock);
 
-found:
-	dprintk("lockd: found file %p (count %d)\n", file, file->f_count);
+	dprintk("lockd: created file %p\n", file);
 	*result = file;
-	file->f_count++;
+	return 0;
 
-out_unlock:
-	mutex_unlock(&nlm_file_mutex);
+found:
+	if (!READ_ONCE(file->f_file[mode])) {
+		mutex_lock(&file->f_mutex);
+		nfserr = nlm_do_fopen(rqstp, file, mode);
+		mutex_unlock(&file->f_mutex);
+	}
+	dprintk("lockd: found file %p (count %d)\n", file,
+		atomic_read(&file->f_count));
+	*result = file;
 	return nfserr;
 
 out_free:
 	kfree(file);
-	goto out_unlock;
+out_unlock:
+	mutex_unlock(&bucket->lock);
+	return nfserr;
+}
+
+static void nlm_close_files(struct nlm_file *file)
+{
+	if (file->f_file[O_RDONLY])
+		nlmsvc_ops->fclose(file->f_file[O_RDONLY]);
+	if (file->f_file[O_WRONLY])
+		nlmsvc_ops->fclose(file->f_file[O_WRONLY]);
 }
 
 /*
- * Delete a file after having released all locks, blocks and shares
+ * Delete a file after having released all locks, blocks and shares.
+ * The caller holds the bucket mutex. Lockless lookups may still pick
+ * up a reference until the file is marked dead; if one did, the file
+ * stays where it is and is dropped again by that lookup's release.
  */
-static inline void
+static void
 nlm_delete_file(struct nlm_file *file)
 {
+	if (atomic_cmpxchg(&file->f_count, 0, NLM_FILE_DEAD) != 0)
+		return;
+
 	nlm_debug_print_file("closing file", file);
 	if (!hlist_unhashed(&file->f_list)) {
-		hlist_del(&file->f_list);
-		if (file->f_file[O_RDONLY])
-			nlmsvc_ops->fclose(file->f_file[O_RDONLY]);
-		if (file->f_file[O_WRONLY])
-			nlmsvc_ops->fclose(file->f_file[O_WRONLY]);
-		kfree(file);
+		hlist_del_rcu(&file->f_list);
+		nlm_close_files(file);
+		kfree_rcu(file, f_rcu);
 	} else {
 		printk(KERN_WARNING "lockd: attempt to release unknown file!\n");
 	}
@@ -267,7 +337,8 @@ nlm_file_inuse(struct nlm_file *file)
 	struct file_lock *fl;
 	struct file_lock_context *flctx = inode->i_flctx;
 
-	if (file->f_count || !list_empty(&file->f_blocks) || file->f_shares)
+	if (atomic_read(&file->f_count) || !list_empty(&file->f_blocks) ||
+	    file->f_shares)
 		return 1;
 
 	if (flctx && !list_empty_careful(&flctx->flc_posix)) {
@@ -284,14 +355,6 @@ nlm_file_inuse(struct nlm_file *file)
 	return 0;
 }
 
-static void nlm_close_files(struct nlm_file *file)
-{
-	if (file->f_file[O_RDONLY])
-		nlmsvc_ops->fclose(file->f_file[O_RDONLY]);
-	if (file->f_file[O_WRONLY])
-		nlmsvc_ops->fclose(file->f_file[O_WRONLY]);
-}
-
 /*
  * Loop over all files in the file table.
  */
@@ -299,35 +362,34 @@ static int
 nlm_traverse_files(void *data, nlm_host_match_fn_t match,
 		int (*is_failover_file)(void *data, struct nlm_file *file))
 {
+	struct nlm_file_bucket *bucket;
 	struct hlist_node *next;
 	struct nlm_file	*file;
 	int i, ret = 0;
 
-	mutex_lock(&nlm_file_mutex);
 	for (i = 0; i < FILE_NRHASH; i++) {
-		hlist_for_each_entry_safe(file, next, &nlm_files[i], f_list) {
+		bucket = &nlm_files[i];
+		mutex_lock(&bucket->lock);
+		hlist_for_each_entry_safe(file, next, &bucket->files, f_list) {
 			if (is_failover_file && !is_failover_file(data, file))
 				continue;
-			file->f_count++;
-			mutex_unlock(&nlm_file_mutex);
+			atomic_inc(&file->f_count);
+			mutex_unlock(&bucket->lock);
 
 			/* Traverse locks, blocks and shares of this file
 			 * and update file->f_locks count */
 			if (nlm_inspect_file(data, file, match))
 				ret = 1;
 
-			mutex_lock(&nlm_file_mutex);
-			file->f_count--;
+			mutex_lock(&bucket->lock);
 			/* No more references to this file. Let go of it. */
-			if (list_empty(&file->f_blocks) && !file->f_locks
-			 && !file->f_shares && !file->f_count) {
-				hlist_del(&file->f_list);
-				nlm_close_files(file);
-				kfree(file);
-			}
+			if (atomic_dec_and_test(&file->f_count) &&
+			    list_empty(&file->f_blocks) && !file->f_locks &&
+			    !file->f_shares)
+				nlm_delete_file(file);
 		}
+		mutex_unlock(&bucket->lock);
 	}
-	mutex_unlock(&nlm_file_mutex);
 	return ret;
 }
 
@@ -343,17 +405,20 @@ nlm_traverse_files(void *data, nlm_host_match_fn_t match,
 void
 nlm_release_file(struct nlm_file *file)
 {
+	struct nlm_file_bucket *bucket = nlm_file_bucket(&file->f_handle);
+
 	dprintk("lockd: nlm_release_file(%p, ct = %d)\n",
-				file, file->f_count);
+				file, atomic_read(&file->f_count));
 
-	/* Lock file table */
-	mutex_lock(&nlm_file_mutex);
+	/* Lock the file's hash chain once the last reference is gone */
+	if (!atomic_dec_and_mutex_lock(&file->f_count, &bucket->lock))
+		return;
 
 	/* If there are no more locks etc, delete the file */
-	if (--file->f_count == 0 && !nlm_file_inuse(file))
+	if (!nlm_file_inuse(file))
 		nlm_delete_file(file);
 
-	mutex_unlock(&nlm_file_mutex);
+	mutex_unlock(&bucket->lock);
 }
 
 /*
@@ -52,6 +52,9 @@ struct persistent_ram_buffer {
 /* 定义持久性RAM区域的签名常量，这里"DBGC"是一个魔数，用于标识数据结构或内存块。 */
 #define PERSISTENT_RAM_SIG (0x43474244) /* DBGC */
 
+/* 启动时检查旧数据时，每次批量解码的数据块数 */
+#define RAM_ECC_BATCH	64
+
 /*
  * 获取持久性RAM区域的缓冲区大小。
  * @prz: 指向持久性RAM区域的指针。
@@ -217,29 +220,48 @@ static void persistent_ram_update_header_ecc(struct persistent_ram_zone *prz)
 static void persistent_ram_ecc_old(struct persistent_ram_zone *prz)
 {
 	struct persistent_ram_buffer *buffer = prz->buffer;  // 获取持久性RAM区域的缓冲区指针
+	uint8_t *end = buffer->data + prz->buffer_size;  // 缓冲区的末尾
+	uint8_t *used = buffer->data + buffer_size(prz);  // 有效数据的末尾
+	int block_size = prz->ecc_info.block_size;
+	int ecc_size = prz->ecc_info.ecc_size;
+	int results[RAM_ECC_BATCH];  // 每个数据块的纠错结果
 	uint8_t *block;  // 指向当前处理的数据块
 	uint8_t *par;    // 指向当前数据块的纠错编码部分
+	int i, nr;
 
-	if (!prz->ecc_info.ecc_size)
+	if (!ecc_size)
 		return;  // 如果纠错编码大小为0，无需处理，直接返回
 
 	block = buffer->data;  // 设置block指向缓冲区的开始
 	par = prz->par_buffer;  // 设置par指向纠错编码的开始
-	while (block < buffer->data + buffer_size(prz)) {  // 循环遍历所有数据块
-		int numerr;  // 用于存储纠错过程中发现的错误数
-		int size = prz->ecc_info.block_size;  // 设置处理的数据块大小为纠错块大小
-		if (block + size > buffer->data + prz->buffer_size)  // 如果数据块末尾超出缓冲区
-			size = buffer->data + prz->buffer_size - block;  // 调整最后一个数据块的大小
-		numerr = persistent_ram_decode_rs8(prz, block, size, par);  // 对数据块进行纠错解码
-		if (numerr > 0) {
-			pr_devel("error in block %p, %d\n", block, numerr);  // 如果有错误被修正，记录修正的错误数
-			prz->corrected_bytes += numerr;  // 累计修正的总字节数
-		} else if (numerr < 0) {
-			pr_devel("uncorrectable error in block %p\n", block);  // 如果错误无法修正，记录错误信息
-			prz->bad_blocks++;  // 增加无法修正的块的计数
+	while (block < used) {  // 循环遍历所有数据块
+		int size = block_size;  // 设置处理的数据块大小为纠错块大小
+
+		/* 完整的数据块每次批量解码RAM_ECC_BATCH个，最后一个可能不完整的块单独解码 */
+		nr = min3((long)RAM_ECC_BATCH,
+			  (long)DIV_ROUND_UP(used - block, block_size),
+			  (long)((end - block) / block_size));
+		if (!nr) {
+			nr = 1;
+			size = end - block;  // 调整最后一个数据块的大小
+		}
+
+		for (i = 0; i < nr * ecc_size; i++)
+			prz->ecc_info.par[i] = par[i];
+		decode_rs8_batch(prz->rs_decoder, block, prz->ecc_info.par,
+				 size, block_size, nr, 0, results);
+
+		for (i = 0; i < nr; i++) {
+			if (results[i] > 0) {
+				pr_devel("error in block %p, %d\n", block, results[i]);  // 如果有错误被修正，记录修正的错误数
+				prz->corrected_bytes += results[i];  // 累计修正的总字节数
+			} else if (results[i] < 0) {
+				pr_devel("uncorrectable error in block %p\n", block);  // 如果错误无法修正，记录错误信息
+				prz->bad_blocks++;  // 增加无法修正的块的计数
+			}
+			block += block_size;  // 移动到下一个数据块
+			par += ecc_size;  // 移动到下一个纠错编码块
 		}
-		block += prz->ecc_info.block_size;  // 移动到下一个数据块
-		par += prz->ecc_info.ecc_size;  // 移动到下一个纠错编码块
 	}
 }
 
@@ -313,8 +335,9 @@ static int persistent_ram_init_ecc(struct persistent_ram_zone *prz,
 	}
 
 	/* allocate workspace instead of using stack VLA */
-	// 分配空间给纠错编码的工作空间，使用动态内存分配而非栈
-	prz->ecc_info.par = kmalloc_array(prz->ecc_info.ecc_size,
+	// 分配空间给纠错编码的工作空间，使用动态内存分配而非栈，大小足以批量解码RAM_ECC_BATCH个块
+	prz->ecc_info.par = kmalloc_array(RAM_ECC_BATCH *
+					  prz->ecc_info.ecc_size,
 					  sizeof(*prz->ecc_info.par),
 					  GFP_KERNEL);
 	if (!prz->ecc_info.par) {
@@ -108,4 +108,38 @@ static inline void chacha20_crypt(u32 *state, u8 *dst, const u8 *src,
 	chacha_crypt(state, dst, src, bytes, 20);
 }
 
+/*
+ * Multi-buffer interface: en/decrypt @n independent messages at once, the
+ * i-th one being @bytes[i] bytes from @src[i] to @dst[i] with @state[i].
+ * Each state is advanced as chacha_crypt() would advance it.  Arch code
+ * may compute the keystream of several messages in parallel SIMD lanes,
+ * which is much faster than chacha_crypt() for short messages.
+ */
+void chacha_crypt_mb_arch(u32 (*state)[CHACHA_STATE_WORDS], u8 **dst,
+			  const u8 **src, const unsigned int *bytes,
+			  unsigned int n, int nrounds);
+
+static inline void chacha_crypt_mb(u32 (*state)[CHACHA_STATE_WORDS], u8 **dst,
+				   const u8 **src, const unsigned int *bytes,
+				   unsigned int n, int nrounds)
+{
+	unsigned int i;
+
+	if (IS_ENABLED(CONFIG_CRYPTO_ARCH_HAVE_LIB_CHACHA_MB)) {
+		chacha_crypt_mb_arch(state, dst, src, bytes, n, nrounds);
+		return;
+	}
+	for (i = 0; i < n; i++)
+		if (bytes[i])
+			chacha_crypt(state[i], dst[i], src[i], bytes[i],
+				     nrounds);
+}
+
+static inline void chacha20_crypt_mb(u32 (*state)[CHACHA_STATE_WORDS],
+				     u8 **dst, const u8 **src,
+				     const unsigned int *bytes, unsigned int n)
+{
+	chacha_crypt_mb(state, dst, src, bytes, n, 20);
+}
+
 #endif /* _CRYPTO_CHACHA_H */
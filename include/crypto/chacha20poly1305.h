@@ -45,6 +45,27 @@ bool chacha20poly1305_decrypt_sg_inplace(struct scatterlist *src, size_t src_len
 					 const u64 nonce,
 					 const u8 key[CHACHA20POLY1305_KEY_SIZE]);
 
+/*
+ * One message of a multi-buffer operation.  @len is the length that the
+ * matching single-message sg_inplace function would take, @ok is set to
+ * its return value.
+ */
+struct chacha20poly1305_req {
+	struct scatterlist *sg;
+	size_t len;
+	const u8 *ad;
+	size_t ad_len;
+	u64 nonce;
+	const u8 *key;
+	bool ok;
+};
+
+void chacha20poly1305_encrypt_sg_inplace_mb(struct chacha20poly1305_req *reqs,
+					    unsigned int n);
+
+void chacha20poly1305_decrypt_sg_inplace_mb(struct chacha20poly1305_req *reqs,
+					    unsigned int n);
+
 bool chacha20poly1305_selftest(void);
 
 #endif /* __CHACHA20POLY1305_H */
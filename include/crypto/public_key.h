@@ -13,6 +13,8 @@
 #include <linux/keyctl.h>
 #include <linux/oid_registry.h>
 
+struct crypto_akcipher;
+
 /*
  * Cryptographic data for the public-key subtype of the asymmetric key type.
  *
@@ -28,6 +30,7 @@ struct public_key {
 	bool key_is_private;
 	const char *id_type;
 	const char *pkey_algo;
+	struct crypto_akcipher *tfm;	/* Keyed transform cached for verification */
 };
 
 extern void public_key_free(struct public_key *key);
@@ -79,8 +82,14 @@ extern int decrypt_blob(struct kernel_pkey_params *, const void *, void *);
 extern int create_signature(struct kernel_pkey_params *, const void *, void *);
 extern int verify_signature(const struct key *,
 			    const struct public_key_signature *);
+extern int verify_signatures(const struct key *,
+			     const struct public_key_signature *const *,
+			     unsigned int, int *);
 
 int public_key_verify_signature(const struct public_key *pkey,
 				const struct public_key_signature *sig);
+int public_key_verify_signatures(const struct public_key *pkey,
+				 const struct public_key_signature *const *sigs,
+				 unsigned int nr_sigs, int *results);
 
 #endif /* _LINUX_PUBLIC_KEY_H */
@@ -42,6 +42,11 @@ struct asymmetric_key_subtype {
 	/* Verify the signature on a key of this subtype (optional) */
 	int (*verify_signature)(const struct key *key,
 				const struct public_key_signature *sig);
+
+	/* Verify a batch of signatures on a key of this subtype (optional) */
+	int (*verify_signatures)(const struct key *key,
+				 const struct public_key_signature *const *sigs,
+				 unsigned int nr_sigs, int *results);
 };
 
 /**
@@ -342,6 +342,9 @@ struct ceph_connection_v1_info {
 
 #define CEPH_FRAME_MAX_SEGMENT_COUNT	4
 
+/* max number of data bvecs handed to a single plain mode recvmsg */
+#define CEPH_IN_DATA_BVEC_CNT		16
+
 struct ceph_frame_desc {
 	int fd_tag;  /* FRAME_TAG_* */
 	int fd_seg_cnt;
@@ -357,7 +360,10 @@ struct ceph_gcm_nonce {
 struct ceph_connection_v2_info {
 	struct iov_iter in_iter;
 	struct kvec in_kvecs[5];  /* recvmsg */
-	struct bio_vec in_bvec;  /* recvmsg (in_cursor) */
+	struct bio_vec in_bvec;  /* recvmsg (in_cursor, rxbounce) */
+	struct bio_vec in_data_bvecs[CEPH_IN_DATA_BVEC_CNT];  /* recvmsg
+							 (in_cursor) */
+	int in_data_bvec_cnt;
 	int in_kvec_cnt;
 	int in_state;  /* IN_S_* */
 
@@ -386,6 +392,8 @@ struct ceph_connection_v2_info {
 	int in_enc_page_cnt;
 	int in_enc_resid;
 	int in_enc_i;
+	struct bio_vec *in_enc_bvecs;  /* in-place decryption of in_msg */
+	int in_enc_bvec_cnt;
 	struct page **out_enc_pages;
 	int out_enc_page_cnt;
 	int out_enc_resid;
@@ -16,6 +16,21 @@
  */
 #define DIM_NEVENTS 64
 
+/*
+ * Latency-target mode: the percentile of wakeup latencies that has to stay
+ * under the target, and the number of latency samples a decision needs.
+ */
+#define DIM_LAT_PERCENTILE 99
+#define DIM_LAT_MIN_SAMPLES 128
+
+/*
+ * Latency-target mode: number of measurements to wait, within budget, before
+ * probing a profile whose latency could not be predicted to fit (doubled on
+ * every failed probe, up to the max).
+ */
+#define DIM_LAT_PROBE_MIN 8
+#define DIM_LAT_PROBE_MAX 256
+
 /*
  * Is a difference between values justifies taking an action.
  * We consider 10% difference as significant.
@@ -82,6 +97,32 @@ struct dim_stats {
 	int cpe_ratio; /* ratio of completions to events */
 };
 
+/**
+ * struct dim_latency - Structure for the latency-target mode of net DIM.
+ * Used for holding the latency samples of the current measurement.
+ *
+ * @target_us: Wakeup latency to stay under, 0 if the mode is off
+ * @limit_us: Latency that still leaves room for the next profile's timer
+ * @nsamples: Number of latency samples
+ * @over: Number of samples above @target_us
+ * @near: Number of samples above @limit_us
+ * @backoff: Measurements to wait before probing the next profile
+ * @stable: Measurements spent within budget since the last step
+ * @probing: The last step was a probe
+ * @tx: The instance uses the TX profiles
+ */
+struct dim_latency {
+	u32 target_us;
+	u32 limit_us;
+	u32 nsamples;
+	u32 over;
+	u32 near;
+	u16 backoff;
+	u16 stable;
+	bool probing;
+	bool tx;
+};
+
 /**
  * struct dim - Main structure for dynamic interrupt moderation (DIM).
  * Used for holding all information about a specific DIM instance.
@@ -98,6 +139,7 @@ struct dim_stats {
  * @steps_right: Number of steps taken towards higher moderation
  * @steps_left: Number of steps taken towards lower moderation
  * @tired: Parking depth counter
+ * @lat: Latency-target mode state (net DIM only)
  */
 struct dim {
 	u8 state;
@@ -112,6 +154,7 @@ struct dim {
 	u8 steps_right;
 	u8 steps_left;
 	u8 tired;
+	struct dim_latency lat;
 };
 
 /**
@@ -273,6 +316,31 @@ dim_update_sample_with_comps(u16 event_ctr, u64 packets, u64 bytes, u64 comps,
 	s->comp_ctr = comps;
 }
 
+/**
+ *	dim_update_latency - account a wakeup latency sample
+ *	@dim: DIM context
+ *	@usecs: Time from a completion to its processing
+ *
+ * Only has an effect in latency-target mode.
+ */
+static inline void dim_update_latency(struct dim *dim, u32 usecs)
+{
+	dim->lat.nsamples++;
+	dim->lat.over += usecs > dim->lat.target_us;
+	dim->lat.near += usecs > dim->lat.limit_us;
+}
+
+/**
+ *	dim_update_latency_ts - account a wakeup latency sample
+ *	@dim: DIM context
+ *	@comp_time: Timestamp of the completion, being processed now
+ */
+static inline void dim_update_latency_ts(struct dim *dim, ktime_t comp_time)
+{
+	dim_update_latency(dim, max_t(s64, ktime_us_delta(ktime_get(),
+							  comp_time), 0));
+}
+
 /* Net DIM */
 
 /**
@@ -301,6 +369,20 @@ struct dim_cq_moder net_dim_get_tx_moderation(u8 cq_period_mode, int ix);
  */
 struct dim_cq_moder net_dim_get_def_tx_moderation(u8 cq_period_mode);
 
+/**
+ *	net_dim_set_latency_target - switch DIM to latency-target mode
+ *	@dim: DIM instance information
+ *	@usecs: Wakeup latency to keep DIM_LAT_PERCENTILE of the samples under,
+ *	0 to go back to rate-based tuning
+ *	@tx: Whether the instance moderates a TX queue
+ *
+ * In latency-target mode DIM picks the most moderated profile whose
+ * latency stays within the target, judged from the samples the consumer
+ * provides with dim_update_latency(), instead of comparing traffic rates.
+ * Must not run concurrently with net_dim() on the same instance.
+ */
+void net_dim_set_latency_target(struct dim *dim, u32 usecs, bool tx);
+
 /**
  *	net_dim - main DIM algorithm entry point
  *	@dim: DIM instance information
@@ -73,6 +73,7 @@ struct nlm_host {
 	const struct cred	*h_cred;
 	char			nodename[UNX_MAXNODENAME + 1];
 	const struct nlmclnt_operations	*h_nlmclnt_ops;	/* Callback ops for NLM users */
+	struct rcu_head		h_rcu;		/* deferred free */
 };
 
 /*
@@ -161,8 +162,9 @@ struct nlm_file {
 	struct nlm_share *	f_shares;	/* DOS shares */
 	struct list_head	f_blocks;	/* blocked locks */
 	unsigned int		f_locks;	/* guesstimate # of locks */
-	unsigned int		f_count;	/* reference count */
+	atomic_t		f_count;	/* reference count */
 	struct mutex		f_mutex;	/* avoid concurrent access */
+	struct rcu_head		f_rcu;		/* deferred free */
 };
 
 /*
@@ -289,6 +291,7 @@ void		  nlmsvc_locks_init_private(struct file_lock *, struct nlm_host *, pid_t);
 /*
  * File handling for the server personality
  */
+void		  nlm_files_init(void);
 __be32		  nlm_lookup_file(struct svc_rqst *, struct nlm_file **,
 					struct nlm_lock *);
 void		  nlm_release_file(struct nlm_file *);
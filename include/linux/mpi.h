@@ -117,6 +117,16 @@ void mpi_mul_barrett(MPI w, MPI u, MPI v, mpi_barrett_t ctx);
 /*-- mpi-pow.c --*/
 int mpi_powm(MPI res, MPI base, MPI exp, MPI mod);
 
+/*-- mpi-mont.c --*/
+
+/* Context used with Montgomery multiplication.  */
+struct mont_ctx_s;
+typedef struct mont_ctx_s *mpi_mont_t;
+
+mpi_mont_t mpi_mont_init(MPI m);
+void mpi_mont_free(mpi_mont_t ctx);
+int mpi_powm_mont(MPI res, MPI base, MPI exp, mpi_mont_t ctx);
+
 /*-- mpi-cmp.c --*/
 int mpi_cmp_ui(MPI u, ulong v);
 int mpi_cmp(MPI u, MPI v);
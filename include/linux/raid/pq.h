@@ -72,6 +72,7 @@ extern const char raid6_empty_zero_page[PAGE_SIZE];
 #define module_exit(x)
 
 #define IS_ENABLED(x) (x)
+#define WRITE_ONCE(x, val) ((x) = (val))
 #define CONFIG_RAID6_PQ_BENCHMARK 1
 #endif /* __KERNEL__ */
 
@@ -111,6 +112,9 @@ extern const struct raid6_calls raid6_avx2x4;
 extern const struct raid6_calls raid6_avx512x1;
 extern const struct raid6_calls raid6_avx512x2;
 extern const struct raid6_calls raid6_avx512x4;
+extern const struct raid6_calls raid6_gfnix1;
+extern const struct raid6_calls raid6_gfnix2;
+extern const struct raid6_calls raid6_gfnix4;
 extern const struct raid6_calls raid6_s390vx8;
 extern const struct raid6_calls raid6_vpermxor1;
 extern const struct raid6_calls raid6_vpermxor2;
@@ -129,6 +133,7 @@ extern const struct raid6_recov_calls raid6_recov_intx1;
 extern const struct raid6_recov_calls raid6_recov_ssse3;
 extern const struct raid6_recov_calls raid6_recov_avx2;
 extern const struct raid6_recov_calls raid6_recov_avx512;
+extern const struct raid6_recov_calls raid6_recov_gfni;
 extern const struct raid6_recov_calls raid6_recov_s390xc;
 extern const struct raid6_recov_calls raid6_recov_neon;
 
@@ -141,6 +146,7 @@ extern const struct raid6_calls raid6_neonx8;
 extern const struct raid6_calls * const raid6_algos[];
 extern const struct raid6_recov_calls *const raid6_recov_algos[];
 int raid6_select_algo(void);
+int raid6_benchmark(int disks, size_t bytes);
 
 /* Return values from chk_syndrome */
 #define RAID6_OK	0
@@ -155,6 +161,7 @@ extern const u8 raid6_gfexp[256]      __attribute__((aligned(256)));
 extern const u8 raid6_gflog[256]      __attribute__((aligned(256)));
 extern const u8 raid6_gfinv[256]      __attribute__((aligned(256)));
 extern const u8 raid6_gfexi[256]      __attribute__((aligned(256)));
+extern const u64 raid6_gfaff[256]     __attribute__((aligned(256)));
 
 /* Recovery routines */
 extern void (*raid6_2data_recov)(int disks, size_t bytes, int faila, int failb,
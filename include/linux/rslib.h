@@ -28,6 +28,7 @@
  * @iprim:	prim-th root of 1, index form
  * @gfpoly:	The primitive generator polynominal
  * @gffunc:	Function to generate the field, if non-canonical representation
+ * @gfmul:	Split multiplication tables for the batch functions
  * @users:	Users of this structure
  * @list:	List entry for the rs codec list
 */
@@ -43,6 +44,7 @@ struct rs_codec {
 	int		iprim;
 	int		gfpoly;
 	int		(*gffunc)(int);
+	uint8_t		*gfmul;
 	int		users;
 	struct list_head list;
 };
@@ -57,15 +59,26 @@ struct rs_control {
 	uint16_t	buffers[];
 };
 
+/*
+ * The batch functions are accelerated for codes with symbols of up to 8 bit
+ * and at most RS_BATCH_MAX_ROOTS roots
+ */
+#define RS_BATCH_MAX_ROOTS	32
+
 /* General purpose RS codec, 8-bit data width, symbol width 1-15 bit  */
 #ifdef CONFIG_REED_SOLOMON_ENC8
 int encode_rs8(struct rs_control *rs, uint8_t *data, int len, uint16_t *par,
 	       uint16_t invmsk);
+int encode_rs8_batch(struct rs_control *rs, uint8_t *data, int len,
+		     int stride, uint16_t *par, int nr, uint16_t invmsk);
 #endif
 #ifdef CONFIG_REED_SOLOMON_DEC8
 int decode_rs8(struct rs_control *rs, uint8_t *data, uint16_t *par, int len,
 		uint16_t *s, int no_eras, int *eras_pos, uint16_t invmsk,
 	       uint16_t *corr);
+int decode_rs8_batch(struct rs_control *rs, uint8_t *data, uint16_t *par,
+		     int len, int stride, int nr, uint16_t invmsk,
+		     int *results);
 #endif
 
 /* General purpose RS codec, 16-bit data width, symbol width 1-15 bit  */
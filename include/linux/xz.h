@@ -339,6 +339,34 @@ extern enum xz_ret xz_dec_microlzma_run(struct xz_dec_microlzma *s,
  */
 extern void xz_dec_microlzma_end(struct xz_dec_microlzma *s);
 
+/**
+ * xz_dec_mt_run() - Decode a multi-Block .xz Stream using worker threads
+ * @in:         Input buffer holding the whole .xz Stream. It may be followed
+ *              by other data, e.g. Stream Padding or another Stream.
+ * @in_size:    Size of the input buffer
+ * @in_used:    Set to the size of the .xz Stream on success
+ * @flush:      Called with the uncompressed data of each Block, in order,
+ *              from the calling thread. It must return @len on success.
+ *
+ * The Blocks of a Stream created by xz -T (or with --block-size) are
+ * independent and their sizes are stored in the Block Headers, so they
+ * can be decoded in parallel. This function is not available in preboot
+ * code.
+ *
+ * If the Stream has only one Block, doesn't store the sizes of its Blocks,
+ * has a Block larger than 64 MiB uncompressed, uses a Check type other
+ * than none or CRC32, or only one CPU is online, XZ_OK is returned before
+ * any input is used or any output produced. The caller should then decode
+ * the Stream with xz_dec_run(). XZ_STREAM_END is returned on success,
+ * XZ_MEM_ERROR if memory for the output of a Block couldn't be allocated,
+ * XZ_BUF_ERROR if @flush failed, and any of the other errors of
+ * xz_dec_run() if a Block is corrupt. On failure, some output may already
+ * have been flushed.
+ */
+extern enum xz_ret xz_dec_mt_run(const uint8_t *in, size_t in_size,
+				 size_t *in_used,
+				 long (*flush)(void *buf, unsigned long len));
+
 /*
  * Standalone build (userspace build or in-kernel build for boot time use)
  * needs a CRC32 implementation. For normal in-kernel use, kernel's own
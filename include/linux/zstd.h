@@ -220,6 +220,112 @@ zstd_dctx *zstd_init_dctx(void *workspace, size_t workspace_size);
 size_t zstd_decompress_dctx(zstd_dctx *dctx, void *dst, size_t dst_capacity,
 	const void *src, size_t src_size);
 
+/* ======   Single-pass Compression with Dictionary   ====== */
+
+typedef ZSTD_CDict zstd_cdict;
+
+/**
+ * zstd_cdict_workspace_bound() - memory needed to initialize a zstd_cdict
+ * @dict_size: The size of the dictionary.
+ * @cparams:   The compression parameters to be used.
+ *
+ * Return:     A lower bound on the size of the workspace that is passed to
+ *             zstd_init_cdict().
+ */
+size_t zstd_cdict_workspace_bound(size_t dict_size,
+	const zstd_compression_parameters *cparams);
+
+/**
+ * zstd_init_cdict() - digest a dictionary for compression
+ * @dict:           The dictionary. It is referenced, not copied, and must
+ *                  outlive the returned zstd_cdict.
+ * @dict_size:      The size of the dictionary.
+ * @parameters:     The compression parameters to be used.
+ * @workspace:      The workspace to emplace the cdict into. It must outlive
+ *                  the returned cdict.
+ * @workspace_size: The size of workspace. Use zstd_cdict_workspace_bound() to
+ *                  determine how large the workspace must be.
+ *
+ * A digested dictionary is read-only and may be shared by any number of
+ * compression contexts at the same time.
+ *
+ * Return:          A zstd dictionary for compression or NULL on error.
+ */
+const zstd_cdict *zstd_init_cdict(const void *dict, size_t dict_size,
+	const zstd_parameters *parameters, void *workspace,
+	size_t workspace_size);
+
+/**
+ * zstd_compress_using_cdict() - compress src into dst using a dictionary
+ * @cctx:         The context. Must have been initialized with zstd_init_cctx()
+ *                using parameters at least as large as those of @cdict.
+ * @dst:          The buffer to compress src into.
+ * @dst_capacity: The size of the destination buffer.
+ * @src:          The data to compress.
+ * @src_size:     The size of the data to compress.
+ * @cdict:        The digested dictionary, see zstd_init_cdict().
+ *
+ * Return:        The compressed size or an error, which can be checked using
+ *                zstd_is_error().
+ */
+size_t zstd_compress_using_cdict(zstd_cctx *cctx, void *dst,
+	size_t dst_capacity, const void *src, size_t src_size,
+	const zstd_cdict *cdict);
+
+/* ======   Single-pass Decompression with Dictionary   ====== */
+
+typedef ZSTD_DDict zstd_ddict;
+
+/**
+ * zstd_ddict_workspace_bound() - memory needed to initialize a zstd_ddict
+ * @dict_size: The size of the dictionary.
+ *
+ * Return:     A lower bound on the size of the workspace that is passed to
+ *             zstd_init_ddict().
+ */
+size_t zstd_ddict_workspace_bound(size_t dict_size);
+
+/**
+ * zstd_init_ddict() - digest a dictionary for decompression
+ * @dict:           The dictionary. It is referenced, not copied, and must
+ *                  outlive the returned zstd_ddict.
+ * @dict_size:      The size of the dictionary.
+ * @workspace:      The workspace to emplace the ddict into. It must outlive
+ *                  the returned ddict.
+ * @workspace_size: The size of workspace. Use zstd_ddict_workspace_bound() to
+ *                  determine how large the workspace must be.
+ *
+ * Return:          A zstd dictionary for decompression or NULL on error.
+ */
+const zstd_ddict *zstd_init_ddict(const void *dict, size_t dict_size,
+	void *workspace, size_t workspace_size);
+
+/**
+ * zstd_decompress_using_ddict() - decompress src into dst using a dictionary
+ * @dctx:         The decompression context.
+ * @dst:          The buffer to decompress src into.
+ * @dst_capacity: The size of the destination buffer.
+ * @src:          The zstd compressed data to decompress.
+ * @src_size:     The exact size of the data to decompress.
+ * @ddict:        The digested dictionary, see zstd_init_ddict().
+ *
+ * Return:        The decompressed size or an error, which can be checked using
+ *                zstd_is_error().
+ */
+size_t zstd_decompress_using_ddict(zstd_dctx *dctx, void *dst,
+	size_t dst_capacity, const void *src, size_t src_size,
+	const zstd_ddict *ddict);
+
+/**
+ * zstd_get_dict_id() - get the ID stored in a dictionary
+ * @dict:      The dictionary.
+ * @dict_size: The size of the dictionary.
+ *
+ * Return:     The dictionary ID, or 0 if @dict is not a zstd dictionary, e.g.
+ *             raw content.
+ */
+unsigned int zstd_get_dict_id(const void *dict, size_t dict_size);
+
 /* ======   Streaming Buffers   ====== */
 
 /**
@@ -339,6 +445,155 @@ size_t zstd_flush_stream(zstd_cstream *cstream, zstd_out_buffer *output);
  */
 size_t zstd_end_stream(zstd_cstream *cstream, zstd_out_buffer *output);
 
+/* ======   Multi-threaded Compression   ====== */
+
+typedef struct zstd_mt_cctx zstd_mt_cctx;
+
+/**
+ * zstd_init_mt_cctx() - allocate a multi-threaded compression context
+ * @parameters: The compression parameters to be used for every chunk.
+ * @chunk_size: The size of the independently compressed chunks. Must not be
+ *              smaller than 64 KiB.
+ * @nr_workers: The number of chunks compressed in parallel, including the
+ *              calling thread. 0 selects the number of online CPUs.
+ *
+ * The input is split into chunks of @chunk_size bytes, each of which is
+ * compressed into its own zstd frame on a kernel worker. The concatenated
+ * frames form a standard zstd stream that any zstd decompressor accepts.
+ * All workspaces are allocated here, so compression does not allocate
+ * memory apart from growing a small per-chunk bookkeeping array. Fewer
+ * workers than requested are set up if their workspaces can't be allocated
+ * easily.
+ *
+ * The context may sleep and must not be used by more than one caller at a
+ * time.
+ *
+ * Return:      A multi-threaded compression context or NULL on error.
+ */
+zstd_mt_cctx *zstd_init_mt_cctx(const zstd_parameters *parameters,
+	size_t chunk_size, unsigned int nr_workers);
+
+/**
+ * zstd_free_mt_cctx() - free a multi-threaded compression context
+ * @mt_cctx: The context to free, may be NULL.
+ */
+void zstd_free_mt_cctx(zstd_mt_cctx *mt_cctx);
+
+/**
+ * zstd_mt_compress_bound() - output size needed for parallel compression
+ * @mt_cctx:  The multi-threaded compression context.
+ * @src_size: The size of the data to compress.
+ *
+ * Return:    The destination buffer size zstd_compress_mt() needs to
+ *            compress @src_size bytes in parallel. Smaller buffers are
+ *            accepted, but then the input is compressed on one CPU.
+ */
+size_t zstd_mt_compress_bound(const zstd_mt_cctx *mt_cctx, size_t src_size);
+
+/**
+ * zstd_compress_mt() - compress src into dst using several CPUs
+ * @mt_cctx:      The multi-threaded compression context.
+ * @dst:          The buffer to compress src into.
+ * @dst_capacity: The size of the destination buffer.
+ * @src:          The data to compress.
+ * @src_size:     The size of the data to compress.
+ *
+ * Return:        The compressed size or an error, which can be checked using
+ *                zstd_is_error().
+ */
+size_t zstd_compress_mt(zstd_mt_cctx *mt_cctx, void *dst, size_t dst_capacity,
+	const void *src, size_t src_size);
+
+/* ======   Shared Dictionaries   ====== */
+
+struct zstd_dict;
+
+/**
+ * zstd_dict_register() - digest a trained dictionary and publish it by ID
+ * @dict:      The dictionary as produced by the zstd trainer. It is copied.
+ * @dict_size: The size of the dictionary.
+ * @level:     The compression level used with this dictionary.
+ * @src_size:  The typical size of the data compressed with the dictionary,
+ *             e.g. PAGE_SIZE.
+ *
+ * The dictionary is digested once for compression and once for
+ * decompression, and a compression and a decompression context are
+ * allocated for every possible CPU. Other users can then find it with
+ * zstd_dict_get() using the ID stored in the dictionary header, which is
+ * also the ID recorded in frames compressed with it.
+ *
+ * Return:     The registered dictionary holding one reference, or an
+ *             ERR_PTR(). -EINVAL is returned for dictionaries without an ID
+ *             and -EEXIST if the ID is already registered.
+ */
+struct zstd_dict *zstd_dict_register(const void *dict, size_t dict_size,
+	int level, size_t src_size);
+
+/**
+ * zstd_dict_unregister() - unpublish a dictionary and drop a reference
+ * @zd: The dictionary returned by zstd_dict_register().
+ *
+ * Users which already hold a reference keep using the dictionary until they
+ * call zstd_dict_put().
+ */
+void zstd_dict_unregister(struct zstd_dict *zd);
+
+/**
+ * zstd_dict_get() - look up a registered dictionary
+ * @id: The dictionary ID.
+ *
+ * Return: The dictionary with an extra reference held, or NULL.
+ */
+struct zstd_dict *zstd_dict_get(unsigned int id);
+
+/**
+ * zstd_dict_put() - drop a reference to a dictionary
+ * @zd: The dictionary, may be NULL.
+ */
+void zstd_dict_put(struct zstd_dict *zd);
+
+/**
+ * zstd_dict_id() - get the ID of a dictionary
+ * @zd: The dictionary.
+ *
+ * Return: The dictionary ID.
+ */
+unsigned int zstd_dict_id(const struct zstd_dict *zd);
+
+/**
+ * zstd_dict_compress() - compress src into dst with a shared dictionary
+ * @zd:           The dictionary.
+ * @dst:          The buffer to compress src into.
+ * @dst_capacity: The size of the destination buffer.
+ * @src:          The data to compress.
+ * @src_size:     The size of the data to compress.
+ *
+ * Uses a per-CPU compression context bound to @zd, so no workspace has to be
+ * provided and no memory is allocated. May sleep.
+ *
+ * Return:        The compressed size or an error, which can be checked using
+ *                zstd_is_error().
+ */
+size_t zstd_dict_compress(struct zstd_dict *zd, void *dst, size_t dst_capacity,
+	const void *src, size_t src_size);
+
+/**
+ * zstd_dict_decompress() - decompress src into dst with a shared dictionary
+ * @zd:           The dictionary.
+ * @dst:          The buffer to decompress src into.
+ * @dst_capacity: The size of the destination buffer.
+ * @src:          The zstd compressed data to decompress.
+ * @src_size:     The exact size of the data to decompress.
+ *
+ * Uses a per-CPU decompression context bound to @zd. May sleep.
+ *
+ * Return:        The decompressed size or an error, which can be checked using
+ *                zstd_is_error(). Always an error if the decompression module
+ *                is not built in, or is a module while this one is built in.
+ */
+size_t zstd_dict_decompress(struct zstd_dict *zd, void *dst,
+	size_t dst_capacity, const void *src, size_t src_size);
+
 /* ======   Streaming Decompression   ====== */
 
 typedef ZSTD_DStream zstd_dstream;
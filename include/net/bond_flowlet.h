@@ -0,0 +1,63 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Flowlet balancing for the balance-xor and 802.3ad modes.
+ */
+
+#ifndef _NET_BOND_FLOWLET_H
+#define _NET_BOND_FLOWLET_H
+
+#include <linux/atomic.h>
+#include <linux/bitfield.h>
+#include <linux/netdevice.h>
+#include <linux/workqueue.h>
+
+struct bonding;
+struct bond_up_slave;
+struct slave;
+
+#define BOND_FLOWLET_BITS	12
+#define BOND_FLOWLET_SIZE	(1 << BOND_FLOWLET_BITS)
+
+/* Slave loads are sampled every 10 msecs */
+#define BOND_FLOWLET_INTERVAL	msecs_to_jiffies(10)
+
+/* A flow table entry packs the flow's tag, the index of its slave in
+ * usable_slaves and the time of its last packet into one word, so that
+ * it can be read and updated by all CPUs without locks.
+ */
+#define FLOWLET_LAST		GENMASK_ULL(31, 0)	/* local_clock() >> 10 */
+#define FLOWLET_IDX		GENMASK_ULL(39, 32)
+#define FLOWLET_TAG		GENMASK_ULL(63, 40)	/* hash >> 8 */
+#define FLOWLET_MAX_SLAVES	(FIELD_MAX(FLOWLET_IDX) + 1)
+
+struct flowlet_load {
+	const struct net_device *dev;
+	u64 tx_bytes;		/* counter at the last sample */
+	u64 rate;		/* smoothed bytes per sample interval */
+	u64 load;		/* rate plus bytes queued at the last sample */
+};
+
+struct flowlet_loads {
+	struct rcu_head rcu;
+	unsigned int count;
+	struct flowlet_load slave[];
+};
+
+struct bond_flowlet {
+	atomic64_t *table;			/* BOND_FLOWLET_SIZE entries */
+	u64 __percpu *moves;			/* flowlets sent elsewhere */
+	struct flowlet_loads __rcu *loads;	/* replaced by the work only */
+	struct delayed_work work;
+	struct bonding *bond;
+};
+
+int bond_flowlet_start(struct bonding *bond);
+void bond_flowlet_stop(struct bonding *bond);
+void bond_flowlet_free(struct bonding *bond);
+struct slave *bond_flowlet_slave_get(struct bonding *bond,
+				     struct bond_flowlet *fl, struct sk_buff *skb,
+				     struct bond_up_slave *slaves);
+u64 bond_flowlet_moves(struct bonding *bond);
+u64 bond_flowlet_load(struct bonding *bond, const struct net_device *dev);
+
+#endif /* _NET_BOND_FLOWLET_H */
@@ -46,6 +46,22 @@
 /* Specify an eventfd file descriptor to signal on log write. */
 #define VHOST_SET_LOG_FD _IOW(VHOST_VIRTIO, 0x07, int)
 
+/* By default, a device gets one vhost_worker that its virtqueues share. To
+ * spread the virtqueues over more threads, create workers with
+ * VHOST_NEW_WORKER and attach virtqueues to them with
+ * VHOST_ATTACH_VRING_WORKER. A new worker is a kernel thread named
+ * vhost-<caller pid>-<worker id>, in the cgroups of the caller and with the
+ * CPU affinity of the calling thread.
+ */
+
+/* Create a new vhost_worker and return its id in worker_id. */
+#define VHOST_NEW_WORKER _IOR(VHOST_VIRTIO, 0x8, struct vhost_worker_state)
+/* Free a worker created with VHOST_NEW_WORKER, if no virtqueue uses it. */
+#define VHOST_FREE_WORKER _IOW(VHOST_VIRTIO, 0x9, struct vhost_worker_state)
+/* Get the thread id and the statistics of a worker. */
+#define VHOST_GET_WORKER_STATS _IOWR(VHOST_VIRTIO, 0xA,		\
+				     struct vhost_worker_stats)
+
 /* Ring setup. */
 /* Set number of descriptors in ring. This parameter can not
  * be modified while ring is running (bound to a device). */
@@ -71,6 +87,17 @@
 #define VHOST_SET_VRING_ENDIAN _IOW(VHOST_VIRTIO, 0x13, struct vhost_vring_state)
 #define VHOST_GET_VRING_ENDIAN _IOW(VHOST_VIRTIO, 0x14, struct vhost_vring_state)
 
+/* Attach a vhost_worker created with VHOST_NEW_WORKER to one of the device's
+ * virtqueues. This must be done before the virtqueue is started, i.e. before
+ * VHOST_SET_VRING_KICK and before the device's backend is set, or it fails
+ * with EBUSY.
+ */
+#define VHOST_ATTACH_VRING_WORKER _IOW(VHOST_VIRTIO, 0x15,		\
+				       struct vhost_vring_worker)
+/* Return the id of the vhost_worker a virtqueue is using. */
+#define VHOST_GET_VRING_WORKER _IOWR(VHOST_VIRTIO, 0x16,		\
+				     struct vhost_vring_worker)
+
 /* The following ioctls use eventfd file descriptors to signal and poll
  * for events. */
 
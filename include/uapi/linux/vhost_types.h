@@ -27,6 +27,39 @@ struct vhost_vring_file {
 
 };
 
+struct vhost_worker_state {
+	/*
+	 * For VHOST_NEW_WORKER the kernel will return the new vhost_worker id.
+	 * For VHOST_FREE_WORKER this must be set to the id of the vhost_worker
+	 * to free.
+	 */
+	unsigned int worker_id;
+};
+
+struct vhost_vring_worker {
+	/* vring index */
+	unsigned int index;
+	/* The id of the vhost_worker returned from VHOST_NEW_WORKER */
+	unsigned int worker_id;
+};
+
+struct vhost_worker_stats {
+	/* Set by userspace to the id of the vhost_worker */
+	unsigned int worker_id;
+	/*
+	 * Thread id of the worker in the caller's pid namespace, or 0 if it
+	 * is not visible there.
+	 */
+	int pid;
+	/* Number of vrings attached to the worker */
+	unsigned int vrings;
+	unsigned int padding;
+	/* Work items run, wakeups from idle and time spent running work */
+	__u64 work_items;
+	__u64 wakeups;
+	__u64 busy_ns;
+};
+
 struct vhost_vring_addr {
 	unsigned int index;
 	/* Option flags. */
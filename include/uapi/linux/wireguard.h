@@ -38,6 +38,10 @@
  *            WGPEER_A_LAST_HANDSHAKE_TIME: NLA_EXACT_LEN, struct __kernel_timespec
  *            WGPEER_A_RX_BYTES: NLA_U64
  *            WGPEER_A_TX_BYTES: NLA_U64
+ *            WGPEER_A_TX_GSO_BATCHES: NLA_U64
+ *            WGPEER_A_TX_GSO_PACKETS: NLA_U64
+ *            WGPEER_A_RX_GRO_BATCHES: NLA_U64
+ *            WGPEER_A_RX_GRO_PACKETS: NLA_U64
  *            WGPEER_A_ALLOWEDIPS: NLA_NESTED
  *                0: NLA_NESTED
  *                    WGALLOWEDIP_A_FAMILY: NLA_U16
@@ -180,6 +184,10 @@ enum wgpeer_attribute {
 	WGPEER_A_TX_BYTES,
 	WGPEER_A_ALLOWEDIPS,
 	WGPEER_A_PROTOCOL_VERSION,
+	WGPEER_A_TX_GSO_BATCHES,
+	WGPEER_A_TX_GSO_PACKETS,
+	WGPEER_A_RX_GRO_BATCHES,
+	WGPEER_A_RX_GRO_PACKETS,
 	__WGPEER_A_LAST
 };
 #define WGPEER_A_MAX (__WGPEER_A_LAST - 1)
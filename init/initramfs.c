@@ -485,6 +485,31 @@ static long __init flush_buffer(void *bufv, unsigned long len)
 static unsigned long my_inptr __initdata; /* index of next byte to be processed in inbuf */
 
 #include <linux/decompress/generic.h>
+#include <linux/xz.h>
+
+/*
+ * Decode an .xz archive made of several Blocks in parallel.  Returns
+ * -EAGAIN if it has to go through the regular decompressor instead.
+ */
+static int __init unpack_xz_parallel(char *buf, unsigned long len,
+				     const char *compress_name)
+{
+	size_t in_used;
+	enum xz_ret ret;
+
+	if (!IS_BUILTIN(CONFIG_XZ_DEC) || !IS_ENABLED(CONFIG_XZ_DEC_MT) ||
+	    strcmp(compress_name, "xz"))
+		return -EAGAIN;
+
+	ret = xz_dec_mt_run(buf, len, &in_used, flush_buffer);
+	if (ret == XZ_OK)
+		return -EAGAIN;
+	if (ret != XZ_STREAM_END)
+		return -1;
+
+	my_inptr = in_used;
+	return 0;
+}
 
 static char * __init unpack_to_rootfs(char *buf, unsigned long len)
 {
@@ -522,8 +547,11 @@ static char * __init unpack_to_rootfs(char *buf, unsigned long len)
 		decompress = decompress_method(buf, len, &compress_name);
 		pr_debug("Detected %s compressed data\n", compress_name);
 		if (decompress) {
-			int res = decompress(buf, len, NULL, flush_buffer, NULL,
-				   &my_inptr, error);
+			int res = unpack_xz_parallel(buf, len, compress_name);
+
+			if (res == -EAGAIN)
+				res = decompress(buf, len, NULL, flush_buffer,
+						 NULL, &my_inptr, error);
 			if (res)
 				error("decompressor failed");
 		} else if (compress_name) {
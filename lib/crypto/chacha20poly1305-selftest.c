@@ -8882,6 +8882,85 @@ decryption_success(bool func_ret, bool expect_failure, int memcmp_result)
 	return func_ret && !memcmp_result;
 }
 
+/* Runs all of the vectors with 8-byte nonces through one multi-buffer call,
+ * each split over two sg entries at a different offset.
+ */
+static bool __init
+chacha20poly1305_selftest_mb(const struct chacha20poly1305_testvec *vectors,
+			     size_t count, bool encrypt)
+{
+	struct chacha20poly1305_req *reqs;
+	struct scatterlist *sg;
+	size_t i, n = 0, len, total = 0;
+	bool success = true;
+	u8 *buf, *p;
+
+	for (i = 0; i < count; ++i)
+		total += vectors[i].ilen + POLY1305_DIGEST_SIZE;
+
+	reqs = kcalloc(count, sizeof(*reqs), GFP_KERNEL);
+	sg = kcalloc(count * 2, sizeof(*sg), GFP_KERNEL);
+	buf = kmalloc(total, GFP_KERNEL);
+	if (!reqs || !sg || !buf) {
+		pr_err("chacha20poly1305 mb self-test malloc: FAIL\n");
+		success = false;
+		goto out;
+	}
+
+	for (i = 0, p = buf; i < count; ++i) {
+		if (vectors[i].nlen != 8)
+			continue;
+		len = vectors[i].ilen + (encrypt ? POLY1305_DIGEST_SIZE : 0);
+		memcpy(p, vectors[i].input, vectors[i].ilen);
+		sg_init_table(&sg[n * 2], 2);
+		sg_set_buf(&sg[n * 2], p, (i * 13) % (len + 1));
+		sg_set_buf(&sg[n * 2 + 1], p + sg[n * 2].length,
+			   len - sg[n * 2].length);
+		reqs[n].sg = &sg[n * 2];
+		reqs[n].len = vectors[i].ilen;
+		reqs[n].ad = vectors[i].assoc;
+		reqs[n].ad_len = vectors[i].alen;
+		reqs[n].nonce = get_unaligned_le64(vectors[i].nonce);
+		reqs[n].key = vectors[i].key;
+		p += len;
+		++n;
+	}
+
+	if (encrypt)
+		chacha20poly1305_encrypt_sg_inplace_mb(reqs, n);
+	else
+		chacha20poly1305_decrypt_sg_inplace_mb(reqs, n);
+
+	for (i = 0, n = 0, p = buf; i < count; ++i) {
+		if (vectors[i].nlen != 8)
+			continue;
+		if (encrypt) {
+			len = vectors[i].ilen + POLY1305_DIGEST_SIZE;
+			if (!reqs[n].ok || memcmp(p, vectors[i].output, len))
+				success = false;
+		} else {
+			len = vectors[i].ilen;
+			if (!decryption_success(reqs[n].ok, vectors[i].failure,
+					memcmp(p, vectors[i].output,
+					       len - POLY1305_DIGEST_SIZE)))
+				success = false;
+		}
+		if (!success) {
+			pr_err("chacha20poly1305 mb %scryption self-test %zu: FAIL\n",
+			       encrypt ? "en" : "de", i + 1);
+			break;
+		}
+		p += len;
+		++n;
+	}
+
+out:
+	kfree(buf);
+	kfree(sg);
+	kfree(reqs);
+	return success;
+}
+
 bool __init chacha20poly1305_selftest(void)
 {
 	enum { MAXIMUM_TEST_BUFFER_LEN = 1UL << 12 };
@@ -8984,6 +9063,13 @@ bool __init chacha20poly1305_selftest(void)
 		}
 	}
 
+	if (!chacha20poly1305_selftest_mb(chacha20poly1305_enc_vectors,
+				ARRAY_SIZE(chacha20poly1305_enc_vectors), true))
+		success = false;
+	if (!chacha20poly1305_selftest_mb(chacha20poly1305_dec_vectors,
+				ARRAY_SIZE(chacha20poly1305_dec_vectors), false))
+		success = false;
+
 	for (i = 0; i < ARRAY_SIZE(xchacha20poly1305_enc_vectors); ++i) {
 		memset(computed_output, 0, MAXIMUM_TEST_BUFFER_LEN);
 		xchacha20poly1305_encrypt(computed_output,
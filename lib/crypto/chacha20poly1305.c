@@ -354,6 +354,259 @@ bool chacha20poly1305_decrypt_sg_inplace(struct scatterlist *src, size_t src_len
 }
 EXPORT_SYMBOL(chacha20poly1305_decrypt_sg_inplace);
 
+/*
+ * Multi-buffer variants of the sg_inplace functions.  Short messages, such
+ * as most network packets, are only one or two ChaCha blocks long, which
+ * leaves the SIMD ChaCha code with little to work on per message.  Here the
+ * ChaCha keystream of up to CHACHA20POLY1305_MB_LANES messages is computed
+ * together by chacha_crypt_mb(), while Poly1305, whose SIMD code already
+ * works well on a single message, is computed one message at a time.
+ */
+#define CHACHA20POLY1305_MB_LANES	(IS_ENABLED(CONFIG_64BIT) ? 8 : 4)
+
+struct chacha20poly1305_mb_cursor {
+	struct scatterlist *sg;
+	unsigned int offset;
+	size_t left;
+};
+
+static bool chacha20poly1305_mb_sg_fits(struct scatterlist *sg, size_t len)
+{
+	size_t total = 0;
+
+	if (len > INT_MAX)
+		return false;
+	for (; sg && total < len + POLY1305_DIGEST_SIZE; sg = sg_next(sg))
+		total += sg->length;
+	return total >= len + POLY1305_DIGEST_SIZE;
+}
+
+static noinline_for_stack bool
+chacha20poly1305_mb_mac(const struct chacha20poly1305_req *req, size_t src_len,
+			const u8 key[POLY1305_KEY_SIZE], bool encrypt)
+{
+	const u8 *pad0 = page_address(ZERO_PAGE(0));
+	struct poly1305_desc_ctx poly1305_state;
+	struct sg_mapping_iter miter;
+	size_t sl = src_len;
+	bool ret = true;
+	union {
+		u8 mac[2][POLY1305_DIGEST_SIZE];
+		__le64 lens[2];
+	} b __aligned(16);
+
+	poly1305_init(&poly1305_state, key);
+
+	if (unlikely(req->ad_len)) {
+		poly1305_update(&poly1305_state, req->ad, req->ad_len);
+		if (req->ad_len & 0xf)
+			poly1305_update(&poly1305_state, pad0,
+					0x10 - (req->ad_len & 0xf));
+	}
+
+	sg_miter_start(&miter, req->sg, sg_nents(req->sg),
+		       SG_MITER_FROM_SG | SG_MITER_ATOMIC);
+	while (sl && sg_miter_next(&miter)) {
+		size_t l = min(sl, miter.length);
+
+		poly1305_update(&poly1305_state, miter.addr, l);
+		sl -= l;
+	}
+	sg_miter_stop(&miter);
+
+	if (src_len & 0xf)
+		poly1305_update(&poly1305_state, pad0, 0x10 - (src_len & 0xf));
+
+	b.lens[0] = cpu_to_le64(req->ad_len);
+	b.lens[1] = cpu_to_le64(src_len);
+	poly1305_update(&poly1305_state, (u8 *)b.lens, sizeof(b.lens));
+
+	poly1305_final(&poly1305_state, b.mac[0]);
+	if (encrypt) {
+		scatterwalk_map_and_copy(b.mac[0], req->sg, src_len,
+					 POLY1305_DIGEST_SIZE, 1);
+	} else {
+		scatterwalk_map_and_copy(b.mac[1], req->sg, src_len,
+					 POLY1305_DIGEST_SIZE, 0);
+		ret = !crypto_memneq(b.mac[0], b.mac[1], POLY1305_DIGEST_SIZE);
+	}
+
+	memzero_explicit(&b, sizeof(b));
+	return ret;
+}
+
+/*
+ * Run ChaCha over the remaining bytes of each cursor.  Every step passes
+ * the contiguous, block aligned part of each message's current sg entry to
+ * chacha_crypt_mb(); a block straddling two entries is bounced through a
+ * buffer instead.
+ */
+static noinline_for_stack void
+chacha20poly1305_mb_crypt(u32 (*state)[CHACHA_STATE_WORDS],
+			  struct chacha20poly1305_mb_cursor *cur,
+			  unsigned int n)
+{
+	u8 buf[CHACHA_BLOCK_SIZE] __aligned(16);
+	unsigned int bytes[CHACHA20POLY1305_MB_LANES];
+	const u8 *src[CHACHA20POLY1305_MB_LANES];
+	u8 *dst[CHACHA20POLY1305_MB_LANES];
+	unsigned int i, l;
+	bool more;
+
+	do {
+		more = false;
+		for (i = 0; i < n; i++) {
+			struct chacha20poly1305_mb_cursor *c = &cur[i];
+
+			dst[i] = NULL;
+			src[i] = NULL;
+			bytes[i] = 0;
+
+			while (c->left && c->offset >= c->sg->length) {
+				c->offset -= c->sg->length;
+				c->sg = sg_next(c->sg);
+			}
+			if (!c->left)
+				continue;
+
+			l = min_t(size_t, c->left, c->sg->length - c->offset);
+			if (unlikely(l < c->left && l < CHACHA_BLOCK_SIZE)) {
+				l = min_t(size_t, c->left, CHACHA_BLOCK_SIZE);
+				scatterwalk_map_and_copy(buf, c->sg, c->offset,
+							 l, 0);
+				chacha20_crypt(state[i], buf, buf, l);
+				scatterwalk_map_and_copy(buf, c->sg, c->offset,
+							 l, 1);
+			} else {
+				if (l < c->left)
+					l = round_down(l, CHACHA_BLOCK_SIZE);
+				dst[i] = sg_virt(c->sg) + c->offset;
+				src[i] = dst[i];
+				bytes[i] = l;
+			}
+			c->offset += l;
+			c->left -= l;
+			more |= c->left != 0;
+		}
+		chacha20_crypt_mb(state, dst, src, bytes, n);
+	} while (more);
+
+	memzero_explicit(buf, sizeof(buf));
+}
+
+static void chacha20poly1305_crypt_sg_inplace_mb(struct chacha20poly1305_req *reqs,
+						 unsigned int n, bool encrypt)
+{
+	const u8 *pad0 = page_address(ZERO_PAGE(0));
+	struct chacha20poly1305_mb_cursor cur[CHACHA20POLY1305_MB_LANES];
+	struct chacha20poly1305_req *req[CHACHA20POLY1305_MB_LANES];
+	u32 state[CHACHA20POLY1305_MB_LANES][CHACHA_STATE_WORDS];
+	u8 block0[CHACHA20POLY1305_MB_LANES][POLY1305_KEY_SIZE];
+	unsigned int bytes[CHACHA20POLY1305_MB_LANES];
+	const u8 *src[CHACHA20POLY1305_MB_LANES];
+	u8 *dst[CHACHA20POLY1305_MB_LANES];
+	u32 k[CHACHA_KEY_WORDS];
+	unsigned int i, m;
+	__le64 iv[2];
+
+	while (n) {
+		for (m = 0; n && m < CHACHA20POLY1305_MB_LANES; reqs++, n--) {
+			size_t len = reqs->len;
+
+			if (!encrypt) {
+				if (unlikely(len < POLY1305_DIGEST_SIZE)) {
+					reqs->ok = false;
+					continue;
+				}
+				len -= POLY1305_DIGEST_SIZE;
+			}
+			if (WARN_ON(!chacha20poly1305_mb_sg_fits(reqs->sg, len))) {
+				reqs->ok = false;
+				continue;
+			}
+
+			chacha_load_key(k, reqs->key);
+			iv[0] = 0;
+			iv[1] = cpu_to_le64(reqs->nonce);
+			chacha_init(state[m], k, (u8 *)iv);
+
+			req[m] = reqs;
+			cur[m].sg = reqs->sg;
+			cur[m].offset = 0;
+			cur[m].left = len;
+			dst[m] = block0[m];
+			src[m] = pad0;
+			bytes[m] = POLY1305_KEY_SIZE;
+			m++;
+		}
+		if (!m)
+			break;
+
+		/* The Poly1305 keys, which leaves every state at block 1 */
+		chacha20_crypt_mb(state, dst, src, bytes, m);
+
+		if (!encrypt) {
+			for (i = 0; i < m; i++) {
+				req[i]->ok = chacha20poly1305_mb_mac(req[i],
+						cur[i].left, block0[i], false);
+				/* No point in decrypting a forgery */
+				if (!req[i]->ok)
+					cur[i].left = 0;
+			}
+		}
+
+		chacha20poly1305_mb_crypt(state, cur, m);
+
+		if (encrypt) {
+			for (i = 0; i < m; i++)
+				req[i]->ok = chacha20poly1305_mb_mac(req[i],
+						req[i]->len, block0[i], true);
+		}
+	}
+
+	memzero_explicit(state, sizeof(state));
+	memzero_explicit(block0, sizeof(block0));
+	memzero_explicit(k, sizeof(k));
+	memzero_explicit(iv, sizeof(iv));
+}
+
+void chacha20poly1305_encrypt_sg_inplace_mb(struct chacha20poly1305_req *reqs,
+					    unsigned int n)
+{
+	unsigned int i;
+
+	/* The multi-buffer code addresses the buffers through sg_virt() */
+	if (IS_ENABLED(CONFIG_HIGHMEM)) {
+		for (i = 0; i < n; i++)
+			reqs[i].ok = chacha20poly1305_encrypt_sg_inplace(
+					reqs[i].sg, reqs[i].len, reqs[i].ad,
+					reqs[i].ad_len, reqs[i].nonce,
+					reqs[i].key);
+		return;
+	}
+
+	chacha20poly1305_crypt_sg_inplace_mb(reqs, n, true);
+}
+EXPORT_SYMBOL(chacha20poly1305_encrypt_sg_inplace_mb);
+
+void chacha20poly1305_decrypt_sg_inplace_mb(struct chacha20poly1305_req *reqs,
+					    unsigned int n)
+{
+	unsigned int i;
+
+	if (IS_ENABLED(CONFIG_HIGHMEM)) {
+		for (i = 0; i < n; i++)
+			reqs[i].ok = chacha20poly1305_decrypt_sg_inplace(
+					reqs[i].sg, reqs[i].len, reqs[i].ad,
+					reqs[i].ad_len, reqs[i].nonce,
+					reqs[i].key);
+		return;
+	}
+
+	chacha20poly1305_crypt_sg_inplace_mb(reqs, n, false);
+}
+EXPORT_SYMBOL(chacha20poly1305_decrypt_sg_inplace_mb);
+
 static int __init chacha20poly1305_init(void)
 {
 	if (!IS_ENABLED(CONFIG_CRYPTO_MANAGER_DISABLE_TESTS) &&
@@ -215,8 +215,87 @@ static bool net_dim_decision(struct dim_stats *curr_stats, struct dim *dim)
 	return dim->profile_ix != prev_ix;
 }
 
+static u16 net_dim_profile_usec(struct dim *dim, int ix)
+{
+	if (dim->lat.tx)
+		return tx_profile[dim->mode][ix].usec;
+	return rx_profile[dim->mode][ix].usec;
+}
+
+/*
+ * Start a latency measurement.  Moving to the next profile makes wakeups
+ * wait up to the difference of the two timers longer, so a sample that is
+ * within that difference of the target is one that might not fit there.
+ */
+static void net_dim_latency_start(struct dim *dim)
+{
+	struct dim_latency *lat = &dim->lat;
+	u32 delta = 0;
+
+	if (dim->profile_ix < NET_DIM_PARAMS_NUM_PROFILES - 1)
+		delta = net_dim_profile_usec(dim, dim->profile_ix + 1) -
+			net_dim_profile_usec(dim, dim->profile_ix);
+
+	lat->limit_us = lat->target_us > delta ? lat->target_us - delta : 0;
+	lat->nsamples = 0;
+	lat->over = 0;
+	lat->near = 0;
+}
+
+static bool net_dim_latency_decision(struct dim *dim)
+{
+	struct dim_latency *lat = &dim->lat;
+	u32 budget = lat->nsamples * (100 - DIM_LAT_PERCENTILE) / 100;
+	int prev_ix = dim->profile_ix;
+	bool probing = lat->probing;
+
+	lat->probing = false;
+
+	if (lat->over > budget) {
+		/* Each failed probe doubles the wait before the next one */
+		if (probing)
+			lat->backoff = min(lat->backoff * 2, DIM_LAT_PROBE_MAX);
+		else
+			lat->backoff = DIM_LAT_PROBE_MIN;
+		if (dim->profile_ix)
+			dim->profile_ix--;
+	} else if (dim->profile_ix < NET_DIM_PARAMS_NUM_PROFILES - 1) {
+		if (lat->near <= budget) {
+			dim->profile_ix++;
+		} else if (++lat->stable >= lat->backoff) {
+			/*
+			 * The packet limit rather than the timer may be what
+			 * ends most waits, which the samples can't tell: try.
+			 */
+			dim->profile_ix++;
+			lat->probing = true;
+		}
+	}
+
+	if (dim->profile_ix == prev_ix)
+		return false;
+
+	lat->stable = 0;
+	return true;
+}
+
+void net_dim_set_latency_target(struct dim *dim, u32 usecs, bool tx)
+{
+	struct dim_latency *lat = &dim->lat;
+
+	lat->target_us = usecs;
+	lat->tx = tx;
+	lat->backoff = DIM_LAT_PROBE_MIN;
+	lat->stable = 0;
+	lat->probing = false;
+	net_dim_latency_start(dim);
+}
+EXPORT_SYMBOL(net_dim_set_latency_target);
+
 void net_dim(struct dim *dim, struct dim_sample end_sample)
 {
+	bool changed;
+
 	struct dim_stats curr_stats;
 	u16 nevents;
 
@@ -227,8 +306,16 @@ void net_dim(struct dim *dim, struct dim_sample end_sample)
 				  dim->start_sample.event_ctr);
 		if (nevents < DIM_NEVENTS)
 			break;
-		dim_calc_stats(&dim->start_sample, &end_sample, &curr_stats);
-		if (net_dim_decision(&curr_stats, dim)) {
+		if (dim->lat.target_us) {
+			if (dim->lat.nsamples < DIM_LAT_MIN_SAMPLES)
+				break;
+			changed = net_dim_latency_decision(dim);
+		} else {
+			dim_calc_stats(&dim->start_sample, &end_sample,
+				       &curr_stats);
+			changed = net_dim_decision(&curr_stats, dim);
+		}
+		if (changed) {
 			dim->state = DIM_APPLY_NEW_PROFILE;
 			schedule_work(&dim->work);
 			break;
@@ -237,6 +324,8 @@ void net_dim(struct dim *dim, struct dim_sample end_sample)
 	case DIM_START_MEASURE:
 		dim_update_sample(end_sample.event_ctr, end_sample.pkt_ctr,
 				  end_sample.byte_ctr, &dim->start_sample);
+		if (dim->lat.target_us)
+			net_dim_latency_start(dim);
 		dim->state = DIM_MEASURE_IN_PROGRESS;
 		break;
 	case DIM_APPLY_NEW_PROFILE:
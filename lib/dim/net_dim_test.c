@@ -0,0 +1,174 @@
+// SPDX-License-Identifier: GPL-2.0 OR Linux-OpenIB
+/*
+ * KUnit tests for the latency-target mode of net DIM.
+ *
+ * An RX queue is simulated in CQE period mode: packets arrive at random
+ * intervals around a mean, the moderation timer starts with the first
+ * pending completion and the interrupt fires when it expires or when the
+ * profile's packet count is reached, whichever comes first.  Each packet's
+ * wait for its interrupt is fed to DIM as a latency sample.
+ */
+
+#include <kunit/test.h>
+#include <linux/dim.h>
+#include <linux/prandom.h>
+
+#define SIM_MAX_PKTS	256
+#define SIM_LAT_BUCKETS	128
+
+struct dim_sim {
+	struct dim dim;
+	struct rnd_state rnd;
+	u32 gap_ns;			/* mean time between packets */
+	u64 next_ns;			/* arrival of the next packet */
+	u16 event_ctr;
+	u64 pkt_ctr;
+	u64 arrival[SIM_MAX_PKTS];
+	u32 hist[SIM_LAT_BUCKETS];	/* latency samples, by usec */
+	u32 nsamples;
+};
+
+static void dim_sim_work(struct work_struct *work)
+{
+	struct dim *dim = container_of(work, struct dim, work);
+
+	dim->state = DIM_START_MEASURE;
+}
+
+static struct dim_sim *dim_sim_create(struct kunit *test, u32 gap_ns,
+				      u32 target_us)
+{
+	struct dim_sim *sim = kunit_kzalloc(test, sizeof(*sim), GFP_KERNEL);
+
+	KUNIT_ASSERT_NOT_NULL(test, sim);
+	INIT_WORK(&sim->dim.work, dim_sim_work);
+	sim->dim.mode = DIM_CQ_PERIOD_MODE_START_FROM_CQE;
+	sim->dim.profile_ix = 1;
+	prandom_seed_state(&sim->rnd, 0x5eed);
+	sim->gap_ns = gap_ns;
+	net_dim_set_latency_target(&sim->dim, target_us, false);
+	return sim;
+}
+
+static void dim_sim_irq(struct dim_sim *sim)
+{
+	struct dim_cq_moder moder =
+		net_dim_get_rx_moderation(sim->dim.mode, sim->dim.profile_ix);
+	u64 fire = sim->next_ns + moder.usec * NSEC_PER_USEC;
+	struct dim_sample sample;
+	unsigned int i, n = 0;
+	u32 usecs;
+
+	while (n < moder.pkts && sim->next_ns <= fire) {
+		sim->arrival[n++] = sim->next_ns;
+		sim->next_ns += prandom_u32_state(&sim->rnd) %
+				(2 * sim->gap_ns + 1);
+	}
+	if (n == moder.pkts)
+		fire = sim->arrival[n - 1];
+
+	for (i = 0; i < n; i++) {
+		usecs = div_u64(fire - sim->arrival[i], NSEC_PER_USEC);
+		dim_update_latency(&sim->dim, usecs);
+		sim->hist[min_t(u32, usecs, SIM_LAT_BUCKETS - 1)]++;
+		sim->nsamples++;
+	}
+
+	/* The next packet can only start a new wait once this one is over */
+	sim->next_ns = max(sim->next_ns, fire);
+	sim->pkt_ctr += n;
+	dim_update_sample(++sim->event_ctr, sim->pkt_ctr, sim->pkt_ctr * 64,
+			  &sample);
+	net_dim(&sim->dim, sample);
+	if (sim->dim.state == DIM_APPLY_NEW_PROFILE)
+		flush_work(&sim->dim.work);
+}
+
+/* Run for @nirqs interrupts and return the p99 latency over the last half */
+static u32 dim_sim_run(struct dim_sim *sim, unsigned int nirqs)
+{
+	u32 sum = 0, nsamples;
+	unsigned int i;
+
+	for (i = 0; i < nirqs / 2; i++)
+		dim_sim_irq(sim);
+
+	memset(sim->hist, 0, sizeof(sim->hist));
+	sim->nsamples = 0;
+	for (i = 0; i < nirqs - nirqs / 2; i++)
+		dim_sim_irq(sim);
+
+	nsamples = sim->nsamples * DIM_LAT_PERCENTILE / 100;
+	for (i = 0; i < SIM_LAT_BUCKETS - 1; i++) {
+		sum += sim->hist[i];
+		if (sum >= nsamples)
+			break;
+	}
+	return i;
+}
+
+/* 500 kpps: timers are what ends the waits, 16 usecs is the best fit */
+static void net_dim_latency_test_converge(struct kunit *test)
+{
+	struct dim_sim *sim = dim_sim_create(test, 2000, 20);
+	u32 p99 = dim_sim_run(sim, 64 * 2000);
+
+	KUNIT_EXPECT_EQ(test, sim->dim.profile_ix, 2);
+	KUNIT_EXPECT_LE(test, p99, 20);
+}
+
+/* 10 Mpps: the packet limit ends the waits, the longest timer fits */
+static void net_dim_latency_test_busy(struct kunit *test)
+{
+	struct dim_sim *sim = dim_sim_create(test, 100, 20);
+	u32 p99 = dim_sim_run(sim, 64 * 2000);
+
+	KUNIT_EXPECT_EQ(test, sim->dim.profile_ix, 4);
+	KUNIT_EXPECT_LE(test, p99, 20);
+}
+
+/* A target below every timer leaves the least moderated profile */
+static void net_dim_latency_test_tight(struct kunit *test)
+{
+	struct dim_sim *sim = dim_sim_create(test, 2000, 1);
+
+	dim_sim_run(sim, 64 * 200);
+	KUNIT_EXPECT_EQ(test, sim->dim.profile_ix, 0);
+}
+
+/* Load going up lets DIM move right, a tighter target moves it back */
+static void net_dim_latency_test_retarget(struct kunit *test)
+{
+	struct dim_sim *sim = dim_sim_create(test, 2000, 20);
+	u32 p99;
+
+	dim_sim_run(sim, 64 * 500);
+	KUNIT_EXPECT_EQ(test, sim->dim.profile_ix, 2);
+
+	sim->gap_ns = 100;
+	dim_sim_run(sim, 64 * 2000);
+	KUNIT_EXPECT_EQ(test, sim->dim.profile_ix, 4);
+
+	sim->gap_ns = 2000;
+	net_dim_set_latency_target(&sim->dim, 10, false);
+	p99 = dim_sim_run(sim, 64 * 500);
+	KUNIT_EXPECT_EQ(test, sim->dim.profile_ix, 1);
+	KUNIT_EXPECT_LE(test, p99, 10);
+}
+
+static struct kunit_case net_dim_test_cases[] = {
+	KUNIT_CASE(net_dim_latency_test_converge),
+	KUNIT_CASE(net_dim_latency_test_busy),
+	KUNIT_CASE(net_dim_latency_test_tight),
+	KUNIT_CASE(net_dim_latency_test_retarget),
+	{}
+};
+
+static struct kunit_suite net_dim_suite = {
+	.name = "net-dim",
+	.test_cases = net_dim_test_cases,
+};
+
+kunit_test_suite(net_dim_suite);
+
+MODULE_LICENSE("Dual BSD/GPL");
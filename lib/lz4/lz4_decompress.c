@@ -278,6 +278,13 @@ static FORCE_INLINE int LZ4_decompress_generic(
 			 */
 			if (!partialDecoding || (cpy == oend) || (ip >= (iend - 2)))
 				break;
+		} else if (LZ4_FAST_WILDCOPY && endOnInput &&
+			   likely((cpy <= oend - 16) &
+				  (ip + length <= iend - 16))) {
+			/* may overwrite up to 15 bytes beyond cpy */
+			LZ4_wildCopy16(op, ip, cpy);
+			ip += length;
+			op = cpy;
 		} else {
 			/* may overwrite up to WILDCOPYLENGTH beyond cpy */
 			LZ4_wildCopy(op, ip, cpy);
@@ -437,8 +444,13 @@ static FORCE_INLINE int LZ4_decompress_generic(
 				*op++ = *match++;
 		} else {
 			LZ4_copy8(op, match);
-			if (length > 16)
-				LZ4_wildCopy(op + 8, match + 8, cpy);
+			if (length > 16) {
+				/* offset >= 8 here, see LZ4_wildCopy16() */
+				if (LZ4_FAST_WILDCOPY && likely(cpy <= oend - 16))
+					LZ4_wildCopy16(op + 8, match + 8, cpy);
+				else
+					LZ4_wildCopy(op + 8, match + 8, cpy);
+			}
 		}
 		op = cpy; /* wildcopy correction */
 	}
@@ -0,0 +1,186 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * KUnit tests and benchmark for the LZ4 decompressor.
+ *
+ * The input mixes literal runs with matches at every short offset and at
+ * long offsets, so that both the overlapping and the wide copy paths of
+ * the decompressor are exercised. Guard bytes after the output buffer
+ * catch copies that overrun the destination capacity.
+ */
+
+#include <kunit/test.h>
+#include <linux/ktime.h>
+#include <linux/lz4.h>
+#include <linux/math64.h>
+#include <linux/mm.h>
+#include <linux/prandom.h>
+
+#define LZ4_TEST_SIZE		(1024 * 1024)
+#define LZ4_TEST_GUARD		64
+#define LZ4_TEST_GUARD_BYTE	0xa5
+
+struct lz4_test_buf {
+	char *src;
+	char *comp;
+	char *out;
+	void *wrkmem;
+	int comp_size;
+};
+
+static void lz4_test_fill(struct rnd_state *rnd, char *buf, size_t len)
+{
+	size_t i = 0;
+
+	while (i < len) {
+		size_t run = 1 + prandom_u32_state(rnd) % 48;
+		size_t off;
+
+		if (i < 64 || !(prandom_u32_state(rnd) % 3)) {
+			while (run-- && i < len)
+				buf[i++] = prandom_u32_state(rnd);
+			continue;
+		}
+
+		if (prandom_u32_state(rnd) & 1)
+			off = 1 + prandom_u32_state(rnd) % 32;
+		else
+			off = 1 + prandom_u32_state(rnd) % min_t(size_t, i, 65535);
+		if (prandom_u32_state(rnd) % 8 == 0)
+			run += prandom_u32_state(rnd) % 512;
+		for (; run && i < len; run--, i++)
+			buf[i] = buf[i - off];
+	}
+}
+
+static void lz4_test_alloc(struct kunit *test, struct lz4_test_buf *b,
+			   size_t len)
+{
+	b->src = kunit_kmalloc(test, len, GFP_KERNEL);
+	b->comp = kunit_kmalloc(test, LZ4_compressBound(len), GFP_KERNEL);
+	b->out = kunit_kmalloc(test, len + LZ4_TEST_GUARD, GFP_KERNEL);
+	b->wrkmem = kunit_kmalloc(test, LZ4_MEM_COMPRESS, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, b->src);
+	KUNIT_ASSERT_NOT_NULL(test, b->comp);
+	KUNIT_ASSERT_NOT_NULL(test, b->out);
+	KUNIT_ASSERT_NOT_NULL(test, b->wrkmem);
+}
+
+static void lz4_test_compress(struct kunit *test, struct lz4_test_buf *b,
+			      size_t len)
+{
+	b->comp_size = LZ4_compress_default(b->src, b->comp, len,
+					    LZ4_compressBound(len), b->wrkmem);
+	KUNIT_ASSERT_GT(test, b->comp_size, 0);
+}
+
+static void lz4_test_check_guard(struct kunit *test, const char *out,
+				 size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < LZ4_TEST_GUARD; i++)
+		KUNIT_EXPECT_EQ(test, (u8)out[len + i], LZ4_TEST_GUARD_BYTE);
+}
+
+static void lz4_test_roundtrip(struct kunit *test)
+{
+	struct lz4_test_buf b;
+	struct rnd_state rnd;
+	int i, ret;
+
+	prandom_seed_state(&rnd, 0x4c5a34);
+	lz4_test_alloc(test, &b, LZ4_TEST_SIZE);
+
+	for (i = 0; i < 200; i++) {
+		size_t len = 1 + prandom_u32_state(&rnd) %
+			     (i < 100 ? PAGE_SIZE : LZ4_TEST_SIZE);
+		size_t part = len / 2 + 1;
+
+		lz4_test_fill(&rnd, b.src, len);
+		lz4_test_compress(test, &b, len);
+
+		memset(b.out, LZ4_TEST_GUARD_BYTE, len + LZ4_TEST_GUARD);
+		ret = LZ4_decompress_safe(b.comp, b.out, b.comp_size, len);
+		KUNIT_ASSERT_EQ(test, ret, (int)len);
+		KUNIT_ASSERT_EQ(test, memcmp(b.out, b.src, len), 0);
+		lz4_test_check_guard(test, b.out, len);
+
+		memset(b.out, LZ4_TEST_GUARD_BYTE, len + LZ4_TEST_GUARD);
+		ret = LZ4_decompress_fast(b.comp, b.out, len);
+		KUNIT_ASSERT_EQ(test, ret, b.comp_size);
+		KUNIT_ASSERT_EQ(test, memcmp(b.out, b.src, len), 0);
+		lz4_test_check_guard(test, b.out, len);
+
+		memset(b.out, LZ4_TEST_GUARD_BYTE, len + LZ4_TEST_GUARD);
+		ret = LZ4_decompress_safe_partial(b.comp, b.out, b.comp_size,
+						  part, part);
+		KUNIT_ASSERT_GE(test, ret, 0);
+		KUNIT_ASSERT_EQ(test, memcmp(b.out, b.src, min_t(size_t, ret, part)), 0);
+		lz4_test_check_guard(test, b.out, part);
+	}
+}
+
+static void lz4_test_corrupt(struct kunit *test)
+{
+	struct lz4_test_buf b;
+	struct rnd_state rnd;
+	int i;
+
+	prandom_seed_state(&rnd, 0xbad1a4);
+	lz4_test_alloc(test, &b, PAGE_SIZE);
+	lz4_test_fill(&rnd, b.src, PAGE_SIZE);
+	lz4_test_compress(test, &b, PAGE_SIZE);
+
+	/* Whatever the input, the decoder must stay within its buffers */
+	for (i = 0; i < 1000; i++) {
+		b.comp[prandom_u32_state(&rnd) % b.comp_size] =
+			prandom_u32_state(&rnd);
+		memset(b.out, LZ4_TEST_GUARD_BYTE, PAGE_SIZE + LZ4_TEST_GUARD);
+		LZ4_decompress_safe(b.comp, b.out, b.comp_size, PAGE_SIZE);
+		lz4_test_check_guard(test, b.out, PAGE_SIZE);
+	}
+}
+
+static void lz4_test_benchmark(struct kunit *test)
+{
+	struct lz4_test_buf b;
+	struct rnd_state rnd;
+	u64 best = U64_MAX;
+	int i;
+
+	prandom_seed_state(&rnd, 0x5eed);
+	lz4_test_alloc(test, &b, LZ4_TEST_SIZE);
+	lz4_test_fill(&rnd, b.src, LZ4_TEST_SIZE);
+	lz4_test_compress(test, &b, LZ4_TEST_SIZE);
+
+	for (i = 0; i < 20; i++) {
+		ktime_t start = ktime_get();
+		int ret;
+
+		ret = LZ4_decompress_safe(b.comp, b.out, b.comp_size,
+					  LZ4_TEST_SIZE);
+		best = min_t(u64, best, ktime_to_ns(ktime_sub(ktime_get(),
+							      start)));
+		KUNIT_ASSERT_EQ(test, ret, LZ4_TEST_SIZE);
+	}
+
+	kunit_info(test, "decompress %d -> %d bytes: %llu MB/s\n",
+		   b.comp_size, LZ4_TEST_SIZE,
+		   div64_u64((u64)LZ4_TEST_SIZE * 1000, best ?: 1));
+}
+
+static struct kunit_case lz4_test_cases[] = {
+	KUNIT_CASE(lz4_test_roundtrip),
+	KUNIT_CASE(lz4_test_corrupt),
+	KUNIT_CASE(lz4_test_benchmark),
+	{}
+};
+
+static struct kunit_suite lz4_test_suite = {
+	.name = "lz4",
+	.test_cases = lz4_test_cases,
+};
+
+kunit_test_suite(lz4_test_suite);
+
+MODULE_LICENSE("GPL");
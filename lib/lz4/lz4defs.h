@@ -63,6 +63,16 @@ typedef uintptr_t uptrval;
 #define LZ4_ARCH64 0
 #endif
 
+/*
+ * Where unaligned 64-bit accesses are cheap, long literal runs and matches
+ * are copied 16 bytes per iteration when the buffers have enough room.
+ */
+#if LZ4_ARCH64 && defined(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS)
+#define LZ4_FAST_WILDCOPY 1
+#else
+#define LZ4_FAST_WILDCOPY 0
+#endif
+
 #if defined(__LITTLE_ENDIAN)
 #define LZ4_LITTLE_ENDIAN 1
 #else
@@ -183,6 +193,27 @@ static FORCE_INLINE void LZ4_wildCopy(void *dstPtr,
 	} while (d < e);
 }
 
+/*
+ * same as LZ4_wildCopy() with 16 bytes per iteration,
+ * which can overwrite up to 15 bytes beyond dstEnd.
+ * The two halves are copied in order, so like LZ4_wildCopy()
+ * it handles overlapping buffers as long as src <= dst - 8.
+ */
+static FORCE_INLINE void LZ4_wildCopy16(void *dstPtr,
+	const void *srcPtr, void *dstEnd)
+{
+	BYTE *d = (BYTE *)dstPtr;
+	const BYTE *s = (const BYTE *)srcPtr;
+	BYTE *const e = (BYTE *)dstEnd;
+
+	do {
+		LZ4_copy8(d, s);
+		LZ4_copy8(d + 8, s + 8);
+		d += 16;
+		s += 16;
+	} while (d < e);
+}
+
 static FORCE_INLINE unsigned int LZ4_NbCommonBytes(register size_t val)
 {
 #if LZ4_LITTLE_ENDIAN
@@ -0,0 +1,267 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/* mpi-mont.c  -  Montgomery modular exponentiation
+ *
+ * For an odd modulus M of N limbs and R = B^N, Montgomery multiplication
+ * computes A * B / R mod M with N multiply-accumulate passes instead of a
+ * long division, so an exponentiation done in Montgomery form costs no
+ * divisions at all beyond the one made once when the context is set up.
+ * The context is read-only after mpi_mont_init(), which lets a caller
+ * build it once per key and share it between concurrent users.
+ */
+
+#include <linux/sched.h>
+#include <linux/string.h>
+#include "mpi-internal.h"
+#include "longlong.h"
+
+/* Context used with Montgomery multiplication.  */
+struct mont_ctx_s {
+	MPI m;			/* The modulus, odd and normalized. */
+	mpi_size_t n;		/* Limbs in M. */
+	mpi_limb_t minv;	/* -M^-1 mod B. */
+	mpi_ptr_t rr;		/* R^2 mod M, N limbs. */
+};
+
+/* Scratch space for one exponentiation.  */
+struct mont_scratch {
+	mpi_ptr_t tp;		/* Double-width product, 2 * N limbs. */
+	mpi_ptr_t tspace;	/* Karatsuba temporary, 2 * N limbs. */
+};
+
+/* Return a new context for Montgomery based operations on the odd modulus
+ * M, or NULL if M is even or memory is short.  M is copied, so the caller
+ * may change or release it afterwards.  The context must be released with
+ * mpi_mont_free().
+ */
+mpi_mont_t mpi_mont_init(MPI m)
+{
+	mpi_mont_t ctx;
+	mpi_limb_t inv, m0;
+	MPI tmp;
+	int i;
+
+	mpi_normalize(m);
+	if (!m->nlimbs || m->sign || !(m->d[0] & 1))
+		return NULL;
+
+	ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
+	if (!ctx)
+		return NULL;
+
+	ctx->m = mpi_copy(m);
+	if (!ctx->m)
+		goto err;
+	ctx->n = m->nlimbs;
+
+	/* Newton iteration for M^-1 mod B; M * M == 1 mod 8 gives the first
+	 * three bits and every step doubles the number of correct bits.
+	 */
+	m0 = m->d[0];
+	inv = m0;
+	for (i = 3; i < BITS_PER_MPI_LIMB; i *= 2)
+		inv *= 2 - m0 * inv;
+	ctx->minv = -inv;
+
+	/* R^2 mod M, the factor that takes a number into Montgomery form. */
+	tmp = mpi_alloc(2 * ctx->n + 1);
+	if (!tmp)
+		goto err;
+	mpi_set_ui(tmp, 1);
+	mpi_lshift_limbs(tmp, 2 * ctx->n);
+	mpi_fdiv_r(tmp, tmp, ctx->m);
+
+	ctx->rr = mpi_alloc_limb_space(ctx->n);
+	if (!ctx->rr) {
+		mpi_free(tmp);
+		goto err;
+	}
+	MPN_ZERO(ctx->rr, ctx->n);
+	MPN_COPY(ctx->rr, tmp->d, tmp->nlimbs);
+	mpi_free(tmp);
+
+	return ctx;
+
+err:
+	mpi_mont_free(ctx);
+	return NULL;
+}
+EXPORT_SYMBOL_GPL(mpi_mont_init);
+
+void mpi_mont_free(mpi_mont_t ctx)
+{
+	if (ctx) {
+		mpi_free(ctx->m);
+		if (ctx->rr)
+			mpi_free_limb_space(ctx->rr);
+		kfree(ctx);
+	}
+}
+EXPORT_SYMBOL_GPL(mpi_mont_free);
+
+/* RP = TP / R mod M, where TP has 2 * N limbs and is less than M * R.
+ * TP is clobbered.
+ *
+ * Each pass clears the lowest remaining limb of TP by adding a multiple of
+ * M, and stores the carry out of that pass in the limb it just cleared;
+ * the carries are then added to the high half in one go at the end.
+ */
+static void mont_redc(mpi_ptr_t rp, mpi_ptr_t tp, mpi_mont_t ctx)
+{
+	mpi_ptr_t mp = ctx->m->d;
+	mpi_size_t i, n = ctx->n;
+	mpi_limb_t cy;
+
+	for (i = 0; i < n; i++)
+		tp[i] = mpihelp_addmul_1(tp + i, mp, n, tp[i] * ctx->minv);
+	cy = mpihelp_add_n(rp, tp + n, tp, n);
+
+	/* The result is below 2 * M, one subtraction is enough. */
+	if (cy || mpihelp_cmp(rp, mp, n) >= 0)
+		mpihelp_sub_n(rp, rp, mp, n);
+}
+
+/* RP = UP * VP / R mod M.  RP may be the same as UP or VP. */
+static void mont_mul(mpi_ptr_t rp, mpi_ptr_t up, mpi_ptr_t vp, mpi_mont_t ctx,
+		     struct mont_scratch *s)
+{
+	mpi_size_t n = ctx->n;
+
+	if (up == vp) {
+		if (n < KARATSUBA_THRESHOLD)
+			mpih_sqr_n_basecase(s->tp, up, n);
+		else
+			mpih_sqr_n(s->tp, up, n, s->tspace);
+	} else {
+		mpih_mul_n(s->tp, up, vp, n, s->tspace);
+	}
+	mont_redc(rp, s->tp, ctx);
+}
+
+/* Window width for the sliding window exponentiation, chosen from the
+ * number of exponent bits as in libgcrypt.
+ */
+static int mont_window_bits(unsigned int ebits)
+{
+	if (ebits > 512)
+		return 5;
+	if (ebits > 256)
+		return 4;
+	if (ebits > 128)
+		return 3;
+	if (ebits > 64)
+		return 2;
+	return 1;
+}
+
+/****************
+ * RES = BASE ^ EXP mod M, with M taken from a context set up by
+ * mpi_mont_init().  The sign of EXP is ignored, as in mpi_powm().
+ */
+int mpi_powm_mont(MPI res, MPI base, MPI exp, mpi_mont_t ctx)
+{
+	mpi_size_t n = ctx->n, esize = exp->nlimbs;
+	struct mont_scratch s = {};
+	mpi_ptr_t bp, xp, tab = NULL;
+	unsigned int ebits, tabsize, win;
+	int rc = -ENOMEM;
+	int w, i, j, k;
+	bool started;
+	MPI b = NULL;
+
+	MPN_NORMALIZE(exp->d, esize);
+	if (!esize) {
+		/* Exponent is zero, result is 1 mod M, i.e. 1 or 0 depending
+		 * on whether M equals 1.
+		 */
+		if (n == 1 && ctx->m->d[0] == 1)
+			mpi_set_ui(res, 0);
+		else
+			mpi_set_ui(res, 1);
+		return 0;
+	}
+	ebits = esize * BITS_PER_MPI_LIMB - count_leading_zeros(exp->d[esize - 1]);
+
+	/* Bring BASE into [0, M); floored division handles a negative BASE. */
+	if (base->sign || mpi_cmp(base, ctx->m) >= 0) {
+		b = mpi_alloc(n);
+		if (!b)
+			return -ENOMEM;
+		mpi_fdiv_r(b, base, ctx->m);
+		base = b;
+	}
+
+	w = mont_window_bits(ebits);
+	tabsize = 1 << (w - 1);
+
+	/* Odd powers BASE^1, BASE^3, ..., then the accumulator. */
+	tab = mpi_alloc_limb_space((tabsize + 1) * n);
+	s.tp = mpi_alloc_limb_space(2 * n);
+	s.tspace = mpi_alloc_limb_space(2 * n);
+	if (!tab || !s.tp || !s.tspace)
+		goto leave;
+	xp = tab + tabsize * n;
+
+	/* BASE in Montgomery form is BASE * R^2 / R. */
+	bp = tab;
+	MPN_ZERO(xp, n);
+	MPN_COPY(xp, base->d, base->nlimbs);
+	mont_mul(bp, xp, ctx->rr, ctx, &s);
+	if (tabsize > 1) {
+		mont_mul(xp, bp, bp, ctx, &s);
+		for (k = 1; k < tabsize; k++)
+			mont_mul(tab + k * n, tab + (k - 1) * n, xp, ctx, &s);
+	}
+
+	/* Left to right sliding window over the bits of EXP. */
+	started = false;
+	for (i = ebits - 1; i >= 0; ) {
+		if (!mpi_test_bit(exp, i)) {
+			if (started)
+				mont_mul(xp, xp, xp, ctx, &s);
+			i--;
+			continue;
+		}
+
+		/* Longest window of at most W bits that ends in a one. */
+		j = max(i - w + 1, 0);
+		while (!mpi_test_bit(exp, j))
+			j++;
+		for (k = i, win = 0; k >= j; k--)
+			win = (win << 1) | mpi_test_bit(exp, k);
+
+		if (started) {
+			for (k = i; k >= j; k--)
+				mont_mul(xp, xp, xp, ctx, &s);
+			mont_mul(xp, xp, tab + (win >> 1) * n, ctx, &s);
+		} else {
+			MPN_COPY(xp, tab + (win >> 1) * n, n);
+			started = true;
+		}
+		i = j - 1;
+		cond_resched();
+	}
+
+	/* Leave Montgomery form: multiply by one. */
+	MPN_COPY(s.tp, xp, n);
+	MPN_ZERO(s.tp + n, n);
+	mont_redc(xp, s.tp, ctx);
+
+	if (mpi_resize(res, n) < 0)
+		goto leave;
+	MPN_COPY(res->d, xp, n);
+	res->nlimbs = n;
+	res->sign = 0;
+	MPN_NORMALIZE(res->d, res->nlimbs);
+	rc = 0;
+
+leave:
+	if (tab)
+		mpi_free_limb_space(tab);
+	if (s.tp)
+		mpi_free_limb_space(s.tp);
+	if (s.tspace)
+		mpi_free_limb_space(s.tspace);
+	mpi_free(b);
+	return rc;
+}
+EXPORT_SYMBOL_GPL(mpi_powm_mont);
@@ -49,6 +49,17 @@ int mpi_powm(MPI res, MPI base, MPI exp, MPI mod)
 	if (!msize)
 		return -EINVAL;
 
+	/* Odd moduli, which covers RSA and DH, take the Montgomery path.  */
+	if (!msign && (mod->d[0] & 1) && esize) {
+		mpi_mont_t mont = mpi_mont_init(mod);
+
+		if (mont) {
+			rc = mpi_powm_mont(res, base, exp, mont);
+			mpi_mont_free(mont);
+			return rc;
+		}
+	}
+
 	if (!esize) {
 		/* Exponent is zero, result is 1 mod MOD, i.e., 1 or 0
 		 * depending on if MOD equals 1.  */
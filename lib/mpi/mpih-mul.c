@@ -318,6 +318,15 @@ mpih_sqr_n(mpi_ptr_t prodp, mpi_ptr_t up, mpi_size_t size, mpi_ptr_t tspace)
 }
 
 
+/* As mpihelp_mul_n() for distinct operands, but with the Karatsuba scratch
+ * space (2 * SIZE limbs) provided by the caller.
+ */
+void mpih_mul_n(mpi_ptr_t prodp, mpi_ptr_t up, mpi_ptr_t vp, mpi_size_t size,
+		mpi_ptr_t tspace)
+{
+	MPN_MUL_N_RECURSE(prodp, up, vp, size, tspace);
+}
+
 void mpihelp_mul_n(mpi_ptr_t prodp,
 		mpi_ptr_t up, mpi_ptr_t vp, mpi_size_t size)
 {
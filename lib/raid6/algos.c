@@ -15,9 +15,15 @@
 #ifndef __KERNEL__
 #include <sys/mman.h>
 #include <stdio.h>
+#include <stdlib.h>
+#define vmalloc(size)	aligned_alloc(PAGE_SIZE, size)
+#define vfree(ptr)	free(ptr)
 #else
 #include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/mutex.h>
 #include <linux/gfp.h>
+#include <linux/vmalloc.h>
 #if !RAID6_USE_EMPTY_ZERO_PAGE
 /* In .bss so it's zeroed */
 const char raid6_empty_zero_page[PAGE_SIZE] __attribute__((aligned(256)));
@@ -30,6 +36,10 @@ EXPORT_SYMBOL_GPL(raid6_call);
 
 const struct raid6_calls * const raid6_algos[] = {
 #if defined(__i386__) && !defined(__arch_um__)
+#ifdef CONFIG_AS_GFNI
+	&raid6_gfnix2,
+	&raid6_gfnix1,
+#endif
 #ifdef CONFIG_AS_AVX512
 	&raid6_avx512x2,
 	&raid6_avx512x1,
@@ -44,6 +54,11 @@ const struct raid6_calls * const raid6_algos[] = {
 	&raid6_mmxx1,
 #endif
 #if defined(__x86_64__) && !defined(__arch_um__)
+#ifdef CONFIG_AS_GFNI
+	&raid6_gfnix4,
+	&raid6_gfnix2,
+	&raid6_gfnix1,
+#endif
 #ifdef CONFIG_AS_AVX512
 	&raid6_avx512x4,
 	&raid6_avx512x2,
@@ -94,6 +109,9 @@ EXPORT_SYMBOL_GPL(raid6_datap_recov);
 
 const struct raid6_recov_calls *const raid6_recov_algos[] = {
 #ifdef CONFIG_X86
+#ifdef CONFIG_AS_GFNI
+	&raid6_recov_gfni,
+#endif
 #ifdef CONFIG_AS_AVX512
 	&raid6_recov_avx512,
 #endif
@@ -119,21 +137,85 @@ const struct raid6_recov_calls *const raid6_recov_algos[] = {
 #endif
 
 #define RAID6_TEST_DISKS	8
-#define RAID6_TEST_DISKS_ORDER	3
 
-static inline const struct raid6_recov_calls *raid6_choose_recov(void)
+/* Limits for benchmarks run on request */
+#define RAID6_BENCH_MAX_DISKS	256
+#define RAID6_BENCH_MAX_BYTES	(64 * 1024)
+
+/* Stripe geometry used for the benchmark at boot */
+static int raid6_bench_disks = RAID6_TEST_DISKS;
+static unsigned int raid6_bench_bytes = PAGE_SIZE;
+
+/* Data throughput of perf calls over a stripe of disks * bytes */
+static unsigned long raid6_mbps(unsigned long perf, int disks, size_t bytes)
 {
+	return ((u64)perf * HZ * (disks - 2) * bytes) >>
+		(20 + RAID6_TIME_JIFFIES_LG2);
+}
+
+/*
+ * The selected routines may be switched while md is using them, so update
+ * each pointer on its own.  Mixing the routines of two sets is harmless as
+ * they all compute the same syndromes.
+ */
+static void raid6_set_call(const struct raid6_calls *best)
+{
+	WRITE_ONCE(raid6_call.gen_syndrome, best->gen_syndrome);
+	WRITE_ONCE(raid6_call.xor_syndrome, best->xor_syndrome);
+	WRITE_ONCE(raid6_call.valid, best->valid);
+	WRITE_ONCE(raid6_call.name, best->name);
+	WRITE_ONCE(raid6_call.priority, best->priority);
+}
+
+static const struct raid6_recov_calls *raid6_choose_recov(void **dptrs,
+	int disks, size_t bytes, int bench)
+{
+	unsigned long perf, bestperf, j0, j1;
 	const struct raid6_recov_calls *const *algo;
 	const struct raid6_recov_calls *best;
 
-	for (best = NULL, algo = raid6_recov_algos; *algo; algo++)
-		if (!best || (*algo)->priority > best->priority)
-			if (!(*algo)->valid || (*algo)->valid())
+	/*
+	 * The recovery routines stand raid6_empty_zero_page in for the failed
+	 * disks while they regenerate the syndromes, so they can't work on
+	 * more than a page.
+	 */
+	if (bytes > PAGE_SIZE)
+		bytes = PAGE_SIZE;
+
+	for (bestperf = 0, best = NULL, algo = raid6_recov_algos; *algo; algo++) {
+		if ((*algo)->valid && !(*algo)->valid())
+			continue;
+
+		if (!bench) {
+			if (!best || (*algo)->priority > best->priority)
 				best = *algo;
+			continue;
+		}
+
+		perf = 0;
+
+		preempt_disable();
+		j0 = jiffies;
+		while ((j1 = jiffies) == j0)
+			cpu_relax();
+		while (time_before(jiffies,
+				   j1 + (1 << RAID6_TIME_JIFFIES_LG2))) {
+			(*algo)->data2(disks, bytes, 0, disks - 3, dptrs);
+			perf++;
+		}
+		preempt_enable();
+
+		if (perf > bestperf) {
+			bestperf = perf;
+			best = *algo;
+		}
+		pr_info("raid6: %-8s recov() %5ld MB/s\n", (*algo)->name,
+			raid6_mbps(perf, disks, bytes));
+	}
 
 	if (best) {
-		raid6_2data_recov = best->data2;
-		raid6_datap_recov = best->datap;
+		WRITE_ONCE(raid6_2data_recov, best->data2);
+		WRITE_ONCE(raid6_datap_recov, best->datap);
 
 		pr_info("raid6: using %s recovery algorithm\n", best->name);
 	} else
@@ -142,8 +224,8 @@ static inline const struct raid6_recov_calls *raid6_choose_recov(void)
 	return best;
 }
 
-static inline const struct raid6_calls *raid6_choose_gen(
-	void *(*const dptrs)[RAID6_TEST_DISKS], const int disks)
+static const struct raid6_calls *raid6_choose_gen(void **dptrs, int disks,
+	size_t bytes, int bench)
 {
 	unsigned long perf, bestgenperf, j0, j1;
 	int start = (disks>>1)-1, stop = disks-3;	/* work on the second half of the disks */
@@ -155,7 +237,11 @@ static inline const struct raid6_calls *raid6_choose_gen(
 			if ((*algo)->valid && !(*algo)->valid())
 				continue;
 
-			if (!IS_ENABLED(CONFIG_RAID6_PQ_BENCHMARK)) {
+			/* md may already rely on xor_syndrome() for rmw */
+			if (raid6_call.xor_syndrome && !(*algo)->xor_syndrome)
+				continue;
+
+			if (!bench) {
 				best = *algo;
 				break;
 			}
@@ -168,7 +254,7 @@ static inline const struct raid6_calls *raid6_choose_gen(
 				cpu_relax();
 			while (time_before(jiffies,
 					    j1 + (1<<RAID6_TIME_JIFFIES_LG2))) {
-				(*algo)->gen_syndrome(disks, PAGE_SIZE, *dptrs);
+				(*algo)->gen_syndrome(disks, bytes, dptrs);
 				perf++;
 			}
 			preempt_enable();
@@ -178,8 +264,7 @@ static inline const struct raid6_calls *raid6_choose_gen(
 				best = *algo;
 			}
 			pr_info("raid6: %-8s gen() %5ld MB/s\n", (*algo)->name,
-				(perf * HZ * (disks-2)) >>
-				(20 - PAGE_SHIFT + RAID6_TIME_JIFFIES_LG2));
+				raid6_mbps(perf, disks, bytes));
 		}
 	}
 
@@ -188,18 +273,16 @@ static inline const struct raid6_calls *raid6_choose_gen(
 		goto out;
 	}
 
-	raid6_call = *best;
+	raid6_set_call(best);
 
-	if (!IS_ENABLED(CONFIG_RAID6_PQ_BENCHMARK)) {
+	if (!bench) {
 		pr_info("raid6: skipped pq benchmark and selected %s\n",
 			best->name);
 		goto out;
 	}
 
 	pr_info("raid6: using algorithm %s gen() %ld MB/s\n",
-		best->name,
-		(bestgenperf * HZ * (disks - 2)) >>
-		(20 - PAGE_SHIFT + RAID6_TIME_JIFFIES_LG2));
+		best->name, raid6_mbps(bestgenperf, disks, bytes));
 
 	if (best->xor_syndrome) {
 		perf = 0;
@@ -211,65 +294,158 @@ static inline const struct raid6_calls *raid6_choose_gen(
 		while (time_before(jiffies,
 				   j1 + (1 << RAID6_TIME_JIFFIES_LG2))) {
 			best->xor_syndrome(disks, start, stop,
-					   PAGE_SIZE, *dptrs);
+					   bytes, dptrs);
 			perf++;
 		}
 		preempt_enable();
 
 		pr_info("raid6: .... xor() %ld MB/s, rmw enabled\n",
-			(perf * HZ * (disks - 2)) >>
-			(20 - PAGE_SHIFT + RAID6_TIME_JIFFIES_LG2 + 1));
+			raid6_mbps(perf, disks, bytes) >> 1);
 	}
 
 out:
 	return best;
 }
 
-
-/* Try to pick the best algorithm */
-/* This code uses the gfmul table as convenient data set to abuse */
-
-int __init raid6_select_algo(void)
+/*
+ * Pick the best algorithms for stripes of disks * bytes.  The syndrome
+ * routines are benchmarked if bench is set or if the kernel is configured
+ * to do so at boot; the recovery routines only if bench is set.
+ */
+static int raid6_run_benchmark(int disks, size_t bytes, int bench)
 {
-	const int disks = RAID6_TEST_DISKS;
-
 	const struct raid6_calls *gen_best;
 	const struct raid6_recov_calls *rec_best;
+	size_t len = (size_t)disks * bytes;
 	char *disk_ptr, *p;
-	void *dptrs[RAID6_TEST_DISKS];
-	int i, cycle;
+	void **dptrs;
+	int i;
 
-	/* prepare the buffer and fill it circularly with gfmul table */
-	disk_ptr = (char *)__get_free_pages(GFP_KERNEL, RAID6_TEST_DISKS_ORDER);
+	/* The pointer table goes into the page after the disks */
+	disk_ptr = vmalloc(len + PAGE_SIZE);
 	if (!disk_ptr) {
 		pr_err("raid6: Yikes!  No memory available.\n");
 		return -ENOMEM;
 	}
 
-	p = disk_ptr;
+	dptrs = (void **)(disk_ptr + len);
 	for (i = 0; i < disks; i++)
-		dptrs[i] = p + PAGE_SIZE * i;
+		dptrs[i] = disk_ptr + bytes * i;
 
-	cycle = ((disks - 2) * PAGE_SIZE) / 65536;
-	for (i = 0; i < cycle; i++) {
-		memcpy(p, raid6_gfmul, 65536);
-		p += 65536;
+	/* This code uses the gfmul table as convenient data set to abuse */
+	len = (disks - 2) * bytes;
+	for (p = disk_ptr; len; p += i, len -= i) {
+		i = len < 65536 ? len : 65536;
+		memcpy(p, raid6_gfmul, i);
 	}
 
-	if ((disks - 2) * PAGE_SIZE % 65536)
-		memcpy(p, raid6_gfmul, (disks - 2) * PAGE_SIZE % 65536);
-
 	/* select raid gen_syndrome function */
-	gen_best = raid6_choose_gen(&dptrs, disks);
+	gen_best = raid6_choose_gen(dptrs, disks, bytes,
+				    bench || IS_ENABLED(CONFIG_RAID6_PQ_BENCHMARK));
 
 	/* select raid recover functions */
-	rec_best = raid6_choose_recov();
+	rec_best = raid6_choose_recov(dptrs, disks, bytes, bench);
 
-	free_pages((unsigned long)disk_ptr, RAID6_TEST_DISKS_ORDER);
+	vfree(disk_ptr);
 
 	return gen_best && rec_best ? 0 : -EINVAL;
 }
 
+static int raid6_bench_valid(int disks, size_t bytes)
+{
+	return disks >= 4 && disks <= RAID6_BENCH_MAX_DISKS && bytes &&
+	       bytes <= RAID6_BENCH_MAX_BYTES && !(bytes % PAGE_SIZE);
+}
+
+/*
+ * Benchmark all usable algorithms on stripes of the given geometry and
+ * switch to the fastest ones.  bytes is the amount of data per disk.
+ */
+int raid6_benchmark(int disks, size_t bytes)
+{
+	if (!raid6_bench_valid(disks, bytes))
+		return -EINVAL;
+
+	return raid6_run_benchmark(disks, bytes, 1);
+}
+
+#ifdef __KERNEL__
+static bool raid6_algo_selected;
+static DEFINE_MUTEX(raid6_bench_mutex);
+
+static int raid6_benchmark_set(const char *val, const struct kernel_param *kp)
+{
+	unsigned int bytes = PAGE_SIZE;
+	int disks, ret;
+
+	if (sscanf(val, "%d%*[ ,]%u", &disks, &bytes) < 1)
+		return -EINVAL;
+
+	mutex_lock(&raid6_bench_mutex);
+	if (raid6_algo_selected)
+		ret = raid6_benchmark(disks, bytes);
+	else	/* Set on the command line, used by raid6_select_algo() */
+		ret = raid6_bench_valid(disks, bytes) ? 0 : -EINVAL;
+	if (!ret) {
+		raid6_bench_disks = disks;
+		raid6_bench_bytes = bytes;
+	}
+	mutex_unlock(&raid6_bench_mutex);
+
+	return ret;
+}
+
+static int raid6_benchmark_get(char *buf, const struct kernel_param *kp)
+{
+	return sysfs_emit(buf, "%d %u\n", raid6_bench_disks, raid6_bench_bytes);
+}
+
+static const struct kernel_param_ops raid6_benchmark_ops = {
+	.set = raid6_benchmark_set,
+	.get = raid6_benchmark_get,
+};
+module_param_cb(benchmark, &raid6_benchmark_ops, NULL, 0644);
+MODULE_PARM_DESC(benchmark,
+		 "Stripe geometry \"<disks>,<bytes per disk>\" to benchmark the algorithms with; writing it re-runs the benchmark");
+
+static int raid6_algorithm_get(char *buf, const struct kernel_param *kp)
+{
+	const struct raid6_recov_calls *const *algo;
+	const char *recov = "none";
+
+	for (algo = raid6_recov_algos; *algo; algo++)
+		if ((*algo)->data2 == READ_ONCE(raid6_2data_recov))
+			recov = (*algo)->name;
+
+	return sysfs_emit(buf, "gen=%s recov=%s\n",
+			  READ_ONCE(raid6_call.name) ?: "none", recov);
+}
+
+static const struct kernel_param_ops raid6_algorithm_ops = {
+	.get = raid6_algorithm_get,
+};
+module_param_cb(algorithm, &raid6_algorithm_ops, NULL, 0444);
+MODULE_PARM_DESC(algorithm, "Selected syndrome and recovery algorithms");
+#endif
+
+/* Try to pick the best algorithm */
+
+int __init raid6_select_algo(void)
+{
+	int ret;
+
+#ifdef __KERNEL__
+	mutex_lock(&raid6_bench_mutex);
+#endif
+	ret = raid6_run_benchmark(raid6_bench_disks, raid6_bench_bytes, 0);
+#ifdef __KERNEL__
+	raid6_algo_selected = true;
+	mutex_unlock(&raid6_bench_mutex);
+#endif
+
+	return ret;
+}
+
 static void raid6_exit(void)
 {
 	do { } while (0);
@@ -171,5 +171,29 @@ int main(int argc, char *argv[])
 	printf("EXPORT_SYMBOL(raid6_gfexi);\n");
 	printf("#endif\n");
 
+	/*
+	 * Compute the GF2P8AFFINEQB bit matrices for multiplication by a
+	 * constant.  Byte 7-i of each matrix selects the input bits which
+	 * contribute to bit i of the product.
+	 */
+	printf("\nconst u64 __attribute__((aligned(256)))\n"
+	       "raid6_gfaff[256] =\n" "{\n");
+	for (i = 0; i < 256; i += 4) {
+		printf("\t");
+		for (j = 0; j < 4; j++) {
+			uint64_t m = 0;
+
+			for (k = 0; k < 64; k++)
+				if (gfmul(i + j, 1 << (k & 7)) & (1 << (7 - k / 8)))
+					m |= (uint64_t)1 << k;
+			printf("0x%016" PRIx64 "ULL,%c", m,
+			       (j == 3) ? '\n' : ' ');
+		}
+	}
+	printf("};\n");
+	printf("#ifdef __KERNEL__\n");
+	printf("EXPORT_SYMBOL(raid6_gfaff);\n");
+	printf("#endif\n");
+
 	return 0;
 }
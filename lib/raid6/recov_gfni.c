@@ -0,0 +1,269 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * RAID-6 data recovery using AVX512 and GFNI
+ *
+ * Based on recov_avx512.c: Copyright (C) 2016 Intel Corporation
+ *
+ * The table based recovery code multiplies by the pbmul and qmul constants
+ * with two nibble lookups, two shifts/masks and an xor per vector.  With
+ * GF2P8AFFINEQB each of those multiplications is a single instruction using
+ * the bit matrix of the constant.
+ */
+
+#ifdef CONFIG_AS_GFNI
+
+#include <linux/raid/pq.h>
+#include "x86.h"
+
+static int raid6_has_gfni(void)
+{
+	return boot_cpu_has(X86_FEATURE_AVX2) &&
+		boot_cpu_has(X86_FEATURE_AVX) &&
+		boot_cpu_has(X86_FEATURE_AVX512F) &&
+		boot_cpu_has(X86_FEATURE_AVX512BW) &&
+		boot_cpu_has(X86_FEATURE_AVX512VL) &&
+		boot_cpu_has(X86_FEATURE_AVX512DQ) &&
+		boot_cpu_has(X86_FEATURE_GFNI);
+}
+
+static void raid6_2data_recov_gfni(int disks, size_t bytes, int faila,
+				   int failb, void **ptrs)
+{
+	u8 *p, *q, *dp, *dq;
+	const u64 *pbmul;	/* P multiplier matrix for B data */
+	const u64 *qmul;	/* Q multiplier matrix (for both) */
+
+	p = (u8 *)ptrs[disks-2];
+	q = (u8 *)ptrs[disks-1];
+
+	/*
+	 * Compute syndrome with zero for the missing data pages
+	 * Use the dead data pages as temporary storage for
+	 * delta p and delta q
+	 */
+
+	dp = (u8 *)ptrs[faila];
+	ptrs[faila] = (void *)raid6_empty_zero_page;
+	ptrs[disks-2] = dp;
+	dq = (u8 *)ptrs[failb];
+	ptrs[failb] = (void *)raid6_empty_zero_page;
+	ptrs[disks-1] = dq;
+
+	raid6_call.gen_syndrome(disks, bytes, ptrs);
+
+	/* Restore pointer table */
+	ptrs[faila]   = dp;
+	ptrs[failb]   = dq;
+	ptrs[disks-2] = p;
+	ptrs[disks-1] = q;
+
+	/* Now, pick the proper data matrices */
+	pbmul = &raid6_gfaff[raid6_gfexi[failb-faila]];
+	qmul  = &raid6_gfaff[raid6_gfinv[raid6_gfexp[faila] ^
+		raid6_gfexp[failb]]];
+
+	kernel_fpu_begin();
+
+	asm volatile("vpbroadcastq %0, %%zmm0\n\t"
+		     "vpbroadcastq %1, %%zmm1"
+		     :
+		     : "m" (*pbmul), "m" (*qmul));
+
+	while (bytes) {
+#ifdef CONFIG_X86_64
+		asm volatile("vmovdqa64 %0, %%zmm2\n\t"
+			     "vmovdqa64 %1, %%zmm3\n\t"
+			     "vmovdqa64 %2, %%zmm4\n\t"
+			     "vmovdqa64 %3, %%zmm5\n\t"
+			     "vpxorq %4, %%zmm2, %%zmm2\n\t"
+			     "vpxorq %5, %%zmm3, %%zmm3\n\t"
+			     "vpxorq %6, %%zmm4, %%zmm4\n\t"
+			     "vpxorq %7, %%zmm5, %%zmm5"
+			     :
+			     : "m" (p[0]), "m" (p[64]), "m" (q[0]),
+			       "m" (q[64]), "m" (dp[0]), "m" (dp[64]),
+			       "m" (dq[0]), "m" (dq[64]));
+
+		/*
+		 * 2 = px[0]  = dp[0]  ^ p[0]
+		 * 3 = px[64] = dp[64] ^ p[64]
+		 * 4 = dq[0]  ^ q[0]
+		 * 5 = dq[64] ^ q[64]
+		 */
+
+		asm volatile("vgf2p8affineqb $0, %%zmm1, %%zmm4, %%zmm4\n\t"
+			     "vgf2p8affineqb $0, %%zmm1, %%zmm5, %%zmm5\n\t"
+			     "vgf2p8affineqb $0, %%zmm0, %%zmm2, %%zmm6\n\t"
+			     "vgf2p8affineqb $0, %%zmm0, %%zmm3, %%zmm7\n\t"
+			     "vpxorq %%zmm6, %%zmm4, %%zmm4\n\t"
+			     "vpxorq %%zmm7, %%zmm5, %%zmm5"
+			     :
+			     : );
+
+		/*
+		 * 4 = db[0]  = qmul[dq[0]  ^ q[0]]  ^ pbmul[px[0]]
+		 * 5 = db[64] = qmul[dq[64] ^ q[64]] ^ pbmul[px[64]]
+		 */
+		asm volatile("vmovdqa64 %%zmm4, %0\n\t"
+			     "vmovdqa64 %%zmm5, %1\n\t"
+			     "vpxorq %%zmm4, %%zmm2, %%zmm2\n\t"
+			     "vpxorq %%zmm5, %%zmm3, %%zmm3\n\t"
+			     "vmovdqa64 %%zmm2, %2\n\t"
+			     "vmovdqa64 %%zmm3, %3"
+			     :
+			     : "m" (dq[0]), "m" (dq[64]), "m" (dp[0]),
+			       "m" (dp[64]));
+
+		bytes -= 128;
+		p += 128;
+		q += 128;
+		dp += 128;
+		dq += 128;
+#else
+		asm volatile("vmovdqa64 %0, %%zmm2\n\t"
+			     "vmovdqa64 %1, %%zmm4\n\t"
+			     "vpxorq %2, %%zmm2, %%zmm2\n\t"
+			     "vpxorq %3, %%zmm4, %%zmm4"
+			     :
+			     : "m" (*p), "m" (*q), "m" (*dp), "m" (*dq));
+
+		/* 2 = px = dp ^ p;  4 = dq ^ q */
+
+		asm volatile("vgf2p8affineqb $0, %%zmm1, %%zmm4, %%zmm4\n\t"
+			     "vgf2p8affineqb $0, %%zmm0, %%zmm2, %%zmm6\n\t"
+			     "vpxorq %%zmm6, %%zmm4, %%zmm4"
+			     :
+			     : );
+
+		/* 4 = db = qmul[dq ^ q] ^ pbmul[px] */
+		asm volatile("vmovdqa64 %%zmm4, %0\n\t"
+			     "vpxorq %%zmm4, %%zmm2, %%zmm2\n\t"
+			     "vmovdqa64 %%zmm2, %1"
+			     :
+			     : "m" (dq[0]), "m" (dp[0]));
+
+		bytes -= 64;
+		p += 64;
+		q += 64;
+		dp += 64;
+		dq += 64;
+#endif
+	}
+
+	kernel_fpu_end();
+}
+
+static void raid6_datap_recov_gfni(int disks, size_t bytes, int faila,
+				   void **ptrs)
+{
+	u8 *p, *q, *dq;
+	const u64 *qmul;	/* Q multiplier matrix */
+
+	p = (u8 *)ptrs[disks-2];
+	q = (u8 *)ptrs[disks-1];
+
+	/*
+	 * Compute syndrome with zero for the missing data page
+	 * Use the dead data page as temporary storage for delta q
+	 */
+
+	dq = (u8 *)ptrs[faila];
+	ptrs[faila] = (void *)raid6_empty_zero_page;
+	ptrs[disks-1] = dq;
+
+	raid6_call.gen_syndrome(disks, bytes, ptrs);
+
+	/* Restore pointer table */
+	ptrs[faila]   = dq;
+	ptrs[disks-1] = q;
+
+	/* Now, pick the proper data matrix */
+	qmul  = &raid6_gfaff[raid6_gfinv[raid6_gfexp[faila]]];
+
+	kernel_fpu_begin();
+
+	asm volatile("vpbroadcastq %0, %%zmm1" : : "m" (*qmul));
+
+	while (bytes) {
+#ifdef CONFIG_X86_64
+		asm volatile("vmovdqa64 %0, %%zmm3\n\t"
+			     "vmovdqa64 %1, %%zmm4\n\t"
+			     "vpxorq %2, %%zmm3, %%zmm3\n\t"
+			     "vpxorq %3, %%zmm4, %%zmm4\n\t"
+			     "vgf2p8affineqb $0, %%zmm1, %%zmm3, %%zmm3\n\t"
+			     "vgf2p8affineqb $0, %%zmm1, %%zmm4, %%zmm4"
+			     :
+			     : "m" (dq[0]), "m" (dq[64]), "m" (q[0]),
+			       "m" (q[64]));
+
+		/*
+		 * 3 = qmul[q[0]  ^ dq[0]]
+		 * 4 = qmul[q[64] ^ dq[64]]
+		 */
+		asm volatile("vmovdqa64 %0, %%zmm5\n\t"
+			     "vmovdqa64 %1, %%zmm6\n\t"
+			     "vpxorq %%zmm3, %%zmm5, %%zmm5\n\t"
+			     "vpxorq %%zmm4, %%zmm6, %%zmm6"
+			     :
+			     : "m" (p[0]), "m" (p[64]));
+
+		/*
+		 * 5 = p[0]  ^ qmul[q[0]  ^ dq[0]]
+		 * 6 = p[64] ^ qmul[q[64] ^ dq[64]]
+		 */
+		asm volatile("vmovdqa64 %%zmm3, %0\n\t"
+			     "vmovdqa64 %%zmm4, %1\n\t"
+			     "vmovdqa64 %%zmm5, %2\n\t"
+			     "vmovdqa64 %%zmm6, %3"
+			     :
+			     : "m" (dq[0]), "m" (dq[64]), "m" (p[0]),
+			       "m" (p[64]));
+
+		bytes -= 128;
+		p += 128;
+		q += 128;
+		dq += 128;
+#else
+		asm volatile("vmovdqa64 %0, %%zmm3\n\t"
+			     "vpxorq %1, %%zmm3, %%zmm3\n\t"
+			     "vgf2p8affineqb $0, %%zmm1, %%zmm3, %%zmm3"
+			     :
+			     : "m" (dq[0]), "m" (q[0]));
+
+		/* 3 = qmul[q ^ dq] */
+
+		asm volatile("vmovdqa64 %0, %%zmm5\n\t"
+			     "vpxorq %%zmm3, %%zmm5, %%zmm5"
+			     :
+			     : "m" (p[0]));
+
+		/* 5 = p ^ qmul[q ^ dq] */
+
+		asm volatile("vmovdqa64 %%zmm3, %0\n\t"
+			     "vmovdqa64 %%zmm5, %1"
+			     :
+			     : "m" (dq[0]), "m" (p[0]));
+
+		bytes -= 64;
+		p += 64;
+		q += 64;
+		dq += 64;
+#endif
+	}
+
+	kernel_fpu_end();
+}
+
+const struct raid6_recov_calls raid6_recov_gfni = {
+	.data2 = raid6_2data_recov_gfni,
+	.datap = raid6_datap_recov_gfni,
+	.valid = raid6_has_gfni,
+#ifdef CONFIG_X86_64
+	.name = "gfnix2",
+#else
+	.name = "gfnix1",
+#endif
+	.priority = 4,
+};
+
+#endif /* CONFIG_AS_GFNI */
@@ -18,6 +18,17 @@
 
 #define NDISKS		16	/* Including P and Q */
 
+/* Stripe geometries benchmarked with -b: disks (including P and Q), bytes */
+static const struct {
+	int disks;
+	size_t bytes;
+} bench_geometry[] = {
+	{ 8, PAGE_SIZE },
+	{ 12, 16 * PAGE_SIZE },
+	{ 24, 16 * PAGE_SIZE },
+	{ 64, 4 * PAGE_SIZE },
+};
+
 const char raid6_empty_zero_page[PAGE_SIZE] __attribute__((aligned(PAGE_SIZE)));
 
 char *dataptrs[NDISKS];
@@ -90,6 +101,7 @@ int main(int argc, char *argv[])
 	const struct raid6_recov_calls *const *ra;
 	int i, j, p1, p2;
 	int err = 0;
+	int bench = argc > 1 && !strcmp(argv[1], "-b");
 
 	makedata(0, NDISKS-1);
 
@@ -145,6 +157,18 @@ int main(int argc, char *argv[])
 	/* Pick the best algorithm test */
 	raid6_select_algo();
 
+	/* Benchmark syndrome and recovery routines on wider stripes */
+	for (i = 0; bench && i < sizeof(bench_geometry) /
+				 sizeof(bench_geometry[0]); i++) {
+		printf("\nbenchmark disks=%d bytes=%zu\n",
+		       bench_geometry[i].disks, bench_geometry[i].bytes);
+		if (raid6_benchmark(bench_geometry[i].disks,
+				    bench_geometry[i].bytes)) {
+			printf("*** BENCHMARK FAILED ***\n");
+			err++;
+		}
+	}
+
 	if (err)
 		printf("\n*** ERRORS FOUND ***\n");
 
@@ -0,0 +1,341 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Batched Reed Solomon encoder / decoder for 8-bit data width
+ *
+ * The codewords of a batch are processed RS_BATCH_LANES at a time, one
+ * codeword per byte lane of a vector register. Symbols are gathered into
+ * lane order in chunks, so that a multiplication of a whole vector by a
+ * constant of the field is two 16 entry table lookups (PSHUFB), one for
+ * each nibble, with the tables built by codec_init(). Both the encoder
+ * register and the syndromes stay in lane order for the whole codeword.
+ *
+ * Decoding only computes the syndromes in parallel. Codewords with errors
+ * are then handed to the regular decoder along with their syndrome.
+ *
+ * Included by reed_solomon.c.
+ */
+
+#define RS_BATCH_LANES	16
+#define RS_BATCH_CHUNK	16
+
+#if defined(CONFIG_X86) && \
+	(defined(CONFIG_REED_SOLOMON_ENC8) || defined(CONFIG_REED_SOLOMON_DEC8))
+#include <asm/cpufeature.h>
+#include <asm/fpu/api.h>
+#include <asm/simd.h>
+
+static const uint8_t rs_batch_nibble[RS_BATCH_LANES] __aligned(16) = {
+	[0 ... RS_BATCH_LANES - 1] = 0x0f
+};
+
+static bool rs_batch_simd_usable(void)
+{
+	return boot_cpu_has(X86_FEATURE_SSSE3) && may_use_simd();
+}
+
+static void rs_batch_simd_begin(void)
+{
+	kernel_fpu_begin();
+	asm volatile("movdqa %0, %%xmm7" : : "m" (rs_batch_nibble));
+}
+
+static void rs_batch_simd_end(void)
+{
+	kernel_fpu_end();
+}
+
+/* Load the multiplicand a ^ b, split in nibbles: low in xmm0, high in xmm1 */
+static __always_inline void rs_batch_load(const uint8_t *a, const uint8_t *b)
+{
+	asm volatile("movdqu %0, %%xmm0\n\t"
+		     "movdqu %1, %%xmm1\n\t"
+		     "pxor %%xmm1, %%xmm0\n\t"
+		     "movdqa %%xmm0, %%xmm1\n\t"
+		     "psrlw $4, %%xmm1\n\t"
+		     "pand %%xmm7, %%xmm0\n\t"
+		     "pand %%xmm7, %%xmm1"
+		     : : "m" (*(const uint8_t (*)[RS_BATCH_LANES])a),
+			 "m" (*(const uint8_t (*)[RS_BATCH_LANES])b));
+}
+
+/* dst = src ^ c * multiplicand, with @tbl the split table of c */
+static __always_inline void rs_batch_mul_add(uint8_t *dst, const uint8_t *src,
+					     const uint8_t *tbl)
+{
+	asm volatile("movdqu %1, %%xmm2\n\t"
+		     "movdqu %2, %%xmm3\n\t"
+		     "pshufb %%xmm0, %%xmm2\n\t"
+		     "pshufb %%xmm1, %%xmm3\n\t"
+		     "pxor %%xmm3, %%xmm2\n\t"
+		     "movdqu %3, %%xmm3\n\t"
+		     "pxor %%xmm3, %%xmm2\n\t"
+		     "movdqu %%xmm2, %0"
+		     : "+m" (*(uint8_t (*)[RS_BATCH_LANES])dst)
+		     : "m" (*(const uint8_t (*)[16])tbl),
+		       "m" (*(const uint8_t (*)[16])(tbl + 16)),
+		       "m" (*(const uint8_t (*)[RS_BATCH_LANES])src));
+}
+#else
+static inline bool rs_batch_simd_usable(void) { return false; }
+static inline void rs_batch_simd_begin(void) { }
+static inline void rs_batch_simd_end(void) { }
+static inline void rs_batch_load(const uint8_t *a, const uint8_t *b) { }
+static inline void rs_batch_mul_add(uint8_t *dst, const uint8_t *src,
+				    const uint8_t *tbl) { }
+#endif
+
+#if defined(CONFIG_REED_SOLOMON_ENC8) || defined(CONFIG_REED_SOLOMON_DEC8)
+static const uint8_t rs_batch_zero[RS_BATCH_LANES];
+
+/* t[i][l] = symbol i of data field l, for @n symbols of @nr data fields */
+static void rs_batch_gather8(uint8_t (*t)[RS_BATCH_LANES], const uint8_t *data,
+			     int stride, int nr, int n, uint16_t invmsk,
+			     uint16_t msk)
+{
+	int i, l;
+
+	if (nr < RS_BATCH_LANES)
+		memset(t, 0, n * RS_BATCH_LANES);
+	for (l = 0; l < nr; l++, data += stride) {
+		for (i = 0; i < n; i++)
+			t[i][l] = (data[i] ^ invmsk) & msk;
+	}
+}
+
+/* Same for parity fields, which are packed nroots apart */
+static void rs_batch_gather16(uint8_t (*t)[RS_BATCH_LANES],
+			      const uint16_t *par, int nroots, int nr, int n,
+			      uint16_t msk)
+{
+	int i, l;
+
+	if (nr < RS_BATCH_LANES)
+		memset(t, 0, n * RS_BATCH_LANES);
+	for (l = 0; l < nr; l++, par += nroots) {
+		for (i = 0; i < n; i++)
+			t[i][l] = par[i] & msk;
+	}
+}
+
+/* Whether the batch can use the vector code for @nr codewords */
+static bool rs_batch_accel(struct rs_codec *rs, int nr)
+{
+	return rs->gfmul && rs->nroots && nr > 1 && rs_batch_simd_usable();
+}
+#endif
+
+#ifdef CONFIG_REED_SOLOMON_ENC8
+static void encode_rs8_lanes(struct rs_codec *rs, uint8_t *data, int len,
+			     int stride, uint16_t *par, int nr, uint16_t invmsk)
+{
+	uint8_t reg[RS_BATCH_MAX_ROOTS][RS_BATCH_LANES];
+	uint8_t t[RS_BATCH_CHUNK][RS_BATCH_LANES];
+	const uint8_t *gfmul = rs->gfmul;
+	uint16_t msk = (uint16_t) rs->nn;
+	int nroots = rs->nroots;
+	int h = 0, i, j, k, l, n;
+
+	/*
+	 * The parity register is kept as a ring: reg[h] is par[0] of the
+	 * scalar encoder, so the shift is a move of h.
+	 */
+	rs_batch_gather16(reg, par, nroots, nr, nroots, msk);
+
+	for (i = 0; i < len; i += n) {
+		n = min(len - i, RS_BATCH_CHUNK);
+		rs_batch_gather8(t, data + i, stride, nr, n, invmsk, msk);
+
+		for (k = 0; k < n; k++) {
+			rs_batch_load(t[k], reg[h]);
+			for (j = 1, l = h + 1; j < nroots; j++, l++) {
+				if (l == nroots)
+					l = 0;
+				rs_batch_mul_add(reg[l], reg[l],
+						 gfmul + 32 * (nroots - j));
+			}
+			rs_batch_mul_add(reg[h], rs_batch_zero, gfmul);
+			if (++h == nroots)
+				h = 0;
+		}
+	}
+
+	for (l = 0; l < nr; l++, par += nroots) {
+		for (j = 0, k = h; j < nroots; j++) {
+			par[j] = reg[k][l];
+			if (++k == nroots)
+				k = 0;
+		}
+	}
+}
+
+/**
+ *  encode_rs8_batch - Calculate the parity for many data fields
+ *  @rsc:	the rs control structure
+ *  @data:	the data fields, @stride bytes apart
+ *  @len:	data length of each field
+ *  @stride:	distance between the start of two data fields
+ *  @par:	parity data, @nr arrays of nroots entries one after the other,
+ *		must be initialized by caller (usually all 0)
+ *  @nr:	number of data fields
+ *  @invmsk:	invert data mask (will be xored on data, not on parity!)
+ *
+ *  Same as calling encode_rs8() on each of the data fields, but codes with
+ *  symbols of up to 8 bit and at most RS_BATCH_MAX_ROOTS roots are encoded
+ *  several codewords at a time with vector instructions, if the CPU has
+ *  them and they can be used in the calling context.
+ */
+int encode_rs8_batch(struct rs_control *rsc, uint8_t *data, int len,
+		     int stride, uint16_t *par, int nr, uint16_t invmsk)
+{
+	struct rs_codec *rs = rsc->codec;
+	int nroots = rs->nroots;
+	int i, n, pad;
+
+	/* Check length parameter for validity */
+	pad = rs->nn - nroots - len;
+	if (pad < 0 || pad >= rs->nn)
+		return -ERANGE;
+
+	if (!rs_batch_accel(rs, nr)) {
+		for (i = 0; i < nr; i++)
+			encode_rs8(rsc, data + (size_t)i * stride, len,
+				   par + (size_t)i * nroots, invmsk);
+		return 0;
+	}
+
+	for (i = 0; i < nr; i += n) {
+		n = min(nr - i, RS_BATCH_LANES);
+		rs_batch_simd_begin();
+		encode_rs8_lanes(rs, data + (size_t)i * stride, len, stride,
+				 par + (size_t)i * nroots, n, invmsk);
+		rs_batch_simd_end();
+	}
+	return 0;
+}
+EXPORT_SYMBOL_GPL(encode_rs8_batch);
+#endif
+
+#ifdef CONFIG_REED_SOLOMON_DEC8
+static void syndrome_rs8_lanes(struct rs_codec *rs,
+			       uint8_t (*syn)[RS_BATCH_LANES], uint8_t *data,
+			       uint16_t *par, int len, int stride, int nr,
+			       uint16_t invmsk)
+{
+	uint8_t t[RS_BATCH_CHUNK][RS_BATCH_LANES];
+	int nroots = rs->nroots;
+	const uint8_t *gfmul = rs->gfmul + 32 * nroots;
+	uint16_t msk = (uint16_t) rs->nn;
+	int i, j, k, n;
+
+	memset(syn, 0, nroots * RS_BATCH_LANES);
+
+	/* Horner's rule over the data, then the parity */
+	for (i = 0; i < len + nroots; i += n) {
+		if (i < len) {
+			n = min(len - i, RS_BATCH_CHUNK);
+			rs_batch_gather8(t, data + i, stride, nr, n, invmsk,
+					 msk);
+		} else {
+			n = min(len + nroots - i, RS_BATCH_CHUNK);
+			rs_batch_gather16(t, par + i - len, nroots, nr, n, msk);
+		}
+
+		for (k = 0; k < n; k++) {
+			for (j = 0; j < nroots; j++) {
+				rs_batch_load(syn[j], rs_batch_zero);
+				rs_batch_mul_add(syn[j], t[k], gfmul + 32 * j);
+			}
+		}
+	}
+}
+
+/**
+ *  decode_rs8_batch - Decode many codewords
+ *  @rsc:	the rs control structure
+ *  @data:	the data fields, @stride bytes apart
+ *  @par:	received parity data, @nr arrays of nroots entries one after
+ *		the other
+ *  @len:	data length of each field
+ *  @stride:	distance between the start of two data fields
+ *  @nr:	number of codewords
+ *  @invmsk:	invert data mask (will be xored on data, not on parity!)
+ *  @results:	if not NULL, receives what decode_rs8() returned for each
+ *		codeword
+ *
+ *  Same as calling decode_rs8() without erasures on each of the codewords,
+ *  but for codes with symbols of up to 8 bit and at most RS_BATCH_MAX_ROOTS
+ *  roots the syndromes are computed several codewords at a time with vector
+ *  instructions, if the CPU has them and they can be used in the calling
+ *  context. Only the codewords with errors go through the scalar decoder.
+ *
+ *  Note: The rc_control struct @rsc contains buffers which are used for
+ *  decoding, so the caller has to ensure that decoder invocations are
+ *  serialized.
+ *
+ *  Returns the total number of corrected symbols, or -EBADMSG if at least
+ *  one of the codewords had uncorrectable errors.
+ */
+int decode_rs8_batch(struct rs_control *rsc, uint8_t *data, uint16_t *par,
+		     int len, int stride, int nr, uint16_t invmsk,
+		     int *results)
+{
+	uint8_t syn[RS_BATCH_MAX_ROOTS][RS_BATCH_LANES];
+	uint16_t s[RS_BATCH_MAX_ROOTS];
+	struct rs_codec *rs = rsc->codec;
+	int nroots = rs->nroots;
+	int i, j, l, n, ret;
+	int count = 0;
+	bool bad = false;
+
+	if (!rs_batch_accel(rs, nr)) {
+		for (i = 0; i < nr; i++) {
+			ret = decode_rs8(rsc, data + (size_t)i * stride,
+					 par + (size_t)i * nroots, len, NULL,
+					 0, NULL, invmsk, NULL);
+			if (results)
+				results[i] = ret;
+			if (ret < 0)
+				bad = true;
+			else
+				count += ret;
+		}
+		return bad ? -EBADMSG : count;
+	}
+
+	/* Check length parameter for validity */
+	BUG_ON(len <= 0 || len > rs->nn - nroots);
+
+	for (i = 0; i < nr; i += n) {
+		n = min(nr - i, RS_BATCH_LANES);
+		rs_batch_simd_begin();
+		syndrome_rs8_lanes(rs, syn, data + (size_t)i * stride,
+				   par + (size_t)i * nroots, len, stride, n,
+				   invmsk);
+		rs_batch_simd_end();
+
+		for (l = 0; l < n; l++) {
+			uint16_t syn_error = 0;
+
+			for (j = 0; j < nroots; j++) {
+				syn_error |= syn[j][l];
+				s[j] = rs->index_of[syn[j][l]];
+			}
+
+			ret = 0;
+			if (syn_error)
+				ret = decode_rs8(rsc,
+						 data + (size_t)(i + l) * stride,
+						 par + (size_t)(i + l) * nroots,
+						 len, s, 0, NULL, invmsk, NULL);
+			if (results)
+				results[i + l] = ret;
+			if (ret < 0)
+				bad = true;
+			else
+				count += ret;
+		}
+	}
+	return bad ? -EBADMSG : count;
+}
+EXPORT_SYMBOL_GPL(decode_rs8_batch);
+#endif
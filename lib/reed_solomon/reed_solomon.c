@@ -49,6 +49,28 @@ enum {
 	RS_DECODE_NUM_BUFFERS
 };
 
+/* Multiply two field elements in polynomial form */
+static uint16_t gf_mul(struct rs_codec *rs, uint16_t a, uint16_t b)
+{
+	if (!a || !b)
+		return 0;
+	return rs->alpha_to[rs_modnn(rs, rs->index_of[a] + rs->index_of[b])];
+}
+
+/*
+ * Build the split table for multiplications by @c: c * x for the 16 values
+ * of the low nibble x, followed by c * (x << 4) for the high nibble.
+ */
+static void gf_mul_table(struct rs_codec *rs, uint8_t *tbl, uint16_t c)
+{
+	int x;
+
+	for (x = 0; x < 16; x++) {
+		tbl[x] = x <= rs->nn ? gf_mul(rs, c, x) : 0;
+		tbl[16 + x] = (x << 4) <= rs->nn ? gf_mul(rs, c, x << 4) : 0;
+	}
+}
+
 /* This list holds all currently allocated rs codec structures */
 static LIST_HEAD(codec_list);
 /* Protection for the list */
@@ -152,11 +174,30 @@ static struct rs_codec *codec_init(int symsize, int gfpoly, int (*gffunc)(int),
 	for (i = 0; i <= nroots; i++)
 		rs->genpoly[i] = rs->index_of[rs->genpoly[i]];
 
+	/*
+	 * Multiplication tables for the batch functions: the generator
+	 * polynomial coefficients, then the roots.
+	 */
+	if (symsize <= 8 && nroots <= RS_BATCH_MAX_ROOTS) {
+		rs->gfmul = kmalloc_array(2 * nroots, 32, gfp);
+		if (!rs->gfmul)
+			goto err;
+
+		for (i = 0; i < nroots; i++) {
+			gf_mul_table(rs, rs->gfmul + 32 * i,
+				     rs->alpha_to[rs->genpoly[i]]);
+			gf_mul_table(rs, rs->gfmul + 32 * (nroots + i),
+				     rs->alpha_to[rs_modnn(rs,
+							   (fcr + i) * prim)]);
+		}
+	}
+
 	rs->users = 1;
 	list_add(&rs->list, &codec_list);
 	return rs;
 
 err:
+	kfree(rs->gfmul);
 	kfree(rs->genpoly);
 	kfree(rs->index_of);
 	kfree(rs->alpha_to);
@@ -188,6 +229,7 @@ void free_rs(struct rs_control *rs)
 		kfree(cd->alpha_to);
 		kfree(cd->index_of);
 		kfree(cd->genpoly);
+		kfree(cd->gfmul);
 		kfree(cd);
 	}
 	mutex_unlock(&rslistlock);
@@ -418,6 +460,8 @@ int decode_rs16(struct rs_control *rsc, uint16_t *data, uint16_t *par, int len,
 EXPORT_SYMBOL_GPL(decode_rs16);
 #endif
 
+#include "batch_rs8.c"
+
 MODULE_LICENSE("GPL");
 MODULE_DESCRIPTION("Reed Solomon encoder/decoder");
 MODULE_AUTHOR("Phil Karn, Thomas Gleixner");
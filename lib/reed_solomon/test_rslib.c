@@ -11,6 +11,7 @@
 #include <linux/moduleparam.h>
 #include <linux/random.h>
 #include <linux/slab.h>
+#include <linux/timekeeping.h>
 
 enum verbosity {
 	V_SILENT,
@@ -32,6 +33,7 @@ enum method {
 __param(int, v, V_PROGRESS, "Verbosity level");
 __param(int, ewsc, 1, "Erasures without symbol corruption");
 __param(int, bc, 1, "Test for correct behaviour beyond error correction capacity");
+__param(int, bench, 0, "Benchmark the batch interface against the single codeword one");
 
 struct etab {
 	int	symsize;
@@ -439,6 +441,239 @@ static int exercise_rs_bc(struct rs_control *rs, struct wspace *ws,
 	return stat.noncw;
 }
 
+#if defined(CONFIG_REED_SOLOMON_ENC8) && defined(CONFIG_REED_SOLOMON_DEC8)
+/* Codewords per batch, and gap between two data fields in a batch */
+#define BATCH_NR	37
+#define BATCH_GAP	3
+
+struct bwspace {
+	uint8_t		*data;		/* batch data fields */
+	uint8_t		*rdata;		/* the same, for the reference */
+	uint16_t	*par;		/* batch parity */
+	uint16_t	*rpar;		/* reference parity */
+	int		*res;		/* batch results */
+	int		*rres;		/* reference results */
+};
+
+static void free_bws(struct bwspace *bws)
+{
+	if (!bws)
+		return;
+
+	kfree(bws->data);
+	kfree(bws->par);
+	kfree(bws->res);
+	kfree(bws);
+}
+
+static struct bwspace *alloc_bws(int stride, int nroots)
+{
+	struct bwspace *bws;
+
+	bws = kzalloc(sizeof(*bws), GFP_KERNEL);
+	if (!bws)
+		return NULL;
+
+	bws->data = kcalloc(2 * BATCH_NR, stride, GFP_KERNEL);
+	bws->par = kcalloc(2 * BATCH_NR * nroots, sizeof(uint16_t),
+			   GFP_KERNEL);
+	bws->res = kcalloc(2 * BATCH_NR, sizeof(int), GFP_KERNEL);
+	if (!bws->data || !bws->par || !bws->res) {
+		free_bws(bws);
+		return NULL;
+	}
+
+	bws->rdata = bws->data + BATCH_NR * stride;
+	bws->rpar = bws->par + BATCH_NR * nroots;
+	bws->rres = bws->res + BATCH_NR;
+	return bws;
+}
+
+/*
+ * Adds errs random errors to the codeword with data field data and parity
+ * field par.
+ */
+static void corrupt_rs8(struct rs_control *rs, uint8_t *data, uint16_t *par,
+			int len, int errs)
+{
+	int nroots = rs->codec->nroots;
+	int dlen = len - nroots;
+	int nn = rs->codec->nn;
+	int errval, errloc, i;
+
+	/* Errors may land twice in the same place, which is fine here */
+	for (i = 0; i < errs; i++) {
+		do {
+			errval = get_random_u32() & nn;
+		} while (errval == 0);
+
+		errloc = prandom_u32_max(len);
+		if (errloc < dlen)
+			data[errloc] ^= errval;
+		else
+			par[errloc - dlen] ^= errval;
+	}
+}
+
+/*
+ * Checks that encode_rs8_batch() and decode_rs8_batch() give the same
+ * results as encode_rs8() and decode_rs8() on each codeword. Every third
+ * codeword is left intact, the others get errors up to the error
+ * correction capacity, or beyond it if bc is set.
+ */
+static int exercise_rs_batch(struct rs_control *rs, int len, int trials)
+{
+	int nroots = rs->codec->nroots;
+	int dlen = len - nroots;
+	int stride = dlen + BATCH_GAP;
+	int nn = rs->codec->nn;
+	int maxerrs = bc ? nroots + 1 : nroots / 2;
+	int ret, rret, errs, fail = 0;
+	struct bwspace *bws;
+	uint16_t invmsk;
+	int i, j;
+
+	if (v >= V_PROGRESS)
+		pr_info("Testing batch interface...\n");
+
+	bws = alloc_bws(stride, nroots);
+	if (!bws)
+		return -ENOMEM;
+
+	for (j = 0; j < trials; j++) {
+		invmsk = j & 1 ? nn : 0;
+
+		for (i = 0; i < BATCH_NR * stride; i++)
+			bws->data[i] = get_random_u32() & nn;
+		memset(bws->par, 0, 2 * BATCH_NR * nroots * sizeof(uint16_t));
+
+		for (i = 0; i < BATCH_NR; i++)
+			encode_rs8(rs, bws->data + i * stride, dlen,
+				   bws->rpar + i * nroots, invmsk);
+		encode_rs8_batch(rs, bws->data, dlen, stride, bws->par,
+				 BATCH_NR, invmsk);
+		if (memcmp(bws->par, bws->rpar,
+			   BATCH_NR * nroots * sizeof(uint16_t))) {
+			fail++;
+			continue;
+		}
+
+		for (i = 0; i < BATCH_NR; i++) {
+			errs = i % 3 ? prandom_u32_max(maxerrs + 1) : 0;
+			corrupt_rs8(rs, bws->data + i * stride,
+				    bws->par + i * nroots, len, errs);
+		}
+		memcpy(bws->rdata, bws->data, BATCH_NR * stride);
+		memcpy(bws->rpar, bws->par,
+		       BATCH_NR * nroots * sizeof(uint16_t));
+
+		rret = 0;
+		for (i = 0; i < BATCH_NR; i++) {
+			bws->rres[i] = decode_rs8(rs, bws->rdata + i * stride,
+						  bws->rpar + i * nroots, dlen,
+						  NULL, 0, NULL, invmsk, NULL);
+			if (bws->rres[i] < 0)
+				rret = -EBADMSG;
+			else if (rret >= 0)
+				rret += bws->rres[i];
+		}
+		ret = decode_rs8_batch(rs, bws->data, bws->par, dlen, stride,
+				       BATCH_NR, invmsk, bws->res);
+
+		if (ret != rret
+		    || memcmp(bws->res, bws->rres, BATCH_NR * sizeof(int))
+		    || memcmp(bws->data, bws->rdata, BATCH_NR * stride)
+		    || memcmp(bws->par, bws->rpar,
+			      BATCH_NR * nroots * sizeof(uint16_t)))
+			fail++;
+	}
+
+	if (v >= V_CSUMMARY)
+		pr_info("    Batches differing:    %d / %d\n", fail, trials);
+
+	if (fail && v >= V_PROGRESS)
+		pr_warn("    FAIL: %d batch mismatches!\n", fail);
+
+	free_bws(bws);
+	return fail;
+}
+
+/*
+ * Times both interfaces on a 64KiB buffer split in blocks of 128 bytes with
+ * 16 parity bytes each, which is what ramoops uses by default.
+ */
+static int bench_rs_batch(void)
+{
+	const int len = 128, nroots = 16, nr = 512, loops = 100;
+	u64 t0, t1, t2, t3, t4;
+	struct rs_control *rs;
+	struct bwspace *bws;
+	int i, j, ret = 0;
+
+	rs = init_rs(8, 0x11d, 0, 1, nroots);
+	if (!rs)
+		return -ENOMEM;
+
+	bws = kzalloc(sizeof(*bws), GFP_KERNEL);
+	if (bws) {
+		bws->data = kmalloc_array(nr, len, GFP_KERNEL);
+		bws->par = kcalloc(nr * nroots, sizeof(uint16_t), GFP_KERNEL);
+	}
+	if (!bws || !bws->data || !bws->par) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	get_random_bytes(bws->data, nr * len);
+
+	t0 = ktime_get_ns();
+	for (j = 0; j < loops; j++) {
+		memset(bws->par, 0, nr * nroots * sizeof(uint16_t));
+		for (i = 0; i < nr; i++)
+			encode_rs8(rs, bws->data + i * len, len,
+				   bws->par + i * nroots, 0);
+	}
+	t1 = ktime_get_ns();
+	for (j = 0; j < loops; j++) {
+		memset(bws->par, 0, nr * nroots * sizeof(uint16_t));
+		encode_rs8_batch(rs, bws->data, len, len, bws->par, nr, 0);
+	}
+	t2 = ktime_get_ns();
+	for (j = 0; j < loops; j++) {
+		for (i = 0; i < nr; i++)
+			ret |= decode_rs8(rs, bws->data + i * len,
+					  bws->par + i * nroots, len,
+					  NULL, 0, NULL, 0, NULL);
+	}
+	t3 = ktime_get_ns();
+	for (j = 0; j < loops; j++)
+		ret |= decode_rs8_batch(rs, bws->data, bws->par, len, len,
+					nr, 0, NULL);
+	t4 = ktime_get_ns();
+
+	pr_info("rslib: (%d,%d)_256 code, %d codewords, ns per codeword:\n",
+		len + nroots, len, nr);
+	pr_info("  encode_rs8: %llu  encode_rs8_batch: %llu\n",
+		div_u64(t1 - t0, loops * nr), div_u64(t2 - t1, loops * nr));
+	pr_info("  decode_rs8: %llu  decode_rs8_batch: %llu\n",
+		div_u64(t3 - t2, loops * nr), div_u64(t4 - t3, loops * nr));
+
+out:
+	free_bws(bws);
+	free_rs(rs);
+	return ret;
+}
+#else
+static int exercise_rs_batch(struct rs_control *rs, int len, int trials)
+{
+	return 0;
+}
+
+static int bench_rs_batch(void)
+{
+	return 0;
+}
+#endif
+
 static int run_exercise(struct etab *e)
 {
 	int nn = (1 << e->symsize) - 1;
@@ -475,6 +710,9 @@ static int run_exercise(struct etab *e)
 		retval |= exercise_rs(rsc, ws, len, e->ntrials);
 		if (bc)
 			retval |= exercise_rs_bc(rsc, ws, len, e->ntrials);
+		if (e->symsize <= 8)
+			retval |= exercise_rs_batch(rsc, len,
+						    DIV_ROUND_UP(e->ntrials, 10));
 	}
 
 	free_ws(ws);
@@ -498,6 +736,9 @@ static int __init test_rslib_init(void)
 		fail |= retval;
 	}
 
+	if (bench && bench_rs_batch() < 0)
+		fail = 1;
+
 	if (fail)
 		pr_warn("rslib: test failed\n");
 	else
@@ -0,0 +1,331 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Multi-threaded .xz Stream decoder
+ *
+ * xz -T compresses its input in independent Blocks and stores the
+ * compressed and uncompressed size of each in its Block Header. The Blocks
+ * of such a Stream can be located without decompressing anything, and then
+ * decoded in parallel on worker threads, each directly into an output
+ * buffer of its own. The Index and the Stream Footer are checked against
+ * the Block Headers before any output is produced, so that a Stream that
+ * can't be split this way can still be handed to the regular decoder.
+ */
+
+#include <linux/completion.h>
+#include <linux/cpumask.h>
+#include <linux/mm.h>
+#include <linux/workqueue.h>
+
+#include "xz_private.h"
+#include "xz_stream.h"
+
+/* Blocks being decoded or waiting to be flushed, per online CPU */
+#define XZ_MT_BLOCKS_PER_CPU 2
+
+/*
+ * Limit on the uncompressed size of the Blocks being decoded or waiting to
+ * be flushed, so that the output buffers stay small whatever the number of
+ * CPUs. A Stream with a larger Block is left to the regular decoder.
+ */
+#define XZ_MT_MAX_BYTES (64 << 20)
+
+/* Hash of the Block sizes, to compare the Block Headers with the Index */
+struct xz_mt_hash {
+	vli_type unpadded;
+	vli_type uncompressed;
+	uint32_t crc32;
+};
+
+struct xz_mt_block {
+	struct work_struct work;
+	struct completion done;
+
+	/* The whole Block, from the Block Header to the Check field */
+	const uint8_t *in;
+	size_t in_size;
+
+	/* Uncompressed data, allocated once the Block is queued */
+	uint8_t *out;
+	size_t out_size;
+
+	enum xz_check check;
+	enum xz_ret ret;
+};
+
+struct xz_mt_stream {
+	const uint8_t *in;
+	size_t in_size;
+
+	/* Check ID from the Stream Flags */
+	enum xz_check check;
+
+	/* Offset of the Index, and of the end of the Stream */
+	size_t index_pos;
+	size_t end;
+};
+
+/*
+ * Decode a variable-length integer from buf[*pos]. Returns false if it is
+ * truncated or not minimally encoded.
+ */
+static bool xz_mt_vli(const uint8_t *buf, size_t size, size_t *pos,
+		      vli_type *vli)
+{
+	uint32_t shift = 0;
+	uint8_t byte;
+
+	*vli = 0;
+	do {
+		if (*pos >= size || shift == 7 * VLI_BYTES_MAX)
+			return false;
+
+		byte = buf[(*pos)++];
+		*vli |= (vli_type)(byte & 0x7F) << shift;
+		shift += 7;
+	} while (byte & 0x80);
+
+	return byte != 0 || shift == 7;
+}
+
+static bool xz_mt_stream_header(struct xz_mt_stream *st)
+{
+	const uint8_t *in = st->in;
+
+	if (st->in_size < 2 * STREAM_HEADER_SIZE
+			|| !memeq(in, HEADER_MAGIC, HEADER_MAGIC_SIZE)
+			|| xz_crc32(in + HEADER_MAGIC_SIZE, 2, 0)
+				!= get_le32(in + HEADER_MAGIC_SIZE + 2)
+			|| in[HEADER_MAGIC_SIZE] != 0
+			|| in[HEADER_MAGIC_SIZE + 1] > XZ_CHECK_CRC32)
+		return false;
+
+	st->check = in[HEADER_MAGIC_SIZE + 1];
+	return true;
+}
+
+/*
+ * Locate the Blocks of the Stream and fill in blocks[] if it isn't NULL.
+ * Returns the number of Blocks, or zero if some Block Header doesn't store
+ * both sizes or doesn't look valid; in either case the Stream is left to
+ * the regular decoder, which also takes care of reporting corruption.
+ */
+static size_t xz_mt_walk(struct xz_mt_stream *st, struct xz_mt_block *blocks,
+			 struct xz_mt_hash *hash)
+{
+	uint32_t check_size = st->check == XZ_CHECK_CRC32 ? 4 : 0;
+	size_t pos = STREAM_HEADER_SIZE;
+	size_t count = 0;
+	size_t hdr_size, hdr_pos, size;
+	vli_type compressed, uncompressed;
+	const uint8_t *hdr;
+
+	memzero(hash, sizeof(*hash));
+
+	while (pos < st->in_size && st->in[pos] != 0) {
+		hdr = st->in + pos;
+		hdr_size = ((size_t)hdr[0] + 1) * 4;
+		if (st->in_size - pos < hdr_size
+				|| xz_crc32(hdr, hdr_size - 4, 0)
+					!= get_le32(hdr + hdr_size - 4))
+			return 0;
+
+		/* Both Compressed Size and Uncompressed Size are needed. */
+		if ((hdr[1] & 0xC0) != 0xC0)
+			return 0;
+
+		hdr_pos = 2;
+		if (!xz_mt_vli(hdr, hdr_size - 4, &hdr_pos, &compressed)
+				|| !xz_mt_vli(hdr, hdr_size - 4, &hdr_pos,
+					      &uncompressed))
+			return 0;
+
+		if (compressed > st->in_size - pos - hdr_size
+				|| uncompressed > XZ_MT_MAX_BYTES)
+			return 0;
+
+		size = round_up(hdr_size + compressed, 4) + check_size;
+		if (size > st->in_size - pos)
+			return 0;
+
+		if (blocks != NULL) {
+			blocks[count].in = hdr;
+			blocks[count].in_size = size;
+			blocks[count].out_size = uncompressed;
+			blocks[count].check = st->check;
+		}
+
+		hash->unpadded += hdr_size + compressed + check_size;
+		hash->uncompressed += uncompressed;
+		hash->crc32 = xz_crc32((const uint8_t *)hash, sizeof(*hash),
+				       hash->crc32);
+
+		pos += size;
+		++count;
+	}
+
+	st->index_pos = pos;
+	return count;
+}
+
+/*
+ * Validate the Index and the Stream Footer against the Block Headers, and
+ * find the end of the Stream.
+ */
+static bool xz_mt_check_index(struct xz_mt_stream *st, size_t count,
+			      const struct xz_mt_hash *blocks_hash)
+{
+	const uint8_t *in = st->in + st->index_pos;
+	size_t size = st->in_size - st->index_pos;
+	vli_type records, unpadded, uncompressed;
+	struct xz_mt_hash hash;
+	const uint8_t *footer;
+	size_t pos = 1;
+
+	/* The Block walk may have stopped at the end of the input. */
+	if (st->index_pos >= st->in_size)
+		return false;
+
+	if (!xz_mt_vli(in, size, &pos, &records) || records != count)
+		return false;
+
+	memzero(&hash, sizeof(hash));
+	while (records-- > 0) {
+		if (!xz_mt_vli(in, size, &pos, &unpadded)
+				|| !xz_mt_vli(in, size, &pos, &uncompressed))
+			return false;
+
+		hash.unpadded += unpadded;
+		hash.uncompressed += uncompressed;
+		hash.crc32 = xz_crc32((const uint8_t *)&hash, sizeof(hash),
+				      hash.crc32);
+	}
+
+	if (!memeq(&hash, blocks_hash, sizeof(hash)))
+		return false;
+
+	while (pos & 3)
+		if (pos == size || in[pos++] != 0)
+			return false;
+
+	if (size - pos < 4 + STREAM_HEADER_SIZE
+			|| xz_crc32(in, pos, 0) != get_le32(in + pos))
+		return false;
+
+	/* Backward Size counts the Index CRC32 too, minus one unit of 4. */
+	footer = in + pos + 4;
+	if (xz_crc32(footer + 4, 6, 0) != get_le32(footer)
+			|| get_le32(footer + 4) != pos / 4
+			|| !memeq(footer + 8, st->in + HEADER_MAGIC_SIZE, 2)
+			|| !memeq(footer + 10, FOOTER_MAGIC, FOOTER_MAGIC_SIZE))
+		return false;
+
+	st->end = st->index_pos + pos + 4 + STREAM_HEADER_SIZE;
+	return true;
+}
+
+static void xz_mt_work(struct work_struct *work)
+{
+	struct xz_mt_block *blk = container_of(work, struct xz_mt_block, work);
+	struct xz_buf b = {
+		.in = blk->in,
+		.in_size = blk->in_size,
+		.out = blk->out,
+		.out_size = blk->out_size,
+	};
+	struct xz_dec *s;
+
+	s = xz_dec_init(XZ_SINGLE, 0);
+	if (s == NULL) {
+		blk->ret = XZ_MEM_ERROR;
+	} else {
+		blk->ret = xz_dec_block_run(s, blk->check, &b);
+		if (blk->ret == XZ_STREAM_END && (b.in_pos != b.in_size
+				|| b.out_pos != b.out_size))
+			blk->ret = XZ_DATA_ERROR;
+
+		xz_dec_end(s);
+	}
+
+	complete(&blk->done);
+}
+
+static bool xz_mt_queue(struct xz_mt_block *blk)
+{
+	if (blk->out_size > 0) {
+		blk->out = vmalloc(blk->out_size);
+		if (blk->out == NULL)
+			return false;
+	}
+
+	init_completion(&blk->done);
+	INIT_WORK(&blk->work, xz_mt_work);
+	queue_work(system_unbound_wq, &blk->work);
+	return true;
+}
+
+enum xz_ret xz_dec_mt_run(const uint8_t *in, size_t in_size, size_t *in_used,
+			  long (*flush)(void *buf, unsigned long len))
+{
+	struct xz_mt_stream st = { .in = in, .in_size = in_size };
+	enum xz_ret ret = XZ_STREAM_END;
+	struct xz_mt_block *blocks;
+	struct xz_mt_hash hash;
+	size_t count, max, next, done, in_flight = 0;
+
+	if (num_online_cpus() < 2 || !xz_mt_stream_header(&st))
+		return XZ_OK;
+
+	count = xz_mt_walk(&st, NULL, &hash);
+	if (count < 2 || !xz_mt_check_index(&st, count, &hash))
+		return XZ_OK;
+
+	blocks = kvcalloc(count, sizeof(*blocks), GFP_KERNEL);
+	if (blocks == NULL)
+		return XZ_OK;
+
+	xz_mt_walk(&st, blocks, &hash);
+
+	/*
+	 * Blocks are flushed in order as they complete, and the next ones
+	 * are queued as the flushed ones are freed, as long as their output
+	 * fits in XZ_MT_MAX_BYTES. Once an error is seen, nothing more is
+	 * queued and the Blocks in flight are drained.
+	 */
+	max = num_online_cpus() * XZ_MT_BLOCKS_PER_CPU;
+	for (next = 0, done = 0; done < count; ++done) {
+		while (ret == XZ_STREAM_END && next < count
+				&& next - done < max
+				&& blocks[next].out_size
+					<= XZ_MT_MAX_BYTES - in_flight) {
+			if (!xz_mt_queue(&blocks[next])) {
+				if (next == done)
+					ret = XZ_MEM_ERROR;
+				break;
+			}
+			in_flight += blocks[next].out_size;
+			++next;
+		}
+
+		if (done == next)
+			break;
+
+		wait_for_completion(&blocks[done].done);
+		if (ret == XZ_STREAM_END)
+			ret = blocks[done].ret;
+
+		if (ret == XZ_STREAM_END && blocks[done].out_size > 0
+				&& flush(blocks[done].out, blocks[done].out_size)
+					!= blocks[done].out_size)
+			ret = XZ_BUF_ERROR;
+
+		vfree(blocks[done].out);
+		in_flight -= blocks[done].out_size;
+	}
+
+	kvfree(blocks);
+
+	if (ret == XZ_STREAM_END)
+		*in_used = st.end;
+
+	return ret;
+}
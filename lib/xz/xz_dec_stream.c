@@ -57,6 +57,11 @@ struct xz_dec {
 	 */
 	bool allow_buf_error;
 
+#ifdef XZ_DEC_MT
+	/* True if decoding stops after one Block, see xz_dec_block_run() */
+	bool single_block;
+#endif
+
 	/* Information stored in Block Header */
 	struct {
 		/*
@@ -666,6 +671,10 @@ static enum xz_ret dec_main(struct xz_dec *s, struct xz_buf *b)
 #endif
 
 			s->sequence = SEQ_BLOCK_START;
+#ifdef XZ_DEC_MT
+			if (s->single_block)
+				return XZ_STREAM_END;
+#endif
 			break;
 
 		case SEQ_INDEX:
@@ -783,6 +792,43 @@ XZ_EXTERN enum xz_ret xz_dec_run(struct xz_dec *s, struct xz_buf *b)
 	return ret;
 }
 
+#ifdef XZ_DEC_MT
+/*
+ * Decode one Block in single-call mode. b->in must hold the Block exactly,
+ * from the Block Header to the end of the Check field, and check is the
+ * Check ID from the Stream Flags of the Stream the Block belongs to.
+ *
+ * The Index isn't seen here, so the caller has to validate the Block sizes
+ * against it.
+ */
+enum xz_ret xz_dec_block_run(struct xz_dec *s, enum xz_check check,
+			     struct xz_buf *b)
+{
+	size_t in_start = b->in_pos;
+	size_t out_start = b->out_pos;
+	enum xz_ret ret;
+
+	if (!DEC_IS_SINGLE(s->mode) || check > XZ_CHECK_CRC32)
+		return XZ_OPTIONS_ERROR;
+
+	xz_dec_reset(s);
+	s->sequence = SEQ_BLOCK_START;
+	s->check_type = check;
+	s->single_block = true;
+
+	ret = dec_main(s, b);
+	if (ret == XZ_OK)
+		ret = b->in_pos == b->in_size ? XZ_DATA_ERROR : XZ_BUF_ERROR;
+
+	if (ret != XZ_STREAM_END) {
+		b->in_pos = in_start;
+		b->out_pos = out_start;
+	}
+
+	return ret;
+}
+#endif
+
 XZ_EXTERN struct xz_dec *xz_dec_init(enum xz_mode mode, uint32_t dict_max)
 {
 	struct xz_dec *s = kmalloc(sizeof(*s), GFP_KERNEL);
@@ -817,6 +863,9 @@ XZ_EXTERN void xz_dec_reset(struct xz_dec *s)
 {
 	s->sequence = SEQ_STREAM_HEADER;
 	s->allow_buf_error = false;
+#ifdef XZ_DEC_MT
+	s->single_block = false;
+#endif
 	s->pos = 0;
 	s->crc32 = 0;
 	memzero(&s->block, sizeof(s->block));
@@ -22,6 +22,10 @@ EXPORT_SYMBOL(xz_dec_microlzma_run);
 EXPORT_SYMBOL(xz_dec_microlzma_end);
 #endif
 
+#ifdef CONFIG_XZ_DEC_MT
+EXPORT_SYMBOL(xz_dec_mt_run);
+#endif
+
 MODULE_DESCRIPTION("XZ decompressor");
 MODULE_VERSION("1.1");
 MODULE_AUTHOR("Lasse Collin <lasse.collin@tukaani.org> and Igor Pavlov");
@@ -40,6 +40,9 @@
 #		ifdef CONFIG_XZ_DEC_MICROLZMA
 #			define XZ_DEC_MICROLZMA
 #		endif
+#		ifdef CONFIG_XZ_DEC_MT
+#			define XZ_DEC_MT
+#		endif
 #		define memeq(a, b, size) (memcmp(a, b, size) == 0)
 #		define memzero(buf, size) memset(buf, 0, size)
 #	endif
@@ -59,4 +59,10 @@ enum xz_check {
 /* Maximum possible Check ID */
 #define XZ_CHECK_MAX 15
 
+#ifdef XZ_DEC_MT
+/* Decode a single Block of a Stream, used by the multi-threaded decoder. */
+enum xz_ret xz_dec_block_run(struct xz_dec *s, enum xz_check check,
+			     struct xz_buf *b);
+#endif
+
 #endif
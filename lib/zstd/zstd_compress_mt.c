@@ -0,0 +1,235 @@
+// SPDX-License-Identifier: GPL-2.0+ OR BSD-3-Clause
+/*
+ * Multi-threaded compression for in-kernel users.
+ *
+ * The input is cut into fixed size chunks which are compressed into
+ * independent frames. Every chunk gets a slot of zstd_compress_bound(chunk)
+ * bytes in the destination buffer, so workers never have to coordinate
+ * where their output goes. Once all chunks are done the frames are packed
+ * together in order, which gives a regular multi-frame zstd stream.
+ *
+ * The calling thread compresses chunks too; the remaining workers run on
+ * the unbound system workqueue and pull chunk numbers from a shared
+ * counter, so a slow chunk does not hold back the others.
+ *
+ * The helpers are only an optimization. Once the caller runs out of chunks
+ * it cancels the workers that have not started yet, so it never waits for
+ * a kworker that may first have to be created, e.g. when compressing under
+ * memory pressure; at worst the caller compresses every chunk itself.
+ * Likewise, the helpers' workspaces and the per-chunk array are allocated
+ * with __GFP_NORETRY: without them, compression still works on fewer CPUs
+ * or as a single frame.
+ */
+
+#include <linux/cpumask.h>
+#include <linux/kernel.h>
+#include <linux/minmax.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/overflow.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/workqueue.h>
+#include <linux/zstd.h>
+
+#include "common/zstd_deps.h"
+#include "common/zstd_internal.h"
+
+#define ZSTD_MT_MIN_CHUNK_SIZE	(64 * 1024)
+#define ZSTD_MT_MAX_WORKERS	64
+
+struct zstd_mt_cctx;
+
+struct zstd_mt_worker {
+	struct work_struct work;
+	struct zstd_mt_cctx *mt;
+	zstd_cctx *cctx;
+	void *workspace;
+};
+
+struct zstd_mt_cctx {
+	zstd_parameters params;
+	size_t chunk_size;
+	size_t slot_size;
+	unsigned int nr_workers;
+
+	/* State of the compression in progress */
+	const u8 *src;
+	size_t src_size;
+	u8 *dst;
+	unsigned int nr_chunks;
+	atomic_t next_chunk;
+
+	/* Compressed size of each chunk, grown on demand */
+	size_t *chunk_sizes;
+	unsigned int max_chunks;
+
+	struct zstd_mt_worker workers[];
+};
+
+static void zstd_mt_run(struct zstd_mt_worker *w)
+{
+	struct zstd_mt_cctx *mt = w->mt;
+	unsigned int i;
+
+	while ((i = atomic_inc_return(&mt->next_chunk) - 1) < mt->nr_chunks) {
+		size_t offset = (size_t)i * mt->chunk_size;
+		size_t len = min(mt->chunk_size, mt->src_size - offset);
+
+		mt->chunk_sizes[i] = zstd_compress_cctx(w->cctx,
+				mt->dst + (size_t)i * mt->slot_size,
+				mt->slot_size, mt->src + offset, len,
+				&mt->params);
+	}
+}
+
+static void zstd_mt_workfn(struct work_struct *work)
+{
+	struct zstd_mt_worker *w = container_of(work, struct zstd_mt_worker,
+						work);
+
+	zstd_mt_run(w);
+}
+
+zstd_mt_cctx *zstd_init_mt_cctx(const zstd_parameters *parameters,
+	size_t chunk_size, unsigned int nr_workers)
+{
+	struct zstd_mt_cctx *mt;
+	size_t workspace_size;
+	unsigned int i;
+
+	if (!nr_workers)
+		nr_workers = num_online_cpus();
+	nr_workers = clamp(nr_workers, 1U, (unsigned int)ZSTD_MT_MAX_WORKERS);
+	chunk_size = max_t(size_t, chunk_size, ZSTD_MT_MIN_CHUNK_SIZE);
+
+	mt = kzalloc(struct_size(mt, workers, nr_workers), GFP_KERNEL);
+	if (!mt)
+		return NULL;
+
+	mt->params = *parameters;
+	mt->chunk_size = chunk_size;
+	mt->slot_size = zstd_compress_bound(chunk_size);
+	mt->nr_workers = nr_workers;
+
+	workspace_size = zstd_cctx_workspace_bound(&parameters->cParams);
+	for (i = 0; i < nr_workers; i++) {
+		struct zstd_mt_worker *w = &mt->workers[i];
+		/* Only the caller's own workspace is needed */
+		gfp_t gfp = i ? GFP_KERNEL | __GFP_NORETRY | __GFP_NOWARN :
+				GFP_KERNEL;
+
+		w->mt = mt;
+		INIT_WORK(&w->work, zstd_mt_workfn);
+		w->workspace = kvmalloc(workspace_size, gfp);
+		if (w->workspace)
+			w->cctx = zstd_init_cctx(w->workspace, workspace_size);
+		if (!w->cctx) {
+			if (!i)
+				goto err;
+			kvfree(w->workspace);
+			w->workspace = NULL;
+			mt->nr_workers = i;
+			break;
+		}
+	}
+	return mt;
+
+err:
+	zstd_free_mt_cctx(mt);
+	return NULL;
+}
+EXPORT_SYMBOL(zstd_init_mt_cctx);
+
+void zstd_free_mt_cctx(zstd_mt_cctx *mt)
+{
+	unsigned int i;
+
+	if (!mt)
+		return;
+	for (i = 0; i < mt->nr_workers; i++)
+		kvfree(mt->workers[i].workspace);
+	kfree(mt->chunk_sizes);
+	kfree(mt);
+}
+EXPORT_SYMBOL(zstd_free_mt_cctx);
+
+size_t zstd_mt_compress_bound(const zstd_mt_cctx *mt, size_t src_size)
+{
+	size_t nr_chunks = DIV_ROUND_UP(src_size, mt->chunk_size);
+	size_t bound;
+
+	if (nr_chunks <= 1)
+		return zstd_compress_bound(src_size);
+	if (check_mul_overflow(nr_chunks, mt->slot_size, &bound))
+		return SIZE_MAX;
+	return bound;
+}
+EXPORT_SYMBOL(zstd_mt_compress_bound);
+
+static int zstd_mt_reserve_chunks(struct zstd_mt_cctx *mt,
+				  unsigned int nr_chunks)
+{
+	size_t *sizes;
+
+	if (nr_chunks <= mt->max_chunks)
+		return 0;
+	sizes = krealloc_array(mt->chunk_sizes, nr_chunks, sizeof(*sizes),
+			       GFP_KERNEL | __GFP_NORETRY | __GFP_NOWARN);
+	if (!sizes)
+		return -ENOMEM;
+	mt->chunk_sizes = sizes;
+	mt->max_chunks = nr_chunks;
+	return 0;
+}
+
+size_t zstd_compress_mt(zstd_mt_cctx *mt, void *dst, size_t dst_capacity,
+	const void *src, size_t src_size)
+{
+	size_t nr_chunks = DIV_ROUND_UP(src_size, mt->chunk_size);
+	unsigned int nr_active, i;
+	size_t out = 0;
+
+	/*
+	 * Small inputs, or outputs too small to give every chunk its own
+	 * slot, are compressed as a single frame on this CPU.
+	 */
+	if (nr_chunks <= 1 || mt->nr_workers == 1 || nr_chunks > INT_MAX ||
+	    dst_capacity < zstd_mt_compress_bound(mt, src_size) ||
+	    zstd_mt_reserve_chunks(mt, nr_chunks))
+		return zstd_compress_cctx(mt->workers[0].cctx, dst,
+					  dst_capacity, src, src_size,
+					  &mt->params);
+
+	mt->src = src;
+	mt->src_size = src_size;
+	mt->dst = dst;
+	mt->nr_chunks = nr_chunks;
+	atomic_set(&mt->next_chunk, 0);
+
+	nr_active = min_t(size_t, mt->nr_workers, nr_chunks);
+	for (i = 1; i < nr_active; i++)
+		queue_work(system_unbound_wq, &mt->workers[i].work);
+
+	/*
+	 * All chunks have been claimed when this returns. Workers that have
+	 * not started are taken off the queue, the others are waited for.
+	 */
+	zstd_mt_run(&mt->workers[0]);
+	for (i = 1; i < nr_active; i++)
+		cancel_work_sync(&mt->workers[i].work);
+
+	/* Pack the frames; chunk 0 is already in place */
+	for (i = 0; i < nr_chunks; i++) {
+		size_t len = mt->chunk_sizes[i];
+
+		if (ZSTD_isError(len))
+			return len;
+		if (i)
+			memmove(mt->dst + out, mt->dst + (size_t)i * mt->slot_size,
+				len);
+		out += len;
+	}
+	return out;
+}
+EXPORT_SYMBOL(zstd_compress_mt);
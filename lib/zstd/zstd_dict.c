@@ -0,0 +1,250 @@
+// SPDX-License-Identifier: GPL-2.0+ OR BSD-3-Clause
+/*
+ * Shared dictionaries for in-kernel users.
+ *
+ * Small blocks such as 4 KiB pages compress poorly on their own, but well
+ * with a dictionary trained on similar data. Digesting a dictionary is
+ * expensive, so it is done once at registration time and the digested
+ * forms are shared by every user that looks the dictionary up by ID.
+ *
+ * Compression and decompression go through per-CPU contexts bound to the
+ * dictionary. The workspaces of every possible CPU are allocated when the
+ * dictionary is registered, so compressing never allocates memory and is
+ * safe on paths that run to free some. The contexts are protected by a
+ * mutex rather than by disabling preemption, so a caller that migrates
+ * while compressing only makes the next user of that CPU's context wait.
+ *
+ * The registry is part of the compression module, which must not depend on
+ * the decompression module. The decompression half is only built when that
+ * module is reachable from here, and zstd_dict_decompress() fails otherwise.
+ */
+
+#include <linux/err.h>
+#include <linux/kernel.h>
+#include <linux/kref.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/xarray.h>
+#include <linux/zstd.h>
+
+#include "common/zstd_deps.h"
+#include "common/zstd_internal.h"
+
+struct zstd_dict_ctx {
+	struct mutex lock;
+	void *cctx_workspace;
+	zstd_cctx *cctx;
+	void *dctx_workspace;
+	zstd_dctx *dctx;
+};
+
+struct zstd_dict {
+	struct kref ref;
+	unsigned int id;
+	void *content;
+	size_t size;
+	zstd_parameters params;
+	void *cdict_workspace;
+	const zstd_cdict *cdict;
+	void *ddict_workspace;
+	const zstd_ddict *ddict;
+	struct zstd_dict_ctx __percpu *ctx;
+};
+
+/*
+ * Protects zstd_dicts. zstd_dict_get() holds it from the lookup until it has
+ * taken its reference, so zstd_dict_unregister() cannot drop the registry's
+ * reference and free the dictionary in between.
+ */
+static DEFINE_MUTEX(zstd_dict_mutex);
+static DEFINE_XARRAY(zstd_dicts);
+
+#define ZSTD_DICT_HAS_DECOMPRESS IS_REACHABLE(CONFIG_ZSTD_DECOMPRESS)
+
+/* Same as zstd_get_dict_id(), which lives in the decompression module. */
+static unsigned int zstd_dict_read_id(const void *dict, size_t dict_size)
+{
+	if (dict_size < 8 || MEM_readLE32(dict) != ZSTD_MAGIC_DICTIONARY)
+		return 0;
+	return MEM_readLE32((const char *)dict + 4);
+}
+
+static void zstd_dict_free(struct zstd_dict *zd)
+{
+	int cpu;
+
+	if (zd->ctx) {
+		for_each_possible_cpu(cpu) {
+			struct zstd_dict_ctx *ctx = per_cpu_ptr(zd->ctx, cpu);
+
+			kvfree(ctx->cctx_workspace);
+			kvfree(ctx->dctx_workspace);
+		}
+		free_percpu(zd->ctx);
+	}
+	kvfree(zd->ddict_workspace);
+	kvfree(zd->cdict_workspace);
+	kvfree(zd->content);
+	kfree(zd);
+}
+
+static void zstd_dict_release(struct kref *ref)
+{
+	zstd_dict_free(container_of(ref, struct zstd_dict, ref));
+}
+
+struct zstd_dict *zstd_dict_register(const void *dict, size_t dict_size,
+	int level, size_t src_size)
+{
+	struct zstd_dict *zd;
+	size_t size;
+	int cpu, err;
+
+	if (!zstd_dict_read_id(dict, dict_size))
+		return ERR_PTR(-EINVAL);
+
+	zd = kzalloc(sizeof(*zd), GFP_KERNEL);
+	if (!zd)
+		return ERR_PTR(-ENOMEM);
+	kref_init(&zd->ref);
+
+	err = -ENOMEM;
+	zd->content = kvmalloc(dict_size, GFP_KERNEL);
+	if (!zd->content)
+		goto err;
+	memcpy(zd->content, dict, dict_size);
+	zd->size = dict_size;
+	zd->id = zstd_dict_read_id(zd->content, dict_size);
+	zd->params = zstd_get_params(level, src_size);
+
+	size = zstd_cdict_workspace_bound(dict_size, &zd->params.cParams);
+	zd->cdict_workspace = kvmalloc(size, GFP_KERNEL);
+	zd->cdict = zstd_init_cdict(zd->content, dict_size, &zd->params,
+				    zd->cdict_workspace, size);
+	if (!zd->cdict)
+		goto err;
+
+#if ZSTD_DICT_HAS_DECOMPRESS
+	size = zstd_ddict_workspace_bound(dict_size);
+	zd->ddict_workspace = kvmalloc(size, GFP_KERNEL);
+	zd->ddict = zstd_init_ddict(zd->content, dict_size,
+				    zd->ddict_workspace, size);
+	if (!zd->ddict)
+		goto err;
+#endif
+
+	zd->ctx = alloc_percpu(struct zstd_dict_ctx);
+	if (!zd->ctx)
+		goto err;
+	for_each_possible_cpu(cpu) {
+		struct zstd_dict_ctx *ctx = per_cpu_ptr(zd->ctx, cpu);
+		int node = cpu_to_node(cpu);
+
+		mutex_init(&ctx->lock);
+
+		size = zstd_cctx_workspace_bound(&zd->params.cParams);
+		ctx->cctx_workspace = kvmalloc_node(size, GFP_KERNEL, node);
+		ctx->cctx = zstd_init_cctx(ctx->cctx_workspace, size);
+		if (!ctx->cctx)
+			goto err;
+
+#if ZSTD_DICT_HAS_DECOMPRESS
+		size = zstd_dctx_workspace_bound();
+		ctx->dctx_workspace = kvmalloc_node(size, GFP_KERNEL, node);
+		ctx->dctx = zstd_init_dctx(ctx->dctx_workspace, size);
+		if (!ctx->dctx)
+			goto err;
+#endif
+	}
+
+	mutex_lock(&zstd_dict_mutex);
+	err = xa_insert(&zstd_dicts, zd->id, zd, GFP_KERNEL);
+	mutex_unlock(&zstd_dict_mutex);
+	if (err == -EBUSY)
+		err = -EEXIST;
+	if (err)
+		goto err;
+	return zd;
+
+err:
+	zstd_dict_free(zd);
+	return ERR_PTR(err);
+}
+EXPORT_SYMBOL(zstd_dict_register);
+
+void zstd_dict_unregister(struct zstd_dict *zd)
+{
+	mutex_lock(&zstd_dict_mutex);
+	xa_erase(&zstd_dicts, zd->id);
+	mutex_unlock(&zstd_dict_mutex);
+	zstd_dict_put(zd);
+}
+EXPORT_SYMBOL(zstd_dict_unregister);
+
+struct zstd_dict *zstd_dict_get(unsigned int id)
+{
+	struct zstd_dict *zd;
+
+	mutex_lock(&zstd_dict_mutex);
+	zd = xa_load(&zstd_dicts, id);
+	if (zd)
+		kref_get(&zd->ref);
+	mutex_unlock(&zstd_dict_mutex);
+	return zd;
+}
+EXPORT_SYMBOL(zstd_dict_get);
+
+void zstd_dict_put(struct zstd_dict *zd)
+{
+	if (zd)
+		kref_put(&zd->ref, zstd_dict_release);
+}
+EXPORT_SYMBOL(zstd_dict_put);
+
+unsigned int zstd_dict_id(const struct zstd_dict *zd)
+{
+	return zd->id;
+}
+EXPORT_SYMBOL(zstd_dict_id);
+
+static struct zstd_dict_ctx *zstd_dict_ctx_lock(struct zstd_dict *zd)
+{
+	struct zstd_dict_ctx *ctx = raw_cpu_ptr(zd->ctx);
+
+	mutex_lock(&ctx->lock);
+	return ctx;
+}
+
+size_t zstd_dict_compress(struct zstd_dict *zd, void *dst, size_t dst_capacity,
+	const void *src, size_t src_size)
+{
+	struct zstd_dict_ctx *ctx = zstd_dict_ctx_lock(zd);
+	size_t ret;
+
+	ret = zstd_compress_using_cdict(ctx->cctx, dst, dst_capacity,
+					src, src_size, zd->cdict);
+	mutex_unlock(&ctx->lock);
+	return ret;
+}
+EXPORT_SYMBOL(zstd_dict_compress);
+
+size_t zstd_dict_decompress(struct zstd_dict *zd, void *dst,
+	size_t dst_capacity, const void *src, size_t src_size)
+{
+#if ZSTD_DICT_HAS_DECOMPRESS
+	struct zstd_dict_ctx *ctx = zstd_dict_ctx_lock(zd);
+	size_t ret;
+
+	ret = zstd_decompress_using_ddict(ctx->dctx, dst, dst_capacity,
+					  src, src_size, zd->ddict);
+	mutex_unlock(&ctx->lock);
+	return ret;
+#else
+	return ERROR(GENERIC);
+#endif
+}
+EXPORT_SYMBOL(zstd_dict_decompress);
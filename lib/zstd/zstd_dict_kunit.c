@@ -0,0 +1,245 @@
+// SPDX-License-Identifier: GPL-2.0+ OR BSD-3-Clause
+/*
+ * KUnit tests for shared zstd dictionaries.
+ */
+
+#include <kunit/test.h>
+#include <linux/cpu.h>
+#include <linux/err.h>
+#include <linux/mm.h>
+#include <linux/string.h>
+#include <linux/workqueue.h>
+#include <linux/zstd.h>
+
+#define ZSTD_DICT_TEST_ID	0x4b504543U
+#define ZSTD_DICT_TEST_LEVEL	3
+#define ZSTD_DICT_TEST_SIZE	(64 * 1024)
+
+/*
+ * Trained with "zstd --train --maxdict=512 --dictID=1263551811" on 4 KiB
+ * samples of zstd_dict_fill() output.
+ */
+static const u8 zstd_dict_test_dict[] = {
+	0x37, 0xa4, 0x30, 0xec, 0x43, 0x45, 0x50, 0x4b, 0x09, 0x10, 0x10, 0xdf,
+	0x30, 0x33, 0x33, 0xb3, 0x77, 0x0a, 0x33, 0xf1, 0x78, 0x3c, 0x1e, 0x8f,
+	0xc7, 0xe3, 0xf1, 0x78, 0x3c, 0xcf, 0xf3, 0xbc, 0xf7, 0xd4, 0x42, 0x41,
+	0x41, 0x41, 0x41, 0x41, 0x41, 0x41, 0x41, 0x41, 0x41, 0x41, 0x41, 0x41,
+	0x41, 0x41, 0x41, 0x41, 0x41, 0x41, 0x41, 0x41, 0x41, 0x41, 0x41, 0x41,
+	0xa1, 0x50, 0x28, 0x14, 0x0a, 0x85, 0x42, 0xa1, 0x50, 0x28, 0x14, 0x0a,
+	0x85, 0xa2, 0x28, 0x8a, 0xa2, 0x28, 0x4a, 0x29, 0x7d, 0x74, 0xe1, 0xe1,
+	0xe1, 0xe1, 0xe1, 0xe1, 0xe1, 0xe1, 0xe1, 0xe1, 0xe1, 0xe1, 0xe1, 0xe1,
+	0xe1, 0xe1, 0xe1, 0xe1, 0xe1, 0xf1, 0x78, 0x3c, 0x1e, 0x8f, 0xc7, 0xe3,
+	0xf1, 0x78, 0x9e, 0xe7, 0x79, 0xef, 0x01, 0x01, 0x00, 0x00, 0x00, 0x04,
+	0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x65, 0x20, 0x7a, 0x6f, 0x6d,
+	0x62, 0x69, 0x65, 0x20, 0x70, 0x72, 0x69, 0x6f, 0x72, 0x6b, 0x65, 0x72,
+	0x2f, 0x31, 0x32, 0x3a, 0x30, 0x20, 0x73, 0x74, 0x61, 0x74, 0x65, 0x20,
+	0x72, 0x75, 0x6e, 0x6e, 0x69, 0x6e, 0x67, 0x20, 0x70, 0x72, 0x69, 0x6f,
+	0x20, 0x31, 0x32, 0x30, 0x0a, 0x70, 0x69, 0x64, 0x20, 0x32, 0x34, 0x39,
+	0x33, 0x31, 0x20, 0x63, 0x6f, 0x6d, 0x6d, 0x20, 0x6b, 0x20, 0x72, 0x75,
+	0x6e, 0x6e, 0x69, 0x6e, 0x67, 0x20, 0x70, 0x72, 0x69, 0x6f, 0x20, 0x31,
+	0x31, 0x32, 0x0a, 0x70, 0x69, 0x64, 0x20, 0x32, 0x36, 0x35, 0x31, 0x35,
+	0x20, 0x63, 0x6f, 0x6d, 0x6d, 0x20, 0x6b, 0x77, 0x6f, 0x72, 0x6b, 0x65,
+	0x72, 0x2f, 0x32, 0x39, 0x3a, 0x32, 0x20, 0x73, 0x74, 0x61, 0x74, 0x77,
+	0x6f, 0x72, 0x6b, 0x65, 0x72, 0x2f, 0x35, 0x38, 0x3a, 0x31, 0x20, 0x73,
+	0x74, 0x61, 0x74, 0x65, 0x20, 0x73, 0x74, 0x6f, 0x70, 0x70, 0x65, 0x64,
+	0x20, 0x70, 0x72, 0x69, 0x6f, 0x20, 0x31, 0x30, 0x32, 0x0a, 0x70, 0x69,
+	0x64, 0x20, 0x32, 0x35, 0x31, 0x37, 0x20, 0x63, 0x6f, 0x6d, 0x6d, 0x20,
+	0x6b, 0x6f, 0x72, 0x6b, 0x65, 0x72, 0x2f, 0x31, 0x3a, 0x32, 0x20, 0x73,
+	0x74, 0x61, 0x74, 0x65, 0x20, 0x73, 0x6c, 0x65, 0x65, 0x70, 0x69, 0x6e,
+	0x67, 0x20, 0x70, 0x72, 0x69, 0x6f, 0x20, 0x31, 0x31, 0x37, 0x0a, 0x70,
+	0x69, 0x64, 0x20, 0x31, 0x31, 0x37, 0x34, 0x32, 0x20, 0x63, 0x6f, 0x6d,
+	0x6d, 0x20, 0x6b, 0x77, 0x6f, 0x72, 0x6b, 0x65, 0x72, 0x2f, 0x36, 0x33,
+	0x3a, 0x30, 0x20, 0x73, 0x74, 0x61, 0x74, 0x65, 0x20, 0x7a, 0x6f, 0x6d,
+	0x62, 0x69, 0x65, 0x20, 0x70, 0x72, 0x69, 0x6f, 0x20, 0x31, 0x31, 0x35,
+	0x0a, 0x70, 0x69, 0x64, 0x20, 0x32, 0x38, 0x36, 0x30, 0x38, 0x20, 0x63,
+	0x6f, 0x6d, 0x6d, 0x20, 0x6b, 0x77, 0x6f, 0x72, 0x6b, 0x65, 0x72, 0x2f,
+	0x33, 0x31, 0x3a, 0x31, 0x20, 0x73, 0x74, 0x61, 0x74, 0x65, 0x20, 0x7a,
+	0x6f, 0x6d, 0x62, 0x69, 0x65, 0x20, 0x70, 0x72, 0x69, 0x6f, 0x20, 0x31,
+	0x33, 0x31, 0x0a, 0x70, 0x69, 0x64, 0x20, 0x32, 0x34, 0x30, 0x39, 0x36,
+	0x20, 0x63, 0x6f, 0x6d, 0x6d, 0x20, 0x6b, 0x32, 0x34, 0x20, 0x63, 0x6f,
+	0x6d, 0x6d, 0x20, 0x6b, 0x77, 0x6f, 0x72, 0x6b, 0x65, 0x72, 0x2f, 0x34,
+	0x30, 0x3a, 0x32, 0x20, 0x73, 0x74, 0x61, 0x74, 0x65, 0x20, 0x72, 0x75,
+	0x6e, 0x6e, 0x69, 0x6e, 0x67, 0x20, 0x70, 0x72, 0x69, 0x6f, 0x20, 0x31,
+	0x31, 0x36, 0x0a, 0x70, 0x69, 0x64, 0x20, 0x32, 0x35, 0x77, 0x6f, 0x72,
+	0x6b, 0x65, 0x72, 0x2f, 0x32, 0x32, 0x3a, 0x32, 0x20, 0x73, 0x74, 0x61,
+	0x74, 0x65, 0x20, 0x73, 0x74, 0x6f, 0x70, 0x70
+};
+
+/* Lines that look like the ones the dictionary was trained on */
+static void zstd_dict_fill(u8 *buf, size_t len)
+{
+	static const char * const states[] = {
+		"running", "sleeping", "stopped", "zombie",
+	};
+	unsigned int i = 0;
+	size_t pos = 0;
+	char line[80];
+	int n;
+
+	while (pos < len) {
+		n = scnprintf(line, sizeof(line),
+			      "pid %u comm kworker/%u:%u state %s prio %u\n",
+			      i * 7919 % 32768, i % 64, i % 3, states[i % 4],
+			      100 + i % 40);
+		n = min_t(size_t, n, len - pos);
+		memcpy(buf + pos, line, n);
+		pos += n;
+		i++;
+	}
+}
+
+static struct zstd_dict *zstd_dict_test_register(struct kunit *test)
+{
+	struct zstd_dict *zd;
+
+	zd = zstd_dict_register(zstd_dict_test_dict,
+				sizeof(zstd_dict_test_dict),
+				ZSTD_DICT_TEST_LEVEL, PAGE_SIZE);
+	KUNIT_ASSERT_FALSE(test, IS_ERR(zd));
+	return zd;
+}
+
+static void zstd_dict_check_roundtrip(struct kunit *test, struct zstd_dict *zd,
+				      const u8 *src, size_t src_size)
+{
+	size_t dst_cap = zstd_compress_bound(src_size);
+	u8 *dst = kvmalloc(dst_cap, GFP_KERNEL);
+	u8 *out = kvmalloc(src_size ?: 1, GFP_KERNEL);
+	size_t ret;
+
+	KUNIT_ASSERT_NOT_NULL(test, dst);
+	KUNIT_ASSERT_NOT_NULL(test, out);
+
+	ret = zstd_dict_compress(zd, dst, dst_cap, src, src_size);
+	KUNIT_ASSERT_FALSE(test, zstd_is_error(ret));
+
+	ret = zstd_dict_decompress(zd, out, src_size, dst, ret);
+	KUNIT_EXPECT_FALSE(test, zstd_is_error(ret));
+	KUNIT_EXPECT_EQ(test, ret, src_size);
+	KUNIT_EXPECT_EQ(test, memcmp(out, src, src_size), 0);
+
+	kvfree(out);
+	kvfree(dst);
+}
+
+static void zstd_dict_test_roundtrip(struct kunit *test)
+{
+	static const size_t sizes[] = {
+		0, 1, 100, PAGE_SIZE, ZSTD_DICT_TEST_SIZE,
+	};
+	struct zstd_dict *zd = zstd_dict_test_register(test);
+	u8 *src = kvmalloc(ZSTD_DICT_TEST_SIZE, GFP_KERNEL);
+	int i;
+
+	KUNIT_ASSERT_NOT_NULL(test, src);
+	zstd_dict_fill(src, ZSTD_DICT_TEST_SIZE);
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++)
+		zstd_dict_check_roundtrip(test, zd, src, sizes[i]);
+
+	kvfree(src);
+	zstd_dict_unregister(zd);
+}
+
+struct zstd_dict_test_work {
+	struct zstd_dict *zd;
+	const u8 *src;
+	u8 *dst;
+	u8 *out;
+};
+
+/* Runs on a worker, so it reports failures instead of asserting */
+static long zstd_dict_test_on_cpu(void *arg)
+{
+	struct zstd_dict_test_work *w = arg;
+	size_t dst_cap = zstd_compress_bound(PAGE_SIZE);
+	size_t ret;
+
+	ret = zstd_dict_compress(w->zd, w->dst, dst_cap, w->src, PAGE_SIZE);
+	if (zstd_is_error(ret))
+		return -EIO;
+	ret = zstd_dict_decompress(w->zd, w->out, PAGE_SIZE, w->dst, ret);
+	if (zstd_is_error(ret) || ret != PAGE_SIZE ||
+	    memcmp(w->out, w->src, PAGE_SIZE))
+		return -EIO;
+	return 0;
+}
+
+/* The contexts of every CPU were allocated at registration and work */
+static void zstd_dict_test_all_cpus(struct kunit *test)
+{
+	struct zstd_dict_test_work w = {};
+	u8 *src = kvmalloc(PAGE_SIZE, GFP_KERNEL);
+	int cpu;
+
+	w.dst = kvmalloc(zstd_compress_bound(PAGE_SIZE), GFP_KERNEL);
+	w.out = kvmalloc(PAGE_SIZE, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, src);
+	KUNIT_ASSERT_NOT_NULL(test, w.dst);
+	KUNIT_ASSERT_NOT_NULL(test, w.out);
+	zstd_dict_fill(src, PAGE_SIZE);
+	w.src = src;
+	w.zd = zstd_dict_test_register(test);
+
+	cpus_read_lock();
+	for_each_online_cpu(cpu)
+		KUNIT_EXPECT_EQ_MSG(test,
+				    work_on_cpu(cpu, zstd_dict_test_on_cpu, &w),
+				    0, "cpu %d", cpu);
+	cpus_read_unlock();
+
+	zstd_dict_unregister(w.zd);
+	kvfree(w.out);
+	kvfree(w.dst);
+	kvfree(src);
+}
+
+static void zstd_dict_test_registry(struct kunit *test)
+{
+	static const u8 raw[] = "no dictionary header";
+	struct zstd_dict *zd = zstd_dict_test_register(test);
+	struct zstd_dict *other, *gone;
+
+	KUNIT_EXPECT_EQ(test, zstd_dict_id(zd), ZSTD_DICT_TEST_ID);
+
+	other = zstd_dict_register(zstd_dict_test_dict,
+				   sizeof(zstd_dict_test_dict),
+				   ZSTD_DICT_TEST_LEVEL, PAGE_SIZE);
+	KUNIT_EXPECT_EQ(test, PTR_ERR(other), -EEXIST);
+
+	other = zstd_dict_register(raw, sizeof(raw), ZSTD_DICT_TEST_LEVEL,
+				   PAGE_SIZE);
+	KUNIT_EXPECT_EQ(test, PTR_ERR(other), -EINVAL);
+
+	other = zstd_dict_get(ZSTD_DICT_TEST_ID);
+	KUNIT_EXPECT_PTR_EQ(test, other, zd);
+
+	/* The reference taken by zstd_dict_get() outlives unregistration */
+	zstd_dict_unregister(zd);
+	gone = zstd_dict_get(ZSTD_DICT_TEST_ID);
+	KUNIT_EXPECT_PTR_EQ(test, gone, NULL);
+	zstd_dict_put(gone);
+	if (other) {
+		u8 src[64];
+
+		zstd_dict_fill(src, sizeof(src));
+		zstd_dict_check_roundtrip(test, other, src, sizeof(src));
+		zstd_dict_put(other);
+	}
+}
+
+static struct kunit_case zstd_dict_test_cases[] = {
+	KUNIT_CASE(zstd_dict_test_roundtrip),
+	KUNIT_CASE(zstd_dict_test_all_cpus),
+	KUNIT_CASE(zstd_dict_test_registry),
+	{}
+};
+
+static struct kunit_suite zstd_dict_test_suite = {
+	.name = "zstd_dict",
+	.test_cases = zstd_dict_test_cases,
+};
+
+kunit_test_suite(zstd_dict_test_suite);
+
+MODULE_LICENSE("Dual BSD/GPL");
@@ -0,0 +1,157 @@
+// SPDX-License-Identifier: GPL-2.0+ OR BSD-3-Clause
+/*
+ * KUnit tests and benchmark for multi-threaded zstd compression.
+ */
+
+#include <kunit/test.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/mm.h>
+#include <linux/random.h>
+#include <linux/zstd.h>
+
+#define ZSTD_MT_TEST_LEVEL	3
+#define ZSTD_MT_TEST_CHUNK	(256 * 1024)
+#define ZSTD_MT_TEST_SIZE	(8 * 1024 * 1024)
+
+/* Half compressible text-like data, half random bytes */
+static void zstd_mt_fill(u8 *buf, size_t len)
+{
+	static const char words[] = "the quick brown fox jumps over the lazy dog ";
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = words[(i * 7 + i / 4096) % (sizeof(words) - 1)];
+	for (i = 0; i < len; i += 8192)
+		get_random_bytes(buf + i, min_t(size_t, 4096, len - i));
+}
+
+static void *zstd_mt_test_alloc(struct kunit *test, size_t size)
+{
+	void *p = kvmalloc(size, GFP_KERNEL);
+
+	KUNIT_ASSERT_NOT_NULL(test, p);
+	return p;
+}
+
+static void zstd_mt_check_roundtrip(struct kunit *test, const u8 *src,
+				    size_t src_size, const u8 *dst,
+				    size_t dst_size)
+{
+	size_t wksp_size = zstd_dctx_workspace_bound();
+	void *wksp = zstd_mt_test_alloc(test, wksp_size);
+	u8 *out = zstd_mt_test_alloc(test, src_size);
+	zstd_dctx *dctx;
+	size_t ret;
+
+	dctx = zstd_init_dctx(wksp, wksp_size);
+	KUNIT_ASSERT_NOT_NULL(test, dctx);
+
+	ret = zstd_decompress_dctx(dctx, out, src_size, dst, dst_size);
+	KUNIT_EXPECT_FALSE(test, zstd_is_error(ret));
+	KUNIT_EXPECT_EQ(test, ret, src_size);
+	KUNIT_EXPECT_EQ(test, memcmp(out, src, src_size), 0);
+
+	kvfree(out);
+	kvfree(wksp);
+}
+
+static void zstd_mt_test_sizes(struct kunit *test)
+{
+	static const size_t sizes[] = {
+		0, 1, 4096, ZSTD_MT_TEST_CHUNK - 1, ZSTD_MT_TEST_CHUNK,
+		ZSTD_MT_TEST_CHUNK + 1, 5 * ZSTD_MT_TEST_CHUNK + 17,
+		ZSTD_MT_TEST_SIZE,
+	};
+	zstd_parameters params;
+	zstd_mt_cctx *mt;
+	size_t dst_cap, ret;
+	u8 *src, *dst;
+	int i;
+
+	params = zstd_get_params(ZSTD_MT_TEST_LEVEL, ZSTD_MT_TEST_CHUNK);
+	mt = zstd_init_mt_cctx(&params, ZSTD_MT_TEST_CHUNK, 4);
+	KUNIT_ASSERT_NOT_NULL(test, mt);
+
+	src = zstd_mt_test_alloc(test, ZSTD_MT_TEST_SIZE);
+	zstd_mt_fill(src, ZSTD_MT_TEST_SIZE);
+	dst_cap = zstd_mt_compress_bound(mt, ZSTD_MT_TEST_SIZE);
+	dst = zstd_mt_test_alloc(test, dst_cap);
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		ret = zstd_compress_mt(mt, dst, dst_cap, src, sizes[i]);
+		KUNIT_ASSERT_FALSE(test, zstd_is_error(ret));
+		zstd_mt_check_roundtrip(test, src, sizes[i], dst, ret);
+	}
+
+	/* A destination smaller than the parallel bound still works */
+	dst_cap = zstd_compress_bound(ZSTD_MT_TEST_SIZE);
+	ret = zstd_compress_mt(mt, dst, dst_cap, src, ZSTD_MT_TEST_SIZE);
+	KUNIT_ASSERT_FALSE(test, zstd_is_error(ret));
+	zstd_mt_check_roundtrip(test, src, ZSTD_MT_TEST_SIZE, dst, ret);
+
+	kvfree(dst);
+	kvfree(src);
+	zstd_free_mt_cctx(mt);
+}
+
+static u64 zstd_mt_time(zstd_mt_cctx *mt, u8 *dst, size_t dst_cap,
+			const u8 *src, size_t src_size, size_t *out)
+{
+	ktime_t start = ktime_get();
+
+	*out = zstd_compress_mt(mt, dst, dst_cap, src, src_size);
+	return ktime_to_ns(ktime_sub(ktime_get(), start)) ?: 1;
+}
+
+static void zstd_mt_benchmark(struct kunit *test)
+{
+	zstd_mt_cctx *single, *multi;
+	zstd_parameters params;
+	size_t dst_cap, ret1, retn;
+	u64 t1, tn;
+	u8 *src, *dst;
+
+	params = zstd_get_params(ZSTD_MT_TEST_LEVEL, ZSTD_MT_TEST_CHUNK);
+	single = zstd_init_mt_cctx(&params, ZSTD_MT_TEST_CHUNK, 1);
+	KUNIT_ASSERT_NOT_NULL(test, single);
+	multi = zstd_init_mt_cctx(&params, ZSTD_MT_TEST_CHUNK, 0);
+	KUNIT_ASSERT_NOT_NULL(test, multi);
+
+	src = zstd_mt_test_alloc(test, ZSTD_MT_TEST_SIZE);
+	zstd_mt_fill(src, ZSTD_MT_TEST_SIZE);
+	dst_cap = zstd_mt_compress_bound(multi, ZSTD_MT_TEST_SIZE);
+	dst = zstd_mt_test_alloc(test, dst_cap);
+
+	t1 = zstd_mt_time(single, dst, dst_cap, src, ZSTD_MT_TEST_SIZE, &ret1);
+	KUNIT_ASSERT_FALSE(test, zstd_is_error(ret1));
+	tn = zstd_mt_time(multi, dst, dst_cap, src, ZSTD_MT_TEST_SIZE, &retn);
+	KUNIT_ASSERT_FALSE(test, zstd_is_error(retn));
+	zstd_mt_check_roundtrip(test, src, ZSTD_MT_TEST_SIZE, dst, retn);
+
+	kunit_info(test, "%u MiB, level %d: 1 cpu %llu MB/s (%zu bytes), %u cpus %llu MB/s (%zu bytes)\n",
+		   ZSTD_MT_TEST_SIZE >> 20, ZSTD_MT_TEST_LEVEL,
+		   div64_u64((u64)ZSTD_MT_TEST_SIZE * 1000, t1), ret1,
+		   num_online_cpus(),
+		   div64_u64((u64)ZSTD_MT_TEST_SIZE * 1000, tn), retn);
+
+	kvfree(dst);
+	kvfree(src);
+	zstd_free_mt_cctx(multi);
+	zstd_free_mt_cctx(single);
+}
+
+static struct kunit_case zstd_mt_test_cases[] = {
+	KUNIT_CASE(zstd_mt_test_sizes),
+	KUNIT_CASE(zstd_mt_benchmark),
+	{}
+};
+
+static struct kunit_suite zstd_mt_test_suite = {
+	.name = "zstd_mt",
+	.test_cases = zstd_mt_test_cases,
+};
+
+kunit_test_suite(zstd_mt_test_suite);
+
+MODULE_LICENSE("Dual BSD/GPL");
@@ -236,6 +236,14 @@ static void set_in_bvec(struct ceph_connection *con, const struct bio_vec *bv)
 	iov_iter_bvec(&con->v2.in_iter, ITER_DEST, &con->v2.in_bvec, 1, bv->bv_len);
 }
 
+static void set_in_bvecs(struct ceph_connection *con,
+			 const struct bio_vec *bvecs, int bvec_cnt, int len)
+{
+	WARN_ON(iov_iter_count(&con->v2.in_iter));
+
+	iov_iter_bvec(&con->v2.in_iter, ITER_DEST, bvecs, bvec_cnt, len);
+}
+
 static void set_in_skip(struct ceph_connection *con, int len)
 {
 	WARN_ON(iov_iter_count(&con->v2.in_iter));
@@ -1007,6 +1015,129 @@ static int setup_message_sgs(struct sg_table *sgt, struct ceph_msg *msg,
 	return 0;
 }
 
+static void set_bvec_buf(struct bio_vec **bv, void *buf, int buf_len)
+{
+	(*bv)->bv_page = virt_to_page(buf);
+	(*bv)->bv_offset = offset_in_page(buf);
+	(*bv)->bv_len = buf_len;
+	(*bv)++;
+}
+
+/*
+ * Same layout as init_sgs(), but as bvecs so that the ciphertext
+ * can be received directly into the buffer.
+ */
+static void init_bvecs(struct bio_vec **bv, void *buf, int buf_len, u8 *pad)
+{
+	void *end = buf + buf_len;
+	int len;
+	void *p;
+
+	if (!buf_len)
+		return;
+
+	if (is_vmalloc_addr(buf)) {
+		p = buf;
+		do {
+			len = min_t(int, end - p, PAGE_SIZE);
+			WARN_ON(!len || offset_in_page(p));
+			(*bv)->bv_page = vmalloc_to_page(p);
+			(*bv)->bv_offset = 0;
+			(*bv)->bv_len = len;
+			(*bv)++;
+			p += len;
+		} while (p != end);
+	} else {
+		set_bvec_buf(bv, buf, buf_len);
+	}
+
+	if (need_padding(buf_len))
+		set_bvec_buf(bv, pad, padding_len(buf_len));
+}
+
+static void init_bvecs_cursor(struct bio_vec **bv,
+			      struct ceph_msg_data_cursor *cursor, u8 *pad)
+{
+	int data_len = cursor->total_resid;
+
+	if (!data_len)
+		return;
+
+	do {
+		get_bvec_at(cursor, *bv);
+		ceph_msg_data_advance(cursor, (*bv)->bv_len);
+		(*bv)++;
+	} while (cursor->total_resid);
+
+	if (need_padding(data_len))
+		set_bvec_buf(bv, pad, padding_len(data_len));
+}
+
+/*
+ * Describe front, middle and data segments of @msg, each followed
+ * by its padding, and epilogue + auth tag as an array of bvecs.
+ * This mirrors the layout that setup_message_sgs() produces.
+ */
+static struct bio_vec *setup_message_bvecs(struct ceph_msg *msg,
+					   u8 *front_pad, u8 *middle_pad,
+					   u8 *data_pad, void *epilogue,
+					   int *bvec_cnt)
+{
+	struct ceph_msg_data_cursor cursor;
+	struct bio_vec *bvecs, *cur_bv;
+	int cnt;
+
+	cnt = 1;  /* epilogue + auth tag */
+	if (front_len(msg))
+		cnt += calc_sg_cnt(msg->front.iov_base, front_len(msg));
+	if (middle_len(msg))
+		cnt += calc_sg_cnt(msg->middle->vec.iov_base,
+				   middle_len(msg));
+	if (data_len(msg)) {
+		ceph_msg_data_cursor_init(&cursor, msg, data_len(msg));
+		cnt += calc_sg_cnt_cursor(&cursor);
+	}
+
+	bvecs = kvmalloc_array(cnt, sizeof(*bvecs), GFP_NOIO);
+	if (!bvecs)
+		return NULL;
+
+	cur_bv = bvecs;
+	if (front_len(msg))
+		init_bvecs(&cur_bv, msg->front.iov_base, front_len(msg),
+			   front_pad);
+	if (middle_len(msg))
+		init_bvecs(&cur_bv, msg->middle->vec.iov_base,
+			   middle_len(msg), middle_pad);
+	if (data_len(msg)) {
+		ceph_msg_data_cursor_init(&cursor, msg, data_len(msg));
+		init_bvecs_cursor(&cur_bv, &cursor, data_pad);
+	}
+
+	WARN_ON(cur_bv != bvecs + cnt - 1);
+	set_bvec_buf(&cur_bv, epilogue, CEPH_EPILOGUE_SECURE_LEN);
+
+	*bvec_cnt = cnt;
+	return bvecs;
+}
+
+static void free_in_enc_bufs(struct ceph_connection *con)
+{
+	if (con->v2.in_enc_pages) {
+		WARN_ON(!con->v2.in_enc_page_cnt);
+		ceph_release_page_vector(con->v2.in_enc_pages,
+					 con->v2.in_enc_page_cnt);
+		con->v2.in_enc_pages = NULL;
+		con->v2.in_enc_page_cnt = 0;
+	}
+	if (con->v2.in_enc_bvecs) {
+		WARN_ON(!con->v2.in_enc_bvec_cnt);
+		kvfree(con->v2.in_enc_bvecs);
+		con->v2.in_enc_bvecs = NULL;
+		con->v2.in_enc_bvec_cnt = 0;
+	}
+}
+
 static int decrypt_preamble(struct ceph_connection *con)
 {
 	struct scatterlist sg;
@@ -1033,6 +1164,37 @@ static int decrypt_control_remainder(struct ceph_connection *con)
 			 padded_len(rem_len) + CEPH_GCM_TAG_LEN);
 }
 
+/*
+ * The ciphertext was received directly into in_msg buffers (and
+ * in_buf for paddings and epilogue), decrypt it there with a single
+ * request.
+ */
+static int decrypt_tail_in_place(struct ceph_connection *con, int tail_len)
+{
+	struct bio_vec *bvecs = con->v2.in_enc_bvecs;
+	struct sg_table sgt = {};
+	struct scatterlist *sg;
+	int ret;
+	int i;
+
+	ret = sg_alloc_table(&sgt, con->v2.in_enc_bvec_cnt, GFP_NOIO);
+	if (ret)
+		return ret;
+
+	for_each_sg(sgt.sgl, sg, sgt.orig_nents, i)
+		sg_set_page(sg, bvecs[i].bv_page, bvecs[i].bv_len,
+			    bvecs[i].bv_offset);
+
+	dout("%s con %p msg %p sg_cnt %d\n", __func__, con, con->in_msg,
+	     sgt.orig_nents);
+	ret = gcm_crypt(con, false, sgt.sgl, sgt.sgl, tail_len);
+	if (!ret)
+		free_in_enc_bufs(con);
+
+	sg_free_table(&sgt);
+	return ret;
+}
+
 static int decrypt_tail(struct ceph_connection *con)
 {
 	struct sg_table enc_sgt = {};
@@ -1041,6 +1203,9 @@ static int decrypt_tail(struct ceph_connection *con)
 	int ret;
 
 	tail_len = tail_onwire_len(con->in_msg, true);
+	if (con->v2.in_enc_bvecs)
+		return decrypt_tail_in_place(con, tail_len);
+
 	ret = sg_alloc_table_from_pages(&enc_sgt, con->v2.in_enc_pages,
 					con->v2.in_enc_page_cnt, 0, tail_len,
 					GFP_NOIO);
@@ -1059,11 +1224,7 @@ static int decrypt_tail(struct ceph_connection *con)
 	if (ret)
 		goto out;
 
-	WARN_ON(!con->v2.in_enc_page_cnt);
-	ceph_release_page_vector(con->v2.in_enc_pages,
-				 con->v2.in_enc_page_cnt);
-	con->v2.in_enc_pages = NULL;
-	con->v2.in_enc_page_cnt = 0;
+	free_in_enc_bufs(con);
 
 out:
 	sg_free_table(&sgt);
@@ -1753,15 +1914,90 @@ static int prepare_read_control_remainder(struct ceph_connection *con)
 	return 0;
 }
 
-static int prepare_read_data(struct ceph_connection *con)
+/*
+ * Pieces that are physically contiguous and belong to the same
+ * (possibly large) folio can be received with a single bvec.
+ */
+static bool in_data_bvec_mergeable(const struct bio_vec *prev,
+				   const struct bio_vec *bv)
+{
+	if (page_folio(prev->bv_page) != page_folio(bv->bv_page))
+		return false;
+
+	return page_to_phys(prev->bv_page) + prev->bv_offset +
+	       prev->bv_len == page_to_phys(bv->bv_page) + bv->bv_offset;
+}
+
+/*
+ * Set up recvmsg directly into the destination pages, covering up
+ * to CEPH_IN_DATA_BVEC_CNT bvecs worth of data at once.  in_cursor
+ * is advanced past everything that is set up here.
+ */
+static void prepare_read_data_batch(struct ceph_connection *con)
+{
+	struct bio_vec *bvecs = con->v2.in_data_bvecs;
+	struct bio_vec bv;
+	int bvec_cnt = 0;
+	int len = 0;
+
+	do {
+		get_bvec_at(&con->v2.in_cursor, &bv);
+		if (bvec_cnt && in_data_bvec_mergeable(&bvecs[bvec_cnt - 1],
+							&bv)) {
+			bvecs[bvec_cnt - 1].bv_len += bv.bv_len;
+		} else {
+			if (bvec_cnt == ARRAY_SIZE(con->v2.in_data_bvecs))
+				break;
+			bvecs[bvec_cnt++] = bv;
+		}
+
+		len += bv.bv_len;
+		ceph_msg_data_advance(&con->v2.in_cursor, bv.bv_len);
+	} while (con->v2.in_cursor.total_resid);
+
+	dout("%s con %p bvec_cnt %d len %d\n", __func__, con, bvec_cnt, len);
+	con->v2.in_data_bvec_cnt = bvec_cnt;
+	set_in_bvecs(con, bvecs, bvec_cnt, len);
+}
+
+static void prepare_read_data_piece(struct ceph_connection *con)
 {
 	struct bio_vec bv;
 
+	if (ceph_test_opt(from_msgr(con->msgr), RXBOUNCE)) {
+		get_bvec_at(&con->v2.in_cursor, &bv);
+		bv.bv_page = con->bounce_page;
+		bv.bv_offset = 0;
+		set_in_bvec(con, &bv);
+	} else {
+		prepare_read_data_batch(con);
+	}
+}
+
+static u32 crc32c_bvec(u32 crc, const struct bio_vec *bv)
+{
+	unsigned int off = bv->bv_offset;
+	unsigned int resid = bv->bv_len;
+	unsigned int len;
+
+	while (resid) {
+		len = min_t(unsigned int, resid,
+			    PAGE_SIZE - offset_in_page(off));
+		crc = ceph_crc32c_page(crc, bv->bv_page + (off >> PAGE_SHIFT),
+				       offset_in_page(off), len);
+		off += len;
+		resid -= len;
+	}
+
+	return crc;
+}
+
+static int prepare_read_data(struct ceph_connection *con)
+{
 	con->in_data_crc = -1;
 	ceph_msg_data_cursor_init(&con->v2.in_cursor, con->in_msg,
 				  data_len(con->in_msg));
 
-	get_bvec_at(&con->v2.in_cursor, &bv);
 	if (ceph_test_opt(from_msgr(con->msgr), RXBOUNCE)) {
 		if (unlikely(!con->bounce_page)) {
 			con->bounce_page = alloc_page(GFP_NOIO);
@@ -1770,11 +2006,9 @@ static int prepare_read_data(struct ceph_connection *con)
 				return -ENOMEM;
 			}
 		}
-
-		bv.bv_page = con->bounce_page;
-		bv.bv_offset = 0;
 	}
-	set_in_bvec(con, &bv);
+
+	prepare_read_data_piece(con);
 	con->v2.in_state = IN_S_PREPARE_READ_DATA_CONT;
 	return 0;
 }
@@ -1782,6 +2016,7 @@ static int prepare_read_data(struct ceph_connection *con)
 static void prepare_read_data_cont(struct ceph_connection *con)
 {
 	struct bio_vec bv;
+	int i;
 
 	if (ceph_test_opt(from_msgr(con->msgr), RXBOUNCE)) {
 		con->in_data_crc = crc32c(con->in_data_crc,
@@ -1792,21 +2027,17 @@ static void prepare_read_data_cont(struct ceph_connection *con)
 		memcpy_to_page(bv.bv_page, bv.bv_offset,
 			       page_address(con->bounce_page),
 			       con->v2.in_bvec.bv_len);
+		ceph_msg_data_advance(&con->v2.in_cursor,
+				      con->v2.in_bvec.bv_len);
 	} else {
-		con->in_data_crc = ceph_crc32c_page(con->in_data_crc,
-						    con->v2.in_bvec.bv_page,
-						    con->v2.in_bvec.bv_offset,
-						    con->v2.in_bvec.bv_len);
+		/* in_cursor was advanced in prepare_read_data_batch() */
+		for (i = 0; i < con->v2.in_data_bvec_cnt; i++)
+			con->in_data_crc = crc32c_bvec(con->in_data_crc,
+						&con->v2.in_data_bvecs[i]);
 	}
 
-	ceph_msg_data_advance(&con->v2.in_cursor, con->v2.in_bvec.bv_len);
 	if (con->v2.in_cursor.total_resid) {
-		get_bvec_at(&con->v2.in_cursor, &bv);
-		if (ceph_test_opt(from_msgr(con->msgr), RXBOUNCE)) {
-			bv.bv_page = con->bounce_page;
-			bv.bv_offset = 0;
-		}
-		set_in_bvec(con, &bv);
+		prepare_read_data_piece(con);
 		WARN_ON(con->v2.in_state != IN_S_PREPARE_READ_DATA_CONT);
 		return;
 	}
@@ -1876,6 +2107,36 @@ static void prepare_read_enc_page(struct ceph_connection *con)
 	con->v2.in_state = IN_S_HANDLE_EPILOGUE;
 }
 
+/*
+ * Receive the ciphertext directly into in_msg buffers, to be
+ * decrypted in place once the auth tag is in.  Paddings and
+ * epilogue go to in_buf, just like with decrypt_tail() from
+ * in_enc_pages.
+ */
+static int prepare_read_tail_secure_in_place(struct ceph_connection *con,
+					     int tail_len)
+{
+	struct bio_vec *bvecs;
+	int bvec_cnt;
+
+	bvecs = setup_message_bvecs(con->in_msg, FRONT_PAD(con->v2.in_buf),
+				    MIDDLE_PAD(con->v2.in_buf),
+				    DATA_PAD(con->v2.in_buf), con->v2.in_buf,
+				    &bvec_cnt);
+	if (!bvecs)
+		return -ENOMEM;
+
+	dout("%s con %p msg %p bvec_cnt %d tail_len %d\n", __func__, con,
+	     con->in_msg, bvec_cnt, tail_len);
+	WARN_ON(con->v2.in_enc_bvecs || con->v2.in_enc_bvec_cnt);
+	con->v2.in_enc_bvecs = bvecs;
+	con->v2.in_enc_bvec_cnt = bvec_cnt;
+
+	set_in_bvecs(con, bvecs, bvec_cnt, tail_len);
+	con->v2.in_state = IN_S_HANDLE_EPILOGUE;
+	return 0;
+}
+
 static int prepare_read_tail_secure(struct ceph_connection *con)
 {
 	struct page **enc_pages;
@@ -1885,6 +2146,14 @@ static int prepare_read_tail_secure(struct ceph_connection *con)
 	tail_len = tail_onwire_len(con->in_msg, true);
 	WARN_ON(!tail_len);
 
+	/*
+	 * With rxbounce, in_msg buffers may change under us (e.g.
+	 * O_DIRECT from a guest that reuses the buffer before the read
+	 * completes), so the ciphertext goes to private pages.
+	 */
+	if (!ceph_test_opt(from_msgr(con->msgr), RXBOUNCE))
+		return prepare_read_tail_secure_in_place(con, tail_len);
+
 	enc_page_cnt = calc_pages_for(0, tail_len);
 	enc_pages = ceph_alloc_page_vector(enc_page_cnt, GFP_NOIO);
 	if (IS_ERR(enc_pages))
@@ -2851,8 +3120,10 @@ static void finish_skip(struct ceph_connection *con)
 {
 	dout("%s con %p\n", __func__, con);
 
-	if (con_secure(con))
+	if (con_secure(con)) {
 		gcm_inc_nonce(&con->v2.in_gcm_nonce);
+		free_in_enc_bufs(con);
+	}
 
 	__finish_skip(con);
 }
@@ -3446,26 +3717,36 @@ static void revoke_at_prepare_read_data(struct ceph_connection *con)
 
 static void revoke_at_prepare_read_data_cont(struct ceph_connection *con)
 {
-	int recved, resid;  /* current piece of data */
+	int recved, resid;  /* current piece (or batch) of data */
 	int remaining;
 
 	WARN_ON(con_secure(con));
 	WARN_ON(!data_len(con->in_msg));
 	WARN_ON(!iov_iter_is_bvec(&con->v2.in_iter));
 	resid = iov_iter_count(&con->v2.in_iter);
-	WARN_ON(!resid || resid > con->v2.in_bvec.bv_len);
-	recved = con->v2.in_bvec.bv_len - resid;
-	dout("%s con %p recved %d resid %d\n", __func__, con, recved, resid);
+	WARN_ON(!resid);
 
-	if (recved)
-		ceph_msg_data_advance(&con->v2.in_cursor, recved);
-	WARN_ON(resid > con->v2.in_cursor.total_resid);
+	if (ceph_test_opt(from_msgr(con->msgr), RXBOUNCE)) {
+		WARN_ON(resid > con->v2.in_bvec.bv_len);
+		recved = con->v2.in_bvec.bv_len - resid;
+		dout("%s con %p recved %d resid %d\n", __func__, con, recved,
+		     resid);
+
+		if (recved)
+			ceph_msg_data_advance(&con->v2.in_cursor, recved);
+		WARN_ON(resid > con->v2.in_cursor.total_resid);
+		remaining = con->v2.in_cursor.total_resid;
+	} else {
+		/* in_cursor is already past the current batch */
+		dout("%s con %p resid %d\n", __func__, con, resid);
+		remaining = resid + con->v2.in_cursor.total_resid;
+	}
 
-	remaining = CEPH_EPILOGUE_PLAIN_LEN;
+	remaining += CEPH_EPILOGUE_PLAIN_LEN;
 	dout("%s con %p total_resid %zu remaining %d\n", __func__, con,
 	     con->v2.in_cursor.total_resid, remaining);
 	con->v2.in_iter.count -= resid;
-	set_in_skip(con, con->v2.in_cursor.total_resid + remaining);
+	set_in_skip(con, remaining);
 	con->v2.in_state = IN_S_FINISH_SKIP;
 }
 
@@ -3543,13 +3824,7 @@ void ceph_con_v2_reset_protocol(struct ceph_connection *con)
 	clear_out_sign_kvecs(con);
 	free_conn_bufs(con);
 
-	if (con->v2.in_enc_pages) {
-		WARN_ON(!con->v2.in_enc_page_cnt);
-		ceph_release_page_vector(con->v2.in_enc_pages,
-					 con->v2.in_enc_page_cnt);
-		con->v2.in_enc_pages = NULL;
-		con->v2.in_enc_page_cnt = 0;
-	}
+	free_in_enc_bufs(con);
 	if (con->v2.out_enc_pages) {
 		WARN_ON(!con->v2.out_enc_page_cnt);
 		ceph_release_page_vector(con->v2.out_enc_pages,
@@ -573,14 +573,18 @@ void tipc_bearer_xmit(struct net *net, u32 bearer_id,
 {
 	struct tipc_bearer *b;
 	struct sk_buff *skb, *tmp;
+	struct sk_buff_head sendq;
 
 	if (skb_queue_empty(xmitq))
 		return;
 
+	__skb_queue_head_init(&sendq);
 	rcu_read_lock();
 	b = bearer_get(net, bearer_id);
-	if (unlikely(!b))
+	if (unlikely(!b)) {
 		__skb_queue_purge(xmitq);
+		goto exit;
+	}
 	skb_queue_walk_safe(xmitq, skb, tmp) {
 		__skb_dequeue(xmitq);
 		if (likely(test_bit(0, &b->up) || msg_is_reset(buf_msg(skb)))) {
@@ -588,11 +592,21 @@ void tipc_bearer_xmit(struct net *net, u32 bearer_id,
 			tipc_crypto_xmit(net, &skb, b, dst, __dnode);
 			if (skb)
 #endif
-				b->media->send_msg(net, skb, b, dst);
+				__skb_queue_tail(&sendq, skb);
 		} else {
 			kfree_skb(skb);
 		}
 	}
+
+	/* Let the media send the whole burst in one go if it can */
+	if (b->media->send_batch) {
+		if (!skb_queue_empty(&sendq))
+			b->media->send_batch(net, &sendq, b, dst);
+	} else {
+		while ((skb = __skb_dequeue(&sendq)))
+			b->media->send_msg(net, skb, b, dst);
+	}
+exit:
 	rcu_read_unlock();
 }
 
@@ -38,6 +38,7 @@
 #include <net/sock.h>
 #include <linux/list_sort.h>
 #include <linux/rbtree_augmented.h>
+#include <linux/jhash.h>
 #include "core.h"
 #include "netlink.h"
 #include "name_table.h"
@@ -220,6 +221,56 @@ static int hash(int x)
 	return x & (TIPC_NAMETBL_SIZE - 1);
 }
 
+/* Any change of a publication invalidates all cached lookup results */
+static void tipc_nametbl_invalidate(struct net *net)
+{
+	atomic_inc(&tipc_name_table(net)->gen);
+}
+
+static struct tipc_lookup_cache_entry *
+tipc_lookup_cache_entry(struct name_table *nt, u32 type, u32 inst, u32 node)
+{
+	u32 idx = jhash_3words(type, inst, node, 0);
+
+	return &this_cpu_ptr(nt->lookup_cache)->entries[idx &
+					(TIPC_LOOKUP_CACHE_SIZE - 1)];
+}
+
+static bool tipc_lookup_cache_get(struct net *net, u32 type, u32 inst,
+				  u32 self, struct tipc_socket_addr *sk)
+{
+	struct name_table *nt = tipc_name_table(net);
+	struct tipc_lookup_cache_entry *e;
+	bool hit = false;
+
+	local_bh_disable();
+	e = tipc_lookup_cache_entry(nt, type, inst, sk->node);
+	if (e->gen == atomic_read(&nt->gen) && e->type == type &&
+	    e->instance == inst && e->node == sk->node && e->self == self) {
+		*sk = e->sk;
+		hit = true;
+	}
+	local_bh_enable();
+	return hit;
+}
+
+/* Caller holds the service lock, so bottom halves are disabled */
+static void tipc_lookup_cache_set(struct net *net, u32 type, u32 inst,
+				  u32 node, u32 self,
+				  struct tipc_socket_addr *sk)
+{
+	struct name_table *nt = tipc_name_table(net);
+	struct tipc_lookup_cache_entry *e;
+
+	e = tipc_lookup_cache_entry(nt, type, inst, node);
+	e->type = type;
+	e->instance = inst;
+	e->node = node;
+	e->self = self;
+	e->sk = *sk;
+	e->gen = atomic_read(&nt->gen);
+}
+
 /**
  * tipc_publ_create - create a publication structure
  * @ua: the service range the user is binding to
@@ -360,6 +411,7 @@ static bool tipc_service_insert_publ(struct net *net,
 		list_add(&p->local_publ, &sr->local_publ);
 	list_add(&p->all_publ, &sr->all_publ);
 	p->id = sc->publ_cnt++;
+	tipc_nametbl_invalidate(net);
 
 	/* Any subscriptions waiting for notification?  */
 	list_for_each_entry_safe(sub, tmp, &sc->subscriptions, service_list) {
@@ -516,6 +568,7 @@ struct publication *tipc_nametbl_remove_publ(struct net *net,
 	p = tipc_service_remove_publ(sr, sk, key);
 	if (!p)
 		goto unlock;
+	tipc_nametbl_invalidate(net);
 
 	/* Notify any waiting subscriptions */
 	last = list_empty(&sr->all_publ);
@@ -565,6 +618,10 @@ struct publication *tipc_nametbl_remove_publ(struct net *net,
  * Note that for legacy users (node configured with Z.C.N address format) the
  * 'closest-first' lookup algorithm must be maintained, i.e., if sk.node is 0
  * we must look in the local binding list first
+ *
+ * Results are cached per cpu when the selected binding list holds a single
+ * publication, since round-robin selection would pick it again anyway. The
+ * cache is invalidated whenever a publication is added or removed.
  */
 bool tipc_nametbl_lookup_anycast(struct net *net,
 				 struct tipc_uaddr *ua,
@@ -574,6 +631,7 @@ bool tipc_nametbl_lookup_anycast(struct net *net,
 	bool legacy = tn->legacy_addr_format;
 	u32 self = tipc_own_addr(net);
 	u32 inst = ua->sa.instance;
+	u32 node = sk->node;
 	struct service_range *r;
 	struct tipc_service *sc;
 	struct publication *p;
@@ -583,6 +641,9 @@ bool tipc_nametbl_lookup_anycast(struct net *net,
 	if (!tipc_in_scope(legacy, sk->node, self))
 		return true;
 
+	if (tipc_lookup_cache_get(net, ua->sr.type, inst, self, sk))
+		return true;
+
 	rcu_read_lock();
 	sc = tipc_service_find(net, ua);
 	if (unlikely(!sc))
@@ -608,6 +669,9 @@ bool tipc_nametbl_lookup_anycast(struct net *net,
 		}
 		*sk = p->sk;
 		res = true;
+		if (list_is_singular(l))
+			tipc_lookup_cache_set(net, ua->sr.type, inst, node,
+					      self, sk);
 		/* Todo: as for legacy, pick the first matching range only, a
 		 * "true" round-robin will be performed as needed.
 		 */
@@ -892,6 +956,13 @@ int tipc_nametbl_init(struct net *net)
 	if (!nt)
 		return -ENOMEM;
 
+	nt->lookup_cache = alloc_percpu(struct tipc_lookup_cache);
+	if (!nt->lookup_cache) {
+		kfree(nt);
+		return -ENOMEM;
+	}
+	atomic_set(&nt->gen, 1);
+
 	for (i = 0; i < TIPC_NAMETBL_SIZE; i++)
 		INIT_HLIST_HEAD(&nt->services[i]);
 
@@ -923,6 +994,7 @@ static void tipc_service_delete(struct net *net, struct tipc_service *sc)
 		kfree(sr);
 	}
 	hlist_del_init_rcu(&sc->service_list);
+	tipc_nametbl_invalidate(net);
 	spin_unlock_bh(&sc->lock);
 	kfree_rcu(sc, rcu);
 }
@@ -950,6 +1022,7 @@ void tipc_nametbl_stop(struct net *net)
 	spin_unlock_bh(&tn->nametbl_lock);
 
 	synchronize_net();
+	free_percpu(nt->lookup_cache);
 	kfree(nt);
 }
 
@@ -50,6 +50,7 @@ struct tipc_uaddr;
 #define TIPC_ZM_SRV		3	/* zone master service name type */
 #define TIPC_PUBL_SCOPE_NUM	(TIPC_NODE_SCOPE + 1)
 #define TIPC_NAMETBL_SIZE	1024	/* must be a power of 2 */
+#define TIPC_LOOKUP_CACHE_SIZE	32	/* must be a power of 2 */
 
 #define TIPC_ANY_SCOPE 10      /* Both node and cluster scope will match */
 
@@ -88,6 +89,32 @@ struct publication {
 	struct rcu_head rcu;
 };
 
+/**
+ * struct tipc_lookup_cache_entry - cached result of an anycast lookup
+ * @type: service type looked up
+ * @instance: service instance looked up
+ * @node: lookup domain node passed by the caller
+ * @self: own node address at the time of the lookup
+ * @gen: name table generation the result is valid for
+ * @sk: the socket address the lookup resolved to
+ */
+struct tipc_lookup_cache_entry {
+	u32 type;
+	u32 instance;
+	u32 node;
+	u32 self;
+	u32 gen;
+	struct tipc_socket_addr sk;
+};
+
+/**
+ * struct tipc_lookup_cache - per-cpu cache of anycast lookup results
+ * @entries: direct mapped cache entries
+ */
+struct tipc_lookup_cache {
+	struct tipc_lookup_cache_entry entries[TIPC_LOOKUP_CACHE_SIZE];
+};
+
 /**
  * struct name_table - table containing all existing port name publications
  * @services: name sequence hash lists
@@ -100,6 +127,8 @@ struct publication {
  * @local_publ_count: number of publications issued by this node
  * @rc_dests: destination node counter
  * @snd_nxt: next sequence number to be used
+ * @lookup_cache: per-cpu anycast lookup results
+ * @gen: generation counter, bumped whenever a publication is added or removed
  */
 struct name_table {
 	struct hlist_head services[TIPC_NAMETBL_SIZE];
@@ -109,6 +138,8 @@ struct name_table {
 	u32 local_publ_count;
 	u32 rc_dests;
 	u32 snd_nxt;
+	struct tipc_lookup_cache __percpu *lookup_cache;
+	atomic_t gen;
 };
 
 int tipc_nl_name_table_dump(struct sk_buff *skb, struct netlink_callback *cb);
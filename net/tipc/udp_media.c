@@ -163,68 +163,99 @@ static int tipc_udp_addr2msg(char *msg, struct tipc_media_addr *a)
 	return 0;
 }
 
-/* tipc_send_msg - enqueue a send request */
-static int tipc_udp_xmit(struct net *net, struct sk_buff *skb,
-			 struct udp_bearer *ub, struct udp_media_addr *src,
-			 struct udp_media_addr *dst, struct dst_cache *cache)
+/* Look up the route to @dst, using @cache when it is still valid.
+ * Must be called with bottom halves disabled.
+ */
+static struct dst_entry *tipc_udp_dst_lookup(struct net *net,
+					     struct udp_bearer *ub,
+					     struct udp_media_addr *src,
+					     struct udp_media_addr *dst,
+					     struct dst_cache *cache, u32 mark)
 {
 	struct dst_entry *ndst;
-	int ttl, err = 0;
 
-	local_bh_disable();
 	ndst = dst_cache_get(cache);
+	if (ndst)
+		return ndst;
+
 	if (dst->proto == htons(ETH_P_IP)) {
-		struct rtable *rt = (struct rtable *)ndst;
-
-		if (!rt) {
-			struct flowi4 fl = {
-				.daddr = dst->ipv4.s_addr,
-				.saddr = src->ipv4.s_addr,
-				.flowi4_mark = skb->mark,
-				.flowi4_proto = IPPROTO_UDP
-			};
-			rt = ip_route_output_key(net, &fl);
-			if (IS_ERR(rt)) {
-				err = PTR_ERR(rt);
-				goto tx_error;
-			}
-			dst_cache_set_ip4(cache, &rt->dst, fl.saddr);
-		}
+		struct flowi4 fl = {
+			.daddr = dst->ipv4.s_addr,
+			.saddr = src->ipv4.s_addr,
+			.flowi4_mark = mark,
+			.flowi4_proto = IPPROTO_UDP
+		};
+		struct rtable *rt;
+
+		rt = ip_route_output_key(net, &fl);
+		if (IS_ERR(rt))
+			return ERR_CAST(rt);
+		dst_cache_set_ip4(cache, &rt->dst, fl.saddr);
+		return &rt->dst;
+	}
+#if IS_ENABLED(CONFIG_IPV6)
+	{
+		struct flowi6 fl6 = {
+			.flowi6_oif = ub->ifindex,
+			.daddr = dst->ipv6,
+			.saddr = src->ipv6,
+			.flowi6_proto = IPPROTO_UDP
+		};
+
+		ndst = ipv6_stub->ipv6_dst_lookup_flow(net, ub->ubsock->sk,
+						       &fl6, NULL);
+		if (IS_ERR(ndst))
+			return ndst;
+		dst_cache_set_ip6(cache, ndst, &fl6.saddr);
+		return ndst;
+	}
+#else
+	return ERR_PTR(-EAFNOSUPPORT);
+#endif
+}
 
-		ttl = ip4_dst_hoplimit(&rt->dst);
-		udp_tunnel_xmit_skb(rt, ub->ubsock->sk, skb, src->ipv4.s_addr,
-				    dst->ipv4.s_addr, 0, ttl, 0, src->port,
+/* Transmit @skb over @ndst, consuming one reference to @ndst */
+static int tipc_udp_xmit_dst(struct sk_buff *skb, struct udp_bearer *ub,
+			     struct udp_media_addr *src,
+			     struct udp_media_addr *dst,
+			     struct dst_entry *ndst)
+{
+	if (dst->proto == htons(ETH_P_IP)) {
+		udp_tunnel_xmit_skb((struct rtable *)ndst, ub->ubsock->sk, skb,
+				    src->ipv4.s_addr, dst->ipv4.s_addr, 0,
+				    ip4_dst_hoplimit(ndst), 0, src->port,
 				    dst->port, false, true);
+		return 0;
+	}
 #if IS_ENABLED(CONFIG_IPV6)
-	} else {
-		if (!ndst) {
-			struct flowi6 fl6 = {
-				.flowi6_oif = ub->ifindex,
-				.daddr = dst->ipv6,
-				.saddr = src->ipv6,
-				.flowi6_proto = IPPROTO_UDP
-			};
-			ndst = ipv6_stub->ipv6_dst_lookup_flow(net,
-							       ub->ubsock->sk,
-							       &fl6, NULL);
-			if (IS_ERR(ndst)) {
-				err = PTR_ERR(ndst);
-				goto tx_error;
-			}
-			dst_cache_set_ip6(cache, ndst, &fl6.saddr);
-		}
-		ttl = ip6_dst_hoplimit(ndst);
-		err = udp_tunnel6_xmit_skb(ndst, ub->ubsock->sk, skb, NULL,
-					   &src->ipv6, &dst->ipv6, 0, ttl, 0,
-					   src->port, dst->port, false);
+	return udp_tunnel6_xmit_skb(ndst, ub->ubsock->sk, skb, NULL,
+				    &src->ipv6, &dst->ipv6, 0,
+				    ip6_dst_hoplimit(ndst), 0, src->port,
+				    dst->port, false);
+#else
+	dst_release(ndst);
+	kfree_skb(skb);
+	return -EAFNOSUPPORT;
 #endif
-	}
-	local_bh_enable();
-	return err;
+}
 
-tx_error:
+/* tipc_send_msg - enqueue a send request */
+static int tipc_udp_xmit(struct net *net, struct sk_buff *skb,
+			 struct udp_bearer *ub, struct udp_media_addr *src,
+			 struct udp_media_addr *dst, struct dst_cache *cache)
+{
+	struct dst_entry *ndst;
+	int err;
+
+	local_bh_disable();
+	ndst = tipc_udp_dst_lookup(net, ub, src, dst, cache, skb->mark);
+	if (IS_ERR(ndst)) {
+		err = PTR_ERR(ndst);
+		kfree_skb(skb);
+	} else {
+		err = tipc_udp_xmit_dst(skb, ub, src, dst, ndst);
+	}
 	local_bh_enable();
-	kfree_skb(skb);
 	return err;
 }
 
@@ -276,6 +307,51 @@ static int tipc_udp_send_msg(struct net *net, struct sk_buff *skb,
 	return err;
 }
 
+/* Send a burst of buffers to the same peer, resolving the route once */
+static int tipc_udp_send_batch(struct net *net, struct sk_buff_head *xmitq,
+			       struct tipc_bearer *b,
+			       struct tipc_media_addr *addr)
+{
+	struct udp_media_addr *src = (struct udp_media_addr *)&b->addr.value;
+	struct udp_media_addr *dst = (struct udp_media_addr *)&addr->value;
+	struct dst_entry *ndst;
+	struct udp_bearer *ub;
+	struct sk_buff *skb;
+	int err = 0;
+
+	ub = rcu_dereference(b->media_ptr);
+	if (!ub || addr->broadcast == TIPC_REPLICAST_SUPPORT) {
+		while ((skb = __skb_dequeue(xmitq)))
+			err = tipc_udp_send_msg(net, skb, b, addr);
+		return err;
+	}
+
+	local_bh_disable();
+	ndst = tipc_udp_dst_lookup(net, ub, src, dst, &ub->rcast.dst_cache,
+				   skb_peek(xmitq)->mark);
+	if (IS_ERR(ndst)) {
+		err = PTR_ERR(ndst);
+		__skb_queue_purge(xmitq);
+		goto out;
+	}
+
+	while ((skb = __skb_dequeue(xmitq))) {
+		if (skb_headroom(skb) < UDP_MIN_HEADROOM &&
+		    pskb_expand_head(skb, UDP_MIN_HEADROOM, 0, GFP_ATOMIC)) {
+			kfree_skb(skb);
+			err = -ENOMEM;
+			continue;
+		}
+		skb_set_inner_protocol(skb, htons(ETH_P_TIPC));
+		dst_hold(ndst);
+		tipc_udp_xmit_dst(skb, ub, src, dst, ndst);
+	}
+	dst_release(ndst);
+out:
+	local_bh_enable();
+	return err;
+}
+
 static bool tipc_udp_is_known_peer(struct tipc_bearer *b,
 				   struct udp_media_addr *addr)
 {
@@ -842,6 +918,7 @@ static void tipc_udp_disable(struct tipc_bearer *b)
 
 struct tipc_media udp_media_info = {
 	.send_msg	= tipc_udp_send_msg,
+	.send_batch	= tipc_udp_send_batch,
 	.enable_media	= tipc_udp_enable,
 	.disable_media	= tipc_udp_disable,
 	.addr2str	= tipc_udp_addr2str,
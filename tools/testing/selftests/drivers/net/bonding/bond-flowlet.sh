@@ -0,0 +1,89 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Test xmit_hash_policy flowlet3+4 on a balance-xor bond of two veths.
+#
+# One slave is throttled by a tbf qdisc, so its backlog keeps growing.
+# Many UDP flows then go out with gaps longer than flowlet_gap_us between
+# the packets of each flow, and most of them should end up on the other
+# slave. Packets are counted as they are enqueued on each slave, because
+# the throttled one only sends a trickle of what it is given.
+
+ksft_skip=4
+
+ns="bond-flowlet-$$"
+ret=0
+
+cleanup()
+{
+	ip netns del "$ns" >/dev/null 2>&1
+	ip netns del "$ns-peer" >/dev/null 2>&1
+}
+
+enqueued()
+{
+	# Sent, still queued and dropped by the root qdisc of a slave
+	ip netns exec "$ns" tc -s -j qdisc show dev "$1" root |
+		jq '.[0].packets + .[0].qlen + .[0].drops'
+}
+
+for tool in jq mausezahn; do
+	if ! command -v $tool >/dev/null; then
+		echo "SKIP: $tool not found"
+		exit $ksft_skip
+	fi
+done
+
+trap cleanup EXIT
+
+ip netns add "$ns"
+ip netns add "$ns-peer"
+
+ip -n "$ns" link add bond0 type bond mode balance-xor miimon 100
+if ! ip netns exec "$ns" sh -c \
+	'echo flowlet3+4 > /sys/class/net/bond0/bonding/xmit_hash_policy' \
+	2>/dev/null; then
+	echo "SKIP: xmit_hash_policy flowlet3+4 not supported"
+	exit $ksft_skip
+fi
+
+for i in 0 1; do
+	ip -n "$ns" link add veth$i type veth peer name peer$i netns "$ns-peer"
+	ip -n "$ns" link set veth$i master bond0
+	ip -n "$ns-peer" link set peer$i up
+done
+ip -n "$ns" addr add 192.0.2.1/24 dev bond0
+ip -n "$ns" link set bond0 up
+
+ip netns exec "$ns" tc qdisc add dev veth0 root tbf \
+	rate 1mbit burst 4kb limit 10mb
+ip netns exec "$ns" tc qdisc add dev veth1 root pfifo limit 10000
+
+# Let the links come up and the first load samples come in
+sleep 1
+
+# 100 flows, one packet every 100 usecs, so 10 msecs between the
+# packets of each flow
+ip netns exec "$ns" mausezahn bond0 -q -c 10000 -d 100usec -p 1000 \
+	-b 00:11:22:33:44:55 -A 192.0.2.1 -B 192.0.2.2 \
+	-t udp "sp=1024-1123,dp=9"
+
+slow=$(enqueued veth0)
+fast=$(enqueued veth1)
+moves=$(ip netns exec "$ns" awk '/Flowlet moves/ { print $3 }' \
+	/proc/net/bonding/bond0)
+
+echo "throttled slave: $slow packets, other slave: $fast packets," \
+     "$moves flowlet moves"
+
+if [ "$fast" -le $((slow * 2)) ]; then
+	echo "FAIL: flowlets did not move off the throttled slave"
+	ret=1
+elif [ "${moves:-0}" -eq 0 ]; then
+	echo "FAIL: no flowlet moves counted"
+	ret=1
+else
+	echo "PASS: flowlets moved off the throttled slave"
+fi
+
+exit $ret
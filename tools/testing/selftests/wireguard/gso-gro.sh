@@ -0,0 +1,190 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Checks that WireGuard sends ciphertext in UDP GSO batches and receives it in
+# UDP GRO batches when the underlay takes them, and that the batch counters
+# are exported over netlink. The topology is two namespaces, each with a wg0,
+# whose ciphertext goes over a veth pair:
+#
+# ┌────────────────────┐          ┌────────────────────┐
+# │ $netns1 namespace  │          │ $netns2 namespace  │
+# │                    │          │                    │
+# │ wg0: 192.168.241.1 │          │ wg0: 192.168.241.2 │
+# │ veth1: 10.0.0.1    ├──────────┤ veth2: 10.0.0.2    │
+# └────────────────────┘          └────────────────────┘
+#
+# A TCP stream is pushed through the tunnel three times: with GRO off on the
+# veth pair, which makes veth hand over the batches as they are, with GRO on,
+# and with UDP segmentation offload off on veth1, so that the batches are cut
+# apart in software on the way out and put back together by GRO.
+
+set -e
+shopt -s extglob
+
+ksft_skip=4
+exec 3>&1
+export LANG=C
+export WG_HIDE_KEYS=never
+netns1="wg-gso-$$-1"
+netns2="wg-gso-$$-2"
+pretty() { echo -e "\x1b[32m\x1b[1m[+] ${1:+NS$1: }${2}\x1b[0m" >&3; }
+pp() { pretty "" "$*"; "$@"; }
+n1() { pretty 1 "$*"; maybe_exec ip netns exec $netns1 "$@"; }
+n2() { pretty 2 "$*"; maybe_exec ip netns exec $netns2 "$@"; }
+ip1() { pretty 1 "ip $*"; ip -n $netns1 "$@"; }
+ip2() { pretty 2 "ip $*"; ip -n $netns2 "$@"; }
+maybe_exec() { if [[ $BASHPID -eq $$ ]]; then "$@"; else exec "$@"; fi; }
+waitiperf() { pretty "${1//*-}" "wait for iperf:${3:-5201} pid $2"; while [[ $(ss -N "$1" -tlpH "sport = ${3:-5201}") != *\"iperf3\",pid=$2,fd=* ]]; do sleep 0.1; done; }
+
+for tool in wg iperf3 python3; do
+	if ! command -v $tool >/dev/null; then
+		echo "SKIP: $tool not found"
+		exit $ksft_skip
+	fi
+done
+
+cleanup() {
+	set +e
+	exec 2>/dev/null
+	ip1 link del dev wg0
+	ip2 link del dev wg0
+	ip1 link del dev veth1
+	local to_kill="$(ip netns pids $netns1) $(ip netns pids $netns2)"
+	[[ -n $to_kill ]] && kill $to_kill
+	pp ip netns del $netns1
+	pp ip netns del $netns2
+	exit
+}
+
+trap cleanup EXIT
+
+# Prints a WGPEER_A_* counter of the only peer of wg0. The wg tool does not
+# know about the batch counters, so this does its own WG_CMD_GET_DEVICE dump.
+wg_peer_counter() {
+	ip netns exec "$1" python3 - "$2" <<-'EOF'
+	import socket, struct, sys
+
+	NLMSG_ERROR, NLMSG_DONE = 2, 3
+	NLM_F_REQUEST, NLM_F_DUMP = 0x1, 0x300
+	GENL_ID_CTRL, CTRL_CMD_GETFAMILY = 0x10, 3
+	CTRL_ATTR_FAMILY_ID, CTRL_ATTR_FAMILY_NAME = 1, 2
+	WG_CMD_GET_DEVICE, WGDEVICE_A_IFNAME, WGDEVICE_A_PEERS = 0, 2, 8
+	WGPEER_A = {
+	    "tx_gso_batches": 11, "tx_gso_packets": 12,
+	    "rx_gro_batches": 13, "rx_gro_packets": 14,
+	}
+
+	def attrs(buf):
+	    out = {}
+	    while len(buf) >= 4:
+	        length, kind = struct.unpack_from("HH", buf)
+	        out[kind & 0x3fff] = buf[4:length]
+	        buf = buf[(length + 3) & ~3:]
+	    return out
+
+	def attr(kind, payload):
+	    data = struct.pack("HH", 4 + len(payload), kind) + payload
+	    return data + b"\0" * (-len(data) & 3)
+
+	def request(sock, family, flags, cmd, payload):
+	    hdr = struct.pack("IHHII", 16 + 4 + len(payload), family,
+	                      NLM_F_REQUEST | flags, 1, 0)
+	    sock.send(hdr + struct.pack("BBH", cmd, 1, 0) + payload)
+	    msgs = []
+	    while True:
+	        buf = sock.recv(65536)
+	        while buf:
+	            length, kind = struct.unpack_from("IH", buf)
+	            if kind == NLMSG_ERROR:
+	                err = struct.unpack_from("i", buf, 16)[0]
+	                if err:
+	                    sys.exit("netlink error %d" % err)
+	            elif kind == NLMSG_DONE:
+	                return msgs
+	            else:
+	                msgs.append(attrs(buf[20:length]))
+	            buf = buf[(length + 3) & ~3:]
+	        if not flags & NLM_F_DUMP:
+	            return msgs
+
+	sock = socket.socket(socket.AF_NETLINK, socket.SOCK_RAW, 16)
+	family = request(sock, GENL_ID_CTRL, 0, CTRL_CMD_GETFAMILY,
+	                 attr(CTRL_ATTR_FAMILY_NAME, b"wireguard\0"))
+	family = struct.unpack("H", family[0][CTRL_ATTR_FAMILY_ID][:2])[0]
+	total = 0
+	for msg in request(sock, family, NLM_F_DUMP, WG_CMD_GET_DEVICE,
+	                   attr(WGDEVICE_A_IFNAME, b"wg0\0")):
+	    for peer in attrs(msg.get(WGDEVICE_A_PEERS, b"")).values():
+	        value = attrs(peer).get(WGPEER_A[sys.argv[1]])
+	        if value is None:
+	            sys.exit("no %s attribute" % sys.argv[1])
+	        total += struct.unpack("Q", value)[0]
+	print(total)
+	EOF
+}
+
+ip netns del $netns1 2>/dev/null || true
+ip netns del $netns2 2>/dev/null || true
+pp ip netns add $netns1
+pp ip netns add $netns2
+ip1 link add veth1 type veth peer name veth2 netns $netns2
+ip1 addr add 10.0.0.1/24 dev veth1
+ip2 addr add 10.0.0.2/24 dev veth2
+ip1 link set veth1 up
+ip2 link set veth2 up
+
+key1="$(pp wg genkey)"
+key2="$(pp wg genkey)"
+pub1="$(pp wg pubkey <<<"$key1")"
+pub2="$(pp wg pubkey <<<"$key2")"
+ip1 link add dev wg0 type wireguard
+ip2 link add dev wg0 type wireguard
+n1 wg set wg0 private-key <(echo "$key1") listen-port 1 \
+	peer "$pub2" allowed-ips 192.168.241.2/32 endpoint 10.0.0.2:2
+n2 wg set wg0 private-key <(echo "$key2") listen-port 2 \
+	peer "$pub1" allowed-ips 192.168.241.1/32 endpoint 10.0.0.1:1
+ip1 addr add 192.168.241.1/24 dev wg0
+ip2 addr add 192.168.241.2/24 dev wg0
+ip1 link set wg0 up
+ip2 link set wg0 up
+n1 ping -c 1 -W 1 192.168.241.2
+
+tx_batches=0 tx_packets=0 rx_batches=0 rx_packets=0
+check_batches() {
+	local tb tp rb rp
+
+	tb=$(wg_peer_counter $netns1 tx_gso_batches)
+	tp=$(wg_peer_counter $netns1 tx_gso_packets)
+	rb=$(wg_peer_counter $netns2 rx_gro_batches)
+	rp=$(wg_peer_counter $netns2 rx_gro_packets)
+	set -- "$1" $((tb - tx_batches)) $((tp - tx_packets)) \
+		$((rb - rx_batches)) $((rp - rx_packets))
+	tx_batches=$tb tx_packets=$tp rx_batches=$rb rx_packets=$rp
+	pretty "" "$1: sent $3 packets in $2 GSO batches, received $5 packets in $4 GRO batches"
+
+	# Every batch holds at least two packets
+	[[ $2 -gt 0 && $3 -ge $(($2 * 2)) ]]
+	[[ $4 -gt 0 && $5 -ge $(($4 * 2)) ]]
+}
+
+for mode in "gro off" "gro on" "tx-udp-segmentation off"; do
+	if [[ $mode == gro* ]]; then
+		n2 ethtool -K veth2 $mode 2>/dev/null
+	else
+		n1 ethtool -K veth1 $mode 2>/dev/null
+	fi || if [[ $mode != "gro off" ]]; then
+		pretty "" "SKIP: veth $mode needs ethtool"
+		continue
+	fi
+	n2 iperf3 -s -1 -B 192.168.241.2 &
+	waitiperf $netns2 $!
+	n1 iperf3 -Z -t 3 -c 192.168.241.2
+	check_batches "veth $mode"
+done
+
+# The tunnel still works with batching for a peer in both directions.
+n2 iperf3 -s -1 -B 192.168.241.2 &
+waitiperf $netns2 $!
+n1 iperf3 -Z -t 3 -c 192.168.241.2 -R
+
+echo "PASS: ciphertext went out and came in batched"